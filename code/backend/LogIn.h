@@ -26,6 +26,6 @@ private:
     //string _databasePath;
 };
 
-void setupLoginRoutes(crow::SimpleApp& app, LogInManager& loginManager, sqlite3* db);
+void setupLoginRoutes(FitnessApp& app, Database& database);
 
 #endif
\ No newline at end of file
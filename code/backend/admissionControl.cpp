@@ -0,0 +1,398 @@
+#include "admissionControl.h"
+#include "helper.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+constexpr int TOKEN_BITS = 24;                                  // low bits: milli-tokens
+constexpr uint64_t TOKEN_MASK = (uint64_t{1} << TOKEN_BITS) - 1;
+constexpr double MAX_BURST = static_cast<double>(TOKEN_MASK / 1000);
+constexpr std::size_t MAX_BUCKETS_PER_SHARD = 4096;
+constexpr std::size_t EVICTION_SCAN = 16;          // LRU entries looked at per insert when over the limit
+constexpr double PER_USER_IP_SHARE = 8;            // users' worth one address may spend on a PerUser rule
+
+int64_t steadyMs()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+long envLong(const char* name, long fallback)
+{
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    return (end && *end == '\0' && parsed >= 0) ? parsed : fallback;
+}
+
+std::string trim(const std::string& s)
+{
+    std::size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    std::size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+// "COUNT/SECONDS", e.g. "10/60" = bursts of 10, refilled over a minute.
+bool parseRate(const std::string& text, double& capacity, double& perSecond)
+{
+    std::size_t slash = text.find('/');
+    if (slash == std::string::npos) return false;
+    char* end = nullptr;
+    double count = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + slash || count < 1) return false;
+    double seconds = std::strtod(text.c_str() + slash + 1, &end);
+    if (*end != '\0' || seconds <= 0) return false;
+    capacity = std::min(count, MAX_BURST);
+    perSecond = count / seconds;
+    return true;
+}
+
+// One rule: "METHOD /path=COUNT/SECONDS[@ip|@user|@route][#MAXCONCURRENT]"
+bool parseRule(const std::string& text, RateRule& rule)
+{
+    std::size_t eq = text.find('=');
+    if (eq == std::string::npos) return false;
+    std::istringstream target(text.substr(0, eq));
+    std::string method, path;
+    target >> method >> path;
+    if (path.empty()) {
+        path = method;
+        method.clear();
+    }
+    if (path.empty() || path[0] != '/') return false;
+    rule.method = (method == "*") ? "" : method;
+    rule.path = path;
+
+    std::string rest = trim(text.substr(eq + 1));
+    std::size_t hash = rest.find('#');
+    if (hash != std::string::npos) {
+        rule.maxConcurrent = std::atoi(rest.c_str() + hash + 1);
+        rest.resize(hash);
+    }
+    std::size_t at = rest.find('@');
+    rule.scope = RateRule::PerIp;
+    if (at != std::string::npos) {
+        std::string scope = rest.substr(at + 1);
+        if (scope == "user") rule.scope = RateRule::PerUser;
+        else if (scope == "route") rule.scope = RateRule::PerRoute;
+        else if (scope != "ip") return false;
+        rest.resize(at);
+    }
+    return parseRate(rest, rule.capacity, rule.perSecond);
+}
+
+RateRule makeRule(const char* method, const char* path, RateRule::Scope scope, double count, double seconds,
+                  int maxConcurrent = 0)
+{
+    RateRule rule;
+    rule.method = method;
+    rule.path = path;
+    rule.scope = scope;
+    rule.capacity = count;
+    rule.perSecond = count / seconds;
+    rule.maxConcurrent = maxConcurrent;
+    return rule;
+}
+
+std::vector<RateRule> loadRules()
+{
+    // Routes that run Argon2 are held to about one request per core at a time:
+    // each hash takes tens of megabytes and a quarter second of CPU.
+    int hashing = static_cast<int>(envLong("MAX_CONCURRENT_HASHING", std::max(1u, std::thread::hardware_concurrency())));
+
+    std::vector<RateRule> rules = {
+        makeRule("POST", "/login", RateRule::PerIp, 10, 60, hashing),
+        makeRule("POST", "/register", RateRule::PerIp, 5, 300, hashing),
+        makeRule("POST", "/auth/api/forgot-password", RateRule::PerIp, 5, 900),
+        makeRule("POST", "/auth/api/reset-password", RateRule::PerIp, 10, 900, hashing),
+        makeRule("GET", "/api/friends/search", RateRule::PerUser, 30, 60),
+    };
+
+    const char* env = std::getenv("RATE_LIMITS");
+    if (env && *env) {
+        std::vector<RateRule> custom;
+        std::stringstream list(env);
+        std::string item;
+        while (std::getline(list, item, ';')) {
+            item = trim(item);
+            if (item.empty()) continue;
+            RateRule rule;
+            if (parseRule(item, rule)) {
+                custom.push_back(rule);
+            } else {
+                std::cerr << "Ignoring malformed RATE_LIMITS entry: " << item << std::endl;
+            }
+        }
+        rules = std::move(custom);
+    }
+
+    // Catch-all per client, checked after the route rules. "0" turns it off.
+    const char* fallback = std::getenv("RATE_LIMIT_DEFAULT");
+    std::string defaultRate = (fallback && *fallback) ? fallback : "600/60";
+    RateRule catchAll;
+    catchAll.path = "/*";
+    if (defaultRate != "0") {
+        if (parseRate(defaultRate, catchAll.capacity, catchAll.perSecond)) {
+            rules.push_back(catchAll);
+        } else {
+            std::cerr << "Ignoring malformed RATE_LIMIT_DEFAULT: " << defaultRate << std::endl;
+        }
+    }
+    return rules;
+}
+
+} // namespace
+
+// ---- TokenBucket ----
+
+TokenBucket::TokenBucket(double capacity, double perSecond, int64_t nowMs)
+    : _capacityMilli(static_cast<uint64_t>(std::min(capacity, MAX_BURST) * 1000)), _perSecond(perSecond)
+{
+    _state.store((static_cast<uint64_t>(nowMs) << TOKEN_BITS) | _capacityMilli, std::memory_order_relaxed);
+}
+
+bool TokenBucket::tryTake(int64_t nowMs, int64_t& retryAfterMs)
+{
+    uint64_t now = static_cast<uint64_t>(nowMs);
+    uint64_t old = _state.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t last = old >> TOKEN_BITS;
+        uint64_t elapsed = now > last ? now - last : 0;
+        double refilled = static_cast<double>(old & TOKEN_MASK) + static_cast<double>(elapsed) * _perSecond;
+        uint64_t tokens = static_cast<uint64_t>(std::min(refilled, static_cast<double>(_capacityMilli)));
+
+        if (tokens < 1000) {
+            // Nothing is written, so the refill keeps counting from `last`.
+            retryAfterMs = static_cast<int64_t>((1000 - tokens) / _perSecond) + 1;
+            return false;
+        }
+        uint64_t next = (std::max(now, last) << TOKEN_BITS) | (tokens - 1000);
+        if (_state.compare_exchange_weak(old, next, std::memory_order_relaxed)) return true;
+    }
+}
+
+bool TokenBucket::full(int64_t nowMs) const
+{
+    uint64_t state = _state.load(std::memory_order_relaxed);
+    uint64_t last = state >> TOKEN_BITS;
+    uint64_t now = static_cast<uint64_t>(nowMs);
+    uint64_t elapsed = now > last ? now - last : 0;
+    double refilled = static_cast<double>(state & TOKEN_MASK) + static_cast<double>(elapsed) * _perSecond;
+    return refilled >= static_cast<double>(_capacityMilli);
+}
+
+// ---- RateRule ----
+
+bool RateRule::matches(const std::string& reqMethod, const std::string& reqPath) const
+{
+    if (!method.empty() && method != reqMethod) return false;
+    if (!path.empty() && path.back() == '*') {
+        return reqPath.compare(0, path.size() - 1, path, 0, path.size() - 1) == 0;
+    }
+    return reqPath == path;
+}
+
+// ---- BucketTable ----
+
+std::shared_ptr<TokenBucket> BucketTable::get(const std::string& key, const RateRule& rule, int64_t nowMs)
+{
+    Shard& shard = _shards[std::hash<std::string>()(key) % _shards.size()];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.buckets.find(key);
+    if (it != shard.buckets.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.second);
+        return it->second.first;
+    }
+
+    // Over the limit: forget the least recently used buckets that are full and
+    // unreferenced. A bucket still refilling would give its client a new burst.
+    auto candidate = shard.lru.end();
+    for (std::size_t scanned = 0; shard.buckets.size() >= _maxPerShard && candidate != shard.lru.begin() &&
+                                  scanned < EVICTION_SCAN; ++scanned) {
+        --candidate;
+        auto victim = shard.buckets.find(*candidate);
+        const std::shared_ptr<TokenBucket>& bucket = victim->second.first;
+        if (bucket.use_count() == 1 && bucket->full(nowMs)) {
+            shard.buckets.erase(victim);
+            candidate = shard.lru.erase(candidate);
+        }
+    }
+    shard.lru.push_front(key);
+    auto bucket = std::make_shared<TokenBucket>(rule.capacity, rule.perSecond, nowMs);
+    shard.buckets.emplace(key, std::make_pair(bucket, shard.lru.begin()));
+    return bucket;
+}
+
+std::size_t BucketTable::size()
+{
+    std::size_t total = 0;
+    for (Shard& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.buckets.size();
+    }
+    return total;
+}
+
+// ---- AdmissionControl ----
+
+struct AdmissionControl::State {
+    std::vector<RateRule> rules;
+    std::vector<RateRule> perAddress;                   // PerUser rules: what one address may spend in total
+    std::unique_ptr<std::atomic<int>[]> ruleInFlight;   // one counter per rule
+    BucketTable buckets{MAX_BUCKETS_PER_SHARD};
+    int maxInFlight = 0;
+    bool trustProxy = false;
+    std::atomic<bool> draining{false};
+
+    std::atomic<int64_t> inFlight{0};
+    std::atomic<uint64_t> admitted{0};
+    std::atomic<uint64_t> rateLimited{0};
+    std::atomic<uint64_t> shed{0};
+};
+
+AdmissionControl::AdmissionControl() : _state(std::make_shared<State>())
+{
+    _state->rules = loadRules();
+    for (RateRule rule : _state->rules) {
+        rule.capacity = std::min(rule.capacity * PER_USER_IP_SHARE, MAX_BURST);
+        rule.perSecond *= PER_USER_IP_SHARE;
+        _state->perAddress.push_back(rule);
+    }
+    _state->ruleInFlight.reset(new std::atomic<int>[_state->rules.size()]);
+    for (std::size_t i = 0; i < _state->rules.size(); ++i) _state->ruleInFlight[i] = 0;
+    _state->maxInFlight = static_cast<int>(envLong("MAX_INFLIGHT_REQUESTS", 256));
+    _state->trustProxy = envLong("TRUST_PROXY", 0) != 0;
+}
+
+namespace {
+
+std::string clientIp(const crow::request& req, bool trustProxy)
+{
+    if (trustProxy) {
+        // The proxy appends the address it saw; the first entry is the original client.
+        std::string forwarded = req.get_header_value("X-Forwarded-For");
+        if (!forwarded.empty()) return trim(forwarded.substr(0, forwarded.find(',')));
+    }
+    return req.remote_ip_address;
+}
+
+void reject(crow::response& res, int code, const char* message, int64_t retryAfterMs, bool close = false)
+{
+    crow::json::wvalue body;
+    body["status"] = "error";
+    body["message"] = message;
+    res.code = code;
+    res.set_header("Content-Type", "application/json");
+    res.set_header("Retry-After", std::to_string(std::max<int64_t>(1, (retryAfterMs + 999) / 1000)));
+    if (close) res.set_header("Connection", "close");
+    res.write(body.dump());
+    res.end();
+}
+
+} // namespace
+
+void AdmissionControl::before_handle(crow::request& req, crow::response& res, context& ctx)
+{
+    State& s = *_state;
+    // Probes report their own state and must not be throttled or shed.
+    if (req.url == "/healthz" || req.url == "/readyz") return;
+
+    if (s.draining.load(std::memory_order_relaxed)) {
+        s.shed.fetch_add(1, std::memory_order_relaxed);
+        reject(res, 503, "Server is restarting, try again shortly", 1000, true);
+        return;
+    }
+
+    const std::string method = crow::method_name(req.method);
+    const std::string ip = clientIp(req, s.trustProxy);
+    const int64_t now = steadyMs();
+
+    for (std::size_t i = 0; i < s.rules.size(); ++i) {
+        const RateRule& rule = s.rules[i];
+        if (!rule.matches(method, req.url)) continue;
+
+        std::string key = std::to_string(i);
+        if (rule.scope != RateRule::PerRoute) key += "|ip:" + ip;
+
+        int64_t retryAfterMs = 0;
+        bool allowed = true;
+        if (rule.scope == RateRule::PerUser) {
+            // The user_id cookie is unverified, so the address pays for every id it sends
+            allowed = s.buckets.get(key, s.perAddress[i], now)->tryTake(now, retryAfterMs);
+            key += "|user:" + getCookieValue(req.get_header_value("Cookie"), "user_id");
+        }
+        if (allowed) allowed = s.buckets.get(key, rule, now)->tryTake(now, retryAfterMs);
+        if (!allowed) {
+            s.rateLimited.fetch_add(1, std::memory_order_relaxed);
+            logEvent(LogLevel::Warn, "rate_limited").field("path", req.url).field("ip", ip).field("retry_after_ms", retryAfterMs);
+            reject(res, 429, "Too many requests", retryAfterMs);
+            return;
+        }
+    }
+
+    // Concurrency caps: take every slot or none.
+    ctx.counted = true;
+    bool overloaded = s.inFlight.fetch_add(1, std::memory_order_relaxed) >= s.maxInFlight && s.maxInFlight > 0;
+    for (std::size_t i = 0; i < s.rules.size() && !overloaded; ++i) {
+        const RateRule& rule = s.rules[i];
+        if (rule.maxConcurrent <= 0 || !rule.matches(method, req.url)) continue;
+        ctx.concurrencySlots.push_back(static_cast<int>(i));
+        overloaded = s.ruleInFlight[i].fetch_add(1, std::memory_order_relaxed) >= rule.maxConcurrent;
+    }
+    if (overloaded) {
+        release(ctx);
+        s.shed.fetch_add(1, std::memory_order_relaxed);
+        reject(res, 503, "Server busy, try again shortly", 1000);
+        return;
+    }
+    s.admitted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AdmissionControl::after_handle(crow::request&, crow::response&, context& ctx)
+{
+    release(ctx);
+}
+
+void AdmissionControl::release(context& ctx)
+{
+    State& s = *_state;
+    for (int i : ctx.concurrencySlots) s.ruleInFlight[i].fetch_sub(1, std::memory_order_relaxed);
+    ctx.concurrencySlots.clear();
+    if (ctx.counted) s.inFlight.fetch_sub(1, std::memory_order_relaxed);
+    ctx.counted = false;
+}
+
+AdmissionStats AdmissionControl::stats() const
+{
+    return AdmissionStats{
+        _state->admitted.load(std::memory_order_relaxed),
+        _state->rateLimited.load(std::memory_order_relaxed),
+        _state->shed.load(std::memory_order_relaxed),
+        _state->inFlight.load(std::memory_order_relaxed),
+        _state->buckets.size(),
+    };
+}
+
+void AdmissionControl::beginDrain()
+{
+    _state->draining = true;
+}
+
+bool AdmissionControl::waitIdle(std::chrono::steady_clock::time_point deadline) const
+{
+    while (_state->inFlight.load(std::memory_order_relaxed) > 0) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
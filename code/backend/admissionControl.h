@@ -0,0 +1,128 @@
+#pragma once
+#include <crow.h>
+#include "requestArena.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Token bucket whose whole state (last refill time and milli-tokens) is one
+// 64-bit word updated with compare-and-swap, so takers never lock.
+class TokenBucket
+{
+public:
+    TokenBucket(double capacity, double perSecond, int64_t nowMs);
+
+    // Takes one token. On failure `retryAfterMs` says when one will be available.
+    bool tryTake(int64_t nowMs, int64_t& retryAfterMs);
+
+    // Whether it has refilled to capacity, i.e. dropping it and starting a
+    // fresh one would change nothing for its client.
+    bool full(int64_t nowMs) const;
+
+private:
+    std::atomic<uint64_t> _state;
+    uint64_t _capacityMilli;
+    double _perSecond;   // tokens per second == milli-tokens per millisecond
+};
+
+struct RateRule {
+    // PerUser is keyed on the client IP plus its user_id cookie, which is not
+    // verified. Each address is also held to 8 users' worth of the rule,
+    // so inventing ids from one address cannot buy more than that.
+    enum Scope { PerIp, PerUser, PerRoute };
+
+    std::string method;       // "" matches any method
+    std::string path;         // exact, or a prefix when it ends in '*'
+    Scope scope = PerIp;
+    double capacity = 0;      // burst size
+    double perSecond = 0;     // refill rate
+    int maxConcurrent = 0;    // 0 = no concurrency cap for this route
+
+    bool matches(const std::string& reqMethod, const std::string& reqPath) const;
+};
+
+// Buckets keyed by rule + client, split over shards so lookups on different
+// keys rarely share a lock. Once a shard holds maxPerShard buckets it drops
+// the least recently used ones that have refilled to full and that no request
+// is holding; only those can be forgotten without handing their client a
+// fresh burst. If none qualifies the shard grows past the limit until some do.
+class BucketTable
+{
+public:
+    explicit BucketTable(std::size_t maxPerShard) : _maxPerShard(maxPerShard) {}
+
+    std::shared_ptr<TokenBucket> get(const std::string& key, const RateRule& rule, int64_t nowMs);
+    std::size_t size();
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::string> lru;   // front = most recently used
+        std::unordered_map<std::string, std::pair<std::shared_ptr<TokenBucket>, std::list<std::string>::iterator>> buckets;
+    };
+
+    std::size_t _maxPerShard;
+    std::array<Shard, 16> _shards;
+};
+
+struct AdmissionStats {
+    uint64_t admitted;
+    uint64_t rateLimited;     // answered 429
+    uint64_t shed;            // answered 503
+    int64_t inFlight;
+    std::size_t buckets;
+};
+
+// Crow middleware in front of every route:
+//  - per-IP, per-user and per-route token buckets (RATE_LIMITS, RATE_LIMIT_DEFAULT)
+//    answer 429 with Retry-After when a client is over its limit;
+//  - a global cap on in-flight requests (MAX_INFLIGHT_REQUESTS) and per-route
+//    caps on the password-hashing routes (MAX_CONCURRENT_HASHING) answer 503
+//    instead of letting work queue up behind the database.
+// /healthz and /readyz bypass all of it.
+struct AdmissionControl
+{
+    struct context {
+        bool counted = false;
+        std::vector<int> concurrencySlots;   // rule indexes holding a slot
+    };
+
+    AdmissionControl();
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx);
+    void after_handle(crow::request& req, crow::response& res, context& ctx);
+
+    AdmissionStats stats() const;
+
+    // From now on every new request gets 503 + Connection: close, so only
+    // the ones already admitted keep running. Used during shutdown.
+    void beginDrain();
+    // Waits until no admitted request is left or `deadline` passes.
+    bool waitIdle(std::chrono::steady_clock::time_point deadline) const;
+
+private:
+    struct State;
+    void release(context& ctx);
+
+    std::shared_ptr<State> _state;   // shared so Crow may copy or move the middleware
+};
+
+// Opens the worker thread's request arena (requestArena.h) for each request
+// and releases it once the handler has returned. Listed after
+// AdmissionControl, so rejected requests never touch it.
+struct RequestArenaMiddleware
+{
+    struct context {};
+
+    void before_handle(crow::request&, crow::response&, context&) { openRequestArena(); }
+    void after_handle(crow::request&, crow::response&, context&) { closeRequestArena(); }
+};
+
+using FitnessApp = crow::App<AdmissionControl, RequestArenaMiddleware>;
@@ -0,0 +1,142 @@
+#include "auth.h"
+#include "hash.h"
+#include "userDirectory.h"
+#include <cstdio>
+#include <cstring>
+
+bool parsePasswordHashParams(const std::string& hash, PasswordHashParams& out)
+{
+    // $<alg>$v=<n>$m=<KiB>,t=<ops>,p=<lanes>$<salt>$<hash>
+    if (hash.size() < 2 || hash[0] != '$') return false;
+    std::size_t algEnd = hash.find('$', 1);
+    if (algEnd == std::string::npos) return false;
+    std::size_t paramStart = hash.find("$m=", algEnd);
+    if (paramStart == std::string::npos) return false;
+
+    unsigned long long memKiB = 0, ops = 0;
+    int lanes = 0;
+    if (std::sscanf(hash.c_str() + paramStart, "$m=%llu,t=%llu,p=%d", &memKiB, &ops, &lanes) != 3) {
+        return false;
+    }
+
+    out.algorithm = hash.substr(1, algEnd - 1);
+    out.memlimitBytes = memKiB * 1024ULL;
+    out.opslimit = ops;
+    out.parallelism = lanes;
+    return true;
+}
+
+// Replaces the stored hash, unless it changed since we read it (e.g. a concurrent reset).
+// `newHash` is computed by the caller before it takes the write lease.
+static bool storeUpgradedHash(sqlite3* db, int userId, const std::string& newHash, const std::string& oldHash)
+{
+    const char* sql = "UPDATE users SET password_hash = ? WHERE id = ? AND password_hash = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, newHash.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, userId);
+    sqlite3_bind_text(stmt, 3, oldHash.c_str(), -1, SQLITE_TRANSIENT);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) > 0;
+    sqlite3_finalize(stmt);
+
+    if (ok) userDirectory().refreshUser(db, userId);
+    return ok;
+}
+
+namespace {
+
+struct StoredLogin {
+    int userId = 0;
+    std::string hash;
+    int flags = 0;
+};
+
+AuthStatus lookupLogin(sqlite3* db, const std::string& username, StoredLogin& out)
+{
+    // Read straight from SQLite rather than the user directory so a flag set
+    // by an admin takes effect on the very next attempt.
+    const char* sql = "SELECT id, password_hash, account_flags FROM users WHERE username = ? LIMIT 1;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return AuthStatus::DatabaseError;
+    }
+    sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
+
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE ? AuthStatus::UnknownUser : AuthStatus::DatabaseError;
+    }
+
+    out.userId = sqlite3_column_int(stmt, 0);
+    const unsigned char* hashText = sqlite3_column_text(stmt, 1);
+    out.hash = hashText ? reinterpret_cast<const char*>(hashText) : "";
+    out.flags = sqlite3_column_int(stmt, 2);
+    sqlite3_finalize(stmt);
+    return AuthStatus::Ok;
+}
+
+AuthResult verifyLogin(const StoredLogin& stored, const std::string& password)
+{
+    AuthResult result;
+    // The hash check runs before the flags so a disabled account leaks nothing to a wrong password.
+    if (!verifyPassword(password, stored.hash)) {
+        result.status = AuthStatus::WrongPassword;
+        return result;
+    }
+
+    result.userId = stored.userId;
+    result.accountFlags = stored.flags;
+    parsePasswordHashParams(stored.hash, result.hashParams);
+    result.needsRehash = passwordNeedsRehash(stored.hash);
+    result.status = (stored.flags & (ACCOUNT_DISABLED | ACCOUNT_LOCKED)) ? AuthStatus::AccountDisabled : AuthStatus::Ok;
+    return result;
+}
+
+} // namespace
+
+const char* authStatusName(AuthStatus status)
+{
+    switch (status) {
+        case AuthStatus::Ok:              return "ok";
+        case AuthStatus::UnknownUser:     return "unknown_user";
+        case AuthStatus::WrongPassword:   return "wrong_password";
+        case AuthStatus::AccountDisabled: return "account_disabled";
+        case AuthStatus::DatabaseError:   return "database_error";
+    }
+    return "database_error";
+}
+
+AuthResult checkPassword(sqlite3* db, const std::string& username, const std::string& password)
+{
+    StoredLogin stored;
+    AuthResult result;
+    result.status = lookupLogin(db, username, stored);
+    return result.ok() ? verifyLogin(stored, password) : result;
+}
+
+AuthResult authenticateUser(Database& database, const std::string& username, const std::string& password)
+{
+    StoredLogin stored;
+    AuthResult result;
+    result.status = lookupLogin(database.read(), username, stored);
+    if (!result.ok()) return result;
+
+    // Argon2 takes a quarter second or more; no connection is held meanwhile
+    result = verifyLogin(stored, password);
+
+    // We hold the plaintext only now, so this is the moment to move the hash to
+    // the current cost. Hashed first, so the writer is held for the UPDATE alone.
+    if (result.ok() && result.needsRehash) {
+        std::string newHash;
+        try {
+            newHash = hashPassword(password);
+        } catch (const std::exception&) {
+            return result;
+        }
+        result.rehashed = storeUpgradedHash(database.write(), stored.userId, newHash, stored.hash);
+    }
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "database.h"
+#include <cstdint>
+#include <sqlite3.h>
+#include <string>
+
+// Bits of users.account_flags.
+enum AccountFlag : int {
+    ACCOUNT_DISABLED = 1 << 0,   // login refused
+    ACCOUNT_LOCKED   = 1 << 1,   // login refused until an admin clears it
+};
+
+// Cost settings read back out of a stored crypto_pwhash string,
+// e.g. "$argon2id$v=19$m=65536,t=2,p=1$...".
+struct PasswordHashParams {
+    std::string algorithm;
+    uint64_t opslimit = 0;
+    uint64_t memlimitBytes = 0;
+    int parallelism = 0;
+};
+
+bool parsePasswordHashParams(const std::string& hash, PasswordHashParams& out);
+
+enum class AuthStatus { Ok, UnknownUser, WrongPassword, AccountDisabled, DatabaseError };
+
+const char* authStatusName(AuthStatus status);
+
+struct AuthResult {
+    AuthStatus status = AuthStatus::DatabaseError;
+    int userId = 0;
+    int accountFlags = 0;
+    PasswordHashParams hashParams;
+    bool needsRehash = false;    // verified, but stored with other parameters than hashPassword uses now
+    bool rehashed = false;       // ...and the stored hash was replaced with one at the current cost
+    bool ok() const { return status == AuthStatus::Ok; }
+};
+
+// Checks a username/password pair with a single query for id, hash and flags.
+// Never writes: the stored hash is left as it is.
+AuthResult checkPassword(sqlite3* db, const std::string& username, const std::string& password);
+
+// The login path. Looks the user up on a read() lease and verifies with no
+// connection held. A successful login with an outdated hash re-hashes the
+// password at the current cost, then takes write() only for the UPDATE.
+AuthResult authenticateUser(Database& database, const std::string& username, const std::string& password);
@@ -0,0 +1,398 @@
+#include "backup.h"
+#include "dateTime.h"
+#include "logger.h"
+#include "maintenance.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sodium.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* DEFAULT_CRON = "30 4 * * *";
+const char* SNAPSHOT_PREFIX = "snapshot-";
+const char* PARTIAL_SUFFIX = ".partial";
+constexpr std::size_t GZIP_CHUNK = 64 * 1024;
+constexpr int64_t GZIP_CHUNK_PAGES = GZIP_CHUNK / 4096;
+
+int intFromEnv(const char* name, int fallback)
+{
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    int parsed = std::atoi(value);
+    return parsed > 0 ? parsed : fallback;
+}
+
+std::string baseName(const std::string& path)
+{
+    std::size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool endsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string snapshotName(int64_t utc)
+{
+    std::time_t t = static_cast<std::time_t>(utc);
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", &tm);
+    return SNAPSHOT_PREFIX + std::string(buf);
+}
+
+int64_t snapshotTime(const std::string& name)
+{
+    std::tm tm{};
+    if (std::sscanf(name.c_str() + std::string(SNAPSHOT_PREFIX).size(), "%4d%2d%2dT%2d%2d%2dZ",
+                    &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return 0;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+bool isSnapshot(const fs::directory_entry& entry)
+{
+    std::string name = entry.path().filename().string();
+    return entry.is_directory() && name.rfind(SNAPSHOT_PREFIX, 0) == 0 && !endsWith(name, PARTIAL_SUFFIX);
+}
+
+bool isWal(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    bool wal = false;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* mode = sqlite3_column_text(stmt, 0);
+            wal = mode && std::string(reinterpret_cast<const char*>(mode)) == "wal";
+        }
+        sqlite3_finalize(stmt);
+    }
+    return wal;
+}
+
+bool syncFile(FILE* file)
+{
+    return std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+} // namespace
+
+BackupConfig loadBackupConfig(const std::string& dbPath)
+{
+    BackupConfig config;
+    const char* dir = std::getenv("FITNESS_BACKUP_DIR");
+    if (dir && *dir) {
+        config.dir = dir;
+    } else {
+        std::size_t slash = dbPath.find_last_of('/');
+        config.dir = (slash == std::string::npos ? std::string() : dbPath.substr(0, slash + 1)) + "backups";
+    }
+    const char* cron = std::getenv("FITNESS_BACKUP_CRON");
+    config.cron = (cron && *cron) ? cron : DEFAULT_CRON;
+    config.pagesPerStep = intFromEnv("FITNESS_BACKUP_PAGES_PER_STEP", config.pagesPerStep);
+    config.keep = intFromEnv("FITNESS_BACKUP_KEEP", config.keep);
+    return config;
+}
+
+struct BackupManager::Source {
+    std::string path;
+    sqlite3* db = nullptr;
+    bool pinned = false;    // holds a read transaction: the copy is one snapshot
+};
+
+BackupManager::BackupManager(BackupConfig config, ShardRouter& shards)
+    : _config(std::move(config)), _shards(shards)
+{
+}
+
+bool BackupManager::run(const std::atomic<bool>& stop)
+{
+    auto started = std::chrono::steady_clock::now();
+    int64_t startUtc = nowUtc().value;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _status.running = true;
+        _status.lastStartUtc = startUtc;
+        _status.lastError.clear();
+    }
+
+    std::string name = snapshotName(startUtc);
+    fs::path partial = fs::path(_config.dir) / (name + PARTIAL_SUFFIX);
+    std::string error;
+    int64_t pages = 0, bytes = 0;
+    uint64_t restartsBefore = status().restarts;
+
+    // Leftovers of a run that crashed or was stopped
+    std::error_code ec;
+    fs::create_directories(_config.dir, ec);
+    for (auto it = fs::directory_iterator(_config.dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (endsWith(it->path().filename().string(), PARTIAL_SUFFIX)) fs::remove_all(it->path(), ec);
+    }
+    ec.clear();
+    if (!fs::create_directories(partial, ec)) error = "can't create " + partial.string() + ": " + ec.message();
+
+    // Pin every file before copying any, so the files are snapshotted moments
+    // apart rather than a whole copy apart. It is still one snapshot per file,
+    // not one across them: a write landing between two pins shows up only in
+    // the later file (see the class comment).
+    std::vector<Source> sources;
+    sources.push_back(Source{_shards.directoryPath()});
+    for (int i = 0; _shards.sharded() && i < _shards.count(); ++i) {
+        sources.push_back(Source{shardPath(_shards.directoryPath(), i, _shards.count())});
+    }
+    for (auto& source : sources) {
+        if (!error.empty()) break;
+        if (sqlite3_open_v2(source.path.c_str(), &source.db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+            error = "can't open " + source.path + ": " + sqlite3_errmsg(source.db);
+            break;
+        }
+        sqlite3_busy_timeout(source.db, 5000);
+        source.pinned = isWal(source.db) &&
+            sqlite3_exec(source.db, "BEGIN; SELECT COUNT(*) FROM sqlite_master;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    std::string sums;
+    for (auto& source : sources) {
+        if (!error.empty() || stop) break;
+        std::string file = (partial / baseName(source.path)).string();
+        std::string sha256;
+        if (!copyFile(source, file, stop, pages, error)) break;
+        // Done with this source: let checkpoints move on while we compress
+        if (source.pinned) sqlite3_exec(source.db, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(source.db);
+        source.db = nullptr;
+
+        if (!compressFile(file, file + ".gz", sha256, stop, error)) break;
+        fs::remove(file, ec);
+        bytes += static_cast<int64_t>(fs::file_size(file + ".gz", ec));
+        sums += sha256 + "  " + baseName(source.path) + ".gz\n";
+    }
+    for (auto& source : sources) {
+        if (source.db) sqlite3_close(source.db);
+    }
+    if (error.empty() && stop) error = "stopped";
+
+    if (error.empty()) {
+        std::ofstream out(partial / "SHA256SUMS");
+        out << sums;
+        out.close();
+        if (!out) error = "can't write SHA256SUMS";
+    }
+    if (error.empty()) {
+        fs::rename(partial, fs::path(_config.dir) / name, ec);
+        if (ec) error = "can't rename " + partial.string() + ": " + ec.message();
+    }
+    if (!error.empty()) {
+        fs::remove_all(partial, ec);
+    } else {
+        prune();
+    }
+
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    uint64_t restarts;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _status.running = false;
+        _status.lastDurationMs = ms;
+        _status.lastError = error;
+        if (error.empty()) {
+            _status.lastSuccessUtc = startUtc;
+            _status.lastBytes = bytes;
+            _status.lastPages = pages;
+        }
+        restarts = _status.restarts - restartsBefore;
+    }
+
+    if (!error.empty()) {
+        logEvent(LogLevel::Error, "backup_failed").field("snapshot", name).field("error", error).field("ms", ms);
+        return false;
+    }
+    logEvent(LogLevel::Info, "backup_finished")
+        .field("snapshot", name)
+        .field("files", static_cast<int64_t>(sources.size()))
+        .field("pages", pages)
+        .field("bytes", bytes)
+        .field("restarts", static_cast<int64_t>(restarts))
+        .field("ms", ms);
+    return true;
+}
+
+bool BackupManager::copyFile(Source& source, const std::string& destPath, const std::atomic<bool>& stop,
+                             int64_t& pages, std::string& error)
+{
+    sqlite3* dest = nullptr;
+    if (sqlite3_open(destPath.c_str(), &dest) != SQLITE_OK) {
+        error = "can't create " + destPath + ": " + sqlite3_errmsg(dest);
+        sqlite3_close(dest);
+        return false;
+    }
+    // Scratch file until it is compressed and checksummed; no journal needed
+    sqlite3_exec(dest, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF;", nullptr, nullptr, nullptr);
+
+    sqlite3_backup* backup = sqlite3_backup_init(dest, "main", source.db, "main");
+    if (!backup) {
+        error = "can't start backup of " + source.path + ": " + sqlite3_errmsg(dest);
+        sqlite3_close(dest);
+        return false;
+    }
+
+    int rc = SQLITE_OK;
+    int lastRemaining = -1;
+    while (!stop) {
+        if (!maintenanceIoBudget().acquire(_config.pagesPerStep, stop)) break;
+        rc = sqlite3_backup_step(backup, _config.pagesPerStep);
+        int remaining = sqlite3_backup_remaining(backup);
+        if (lastRemaining >= 0 && remaining > lastRemaining) {
+            // Someone wrote to an unpinned source; the copy started over
+            std::lock_guard<std::mutex> lock(_mutex);
+            _status.restarts++;
+        }
+        lastRemaining = remaining;
+        if (rc == SQLITE_DONE) break;
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        if (rc != SQLITE_OK) break;
+    }
+    pages += sqlite3_backup_pagecount(backup);
+    sqlite3_backup_finish(backup);
+    sqlite3_close(dest);
+
+    if (rc == SQLITE_DONE) return true;
+    error = stop ? "stopped" : "backup of " + source.path + " failed: " + sqlite3_errstr(rc);
+    return false;
+}
+
+bool BackupManager::compressFile(const std::string& srcPath, const std::string& gzPath, std::string& sha256,
+                                 const std::atomic<bool>& stop, std::string& error)
+{
+    FILE* in = std::fopen(srcPath.c_str(), "rb");
+    FILE* out = std::fopen(gzPath.c_str(), "wb");
+    if (!in || !out) {
+        error = "can't open " + std::string(in ? gzPath : srcPath);
+        if (in) std::fclose(in);
+        if (out) std::fclose(out);
+        return false;
+    }
+
+    // Level 1: on a shared box CPU matters more than the last few percent of size
+    z_stream zs{};
+    deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    crypto_hash_sha256_state hash;
+    crypto_hash_sha256_init(&hash);
+
+    std::vector<unsigned char> inBuf(GZIP_CHUNK), outBuf(GZIP_CHUNK);
+    int flush = Z_NO_FLUSH;
+    bool ok = true;
+    do {
+        if (!maintenanceIoBudget().acquire(GZIP_CHUNK_PAGES, stop)) {
+            error = "stopped";
+            ok = false;
+            break;
+        }
+        zs.avail_in = static_cast<uInt>(std::fread(inBuf.data(), 1, inBuf.size(), in));
+        zs.next_in = inBuf.data();
+        if (std::ferror(in)) {
+            error = "can't read " + srcPath;
+            ok = false;
+            break;
+        }
+        flush = std::feof(in) ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            zs.avail_out = static_cast<uInt>(outBuf.size());
+            zs.next_out = outBuf.data();
+            deflate(&zs, flush);
+            std::size_t have = outBuf.size() - zs.avail_out;
+            if (std::fwrite(outBuf.data(), 1, have, out) != have) {
+                error = "can't write " + gzPath;
+                ok = false;
+                break;
+            }
+            crypto_hash_sha256_update(&hash, outBuf.data(), have);
+        } while (ok && zs.avail_out == 0);
+    } while (ok && flush != Z_FINISH);
+    deflateEnd(&zs);
+    std::fclose(in);
+
+    if (ok && !syncFile(out)) {
+        error = "can't sync " + gzPath;
+        ok = false;
+    }
+    std::fclose(out);
+    if (!ok) return false;
+
+    unsigned char digest[crypto_hash_sha256_BYTES];
+    char hex[crypto_hash_sha256_BYTES * 2 + 1];
+    crypto_hash_sha256_final(&hash, digest);
+    sha256 = sodium_bin2hex(hex, sizeof(hex), digest, sizeof(digest));
+    return true;
+}
+
+void BackupManager::prune()
+{
+    std::vector<fs::path> snapshots;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(_config.dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (isSnapshot(*it)) snapshots.push_back(it->path());
+    }
+    // Names sort by time; drop the oldest
+    std::sort(snapshots.begin(), snapshots.end());
+    for (std::size_t i = 0; i + _config.keep < snapshots.size(); ++i) {
+        fs::remove_all(snapshots[i], ec);
+    }
+}
+
+std::vector<BackupSnapshot> BackupManager::list() const
+{
+    std::vector<BackupSnapshot> snapshots;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(_config.dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (!isSnapshot(*it)) continue;
+        BackupSnapshot snapshot;
+        snapshot.name = it->path().filename().string();
+        snapshot.createdUtc = snapshotTime(snapshot.name);
+        std::error_code fileEc;
+        for (auto file = fs::directory_iterator(it->path(), fileEc); !fileEc && file != fs::directory_iterator(); file.increment(fileEc)) {
+            std::error_code sizeEc;
+            auto size = file->file_size(sizeEc);
+            if (!sizeEc) snapshot.bytes += static_cast<int64_t>(size);
+        }
+        snapshots.push_back(std::move(snapshot));
+    }
+    // Newest first
+    std::sort(snapshots.begin(), snapshots.end(),
+              [](const BackupSnapshot& a, const BackupSnapshot& b) { return a.name > b.name; });
+    return snapshots;
+}
+
+BackupStatus BackupManager::status() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _status;
+}
+
+void registerBackupJob(Scheduler& scheduler, BackupManager& backups)
+{
+    auto job = [&backups](const std::atomic<bool>& stop) { return backups.run(stop); };
+    if (!scheduler.addCron("backup", backups.config().cron, std::chrono::minutes(10), job)) {
+        std::cerr << "Bad FITNESS_BACKUP_CRON '" << backups.config().cron << "', using " << DEFAULT_CRON << std::endl;
+        scheduler.addCron("backup", DEFAULT_CRON, std::chrono::minutes(10), job);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "scheduler.h"
+#include "shardRouter.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct BackupConfig {
+    std::string dir;            // FITNESS_BACKUP_DIR, default "<db dir>/backups"
+    std::string cron;           // FITNESS_BACKUP_CRON, default "30 4 * * *" (server time)
+    int pagesPerStep = 256;     // FITNESS_BACKUP_PAGES_PER_STEP
+    int keep = 7;               // FITNESS_BACKUP_KEEP, newest snapshots kept
+};
+
+BackupConfig loadBackupConfig(const std::string& dbPath);
+
+struct BackupSnapshot {
+    std::string name;           // snapshot-20240131T043000Z
+    int64_t bytes = 0;          // compressed, all files
+    int64_t createdUtc = 0;
+};
+
+struct BackupStatus {
+    bool running = false;
+    int64_t lastStartUtc = 0;
+    int64_t lastSuccessUtc = 0;
+    int64_t lastDurationMs = 0;
+    int64_t lastBytes = 0;
+    int64_t lastPages = 0;
+    uint64_t restarts = 0;      // copies restarted because a file changed underneath
+    std::string lastError;
+};
+
+// Online snapshots of the directory and every shard file.
+//
+// Each file is copied with sqlite3_backup_step(), pagesPerStep pages at a
+// time, paying maintenanceIoBudget() before every step. In WAL mode the
+// source connection holds one read transaction for the whole copy, so the
+// snapshot is point-in-time and writers are never blocked (the WAL just
+// can't be checkpointed past it until the copy ends). In rollback-journal
+// mode a long read lock would stall writers, so there the copy locks only
+// for each step and starts over if the file changed.
+//
+// Snapshots are per file. In WAL mode every file is pinned before the first
+// copy starts, but one after another, so a set can differ by the writes that
+// landed in between (shard rows of a user who signed up after the directory
+// was pinned, say); score totals are re-derived after a restore with
+// --replay-scores.
+//
+// A run writes into <dir>/<name>.partial/: one gzip file per database plus
+// SHA256SUMS (sha256sum -c format), then renames the directory into place
+// and deletes the oldest snapshots beyond `keep`.
+class BackupManager
+{
+public:
+    BackupManager(BackupConfig config, ShardRouter& shards);
+
+    // One snapshot; the body of the "backup" job. False on failure or stop.
+    bool run(const std::atomic<bool>& stop);
+
+    std::vector<BackupSnapshot> list() const;
+    BackupStatus status() const;
+    const BackupConfig& config() const { return _config; }
+
+private:
+    struct Source;
+
+    bool copyFile(Source& source, const std::string& destPath, const std::atomic<bool>& stop,
+                  int64_t& pages, std::string& error);
+    bool compressFile(const std::string& srcPath, const std::string& gzPath, std::string& sha256,
+                      const std::atomic<bool>& stop, std::string& error);
+    void prune();
+
+    BackupConfig _config;
+    ShardRouter& _shards;
+    mutable std::mutex _mutex;
+    BackupStatus _status;       // guarded by _mutex
+};
+
+// Registers "backup" on FITNESS_BACKUP_CRON (also run by POST /admin/backups).
+void registerBackupJob(Scheduler& scheduler, BackupManager& backups);
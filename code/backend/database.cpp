@@ -0,0 +1,229 @@
+#include "database.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+unsigned readersFromEnv()
+{
+    unsigned fallback = std::max(1u, std::thread::hardware_concurrency());
+    const char* value = std::getenv("FITNESS_DB_READERS");
+    if (!value || !*value) return fallback;
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    return (end && *end == '\0' && parsed >= 0) ? static_cast<unsigned>(parsed) : fallback;
+}
+
+// The mode the file actually ended up in; the profile's request can be refused.
+bool inWalMode(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA main.journal_mode;", -1, &stmt, nullptr) != SQLITE_OK) return false;
+    bool wal = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* mode = sqlite3_column_text(stmt, 0);
+        wal = mode && sqlite3_stricmp(reinterpret_cast<const char*>(mode), "wal") == 0;
+    }
+    sqlite3_finalize(stmt);
+    return wal;
+}
+
+} // namespace
+
+// ---- Connection ----
+
+Database::Connection::Connection(Database* owner, sqlite3* db, bool pooledReader, std::unique_lock<std::mutex> writeLock)
+    : _owner(owner), _db(db), _pooledReader(pooledReader), _writeLock(std::move(writeLock))
+{
+}
+
+Database::Connection::Connection(Connection&& other) noexcept
+    : _owner(other._owner), _db(other._db), _pooledReader(other._pooledReader), _writeLock(std::move(other._writeLock))
+{
+    other._db = nullptr;
+    other._pooledReader = false;
+}
+
+Database::Connection::~Connection()
+{
+    if (_pooledReader && _db) _owner->release(_db);
+}
+
+// ---- Database ----
+
+Database::Database(std::string path, StorageProfile profile)
+    : _path(std::move(path)), _profile(std::move(profile)), _maxReaders(readersFromEnv())
+{
+}
+
+Database::~Database()
+{
+    close();
+}
+
+void Database::attach(std::string path, std::string schema)
+{
+    _attached.emplace_back(std::move(path), std::move(schema));
+}
+
+bool Database::attachAll(sqlite3* db)
+{
+    for (const auto& file : _attached) {
+        sqlite3_stmt* stmt;
+        std::string sql = "ATTACH DATABASE ? AS " + file.second + ";";
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+        sqlite3_bind_text(stmt, 1, file.first.c_str(), -1, SQLITE_TRANSIENT);
+        bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        if (!ok) {
+            std::cerr << "Can't attach " << file.first << " to " << _path << ": " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Database::open()
+{
+    if (sqlite3_open(_path.c_str(), &_writer) != SQLITE_OK) {
+        std::cerr << "Can't open database at " << _path << ": " << sqlite3_errmsg(_writer) << std::endl;
+        sqlite3_close(_writer);
+        _writer = nullptr;
+        return false;
+    }
+    _profileApplied = applyStorageProfile(_writer, _profile);
+    if (!attachAll(_writer)) {
+        sqlite3_close(_writer);
+        _writer = nullptr;
+        return false;
+    }
+    if (_maxReaders > 0 && !inWalMode(_writer)) {
+        std::cerr << _path << " is not in WAL mode; reads will share the writer" << std::endl;
+        _maxReaders = 0;
+    }
+    return true;
+}
+
+bool Database::close()
+{
+    bool ok = true;
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    if (_idle.size() != _all.size()) {
+        std::cerr << "Closing database with " << (_all.size() - _idle.size()) << " readers still checked out" << std::endl;
+    }
+    for (sqlite3* reader : _all) {
+        if (sqlite3_close(reader) != SQLITE_OK) {
+            sqlite3_close_v2(reader);
+            ok = false;
+        }
+    }
+    _all.clear();
+    _idle.clear();
+
+    if (_writer && sqlite3_close(_writer) != SQLITE_OK) {
+        std::cerr << "Closing database with statements still open: " << sqlite3_errmsg(_writer) << std::endl;
+        sqlite3_close_v2(_writer);
+        ok = false;
+    }
+    _writer = nullptr;
+    return ok;
+}
+
+sqlite3* Database::openReader()
+{
+    // NOMUTEX: a reader is only ever used by the thread holding its lease.
+    sqlite3* db = nullptr;
+    int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+    if (sqlite3_open_v2(_path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        std::cerr << "Can't open read connection: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    applyStorageProfile(db, _profile);
+    if (!attachAll(db)) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_exec(db, "PRAGMA query_only = ON;", nullptr, nullptr, nullptr);
+    return db;
+}
+
+Database::Connection Database::read()
+{
+    if (_maxReaders == 0) return write();
+    _readCheckouts++;
+
+    std::unique_lock<std::mutex> lock(_poolMutex);
+    sqlite3* reader = nullptr;
+    if (_idle.empty() && _all.size() + _opening < _maxReaders) {
+        // Open a new reader outside the lock; opening reads the schema.
+        _opening++;
+        lock.unlock();
+        reader = openReader();
+        lock.lock();
+        _opening--;
+        if (reader) _all.push_back(reader);
+    }
+    if (!reader && _idle.empty() && _all.empty()) {
+        // No reader could be opened and none exists to be returned: waiting
+        // would never end, so this read shares the writer instead.
+        lock.unlock();
+        return write();
+    }
+    if (!reader) {
+        if (_idle.empty()) {
+            _readWaits++;
+            _readerFree.wait(lock, [this] { return !_idle.empty(); });
+        }
+        reader = _idle.back();
+        _idle.pop_back();
+    }
+    lock.unlock();
+
+    // Every query of this handler sees the same snapshot.
+    sqlite3_exec(reader, "BEGIN;", nullptr, nullptr, nullptr);
+    return Connection(this, reader, true, std::unique_lock<std::mutex>());
+}
+
+void Database::release(sqlite3* reader)
+{
+    if (!sqlite3_get_autocommit(reader) && sqlite3_exec(reader, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_exec(reader, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        _idle.push_back(reader);
+    }
+    _readerFree.notify_one();
+}
+
+Database::Connection Database::write()
+{
+    _writeCheckouts++;
+    std::unique_lock<std::mutex> lock(_writeMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        _writeWaits++;
+        auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        _writeWaitMs += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    return Connection(this, _writer, false, std::move(lock));
+}
+
+Database::Stats Database::stats()
+{
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    return Stats{
+        static_cast<unsigned>(_all.size()),
+        static_cast<unsigned>(_idle.size()),
+        _maxReaders,
+        _readCheckouts.load(),
+        _readWaits.load(),
+        _writeCheckouts.load(),
+        _writeWaits.load(),
+        _writeWaitMs.load(),
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "storageProfile.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read/write split over one SQLite file.
+//
+// Writes go through the single writer connection, one handler at a time, so
+// a handler's transaction never interleaves with another's. Reads use a
+// pool of SQLITE_OPEN_READONLY connections with query_only set; each lease
+// runs inside one read transaction, i.e. one WAL snapshot, and in WAL mode
+// never waits on the writer. Readers are opened on demand, up to
+// FITNESS_DB_READERS (default: CPU cores). With 0 readers, or when the file
+// is not in WAL mode, reads share the writer: under a rollback journal a
+// reader's SHARED lock would make the writer's COMMIT fail with SQLITE_BUSY.
+class Database
+{
+public:
+    // One handler's connection, returned when it goes out of scope. It converts
+    // to sqlite3*, so data-access functions take it unchanged.
+    class Connection
+    {
+    public:
+        Connection(Connection&& other) noexcept;
+        Connection& operator=(Connection&&) = delete;
+        ~Connection();
+
+        operator sqlite3*() const { return _db; }
+        sqlite3* get() const { return _db; }
+
+    private:
+        friend class Database;
+        Connection(Database* owner, sqlite3* db, bool pooledReader, std::unique_lock<std::mutex> writeLock);
+
+        Database* _owner;
+        sqlite3* _db;
+        bool _pooledReader;
+        std::unique_lock<std::mutex> _writeLock;
+    };
+
+    struct Stats {
+        unsigned readersOpen;
+        unsigned readersIdle;
+        unsigned maxReaders;
+        uint64_t readCheckouts;
+        uint64_t readWaits;          // checkouts that found every reader busy
+        uint64_t writeCheckouts;
+        uint64_t writeWaits;         // checkouts that found the writer busy
+        int64_t writeWaitMsTotal;
+    };
+
+    Database(std::string path, StorageProfile profile);
+    ~Database();
+
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+
+    // Another file every connection ATTACHes under `schema` (before open()).
+    // Unqualified table names that main lacks resolve there.
+    void attach(std::string path, std::string schema);
+
+    // Opens the writer and applies the storage profile to it.
+    bool open();
+    // Whether every pragma of the profile took on the writer.
+    bool profileApplied() const { return _profileApplied; }
+    // Closes every connection; all leases must have been returned.
+    bool close();
+
+    // Handlers declare their access mode by which one they call. Startup and
+    // background code (schema, scheduler jobs, outbox) take the same leases, so
+    // nothing reaches the writer without holding its lock.
+    Connection read();
+    Connection write();
+
+    Stats stats();
+
+private:
+    bool attachAll(sqlite3* db);
+    sqlite3* openReader();
+    void release(sqlite3* reader);
+
+    std::string _path;
+    StorageProfile _profile;
+    unsigned _maxReaders;
+    sqlite3* _writer = nullptr;
+    bool _profileApplied = false;
+    std::vector<std::pair<std::string, std::string>> _attached;   // path, schema
+    std::mutex _writeMutex;
+
+    std::mutex _poolMutex;
+    std::condition_variable _readerFree;
+    std::vector<sqlite3*> _idle;
+    std::vector<sqlite3*> _all;
+    unsigned _opening = 0;               // readers being opened outside the lock
+
+    std::atomic<uint64_t> _readCheckouts{0};
+    std::atomic<uint64_t> _readWaits{0};
+    std::atomic<uint64_t> _writeCheckouts{0};
+    std::atomic<uint64_t> _writeWaits{0};
+    std::atomic<int64_t> _writeWaitMs{0};
+};
+
+// Runs work() inside BEGIN ... COMMIT on a write() lease, so a row write and
+// what must change with it (its score, say) land together or not at all.
+// Rolls back if work() returns false or the commit fails.
+//
+// Deferred, not IMMEDIATE: the lease already keeps this file's other writers
+// out, and IMMEDIATE also write-locks every ATTACHed file. Shard writers
+// ATTACH the directory, so one shard's transaction would block every other
+// shard's and every directory write until it commits. Deferred locks only the
+// files it writes.
+template <typename F>
+bool inTransaction(sqlite3* db, F&& work)
+{
+    if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK) return false;
+    if (work() && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK) return true;
+    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    return false;
+}
@@ -0,0 +1,227 @@
+#include "dateTime.h"
+#include <chrono>
+
+namespace {
+
+// Floor division so days before 1970 still land on the right day.
+int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) --q;
+    return q;
+}
+
+void write2(char* p, unsigned v) {
+    p[0] = static_cast<char>('0' + (v / 10) % 10);
+    p[1] = static_cast<char>('0' + v % 10);
+}
+
+void write4(char* p, int v) {
+    unsigned u = static_cast<unsigned>(v < 0 ? 0 : v);
+    p[0] = static_cast<char>('0' + (u / 1000) % 10);
+    p[1] = static_cast<char>('0' + (u / 100) % 10);
+    p[2] = static_cast<char>('0' + (u / 10) % 10);
+    p[3] = static_cast<char>('0' + u % 10);
+}
+
+bool readDigits(std::string_view s, std::size_t pos, std::size_t count, int& out) {
+    if (pos + count > s.size()) return false;
+    int v = 0;
+    for (std::size_t i = pos; i < pos + count; ++i) {
+        char c = s[i];
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    out = v;
+    return true;
+}
+
+unsigned daysInMonth(int year, unsigned month) {
+    static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2) {
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return leap ? 29 : 28;
+    }
+    return days[month - 1];
+}
+
+bool validCivil(int year, int month, int day) {
+    if (year < 1 || year > 9999 || month < 1 || month > 12 || day < 1) return false;
+    return static_cast<unsigned>(day) <= daysInMonth(year, static_cast<unsigned>(month));
+}
+
+} // namespace
+
+Day dayFromCivil(int year, unsigned month, unsigned day)
+{
+    // Howard Hinnant's days_from_civil
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return Day{era * 146097 + static_cast<int32_t>(doe) - 719468};
+}
+
+void civilFromDay(Day d, int& year, unsigned& month, unsigned& day)
+{
+    // Howard Hinnant's civil_from_days
+    const int32_t z = d.value + 719468;
+    const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(yoe) + era * 400 + (month <= 2);
+}
+
+Timestamp nowUtc()
+{
+    using namespace std::chrono;
+    return Timestamp{duration_cast<seconds>(system_clock::now().time_since_epoch()).count()};
+}
+
+Day dayAt(Timestamp ts, int32_t utcOffsetSeconds)
+{
+    return Day{static_cast<int32_t>(floorDiv(ts.value + utcOffsetSeconds, SECONDS_PER_DAY))};
+}
+
+Timestamp startOfDay(Day d, int32_t utcOffsetSeconds)
+{
+    return Timestamp{static_cast<int64_t>(d.value) * SECONDS_PER_DAY - utcOffsetSeconds};
+}
+
+char* formatDate(Day d, char (&out)[DATE_BUF_SIZE])
+{
+    int y;
+    unsigned m, dd;
+    civilFromDay(d, y, m, dd);
+    write4(out, y);
+    out[4] = '-';
+    write2(out + 5, m);
+    out[7] = '-';
+    write2(out + 8, dd);
+    out[10] = '\0';
+    return out;
+}
+
+char* formatDateTime(Timestamp ts, int32_t utcOffsetSeconds, char (&out)[DATETIME_BUF_SIZE])
+{
+    int64_t local = ts.value + utcOffsetSeconds;
+    Day d{static_cast<int32_t>(floorDiv(local, SECONDS_PER_DAY))};
+    int64_t secs = local - static_cast<int64_t>(d.value) * SECONDS_PER_DAY;
+
+    char date[DATE_BUF_SIZE];
+    formatDate(d, date);
+    for (int i = 0; i < 10; ++i) out[i] = date[i];
+    out[10] = ' ';
+    write2(out + 11, static_cast<unsigned>(secs / 3600));
+    out[13] = ':';
+    write2(out + 14, static_cast<unsigned>((secs / 60) % 60));
+    out[16] = ':';
+    write2(out + 17, static_cast<unsigned>(secs % 60));
+    out[19] = '\0';
+    return out;
+}
+
+char* formatIso8601Utc(Timestamp ts, char (&out)[ISO8601_BUF_SIZE])
+{
+    char buf[DATETIME_BUF_SIZE];
+    formatDateTime(ts, 0, buf);
+    for (int i = 0; i < 19; ++i) out[i] = buf[i];
+    out[10] = 'T';
+    out[19] = 'Z';
+    out[20] = '\0';
+    return out;
+}
+
+std::string toDateString(Day d)
+{
+    char buf[DATE_BUF_SIZE];
+    return std::string(formatDate(d, buf), DATE_BUF_SIZE - 1);
+}
+
+std::string toDateTimeString(Timestamp ts, int32_t utcOffsetSeconds)
+{
+    char buf[DATETIME_BUF_SIZE];
+    return std::string(formatDateTime(ts, utcOffsetSeconds, buf), DATETIME_BUF_SIZE - 1);
+}
+
+bool parseDate(std::string_view s, Day& out)
+{
+    int y, m, d;
+    if (s.size() != 10 || s[4] != '-' || s[7] != '-') return false;
+    if (!readDigits(s, 0, 4, y) || !readDigits(s, 5, 2, m) || !readDigits(s, 8, 2, d)) return false;
+    if (!validCivil(y, m, d)) return false;
+    out = dayFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+    return true;
+}
+
+bool parseUSDate(std::string_view s, Day& out)
+{
+    int y, m, d;
+    if (s.size() != 10) return false;
+    if (!((s[2] == '-' && s[5] == '-') || (s[2] == '/' && s[5] == '/'))) return false;
+    if (!readDigits(s, 0, 2, m) || !readDigits(s, 3, 2, d) || !readDigits(s, 6, 4, y)) return false;
+    if (!validCivil(y, m, d)) return false;
+    out = dayFromCivil(y, static_cast<unsigned>(m), static_cast<unsigned>(d));
+    return true;
+}
+
+bool parseTimeOfDay(std::string_view s, int32_t& outSeconds)
+{
+    int h, m, sec = 0;
+    if (s.size() != 5 && s.size() != 8) return false;
+    if (s[2] != ':' || !readDigits(s, 0, 2, h) || !readDigits(s, 3, 2, m)) return false;
+    if (s.size() == 8 && (s[5] != ':' || !readDigits(s, 6, 2, sec))) return false;
+    if (h > 23 || m > 59 || sec > 59) return false;
+    outSeconds = h * 3600 + m * 60 + sec;
+    return true;
+}
+
+bool parseDateTime(std::string_view s, int32_t utcOffsetSeconds, Timestamp& out)
+{
+    Day d;
+    int32_t secs;
+    if (s.size() < 16 || (s[10] != ' ' && s[10] != 'T')) return false;
+    if (!parseDate(s.substr(0, 10), d) || !parseTimeOfDay(s.substr(11), secs)) return false;
+    out = Timestamp{startOfDay(d, utcOffsetSeconds).value + secs};
+    return true;
+}
+
+bool parseIso8601Utc(std::string_view s, Timestamp& out)
+{
+    if (s.size() != 20 || s[10] != 'T' || s[19] != 'Z') return false;
+    return parseDateTime(s.substr(0, 19), 0, out);
+}
+
+bool parseUtcOffset(std::string_view s, int32_t& outSeconds)
+{
+    if (s == "UTC" || s == "Z" || s == "GMT") {
+        outSeconds = 0;
+        return true;
+    }
+
+    // Allow an optional "UTC"/"GMT" prefix, e.g. "UTC+05:30"
+    if (s.size() > 3 && (s.substr(0, 3) == "UTC" || s.substr(0, 3) == "GMT")) s.remove_prefix(3);
+
+    if (s.empty() || (s[0] != '+' && s[0] != '-')) return false;
+    int sign = s[0] == '-' ? -1 : 1;
+    s.remove_prefix(1);
+
+    int h, m = 0;
+    if (s.size() == 2) {
+        if (!readDigits(s, 0, 2, h)) return false;
+    } else if (s.size() == 4) {
+        if (!readDigits(s, 0, 2, h) || !readDigits(s, 2, 2, m)) return false;
+    } else if (s.size() == 5 && s[2] == ':') {
+        if (!readDigits(s, 0, 2, h) || !readDigits(s, 3, 2, m)) return false;
+    } else {
+        return false;
+    }
+    if (h > 14 || m > 59) return false;
+
+    outSeconds = sign * (h * 3600 + m * 60);
+    return true;
+}
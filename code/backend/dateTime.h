@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Calendar day, counted as days since 1970-01-01. Stored as INTEGER in the
+// *_day columns so day windows become plain integer ranges.
+struct Day {
+    int32_t value = 0;
+
+    friend bool operator==(Day a, Day b) { return a.value == b.value; }
+    friend bool operator!=(Day a, Day b) { return a.value != b.value; }
+    friend bool operator<(Day a, Day b) { return a.value < b.value; }
+    friend bool operator<=(Day a, Day b) { return a.value <= b.value; }
+    friend bool operator>(Day a, Day b) { return a.value > b.value; }
+    friend bool operator>=(Day a, Day b) { return a.value >= b.value; }
+    Day operator+(int32_t days) const { return Day{value + days}; }
+    Day operator-(int32_t days) const { return Day{value - days}; }
+};
+
+// Instant, counted as seconds since the Unix epoch (always UTC).
+struct Timestamp {
+    int64_t value = 0;
+
+    friend bool operator==(Timestamp a, Timestamp b) { return a.value == b.value; }
+    friend bool operator!=(Timestamp a, Timestamp b) { return a.value != b.value; }
+    friend bool operator<(Timestamp a, Timestamp b) { return a.value < b.value; }
+    friend bool operator<=(Timestamp a, Timestamp b) { return a.value <= b.value; }
+    friend bool operator>(Timestamp a, Timestamp b) { return a.value > b.value; }
+    friend bool operator>=(Timestamp a, Timestamp b) { return a.value >= b.value; }
+    Timestamp operator+(int64_t seconds) const { return Timestamp{value + seconds}; }
+    Timestamp operator-(int64_t seconds) const { return Timestamp{value - seconds}; }
+};
+
+constexpr int64_t SECONDS_PER_DAY = 86400;
+
+// Buffer sizes for the formatters below (including the trailing '\0').
+constexpr std::size_t DATE_BUF_SIZE = 11;      // "YYYY-MM-DD"
+constexpr std::size_t DATETIME_BUF_SIZE = 20;  // "YYYY-MM-DD HH:MM:SS"
+constexpr std::size_t ISO8601_BUF_SIZE = 21;   // "YYYY-MM-DDTHH:MM:SSZ"
+
+// Civil calendar <-> day number (proleptic Gregorian, no allocation, no libc).
+Day dayFromCivil(int year, unsigned month, unsigned day);
+void civilFromDay(Day d, int& year, unsigned& month, unsigned& day);
+
+// Current instant and the day it falls on for a given UTC offset (seconds east of UTC).
+Timestamp nowUtc();
+Day dayAt(Timestamp ts, int32_t utcOffsetSeconds);
+Timestamp startOfDay(Day d, int32_t utcOffsetSeconds);
+
+// Formatting writes into caller-provided buffers and returns the buffer.
+char* formatDate(Day d, char (&out)[DATE_BUF_SIZE]);
+char* formatDateTime(Timestamp ts, int32_t utcOffsetSeconds, char (&out)[DATETIME_BUF_SIZE]);
+char* formatIso8601Utc(Timestamp ts, char (&out)[ISO8601_BUF_SIZE]);
+std::string toDateString(Day d);
+std::string toDateTimeString(Timestamp ts, int32_t utcOffsetSeconds);
+
+// Strict parsers. They return false on malformed or out-of-range input.
+bool parseDate(std::string_view s, Day& out);        // "YYYY-MM-DD"
+bool parseUSDate(std::string_view s, Day& out);      // "MM-DD-YYYY" (or MM/DD/YYYY)
+bool parseTimeOfDay(std::string_view s, int32_t& outSeconds);  // "HH:MM" or "HH:MM:SS"
+// "YYYY-MM-DD HH:MM[:SS]" (or with 'T'), interpreted as wall time at the given offset.
+bool parseDateTime(std::string_view s, int32_t utcOffsetSeconds, Timestamp& out);
+bool parseIso8601Utc(std::string_view s, Timestamp& out);  // "YYYY-MM-DDTHH:MM:SSZ"
+
+// Fixed UTC offsets as stored in users.timezone: "UTC", "Z", "+05:30", "-0800".
+bool parseUtcOffset(std::string_view s, int32_t& outSeconds);
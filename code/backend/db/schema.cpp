@@ -1,5 +1,6 @@
 #include "schema.h"
 #include <iostream>
+#include <string>
 using namespace std;
 
 bool createTables(sqlite3 *db)
@@ -12,7 +13,9 @@ bool createTables(sqlite3 *db)
             username TEXT UNIQUE NOT NULL,
             password_hash TEXT NOT NULL,
             email TEXT UNIQUE NOT NULL,
-            score INTEGER DEFAULT 0
+            score INTEGER DEFAULT 0,
+            timezone TEXT,                   -- NULL = server's zone, else IANA name or "UTC", "+05:30"
+            account_flags INTEGER NOT NULL DEFAULT 0  -- AccountFlag bits (auth.h)
         );
 
         CREATE TABLE IF NOT EXISTS sessions (
@@ -24,6 +27,7 @@ bool createTables(sqlite3 *db)
             duration INTEGER,
             created_at TEXT DEFAULT (datetime('now')),
             updated_at TEXT DEFAULT (datetime('now')),
+            day INTEGER,                     -- days since 1970-01-01
             FOREIGN KEY (user_id) REFERENCES users(id)
         );
 
@@ -38,6 +42,7 @@ bool createTables(sqlite3 *db)
             duration INTEGER,
             session_id INTEGER,
             notes TEXT,
+            day INTEGER,                     -- days since 1970-01-01
             FOREIGN KEY(session_id) REFERENCES sessions(id),
             FOREIGN KEY(user_id) REFERENCES users(id)
         );
@@ -51,6 +56,7 @@ bool createTables(sqlite3 *db)
             calories INTEGER NOT NULL,
             protein REAL DEFAULT 0,
             created_at TEXT NOT NULL,
+            day INTEGER,                     -- days since 1970-01-01
             FOREIGN KEY(user_id) REFERENCES users(id)
         );
 
@@ -61,6 +67,7 @@ bool createTables(sqlite3 *db)
             duration INTEGER NOT NULL,
             sleep_type TEXT NOT NULL,
             created_at TEXT NOT NULL,
+            sleep_start_ts INTEGER,          -- seconds since epoch, UTC
             FOREIGN KEY(user_id) REFERENCES users(id)
         );
 
@@ -93,6 +100,7 @@ bool createTables(sqlite3 *db)
             goal_id INTEGER NOT NULL,
             date TEXT NOT NULL,
             progress_value REAL NOT NULL,
+            day INTEGER,                     -- days since 1970-01-01
             FOREIGN KEY(goal_id) REFERENCES goals(id) ON DELETE CASCADE
         );
 
@@ -144,6 +152,56 @@ bool createTables(sqlite3 *db)
 
         CREATE INDEX IF NOT EXISTS idx_password_reset_user_id
             ON password_reset_tokens(user_id);
+
+        -- Point weights per activity kind: points + per_unit * min(units, unit_cap)
+        CREATE TABLE IF NOT EXISTS score_rules (
+            kind TEXT PRIMARY KEY,           -- 'exercise', 'meal', 'sleep', 'goal_progress', 'goal_completed'
+            points INTEGER NOT NULL,
+            per_unit REAL NOT NULL DEFAULT 0,
+            unit_cap REAL NOT NULL DEFAULT 0 -- 0 = no cap
+        );
+
+        -- One row per scored activity row; users.score is the sum of points per user
+        CREATE TABLE IF NOT EXISTS score_events (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            kind TEXT NOT NULL,
+            source_id INTEGER NOT NULL,      -- id of the exercise/meal/sleep/... row
+            units REAL NOT NULL DEFAULT 0,
+            points INTEGER NOT NULL,
+            UNIQUE (kind, source_id),
+            FOREIGN KEY (user_id) REFERENCES users(id) ON DELETE CASCADE
+        );
+
+        CREATE INDEX IF NOT EXISTS idx_score_events_user
+            ON score_events(user_id);
+
+        CREATE INDEX IF NOT EXISTS idx_users_score
+            ON users(score DESC);
+
+        -- Outbound mail; request threads insert, the outbox sender delivers and retries
+        CREATE TABLE IF NOT EXISTS email_outbox (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            to_address TEXT NOT NULL,
+            subject TEXT NOT NULL,
+            body_text TEXT NOT NULL,
+            body_html TEXT,
+            status TEXT NOT NULL DEFAULT 'pending' CHECK (status IN ('pending', 'sent', 'failed')),
+            attempts INTEGER NOT NULL DEFAULT 0,
+            next_attempt_at INTEGER NOT NULL,  -- unix seconds
+            last_error TEXT,
+            created_at INTEGER NOT NULL,
+            sent_at INTEGER
+        );
+
+        CREATE INDEX IF NOT EXISTS idx_email_outbox_due
+            ON email_outbox(status, next_attempt_at);
+
+        -- FITNESS_SHARD_COUNT the per-user tables were last laid out for; no row = 1 (unsharded)
+        CREATE TABLE IF NOT EXISTS shard_layout (
+            id INTEGER PRIMARY KEY CHECK (id = 1),
+            shard_count INTEGER NOT NULL
+        );
 )";
 
     // sqlite3_exec executes the queries that are provided to it in the message above. In this case, it will create the tables if they do not already exist.
@@ -157,5 +215,316 @@ bool createTables(sqlite3 *db)
         return false;
     }
     
+    return migrateTables(db);
+}
+
+static bool columnExists(sqlite3 *db, const char *table, const char *column)
+{
+    std::string sql = std::string("PRAGMA table_info(") + table + ");";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+
+    bool found = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *name = sqlite3_column_text(stmt, 1);
+        if (name && std::string(reinterpret_cast<const char *>(name)) == column) {
+            found = true;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static bool addColumnIfMissing(sqlite3 *db, const char *table, const char *column, const char *decl)
+{
+    if (columnExists(db, table, column)) return true;
+
+    std::string sql = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + decl + ";";
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error adding column " << table << "." << column << ": " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool migrateTables(sqlite3 *db)
+{
+    // Databases created before the typed date columns existed only get them through ALTER TABLE.
+    if (!addColumnIfMissing(db, "users", "timezone", "TEXT") ||
+        !addColumnIfMissing(db, "users", "account_flags", "INTEGER NOT NULL DEFAULT 0") ||
+        !addColumnIfMissing(db, "sessions", "day", "INTEGER") ||
+        !addColumnIfMissing(db, "exercises", "day", "INTEGER") ||
+        !addColumnIfMissing(db, "nutrition", "day", "INTEGER") ||
+        !addColumnIfMissing(db, "sleepTable", "sleep_start_ts", "INTEGER") ||
+        !addColumnIfMissing(db, "goal_progress", "day", "INTEGER")) {
+        return false;
+    }
+
+    // Backfill the integer columns from the text ones (julianday of 1970-01-01 is 2440587.5),
+    // then index them so day windows are integer range scans. Sleep start times were
+    // written as server-local wall clock; the 'utc' modifier converts them from the
+    // server zone ($TZ, else /etc/localtime, as serverTimeZone()) instead of reading them as UTC.
+    const char *sql = R"(
+        UPDATE sessions SET day = CAST(julianday(date) - 2440587.5 AS INTEGER)
+            WHERE day IS NULL AND julianday(date) IS NOT NULL;
+        UPDATE exercises SET day = CAST(julianday(date) - 2440587.5 AS INTEGER)
+            WHERE day IS NULL AND julianday(date) IS NOT NULL;
+        UPDATE nutrition SET day = CAST(julianday(date) - 2440587.5 AS INTEGER)
+            WHERE day IS NULL AND julianday(date) IS NOT NULL;
+        UPDATE goal_progress SET day = CAST(julianday(date) - 2440587.5 AS INTEGER)
+            WHERE day IS NULL AND julianday(date) IS NOT NULL;
+        UPDATE sleepTable SET sleep_start_ts = CAST(strftime('%s', sleep_start_time, 'utc') AS INTEGER)
+            WHERE sleep_start_ts IS NULL AND strftime('%s', sleep_start_time, 'utc') IS NOT NULL;
+
+        CREATE INDEX IF NOT EXISTS idx_sessions_user_day ON sessions(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_exercises_user_day ON exercises(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_nutrition_user_day ON nutrition(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_sleep_user_start_ts ON sleepTable(user_id, sleep_start_ts);
+)";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error migrating tables: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+static int schemaVersion(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int version = -1;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+bool ensureSchema(sqlite3 *db, bool *applied)
+{
+    if (applied) *applied = false;
+
+    int version = schemaVersion(db);
+    if (version < 0) {
+        std::cerr << "Error reading schema version: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    if (version == SCHEMA_VERSION) return true;
+    if (version > SCHEMA_VERSION) {
+        std::cerr << "Database schema version " << version << " is newer than this build ("
+                  << SCHEMA_VERSION << ")" << std::endl;
+        return false;
+    }
+
+    // IMMEDIATE so two processes starting together do not both migrate.
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Error starting schema transaction: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    if (schemaVersion(db) == SCHEMA_VERSION) {   // someone else got there first
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        return true;
+    }
+    std::string stamp = "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+    if (!createTables(db) || sqlite3_exec(db, stamp.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    if (applied) *applied = true;
+    return true;
+}
+
+bool createShardTables(sqlite3 *db)
+{
+    // The per-user tables of createTables, without the foreign keys to users:
+    // users live in the directory database, which shards only ATTACH.
+    const char *sql = R"(
+        CREATE TABLE IF NOT EXISTS sessions (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            name TEXT NOT NULL,
+            date TEXT NOT NULL,
+            notes TEXT,
+            duration INTEGER,
+            created_at TEXT DEFAULT (datetime('now')),
+            updated_at TEXT DEFAULT (datetime('now')),
+            day INTEGER
+        );
+
+        CREATE TABLE IF NOT EXISTS exercises (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            date TEXT NOT NULL,
+            type TEXT NOT NULL,
+            sets INTEGER,
+            reps INTEGER,
+            weight REAL,
+            duration INTEGER,
+            session_id INTEGER,
+            notes TEXT,
+            day INTEGER,
+            FOREIGN KEY(session_id) REFERENCES sessions(id)
+        );
+
+        CREATE TABLE IF NOT EXISTS nutrition (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            date TEXT NOT NULL,
+            meal_type TEXT NOT NULL,
+            meal_name TEXT NOT NULL,
+            calories INTEGER NOT NULL,
+            protein REAL DEFAULT 0,
+            created_at TEXT NOT NULL,
+            day INTEGER
+        );
+
+        CREATE TABLE IF NOT EXISTS sleepTable (
+            sleep_id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            sleep_start_time TIMESTAMP NOT NULL,
+            duration INTEGER NOT NULL,
+            sleep_type TEXT NOT NULL,
+            created_at TEXT NOT NULL,
+            sleep_start_ts INTEGER
+        );
+
+        CREATE TABLE IF NOT EXISTS goals (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            goal_name TEXT NOT NULL,
+            target_value REAL,
+            current_value REAL DEFAULT 0,
+            status TEXT DEFAULT 'active',
+            frequency TEXT DEFAULT 'none',
+            start_date TEXT DEFAULT (datetime('now')),
+            end_date TEXT,
+            updated_at TEXT DEFAULT (datetime('now'))
+        );
+
+        CREATE TABLE IF NOT EXISTS goal_progress (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            goal_id INTEGER NOT NULL,
+            date TEXT NOT NULL,
+            progress_value REAL NOT NULL,
+            day INTEGER,
+            FOREIGN KEY(goal_id) REFERENCES goals(id) ON DELETE CASCADE
+        );
+
+        CREATE TABLE IF NOT EXISTS score_events (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            user_id INTEGER NOT NULL,
+            kind TEXT NOT NULL,
+            source_id INTEGER NOT NULL,
+            units REAL NOT NULL DEFAULT 0,
+            points INTEGER NOT NULL,
+            UNIQUE (kind, source_id)
+        );
+
+        -- Sum of score_events.points per user; version != synced_version means
+        -- the directory's users.score has not caught up yet
+        CREATE TABLE IF NOT EXISTS score_totals (
+            user_id INTEGER PRIMARY KEY,
+            score INTEGER NOT NULL DEFAULT 0,
+            version INTEGER NOT NULL DEFAULT 0,
+            synced_version INTEGER NOT NULL DEFAULT 0
+        );
+
+        CREATE INDEX IF NOT EXISTS idx_sessions_user_day ON sessions(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_exercises_user_day ON exercises(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_nutrition_user_day ON nutrition(user_id, day);
+        CREATE INDEX IF NOT EXISTS idx_sleep_user_start_ts ON sleepTable(user_id, sleep_start_ts);
+        CREATE INDEX IF NOT EXISTS idx_goals_user ON goals(user_id);
+        CREATE INDEX IF NOT EXISTS idx_goal_progress_goal ON goal_progress(goal_id);
+        CREATE INDEX IF NOT EXISTS idx_score_events_user ON score_events(user_id);
+        CREATE INDEX IF NOT EXISTS idx_score_totals_unsynced ON score_totals(user_id) WHERE version != synced_version;
+)";
+
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error creating shard tables: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool ensureShardSchema(sqlite3 *db, int64_t firstRowId)
+{
+    int version = schemaVersion(db);
+    if (version < 0) {
+        std::cerr << "Error reading shard schema version: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    if (version == SHARD_SCHEMA_VERSION) return true;
+    if (version > SHARD_SCHEMA_VERSION) {
+        std::cerr << "Shard schema version " << version << " is newer than this build ("
+                  << SHARD_SCHEMA_VERSION << ")" << std::endl;
+        return false;
+    }
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Error starting shard schema transaction: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    if (schemaVersion(db) == SHARD_SCHEMA_VERSION) {
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        return true;
+    }
+
+    // A new shard hands out ids from its own range, so a row id alone names its shard.
+    bool ok = createShardTables(db);
+    if (ok && version == 0) {
+        sqlite3_stmt *stmt;
+        ok = sqlite3_prepare_v2(db,
+                 "INSERT INTO sqlite_sequence (name, seq) VALUES "
+                 "('sessions', ?1), ('exercises', ?1), ('nutrition', ?1), ('sleepTable', ?1), "
+                 "('goals', ?1), ('goal_progress', ?1), ('score_events', ?1);",
+                 -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_int64(stmt, 1, firstRowId - 1);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_finalize(stmt);
+        }
+    }
+    std::string stamp = "PRAGMA user_version = " + std::to_string(SHARD_SCHEMA_VERSION) + ";";
+    if (!ok || sqlite3_exec(db, stamp.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Error creating shard schema: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
     return true;
-}
\ No newline at end of file
+}
+
+int storedShardCount(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int count = -1;
+    if (sqlite3_prepare_v2(db, "SELECT shard_count FROM shard_layout WHERE id = 1;", -1, &stmt, nullptr) == SQLITE_OK) {
+        count = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 1;
+        sqlite3_finalize(stmt);
+    }
+    return count;
+}
+
+bool setStoredShardCount(sqlite3 *db, int count)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,
+            "INSERT INTO shard_layout (id, shard_count) VALUES (1, ?) "
+            "ON CONFLICT(id) DO UPDATE SET shard_count = excluded.shard_count;",
+            -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, count);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
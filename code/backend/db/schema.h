@@ -1,4 +1,33 @@
 #pragma once
+#include <cstdint>
 #include <sqlite3.h>
 
-bool createTables(sqlite3* db);
\ No newline at end of file
+// Stored in PRAGMA user_version. Bump it whenever createTables or
+// migrateTables change, or existing databases will not pick the change up.
+constexpr int SCHEMA_VERSION = 2;
+
+bool createTables(sqlite3* db);
+
+// Brings tables created by older builds up to the current column set.
+bool migrateTables(sqlite3* db);
+
+// Runs createTables + migrateTables in one transaction only when the stored
+// user_version is older than SCHEMA_VERSION, then stamps it. A current
+// database costs one PRAGMA read at startup. `applied` reports whether the
+// DDL ran. Fails on a database stamped by a newer build.
+bool ensureSchema(sqlite3* db, bool* applied = nullptr);
+
+
+// Shard files (FITNESS_SHARD_COUNT > 1) carry their own user_version.
+constexpr int SHARD_SCHEMA_VERSION = 1;
+
+// Per-user tables of one shard: activity rows, goals, score_events and score_totals.
+bool createShardTables(sqlite3* db);
+
+// Creates the shard tables if the file is new or older than this build. A new
+// shard's AUTOINCREMENT sequences start at `firstRowId`.
+bool ensureShardSchema(sqlite3* db, int64_t firstRowId);
+
+// shard_layout in the directory database: 1 until the reshard tool ran, -1 on error.
+int storedShardCount(sqlite3* db);
+bool setStoredShardCount(sqlite3* db, int count);
@@ -0,0 +1,339 @@
+#include "dto.h"
+#include "dateTime.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+namespace dto
+{
+    Reader::Reader(std::string_view text, std::pmr::string& scratch)
+        : _text(text), _scratch(scratch)
+    {
+    }
+
+    bool Reader::fail()
+    {
+        _failed = true;
+        return false;
+    }
+
+    void Reader::skipSpace()
+    {
+        while (_pos < _text.size()) {
+            char c = _text[_pos];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+            ++_pos;
+        }
+    }
+
+    Reader::Kind Reader::peek()
+    {
+        if (_failed) return Kind::Invalid;
+        skipSpace();
+        if (_pos >= _text.size()) return Kind::Invalid;
+        switch (_text[_pos]) {
+            case '{': return Kind::Object;
+            case '[': return Kind::Array;
+            case '"': return Kind::String;
+            case 't': return Kind::True;
+            case 'f': return Kind::False;
+            case 'n': return Kind::Null;
+            case '-': return Kind::Number;
+            default:
+                return (_text[_pos] >= '0' && _text[_pos] <= '9') ? Kind::Number : Kind::Invalid;
+        }
+    }
+
+    bool Reader::beginObject()
+    {
+        if (peek() != Kind::Object) return fail();
+        ++_pos;
+        _firstMember = true;
+        return true;
+    }
+
+    bool Reader::nextKey(std::string_view& key)
+    {
+        if (_failed) return false;
+        skipSpace();
+        if (_pos >= _text.size()) return fail();
+        if (_text[_pos] == '}') {
+            ++_pos;
+            return false;
+        }
+        if (!_firstMember) {
+            if (_text[_pos] != ',') return fail();
+            ++_pos;
+            skipSpace();
+        }
+        _firstMember = false;
+        if (peek() != Kind::String || !readString(key)) return fail();
+        skipSpace();
+        if (_pos >= _text.size() || _text[_pos] != ':') return fail();
+        ++_pos;
+        return true;
+    }
+
+    namespace
+    {
+        int hexValue(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        void appendUtf8(std::pmr::string& out, uint32_t cp)
+        {
+            if (cp < 0x80) {
+                out += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+    }
+
+    bool Reader::readString(std::string_view& out)
+    {
+        if (peek() != Kind::String) return fail();
+        std::size_t start = ++_pos;
+
+        // Common case: no escapes, so the value is a slice of the body
+        while (_pos < _text.size() && _text[_pos] != '"' && _text[_pos] != '\\') {
+            if (static_cast<unsigned char>(_text[_pos]) < 0x20) return fail();
+            ++_pos;
+        }
+        if (_pos >= _text.size()) return fail();
+        if (_text[_pos] == '"') {
+            out = _text.substr(start, _pos - start);
+            ++_pos;
+            return true;
+        }
+
+        // Decoded text is never longer than its source, so reserving the
+        // whole body once keeps earlier views into _scratch valid
+        if (_scratch.capacity() < _text.size()) _scratch.reserve(_text.size());
+        std::size_t decodedStart = _scratch.size();
+        _scratch.append(_text.data() + start, _pos - start);
+
+        while (_pos < _text.size() && _text[_pos] != '"') {
+            char c = _text[_pos];
+            if (static_cast<unsigned char>(c) < 0x20) return fail();
+            if (c != '\\') {
+                _scratch += c;
+                ++_pos;
+                continue;
+            }
+            if (++_pos >= _text.size()) return fail();
+            char e = _text[_pos++];
+            switch (e) {
+                case '"': _scratch += '"'; break;
+                case '\\': _scratch += '\\'; break;
+                case '/': _scratch += '/'; break;
+                case 'b': _scratch += '\b'; break;
+                case 'f': _scratch += '\f'; break;
+                case 'n': _scratch += '\n'; break;
+                case 'r': _scratch += '\r'; break;
+                case 't': _scratch += '\t'; break;
+                case 'u': {
+                    auto hex4 = [this](uint32_t& cp) {
+                        if (_pos + 4 > _text.size()) return false;
+                        cp = 0;
+                        for (int i = 0; i < 4; ++i) {
+                            int v = hexValue(_text[_pos + i]);
+                            if (v < 0) return false;
+                            cp = (cp << 4) | static_cast<uint32_t>(v);
+                        }
+                        _pos += 4;
+                        return true;
+                    };
+                    uint32_t cp;
+                    if (!hex4(cp)) return fail();
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        uint32_t low;
+                        if (_pos + 2 > _text.size() || _text[_pos] != '\\' || _text[_pos + 1] != 'u') return fail();
+                        _pos += 2;
+                        if (!hex4(low) || low < 0xDC00 || low > 0xDFFF) return fail();
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return fail();
+                    }
+                    appendUtf8(_scratch, cp);
+                    break;
+                }
+                default:
+                    return fail();
+            }
+        }
+        if (_pos >= _text.size()) return fail();
+        ++_pos;
+        out = std::string_view(_scratch.data() + decodedStart, _scratch.size() - decodedStart);
+        return true;
+    }
+
+    bool Reader::readNumber(std::string_view& token)
+    {
+        if (peek() != Kind::Number) return fail();
+        std::size_t start = _pos;
+        auto digits = [this] {
+            std::size_t from = _pos;
+            while (_pos < _text.size() && _text[_pos] >= '0' && _text[_pos] <= '9') ++_pos;
+            return _pos > from;
+        };
+
+        if (_text[_pos] == '-') ++_pos;
+        if (_pos < _text.size() && _text[_pos] == '0') {
+            ++_pos;
+        } else if (!digits()) {
+            return fail();
+        }
+        if (_pos < _text.size() && _text[_pos] == '.') {
+            ++_pos;
+            if (!digits()) return fail();
+        }
+        if (_pos < _text.size() && (_text[_pos] == 'e' || _text[_pos] == 'E')) {
+            ++_pos;
+            if (_pos < _text.size() && (_text[_pos] == '+' || _text[_pos] == '-')) ++_pos;
+            if (!digits()) return fail();
+        }
+        token = _text.substr(start, _pos - start);
+        return true;
+    }
+
+    bool Reader::literal(std::string_view word)
+    {
+        if (_text.substr(_pos, word.size()) != word) return fail();
+        _pos += word.size();
+        return true;
+    }
+
+    bool Reader::readBool(bool& out)
+    {
+        Kind kind = peek();
+        if (kind == Kind::True && literal("true")) {
+            out = true;
+            return true;
+        }
+        if (kind == Kind::False && literal("false")) {
+            out = false;
+            return true;
+        }
+        return fail();
+    }
+
+    bool Reader::readNull()
+    {
+        return peek() == Kind::Null ? literal("null") : fail();
+    }
+
+    bool Reader::skipValue()
+    {
+        return skipValue(0);
+    }
+
+    bool Reader::skipValue(int depth)
+    {
+        if (depth > MAX_DEPTH) return fail();
+        std::string_view ignored;
+        bool flag;
+        switch (peek()) {
+            case Kind::String: return readString(ignored);
+            case Kind::Number: return readNumber(ignored);
+            case Kind::True:
+            case Kind::False: return readBool(flag);
+            case Kind::Null: return readNull();
+            case Kind::Object:
+            case Kind::Array: {
+                char close = _text[_pos] == '{' ? '}' : ']';
+                ++_pos;
+                for (bool first = true;; first = false) {
+                    skipSpace();
+                    if (_pos >= _text.size()) return fail();
+                    if (_text[_pos] == close) {
+                        ++_pos;
+                        return true;
+                    }
+                    if (!first) {
+                        if (_text[_pos] != ',') return fail();
+                        ++_pos;
+                    }
+                    if (close == '}') {
+                        skipSpace();
+                        if (!readString(ignored)) return fail();
+                        skipSpace();
+                        if (_pos >= _text.size() || _text[_pos] != ':') return fail();
+                        ++_pos;
+                    }
+                    if (!skipValue(depth + 1)) return false;
+                }
+            }
+            default:
+                return fail();
+        }
+    }
+
+    bool Reader::finish()
+    {
+        if (_failed) return false;
+        skipSpace();
+        return _pos == _text.size() || fail();
+    }
+
+    bool toInt64(std::string_view token, int64_t& out)
+    {
+        const char* end = token.data() + token.size();
+        auto result = std::from_chars(token.data(), end, out);
+        if (result.ec == std::errc() && result.ptr == end) return true;
+        if (result.ec == std::errc::result_out_of_range) return false;
+
+        // Browsers send whole numbers as 5.0 or 5e2 too
+        double value;
+        if (!toDouble(token, value) || std::trunc(value) != value
+            || value < -9.2e18 || value > 9.2e18) {
+            return false;
+        }
+        out = static_cast<int64_t>(value);
+        return true;
+    }
+
+    bool toDouble(std::string_view token, double& out)
+    {
+        const char* end = token.data() + token.size();
+        auto result = std::from_chars(token.data(), end, out);
+        return result.ec == std::errc() && result.ptr == end && std::isfinite(out);
+    }
+
+    std::string formatBound(double value)
+    {
+        char buf[32];
+        if (std::trunc(value) == value && std::fabs(value) < 1e15) {
+            std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(value));
+        } else {
+            std::snprintf(buf, sizeof(buf), "%g", value);
+        }
+        return buf;
+    }
+
+    bool isDate(std::string_view s)
+    {
+        Day day;
+        return parseDate(s, day);
+    }
+
+    bool isTimeOfDay(std::string_view s)
+    {
+        int32_t seconds;
+        return parseTimeOfDay(s, seconds);
+    }
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "requestArena.h"
+
+// Typed request bodies.
+//
+// An endpoint declares its JSON body once, as a constexpr schema over a
+// plain struct:
+//
+//   struct MealDto { std::string_view meal_name; int calories = 0; std::optional<std::string_view> date; };
+//   constexpr auto MEAL_SCHEMA = dto::schema<MealDto>(
+//       dto::required("meal_name", &MealDto::meal_name).length(1, 100),
+//       dto::required("calories", &MealDto::calories).range(0, 20000),
+//       dto::optional("date", &MealDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD"));
+//
+//   auto meal = MEAL_SCHEMA.parse(req.body);
+//   if (!meal) return crow::response(400, meal.error());
+//   meal->calories ...
+//
+// parse() walks the body once: each key is matched against the field names
+// and its value converted straight into the member, with the type, range,
+// length and format checks applied as it goes. The first problem becomes a
+// message naming the field ("calories: expected an integer", "missing
+// field: meal_name", "invalid JSON at offset 17"). Unknown keys are skipped.
+//
+// String members are views into the request body; strings with escapes are
+// decoded into a buffer inside the Parsed result, allocated from the request
+// arena. Keep both the body and the Parsed alive while the DTO is in use.
+//
+// Member types: std::string_view, std::string, int, int64_t, double, bool,
+// and std::optional of those (absent or null leaves it empty).
+namespace dto
+{
+    // Single-pass JSON reader over one object. Never throws; after a syntax
+    // error failed() is set and every call returns false.
+    class Reader
+    {
+    public:
+        enum class Kind { Object, Array, String, Number, True, False, Null, Invalid };
+
+        Reader(std::string_view text, std::pmr::string& scratch);
+
+        // Next value's kind, after skipping whitespace (doesn't consume)
+        Kind peek();
+        bool beginObject();
+        // The next member's key; false at the closing '}' or on an error
+        bool nextKey(std::string_view& key);
+        bool readString(std::string_view& out);
+        // Raw number token, checked against the JSON grammar
+        bool readNumber(std::string_view& token);
+        bool readBool(bool& out);
+        bool readNull();
+        bool skipValue();
+        // Only whitespace may follow the object
+        bool finish();
+
+        bool failed() const { return _failed; }
+        std::size_t offset() const { return _pos; }
+
+    private:
+        static constexpr int MAX_DEPTH = 32;
+
+        void skipSpace();
+        bool fail();
+        bool skipValue(int depth);
+        bool literal(std::string_view word);
+
+        std::string_view _text;
+        std::size_t _pos = 0;
+        std::pmr::string& _scratch;
+        bool _failed = false;
+        bool _firstMember = true;
+    };
+
+    // Number token -> value; false when it doesn't fit (or isn't integral).
+    bool toInt64(std::string_view token, int64_t& out);
+    bool toDouble(std::string_view token, double& out);
+    std::string formatBound(double value);
+
+    // Checks usable with satisfies()
+    bool isDate(std::string_view s);        // YYYY-MM-DD
+    bool isTimeOfDay(std::string_view s);   // HH:MM or HH:MM:SS
+
+    namespace detail
+    {
+        template <typename M> struct Unwrap { using type = M; static constexpr bool optional = false; };
+        template <typename V> struct Unwrap<std::optional<V>> { using type = V; static constexpr bool optional = true; };
+
+        enum class ReadResult { Ok, WrongType, Malformed };
+
+        inline ReadResult read(Reader& r, std::string_view& out)
+        {
+            if (r.peek() != Reader::Kind::String) return ReadResult::WrongType;
+            return r.readString(out) ? ReadResult::Ok : ReadResult::Malformed;
+        }
+
+        inline ReadResult read(Reader& r, std::string& out)
+        {
+            std::string_view view;
+            ReadResult result = read(r, view);
+            if (result == ReadResult::Ok) out.assign(view.data(), view.size());
+            return result;
+        }
+
+        template <typename I>
+        std::enable_if_t<std::is_integral_v<I> && !std::is_same_v<I, bool>, ReadResult>
+        read(Reader& r, I& out)
+        {
+            if (r.peek() != Reader::Kind::Number) return ReadResult::WrongType;
+            std::string_view token;
+            if (!r.readNumber(token)) return ReadResult::Malformed;
+            int64_t value;
+            if (!toInt64(token, value) || value < std::numeric_limits<I>::min() || value > std::numeric_limits<I>::max()) {
+                return ReadResult::WrongType;
+            }
+            out = static_cast<I>(value);
+            return ReadResult::Ok;
+        }
+
+        inline ReadResult read(Reader& r, double& out)
+        {
+            if (r.peek() != Reader::Kind::Number) return ReadResult::WrongType;
+            std::string_view token;
+            if (!r.readNumber(token)) return ReadResult::Malformed;
+            return toDouble(token, out) ? ReadResult::Ok : ReadResult::WrongType;
+        }
+
+        inline ReadResult read(Reader& r, bool& out)
+        {
+            Reader::Kind kind = r.peek();
+            if (kind != Reader::Kind::True && kind != Reader::Kind::False) return ReadResult::WrongType;
+            return r.readBool(out) ? ReadResult::Ok : ReadResult::Malformed;
+        }
+
+        template <typename V>
+        ReadResult read(Reader& r, std::optional<V>& out)
+        {
+            if (r.peek() == Reader::Kind::Null) {
+                out.reset();
+                return r.readNull() ? ReadResult::Ok : ReadResult::Malformed;
+            }
+            return read(r, out.emplace());
+        }
+
+        template <typename V> constexpr const char* expected()
+        {
+            if constexpr (std::is_same_v<V, bool>) return "expected true or false";
+            else if constexpr (std::is_integral_v<V>) return "expected an integer";
+            else if constexpr (std::is_floating_point_v<V>) return "expected a number";
+            else return "expected a string";
+        }
+    }
+
+    template <typename T, typename M>
+    struct Field
+    {
+        using Value = typename detail::Unwrap<M>::type;
+
+        std::string_view name;
+        M T::*member;
+        bool isRequired;
+        double min = std::numeric_limits<double>::lowest();
+        double max = std::numeric_limits<double>::max();
+        std::size_t minLength = 0;
+        std::size_t maxLength = std::numeric_limits<std::size_t>::max();
+        bool (*check)(Value) = nullptr;
+        const char* checkMessage = nullptr;
+
+        // Numbers: inclusive bounds
+        constexpr Field range(double lo, double hi) const
+        {
+            Field f = *this;
+            f.min = lo;
+            f.max = hi;
+            return f;
+        }
+
+        // Strings: inclusive bounds in bytes
+        constexpr Field length(std::size_t lo, std::size_t hi) const
+        {
+            Field f = *this;
+            f.minLength = lo;
+            f.maxLength = hi;
+            return f;
+        }
+
+        constexpr Field satisfies(bool (*fn)(Value), const char* message) const
+        {
+            Field f = *this;
+            f.check = fn;
+            f.checkMessage = message;
+            return f;
+        }
+
+        // The constraint the value breaks, or "" when it is fine
+        std::string violation(const Value& value) const
+        {
+            if constexpr (std::is_arithmetic_v<Value> && !std::is_same_v<Value, bool>) {
+                if (static_cast<double>(value) < min || static_cast<double>(value) > max) {
+                    return "must be between " + formatBound(min) + " and " + formatBound(max);
+                }
+            }
+            if constexpr (std::is_same_v<Value, std::string_view> || std::is_same_v<Value, std::string>) {
+                if (value.size() < minLength || value.size() > maxLength) {
+                    return minLength == 1 && maxLength == std::numeric_limits<std::size_t>::max()
+                        ? std::string("must not be empty")
+                        : "must be " + std::to_string(minLength) + "-" + std::to_string(maxLength) + " characters";
+                }
+            }
+            if (check && !check(value)) return checkMessage;
+            return std::string();
+        }
+    };
+
+    template <typename T, typename M>
+    constexpr Field<T, M> required(std::string_view name, M T::*member)
+    {
+        return Field<T, M>{name, member, true};
+    }
+
+    template <typename T, typename M>
+    constexpr Field<T, M> optional(std::string_view name, M T::*member)
+    {
+        return Field<T, M>{name, member, false};
+    }
+
+    // Result of Schema::parse(): the DTO plus the (request arena) buffer its
+    // escaped strings point into. Neither copyable nor movable, so those views stay valid;
+    // bind it with `auto x = schema.parse(body);`.
+    template <typename T>
+    class Parsed
+    {
+    public:
+        template <typename Schema>
+        Parsed(const Schema& schema, std::string_view body) { _ok = schema.parseInto(body, _value, _scratch, _error); }
+        Parsed(const Parsed&) = delete;
+        Parsed& operator=(const Parsed&) = delete;
+
+        explicit operator bool() const { return _ok; }
+        const std::string& error() const { return _error; }
+        const T& operator*() const { return _value; }
+        const T* operator->() const { return &_value; }
+
+    private:
+        T _value{};
+        std::pmr::string _scratch{requestArena()};
+        std::string _error;
+        bool _ok = false;
+    };
+
+    template <typename T, typename... Fields>
+    class Schema
+    {
+        static_assert(sizeof...(Fields) <= 64, "one bit per field in the seen-mask");
+
+    public:
+        constexpr explicit Schema(Fields... fields) : _fields(fields...) {}
+
+        Parsed<T> parse(std::string_view body) const { return Parsed<T>(*this, body); }
+
+        bool parseInto(std::string_view body, T& out, std::pmr::string& scratch, std::string& error) const
+        {
+            return parseInto(body, out, scratch, error, std::index_sequence_for<Fields...>());
+        }
+
+    private:
+        template <std::size_t... I>
+        bool parseInto(std::string_view body, T& out, std::pmr::string& scratch, std::string& error,
+                       std::index_sequence<I...>) const
+        {
+            Reader reader(body, scratch);
+            if (reader.peek() != Reader::Kind::Object) {
+                error = reader.failed() ? syntaxError(reader) : "expected a JSON object";
+                return false;
+            }
+            reader.beginObject();
+
+            uint64_t seen = 0;
+            std::string_view key;
+            while (reader.nextKey(key)) {
+                bool matched = false;
+                bool ok = true;
+                ((!matched && std::get<I>(_fields).name == key
+                  && (matched = true, ok = readField<I>(reader, out, seen, error))), ...);
+                if (!ok) return false;
+                if (!matched && !reader.skipValue()) break;
+            }
+            if (reader.failed() || !reader.finish()) {
+                error = syntaxError(reader);
+                return false;
+            }
+
+            bool complete = true;
+            ((complete = complete && (!std::get<I>(_fields).isRequired || (seen >> I & 1)
+                                      || (error = "missing field: " + std::string(std::get<I>(_fields).name), false))), ...);
+            return complete;
+        }
+
+        template <std::size_t I>
+        bool readField(Reader& reader, T& out, uint64_t& seen, std::string& error) const
+        {
+            const auto& field = std::get<I>(_fields);
+            std::string_view name = field.name;
+            if (seen >> I & 1) {
+                error = "duplicate field: " + std::string(name);
+                return false;
+            }
+            seen |= uint64_t(1) << I;
+
+            auto& target = out.*(field.member);
+            using Member = std::remove_reference_t<decltype(target)>;
+            detail::ReadResult result = detail::read(reader, target);
+            if (result == detail::ReadResult::Malformed) {
+                error = syntaxError(reader);
+                return false;
+            }
+            if (result == detail::ReadResult::WrongType) {
+                error = std::string(name) + ": " + detail::expected<typename detail::Unwrap<Member>::type>();
+                return false;
+            }
+
+            if constexpr (detail::Unwrap<Member>::optional) {
+                if (!target) {
+                    if (field.isRequired) {
+                        error = std::string(name) + ": " + detail::expected<typename detail::Unwrap<Member>::type>();
+                        return false;
+                    }
+                    return true;
+                }
+                std::string problem = field.violation(*target);
+                if (!problem.empty()) error = std::string(name) + ": " + problem;
+                return problem.empty();
+            } else {
+                std::string problem = field.violation(target);
+                if (!problem.empty()) error = std::string(name) + ": " + problem;
+                return problem.empty();
+            }
+        }
+
+        static std::string syntaxError(const Reader& reader)
+        {
+            return "invalid JSON at offset " + std::to_string(reader.offset());
+        }
+
+        std::tuple<Fields...> _fields;
+    };
+
+    template <typename T, typename... Fields>
+    constexpr Schema<T, Fields...> schema(Fields... fields)
+    {
+        return Schema<T, Fields...>(fields...);
+    }
+}
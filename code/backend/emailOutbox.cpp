@@ -0,0 +1,362 @@
+#include "emailOutbox.h"
+#include "dateTime.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+
+constexpr int MAX_ATTEMPTS = 8;
+constexpr int64_t BASE_BACKOFF_SECONDS = 30;
+constexpr int64_t MAX_BACKOFF_SECONDS = 3600;
+constexpr int SEND_BATCH = 20;
+constexpr int64_t IDLE_POLL_SECONDS = 60;
+
+class MockTransport : public EmailTransport
+{
+public:
+    bool send(const OutboundEmail& email, std::string&) override
+    {
+        std::cout << "[MOCK EMAIL] To: " << email.to
+                  << "\nSubject: " << email.subject
+                  << "\n\n[TEXT VERSION]\n" << email.body_text
+                  << "\n\n[HTML VERSION]\n" << email.body_html
+                  << "\n";
+        return true;
+    }
+};
+
+// Writes each message as an .eml file; tests read the directory instead of a mailbox.
+class FileTransport : public EmailTransport
+{
+public:
+    FileTransport(std::string dir, std::string from) : _dir(std::move(dir)), _from(std::move(from))
+    {
+        mkdir(_dir.c_str(), 0755);
+    }
+
+    bool send(const OutboundEmail& email, std::string& error) override
+    {
+        std::string name = _dir + "/" + std::to_string(nowUtc().value) + "-" + std::to_string(email.id) + ".eml";
+        std::string tmp = name + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::out | std::ios::trunc);
+            if (!out) {
+                error = "cannot write " + tmp;
+                return false;
+            }
+            out << "From: " << _from << "\r\n"
+                << "To: " << email.to << "\r\n"
+                << "Subject: " << email.subject << "\r\n"
+                << "MIME-Version: 1.0\r\n"
+                << "Content-Type: multipart/alternative; boundary=\"outbox\"\r\n\r\n"
+                << "--outbox\r\nContent-Type: text/plain; charset=utf-8\r\n\r\n" << email.body_text << "\r\n"
+                << "--outbox\r\nContent-Type: text/html; charset=utf-8\r\n\r\n" << email.body_html << "\r\n"
+                << "--outbox--\r\n";
+            if (!out) {
+                error = "short write to " + tmp;
+                return false;
+            }
+        }
+        // rename so a reader never sees a half-written message
+        if (std::rename(tmp.c_str(), name.c_str()) != 0) {
+            error = "cannot rename " + tmp;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string _dir;
+    std::string _from;
+};
+
+// Submits the whole batch to the shared HttpClient at once, so a burst of
+// mail goes out over a few pooled keep-alive connections in parallel.
+class MailgunTransport : public EmailTransport
+{
+public:
+    explicit MailgunTransport(EmailConfig cfg) : _cfg(std::move(cfg)) {}
+
+    bool send(const OutboundEmail& email, std::string& error) override
+    {
+        if (!send_email_via_mailgun(_cfg, email.to, email.subject, email.body_text, email.body_html)) {
+            error = "Mailgun request failed";
+            return false;
+        }
+        return true;
+    }
+
+    void sendBatch(const std::vector<OutboundEmail>& emails,
+                   std::vector<bool>& sent, std::vector<std::string>& errors) override
+    {
+        sent.assign(emails.size(), false);
+        errors.assign(emails.size(), std::string());
+
+        std::vector<std::future<HttpResponse>> replies(emails.size());
+        for (std::size_t i = 0; i < emails.size(); ++i) {
+            HttpRequest request;
+            if (!build_mailgun_request(_cfg, emails[i].to, emails[i].subject,
+                                       emails[i].body_text, emails[i].body_html, request)) {
+                errors[i] = "Mailgun is not configured";
+                continue;
+            }
+            replies[i] = sharedHttpClient().submit(std::move(request));
+        }
+
+        for (std::size_t i = 0; i < emails.size(); ++i) {
+            if (!replies[i].valid()) continue;
+            HttpResponse resp = replies[i].get();
+            sent[i] = mailgun_response_ok(resp);
+            if (!sent[i]) {
+                errors[i] = resp.status == 0 ? resp.error : "Mailgun HTTP " + std::to_string(resp.status);
+            }
+        }
+    }
+
+private:
+    EmailConfig _cfg;
+};
+
+int64_t backoffSeconds(int attempts)
+{
+    int64_t delay = BASE_BACKOFF_SECONDS << std::min(attempts - 1, 16);
+    delay = std::min(delay, MAX_BACKOFF_SECONDS);
+    thread_local std::mt19937 rng{std::random_device{}()};
+    return delay + std::uniform_int_distribution<int64_t>(0, delay / 4)(rng);
+}
+
+} // namespace
+
+void EmailTransport::sendBatch(const std::vector<OutboundEmail>& emails,
+                               std::vector<bool>& sent, std::vector<std::string>& errors)
+{
+    sent.assign(emails.size(), false);
+    errors.assign(emails.size(), std::string());
+    for (std::size_t i = 0; i < emails.size(); ++i) {
+        sent[i] = send(emails[i], errors[i]);
+    }
+}
+
+std::unique_ptr<EmailTransport> makeEmailTransport(const EmailConfig& cfg)
+{
+    if (cfg.mode == "real") return std::make_unique<MailgunTransport>(cfg);
+    if (cfg.mode == "file") return std::make_unique<FileTransport>(cfg.outbox_dir, cfg.from);
+    return std::make_unique<MockTransport>();
+}
+
+EmailOutbox::EmailOutbox(Database& database, std::unique_ptr<EmailTransport> transport)
+    : _database(database), _transport(std::move(transport))
+{
+}
+
+EmailOutbox::~EmailOutbox()
+{
+    stop();
+}
+
+bool EmailOutbox::enqueue(sqlite3* db, const std::string& to, const std::string& subject,
+                          const std::string& body_text, const std::string& body_html)
+{
+    const char* sql = R"(
+        INSERT INTO email_outbox (to_address, subject, body_text, body_html, next_attempt_at, created_at)
+        VALUES (?, ?, ?, ?, ?, ?);
+    )";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare email enqueue: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    int64_t now = nowUtc().value;
+    sqlite3_bind_text(stmt, 1, to.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, subject.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, body_text.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, body_html.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 5, now);
+    sqlite3_bind_int64(stmt, 6, now);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+
+    if (!ok) {
+        std::cerr << "Failed to enqueue email: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _poked = true;
+    }
+    _wake.notify_one();
+    return true;
+}
+
+bool EmailOutbox::sendDue(int limit)
+{
+    std::lock_guard<std::mutex> sending(_sendMutex);
+
+    std::vector<OutboundEmail> batch;
+    std::vector<int> attempts;
+    {
+        auto db = _database.read();
+        sqlite3_stmt* stmt;
+        const char* selectSql = R"(
+            SELECT id, to_address, subject, body_text, COALESCE(body_html, ''), attempts
+            FROM email_outbox
+            WHERE status = 'pending' AND next_attempt_at <= ?
+            ORDER BY next_attempt_at
+            LIMIT ?;
+        )";
+        if (sqlite3_prepare_v2(db, selectSql, -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to read email outbox: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, nowUtc().value);
+        sqlite3_bind_int(stmt, 2, limit);
+
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            OutboundEmail e;
+            e.id = sqlite3_column_int64(stmt, 0);
+            e.to = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            e.subject = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            e.body_text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            e.body_html = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+            attempts.push_back(sqlite3_column_int(stmt, 5));
+            batch.push_back(std::move(e));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    if (batch.empty()) return false;
+
+    // Sent without holding a lease; the writer is only taken to record the results.
+    std::vector<bool> sent;
+    std::vector<std::string> errors;
+    _transport->sendBatch(batch, sent, errors);
+
+    // One transaction for the whole batch instead of a commit per row.
+    auto db = _database.write();
+    int64_t now = nowUtc().value;
+    bool recorded = inTransaction(db, [&] {
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            const OutboundEmail& email = batch[i];
+            const std::string& error = errors[i];
+            int tries = attempts[i] + 1;
+
+            sqlite3_stmt* update;
+            if (sent[i]) {
+                if (sqlite3_prepare_v2(db,
+                        "UPDATE email_outbox SET status = 'sent', attempts = ?, sent_at = ?, last_error = NULL WHERE id = ?;",
+                        -1, &update, nullptr) != SQLITE_OK) {
+                    return false;
+                }
+                sqlite3_bind_int(update, 1, tries);
+                sqlite3_bind_int64(update, 2, now);
+                sqlite3_bind_int64(update, 3, email.id);
+            } else {
+                bool giveUp = tries >= MAX_ATTEMPTS;
+                std::cerr << "Email " << email.id << " attempt " << tries << " failed: " << error
+                          << (giveUp ? " (giving up)" : "") << std::endl;
+                if (sqlite3_prepare_v2(db,
+                        "UPDATE email_outbox SET status = ?, attempts = ?, next_attempt_at = ?, last_error = ? WHERE id = ?;",
+                        -1, &update, nullptr) != SQLITE_OK) {
+                    return false;
+                }
+                sqlite3_bind_text(update, 1, giveUp ? "failed" : "pending", -1, SQLITE_STATIC);
+                sqlite3_bind_int(update, 2, tries);
+                sqlite3_bind_int64(update, 3, now + backoffSeconds(tries));
+                sqlite3_bind_text(update, 4, error.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int64(update, 5, email.id);
+            }
+            bool ok = sqlite3_step(update) == SQLITE_DONE;
+            if (!ok) std::cerr << "Failed to update email " << email.id << ": " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_finalize(update);
+            if (!ok) return false;
+        }
+        return true;
+    });
+    if (!recorded) {
+        // Rolled back: these rows stay pending and go out again on the next batch.
+        std::cerr << "Failed to record email outbox batch of " << batch.size() << std::endl;
+        return false;
+    }
+
+    return static_cast<int>(batch.size()) == limit;
+}
+
+int64_t EmailOutbox::nextDueAt()
+{
+    auto db = _database.read();
+    sqlite3_stmt* stmt;
+    int64_t next = 0;
+    if (sqlite3_prepare_v2(db, "SELECT MIN(next_attempt_at) FROM email_outbox WHERE status = 'pending';",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+            next = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return next;
+}
+
+int EmailOutbox::pendingCount()
+{
+    auto db = _database.read();
+    sqlite3_stmt* stmt;
+    int count = 0;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM email_outbox WHERE status = 'pending';",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return count;
+}
+
+void EmailOutbox::run()
+{
+    while (!_stop) {
+        // Drain full batches back to back, then sleep until the next retry is due.
+        while (!_stop && sendDue(SEND_BATCH)) {}
+
+        int64_t now = nowUtc().value;
+        int64_t next = nextDueAt();
+        int64_t waitSeconds = next == 0 ? IDLE_POLL_SECONDS : std::clamp<int64_t>(next - now, 0, IDLE_POLL_SECONDS);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait_for(lock, std::chrono::seconds(waitSeconds), [this] { return _poked || _stop.load(); });
+        _poked = false;
+    }
+}
+
+void EmailOutbox::start()
+{
+    if (_thread.joinable()) return;
+    _stop = false;
+    _thread = std::thread(&EmailOutbox::run, this);
+}
+
+void EmailOutbox::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    if (_thread.joinable()) _thread.join();
+}
+
+bool EmailOutbox::flush(int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool more = sendDue(SEND_BATCH);
+        int64_t next = nextDueAt();
+        if (next == 0 || next > nowUtc().value) return true;  // nothing due right now
+        if (!more) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "database.h"
+#include "reset.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct OutboundEmail {
+    int64_t id = 0;
+    std::string to;
+    std::string subject;
+    std::string body_text;
+    std::string body_html;
+};
+
+// How an email leaves the process. Implementations are only ever called
+// from the outbox sender thread.
+class EmailTransport
+{
+public:
+    virtual ~EmailTransport() {}
+    // Returns false with `error` filled on failure; the outbox retries later.
+    virtual bool send(const OutboundEmail& email, std::string& error) = 0;
+
+    // Sends a whole batch; sent[i]/errors[i] describe emails[i]. The default
+    // sends one at a time, transports that can overlap requests override it.
+    virtual void sendBatch(const std::vector<OutboundEmail>& emails,
+                           std::vector<bool>& sent, std::vector<std::string>& errors);
+};
+
+// EMAIL_MODE=mock: print to stdout. file: write one .eml per message to
+// EMAIL_OUTBOX_DIR (for tests). real: Mailgun over the shared HttpClient.
+std::unique_ptr<EmailTransport> makeEmailTransport(const EmailConfig& cfg);
+
+// Persistent outbound queue (email_outbox table) drained by one background
+// sender with exponential backoff, so request threads only pay for an INSERT.
+// The sender takes its own read() and write() leases, so its updates never
+// interleave with a handler's transaction.
+class EmailOutbox
+{
+public:
+    EmailOutbox(Database& database, std::unique_ptr<EmailTransport> transport);
+    ~EmailOutbox();
+
+    // Stores the message on the caller's write() lease (so it commits with the
+    // caller's own writes) and wakes the sender. Returns false if the INSERT failed.
+    bool enqueue(sqlite3* db, const std::string& to, const std::string& subject,
+                 const std::string& body_text, const std::string& body_html = "");
+
+    void start();
+    void stop();
+
+    // Sends everything already due, waiting at most `timeoutMs`. Returns true if the queue drained.
+    bool flush(int timeoutMs);
+
+    // Number of messages still waiting to be sent.
+    int pendingCount();
+
+private:
+    bool sendDue(int limit);
+    int64_t nextDueAt();
+    void run();
+
+    Database& _database;
+    std::unique_ptr<EmailTransport> _transport;
+    std::mutex _mutex;
+    std::mutex _sendMutex;  // one batch at a time (sender thread or flush)
+    std::condition_variable _wake;
+    bool _poked = false;
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+};
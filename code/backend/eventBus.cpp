@@ -0,0 +1,163 @@
+#include "eventBus.h"
+#include "logger.h"
+#include <chrono>
+#include <exception>
+
+struct EventBus::Subscriber {
+    std::string name;
+    Handler handler;
+    MpscRing<ChangeEvent> ring{RING_CAPACITY};
+    std::atomic<bool> sleeping{false};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+};
+
+const char* changeEntityName(ChangeEntity entity)
+{
+    switch (entity) {
+        case ChangeEntity::Session: return "session";
+        case ChangeEntity::Exercise: return "exercise";
+        case ChangeEntity::Meal: return "meal";
+        case ChangeEntity::Sleep: return "sleep";
+        case ChangeEntity::Goal: return "goal";
+        case ChangeEntity::GoalProgress: return "goal_progress";
+        case ChangeEntity::FriendRequest: return "friend_request";
+        case ChangeEntity::Friendship: return "friendship";
+    }
+    return "unknown";
+}
+
+const char* changeOpName(ChangeOp op)
+{
+    switch (op) {
+        case ChangeOp::Insert: return "insert";
+        case ChangeOp::Update: return "update";
+        case ChangeOp::Delete: return "delete";
+    }
+    return "unknown";
+}
+
+EventBus::EventBus() = default;
+
+EventBus::~EventBus()
+{
+    stop();
+}
+
+void EventBus::subscribe(const std::string& name, Handler handler)
+{
+    if (_started) {
+        logEvent(LogLevel::Error, "event_subscribe_after_start").field("subscriber", name);
+        return;
+    }
+    auto subscriber = std::make_unique<Subscriber>();
+    subscriber->name = name;
+    subscriber->handler = std::move(handler);
+    _subscribers.push_back(std::move(subscriber));
+}
+
+void EventBus::observe(const std::string& name, Handler handler)
+{
+    if (_started) {
+        logEvent(LogLevel::Error, "event_subscribe_after_start").field("observer", name);
+        return;
+    }
+    _observers.emplace_back(name, std::move(handler));
+}
+
+void EventBus::start()
+{
+    if (_started.exchange(true)) return;
+    for (auto& subscriber : _subscribers) {
+        Subscriber* s = subscriber.get();
+        s->thread = std::thread([this, s] { run(*s); });
+    }
+}
+
+void EventBus::stop()
+{
+    if (_stop.exchange(true)) return;
+    for (auto& subscriber : _subscribers) {
+        {
+            std::lock_guard<std::mutex> lock(subscriber->mutex);
+        }
+        subscriber->wake.notify_one();
+        if (subscriber->thread.joinable()) subscriber->thread.join();
+    }
+}
+
+void EventBus::publish(ChangeEvent event)
+{
+    event.sequence = ++_published;
+    for (auto& observer : _observers) {
+        try {
+            observer.second(event);
+        } catch (const std::exception& e) {
+            logEvent(LogLevel::Error, "event_handler_failed").field("observer", observer.first).field("error", e.what());
+        }
+    }
+    for (auto& subscriber : _subscribers) {
+        if (!subscriber->ring.tryPush(event)) {
+            subscriber->dropped++;
+            continue;
+        }
+        // Pairs with the fence in run(): either we see it asleep, or it sees our event
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (subscriber->sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(subscriber->mutex);
+            subscriber->wake.notify_one();
+        }
+    }
+}
+
+void EventBus::run(Subscriber& subscriber)
+{
+    ChangeEvent event;
+    for (;;) {
+        // Read before draining, so everything published before stop() is delivered
+        bool stopping = _stop;
+        while (subscriber.ring.tryPop(event)) {
+            try {
+                subscriber.handler(event);
+            } catch (const std::exception& e) {
+                logEvent(LogLevel::Error, "event_handler_failed")
+                    .field("subscriber", subscriber.name)
+                    .field("error", e.what());
+            }
+            subscriber.delivered++;
+        }
+        if (stopping) return;
+
+        std::unique_lock<std::mutex> lock(subscriber.mutex);
+        subscriber.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (subscriber.ring.sizeApprox() == 0 && !_stop) {
+            // The timeout only bounds the cost of a wakeup lost to a race
+            subscriber.wake.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        subscriber.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+std::vector<EventBus::SubscriberStats> EventBus::stats() const
+{
+    std::vector<SubscriberStats> out;
+    for (const auto& subscriber : _subscribers) {
+        out.push_back(SubscriberStats{
+            subscriber->name,
+            subscriber->delivered.load(),
+            subscriber->dropped.load(),
+            subscriber->ring.sizeApprox(),
+        });
+    }
+    return out;
+}
+
+EventBus& eventBus()
+{
+    static EventBus bus;
+    return bus;
+}
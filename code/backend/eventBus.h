@@ -0,0 +1,155 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class ChangeEntity : uint8_t { Session, Exercise, Meal, Sleep, Goal, GoalProgress, FriendRequest, Friendship };
+enum class ChangeOp : uint8_t { Insert, Update, Delete };
+
+// One committed row change, published by the write paths once the route's
+// transaction has committed, so observers never see a change that rolls back.
+struct ChangeEvent {
+    ChangeEntity entity;
+    ChangeOp op;
+    int user_id;                // owner; for friend requests and friendships the acting user
+    int64_t id;                 // row id (sleepTable.sleep_id for Sleep, 0 for Friendship)
+    int other_user_id = 0;      // the other side of a friend request or friendship
+    uint64_t sequence = 0;      // set by publish(), increasing across the process
+};
+
+const char* changeEntityName(ChangeEntity entity);
+const char* changeOpName(ChangeOp op);
+
+// Bounded lock-free queue for many producers and one consumer (Vyukov's
+// sequence-numbered cells). Capacity is rounded up to a power of two.
+template <typename T>
+class MpscRing
+{
+public:
+    explicit MpscRing(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) size <<= 1;
+        _mask = size - 1;
+        _cells.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i) _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Any thread. False when full.
+    bool tryPush(const T& value)
+    {
+        std::size_t pos = _head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only.
+    bool tryPop(T& out)
+    {
+        std::size_t pos = _tail.load(std::memory_order_relaxed);
+        Cell& cell = _cells[pos & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+        out = cell.value;
+        cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+        _tail.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::size_t sizeApprox() const
+    {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask = 0;
+    alignas(64) std::atomic<std::size_t> _head{0};
+    alignas(64) std::atomic<std::size_t> _tail{0};
+};
+
+// In-process change-data-capture fan-out. publish() never blocks or takes a
+// lock on the common path: the event goes into every subscriber's own ring,
+// and each subscriber drains its ring on its own thread, in order. A
+// subscriber that falls RING_CAPACITY events behind loses the overflow
+// (counted in stats()), so handlers should stay cheap or hand work on.
+//
+// Observers are the exception: they run inside publish(), on the writing
+// thread, before any subscriber is handed the event. That is for the little
+// that must be done before the write's response goes out (dropping cached
+// reads, so the writer reads its own write), and it is paid by every write.
+class EventBus
+{
+public:
+    using Handler = std::function<void(const ChangeEvent&)>;
+    static constexpr std::size_t RING_CAPACITY = 4096;
+
+    struct SubscriberStats {
+        std::string name;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0;
+        std::size_t queued = 0;
+    };
+
+    EventBus();
+    ~EventBus();
+
+    // Before start(); events published earlier are queued for it.
+    void subscribe(const std::string& name, Handler handler);
+    // Before start(). Runs synchronously in publish(); must be cheap and thread-safe.
+    void observe(const std::string& name, Handler handler);
+
+    void start();
+    // Delivers what is already queued, then joins the subscriber threads.
+    void stop();
+
+    void publish(ChangeEvent event);
+
+    uint64_t published() const { return _published.load(); }
+    std::vector<SubscriberStats> stats() const;
+
+private:
+    struct Subscriber;
+    void run(Subscriber& subscriber);
+
+    std::vector<std::pair<std::string, Handler>> _observers;
+    std::vector<std::unique_ptr<Subscriber>> _subscribers;
+    std::atomic<bool> _started{false};
+    std::atomic<bool> _stop{false};
+    std::atomic<uint64_t> _published{0};
+};
+
+EventBus& eventBus();
+
+inline void publishChange(ChangeEntity entity, ChangeOp op, int userId, int64_t id, int otherUserId = 0)
+{
+    eventBus().publish(ChangeEvent{entity, op, userId, id, otherUserId});
+}
@@ -0,0 +1,133 @@
+#include "formData.h"
+#include <cstring>
+
+namespace
+{
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool isControl(unsigned char c)
+    {
+        return c < 0x20 || c == 0x7F;
+    }
+}
+
+bool formDecode(std::string_view raw, char* out, std::size_t& length)
+{
+    // Writes never overtake reads, so out == raw.data() is safe
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c == '+') {
+            out[n++] = ' ';
+        } else if (c == '%') {
+            if (i + 2 >= raw.size()) return false;
+            int hi = hexValue(raw[i + 1]);
+            int lo = hexValue(raw[i + 2]);
+            if (hi < 0 || lo < 0) return false;
+            unsigned char byte = static_cast<unsigned char>(hi << 4 | lo);
+            if (isControl(byte)) return false;
+            out[n++] = static_cast<char>(byte);
+            i += 2;
+        } else {
+            out[n++] = c;
+        }
+    }
+    length = n;
+    return true;
+}
+
+FormData::FormData(std::string_view body, std::pmr::memory_resource* arena)
+    : _decoded(arena)
+{
+    if (body.size() > MAX_BYTES) {
+        fail("form body too large", MAX_BYTES);
+        return;
+    }
+    std::size_t begin = 0;
+    while (begin <= body.size()) {
+        std::size_t end = body.size();
+        if (begin < body.size()) {
+            const void* amp = std::memchr(body.data() + begin, '&', body.size() - begin);
+            if (amp) end = static_cast<const char*>(amp) - body.data();
+        }
+        if (end > begin && !addPair(body, begin, end)) return;
+        begin = end + 1;
+    }
+}
+
+bool FormData::fail(const char* message, std::size_t offset)
+{
+    _error = message;
+    _errorOffset = offset;
+    return false;
+}
+
+bool FormData::addPair(std::string_view body, std::size_t begin, std::size_t end)
+{
+    const void* eq = std::memchr(body.data() + begin, '=', end - begin);
+    if (!eq) return fail("expected name=value", begin);
+    std::size_t split = static_cast<const char*>(eq) - body.data();
+    if (split == begin) return fail("empty field name", begin);
+    if (_count == MAX_FIELDS) return fail("too many fields", begin);
+
+    Field field;
+    if (!component(body, begin, split, field.name) || !component(body, split + 1, end, field.value)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < _count; ++i) {
+        if (_fields[i].name == field.name) return fail("repeated field", begin);
+    }
+    _fields[_count++] = field;
+    return true;
+}
+
+bool FormData::component(std::string_view body, std::size_t begin, std::size_t end, std::string_view& out)
+{
+    bool escaped = false;
+    for (std::size_t i = begin; i < end; ++i) {
+        unsigned char c = static_cast<unsigned char>(body[i]);
+        if (c <= 0x20 || c >= 0x7F) return fail("byte must be percent-encoded", i);
+        if (c == '=') return fail("unescaped '=' in value", i);
+        if (c == '%') {
+            if (i + 2 >= end || hexValue(body[i + 1]) < 0 || hexValue(body[i + 2]) < 0) {
+                return fail("malformed percent escape", i);
+            }
+            unsigned char byte = static_cast<unsigned char>(hexValue(body[i + 1]) << 4 | hexValue(body[i + 2]));
+            if (isControl(byte)) return fail("control character", i);
+            escaped = true;
+            i += 2;
+        } else if (c == '+') {
+            escaped = true;
+        }
+    }
+
+    std::string_view raw = body.substr(begin, end - begin);
+    if (!escaped) {
+        out = raw;
+        return true;
+    }
+    // Reserved once for the whole body (decoding only shrinks), so earlier
+    // views into _decoded survive later appends
+    if (_decoded.capacity() < body.size()) _decoded.reserve(body.size());
+    std::size_t start = _decoded.size();
+    _decoded.resize(start + raw.size());
+    std::size_t length = 0;
+    formDecode(raw, _decoded.data() + start, length);
+    _decoded.resize(start + length);
+    out = std::string_view(_decoded.data() + start, length);
+    return true;
+}
+
+std::optional<std::string_view> FormData::get(std::string_view name) const
+{
+    for (std::size_t i = 0; i < _count; ++i) {
+        if (_fields[i].name == name) return _fields[i].value;
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "requestArena.h"
+
+// An application/x-www-form-urlencoded body (or query string), split and
+// checked in one pass without touching the heap:
+//
+//   FormData form(req.body);
+//   if (!form) return crow::response(400, form.error());
+//   std::optional<std::string_view> username = form.get("username");
+//
+// Names and values are views into the body. Only components with '+' or
+// %XX escapes are decoded, into one buffer from the request arena sized to
+// the body, so every view stays valid as long as the body and the FormData.
+//
+// Strict, because a login form has no business sending anything unusual:
+// the body is rejected when it is over MAX_BYTES or MAX_FIELDS, has a pair
+// without '=', an empty name, a repeated name, a second unescaped '=', a
+// raw byte outside printable ASCII, a '%' not followed by two hex digits,
+// or an escape that decodes to a control character. Empty pairs ("a=1&&b=2",
+// a trailing '&') are skipped, as browsers do.
+class FormData
+{
+public:
+    static constexpr std::size_t MAX_BYTES = 16 * 1024;
+    static constexpr std::size_t MAX_FIELDS = 16;
+
+    explicit FormData(std::string_view body, std::pmr::memory_resource* arena = requestArena());
+    FormData(const FormData&) = delete;
+    FormData& operator=(const FormData&) = delete;
+
+    explicit operator bool() const { return _error == nullptr; }
+    // What was wrong with the body, or nullptr
+    const char* error() const { return _error; }
+    // Byte offset in the body where the problem was found
+    std::size_t errorOffset() const { return _errorOffset; }
+
+    // Decoded value of `name`; nullopt when absent
+    std::optional<std::string_view> get(std::string_view name) const;
+
+    std::size_t size() const { return _count; }
+    std::string_view name(std::size_t i) const { return _fields[i].name; }
+    std::string_view value(std::size_t i) const { return _fields[i].value; }
+
+private:
+    struct Field {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    bool addPair(std::string_view body, std::size_t begin, std::size_t end);
+    bool component(std::string_view body, std::size_t begin, std::size_t end, std::string_view& out);
+    bool fail(const char* message, std::size_t offset);
+
+    std::array<Field, MAX_FIELDS> _fields;
+    std::size_t _count = 0;
+    std::pmr::string _decoded;
+    const char* _error = nullptr;
+    std::size_t _errorOffset = 0;
+};
+
+// Decodes one form component ('+' is a space, %XX a byte) into `out`, which
+// may be raw.data() itself to decode in place. False, leaving `length`
+// unset, when an escape is malformed or decodes to a control character.
+bool formDecode(std::string_view raw, char* out, std::size_t& length);
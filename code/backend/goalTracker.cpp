@@ -1,4 +1,7 @@
 #include "goalTracker.h"
+#include "timeZone.h"
+#include "scoreEngine.h"
+#include "eventBus.h"
 #include <iostream>
 
 std::vector<Goal> getAllGoals(sqlite3* db, int user_id, const std::string& status_filter) {
@@ -66,19 +69,23 @@ bool addGoal(sqlite3* db, int user_id, const std::string& goal_name,
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     if (!success)
         std::cerr << "Error inserting goal: " << sqlite3_errmsg(db) << std::endl;
+    else
+        publishChange(ChangeEntity::Goal, ChangeOp::Insert, user_id, sqlite3_last_insert_rowid(db));
 
     sqlite3_finalize(stmt);
     return success;
 }
 
 bool addGoalProgress(sqlite3* db, int goal_id, double value) {
-    const char* checkSql = "SELECT status FROM goals WHERE id = ?;";
+    const char* checkSql = "SELECT status, user_id FROM goals WHERE id = ?;";
     sqlite3_stmt* checkStmt;
+    int owner_id = 0;
     if (sqlite3_prepare_v2(db, checkSql, -1, &checkStmt, nullptr) == SQLITE_OK) {
         sqlite3_bind_int(checkStmt, 1, goal_id);
         if (sqlite3_step(checkStmt) == SQLITE_ROW) {
             const unsigned char* statusText = sqlite3_column_text(checkStmt, 0);
             std::string status = statusText ? reinterpret_cast<const char*>(statusText) : "active";
+            owner_id = sqlite3_column_int(checkStmt, 1);
             sqlite3_finalize(checkStmt);
             if (status == "completed") {
                 std::cerr << "Goal already completed, cannot add progress.\n";
@@ -90,7 +97,7 @@ bool addGoalProgress(sqlite3* db, int goal_id, double value) {
         return false;
     }
 
-    const char* sql = "INSERT INTO goal_progress (goal_id, date, progress_value) VALUES (?, ?, ?);";
+    const char* sql = "INSERT INTO goal_progress (goal_id, date, progress_value, day) VALUES (?, ?, ?, ?);";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -98,22 +105,30 @@ bool addGoalProgress(sqlite3* db, int goal_id, double value) {
         return false;
     }
 
-    // today's date
-    time_t t = time(nullptr);
-    tm* now = localtime(&t);
-    char buf[11];
-    strftime(buf, sizeof(buf), "%Y-%m-%d", now);
-    std::string today = buf;
+    // today's date in the goal owner's timezone
+    Day today = owner_id ? todayForUser(db, owner_id) : serverTimeZone()->dayAt(nowUtc());
+    char buf[DATE_BUF_SIZE];
+    formatDate(today, buf);
 
     sqlite3_bind_int(stmt, 1, goal_id);
-    sqlite3_bind_text(stmt, 2, today.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, buf, -1, SQLITE_TRANSIENT);
     sqlite3_bind_double(stmt, 3, value);
-
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    if (!success)
-        std::cerr << "Error inserting goal progress: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_bind_int(stmt, 4, today.value);
+
+    // The row and its points commit together
+    int64_t progress_id = 0;
+    bool success = inTransaction(db, [&] {
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Error inserting goal progress: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        progress_id = sqlite3_last_insert_rowid(db);
+        return !owner_id || recordActivity(db, {ScoreKind::GoalProgress, owner_id, progress_id});
+    });
 
     sqlite3_finalize(stmt);
+    if (success && owner_id)
+        publishChange(ChangeEntity::GoalProgress, ChangeOp::Insert, owner_id, progress_id);
     return success;
 }
 
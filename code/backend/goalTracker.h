@@ -2,6 +2,8 @@
 #define GOALTRACKER_H
 
 #include <crow.h>
+#include "admissionControl.h"
+#include "shardRouter.h"
 #include <sqlite3.h>
 #include <vector>
 #include <string>
@@ -26,6 +28,6 @@ double getGoalTotalProgress(sqlite3* db, int goal_id);
 
 
 // Routes
-void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db);
+void setupGoalRoutes(FitnessApp& app, ShardRouter& shards);
 
 #endif
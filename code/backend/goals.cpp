@@ -1,7 +1,19 @@
 #include "calorie_tracker.h"
+#include "dto.h"
 #include <sqlite3.h>
 
-crow::response getUserGoals(crow::SimpleApp& app, sqlite3* db, int user_id) {
+namespace {
+    struct CalorieGoalsDto {
+        int calorie_goal = 0;
+        double protein_goal = 0.0;
+    };
+
+    constexpr auto CALORIE_GOALS_SCHEMA = dto::schema<CalorieGoalsDto>(
+        dto::required("calorie_goal", &CalorieGoalsDto::calorie_goal).range(0, 20000),
+        dto::required("protein_goal", &CalorieGoalsDto::protein_goal).range(0, 2000));
+}
+
+crow::response getUserGoals(FitnessApp& app, sqlite3* db, int user_id) {
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db,
         "SELECT daily_calorie_goal, daily_protein_goal FROM goals WHERE user_id=?",
@@ -22,12 +34,12 @@ crow::response getUserGoals(crow::SimpleApp& app, sqlite3* db, int user_id) {
     return crow::response(result);
 }
 
-crow::response updateUserGoals(crow::SimpleApp& app, sqlite3* db, int user_id, const crow::request& req) {
-    auto data = crow::json::load(req.body);
-    if (!data) return crow::response(400, "Invalid JSON");
+crow::response updateUserGoals(FitnessApp& app, sqlite3* db, int user_id, const crow::request& req) {
+    auto goals = CALORIE_GOALS_SCHEMA.parse(req.body);
+    if (!goals) return crow::response(400, goals.error());
 
-    int calorie_goal = data["calorie_goal"].i();
-    double protein_goal = data["protein_goal"].d();
+    int calorie_goal = goals->calorie_goal;
+    double protein_goal = goals->protein_goal;
 
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db,
@@ -1,4 +1,87 @@
 #include "hash.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// Until calibration runs, new hashes use libsodium's MODERATE preset (the old fixed cost).
+std::atomic<unsigned long long> currentOpslimit{crypto_pwhash_OPSLIMIT_MODERATE};
+std::atomic<size_t> currentMemlimit{crypto_pwhash_MEMLIMIT_MODERATE};
+std::atomic<double> currentHashMs{0.0};
+
+// Calibration only ever raises the cost: never below the MODERATE preset (256 MiB, 3 passes).
+constexpr size_t MIN_CALIBRATED_MEMLIMIT = crypto_pwhash_MEMLIMIT_MODERATE;
+constexpr unsigned long long MIN_CALIBRATED_OPSLIMIT = crypto_pwhash_OPSLIMIT_MODERATE;
+constexpr unsigned long long MAX_CALIBRATED_OPSLIMIT = 20;
+
+// Calibration is timed, so two starts rarely pick the same cost. A stored hash
+// is only redone when its work (passes x memory) is below this share of the
+// current cost's; one pass either way between restarts does not rehash everyone.
+constexpr double REHASH_TOLERANCE = 0.75;
+
+constexpr int ARGON2_VERSION = 0x13;   // the "v=19" libsodium writes
+
+long envLong(const char* name, long fallback)
+{
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    return (end && *end == '\0' && parsed > 0) ? parsed : fallback;
+}
+
+// Best of two runs, in milliseconds; negative if libsodium could not allocate the memory.
+double timeHash(unsigned long long opslimit, size_t memlimit)
+{
+    static const char sample[] = "calibration-password";
+    char out[crypto_pwhash_STRBYTES];
+    double best = -1.0;
+    for (int i = 0; i < 2; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (crypto_pwhash_str(out, sample, sizeof(sample) - 1, opslimit, memlimit) != 0) return -1.0;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+double estimateLoginsPerSecond(size_t memlimit, double hashMs)
+{
+    if (hashMs <= 0) return 0;
+    double cores = std::max(1u, std::thread::hardware_concurrency());
+    double parallel = cores;
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0 && memlimit > 0) {
+        // leave half of RAM for everything else
+        double slots = (static_cast<double>(pages) * pageSize / 2) / memlimit;
+        parallel = std::max(1.0, std::min(cores, slots));
+    }
+    return parallel * 1000.0 / hashMs;
+}
+
+// Passes and memory (bytes) of an "$argon2id$v=19$m=<KiB>,t=<passes>,p=1$..."
+// string; false for anything else, including other algorithms.
+bool hashParameters(const string& hashed, unsigned long long& opslimit, size_t& memlimit)
+{
+    int version = 0;
+    unsigned long memoryKib = 0, passes = 0, lanes = 0;
+    if (std::sscanf(hashed.c_str(), "$argon2id$v=%d$m=%lu,t=%lu,p=%lu$",
+                    &version, &memoryKib, &passes, &lanes) != 4 ||
+        version != ARGON2_VERSION) {
+        return false;
+    }
+    opslimit = passes;
+    memlimit = static_cast<size_t>(memoryKib) * 1024;
+    return true;
+}
+
+} // namespace
 
 string hashPassword(const string &password)
 {
@@ -6,8 +89,8 @@ string hashPassword(const string &password)
     if (crypto_pwhash_str(hashed, 
         password.c_str(), 
         password.size(),
-        crypto_pwhash_OPSLIMIT_MODERATE,
-        crypto_pwhash_MEMLIMIT_MODERATE) != 0) 
+        currentOpslimit.load(),
+        currentMemlimit.load()) != 0) 
         {
             throw runtime_error("Out of memory while hashing");
         }
@@ -22,3 +105,61 @@ bool verifyPassword(const string &password, const string &hashed)
 
     return false;
 }
+
+bool passwordNeedsRehash(const string &hashed)
+{
+    unsigned long long opslimit = 0;
+    size_t memlimit = 0;
+    if (!hashParameters(hashed, opslimit, memlimit)) return true;   // not argon2id, or unreadable
+    if (opslimit < MIN_CALIBRATED_OPSLIMIT || memlimit < MIN_CALIBRATED_MEMLIMIT) return true;
+
+    // Stronger or about as strong as what hashPassword uses now: keep it
+    double work = static_cast<double>(opslimit) * memlimit;
+    double currentWork = static_cast<double>(currentOpslimit.load()) * currentMemlimit.load();
+    return work < currentWork * REHASH_TOLERANCE;
+}
+
+PasswordHashCost calibratePasswordHashing()
+{
+    double targetMs = static_cast<double>(std::min(envLong("PWHASH_TARGET_MS", 250), 10000L));
+    size_t memlimit = static_cast<size_t>(envLong("PWHASH_MEMORY_MB", MIN_CALIBRATED_MEMLIMIT / (1024 * 1024))) * 1024 * 1024;
+    memlimit = std::max<size_t>(MIN_CALIBRATED_MEMLIMIT, std::min<size_t>(memlimit, crypto_pwhash_MEMLIMIT_MAX));
+
+    // One pass over the memory budget; halve the memory (down to the floor) while even that is too slow.
+    double onePassMs = timeHash(1, memlimit);
+    while ((onePassMs < 0 || onePassMs > targetMs) && memlimit / 2 >= MIN_CALIBRATED_MEMLIMIT) {
+        memlimit /= 2;
+        onePassMs = timeHash(1, memlimit);
+    }
+    if (onePassMs < 0) {
+        std::cerr << "Password hash calibration failed; keeping the default cost" << std::endl;
+        return passwordHashCost();
+    }
+
+    // Time grows about linearly with passes, so spend the remaining budget on more of them.
+    unsigned long long opslimit = MIN_CALIBRATED_OPSLIMIT;
+    if (onePassMs * MIN_CALIBRATED_OPSLIMIT < targetMs) {
+        opslimit = std::min<unsigned long long>(MAX_CALIBRATED_OPSLIMIT, targetMs / onePassMs);
+    }
+    double hashMs = timeHash(opslimit, memlimit);
+    while (hashMs > targetMs * 1.25 && opslimit > MIN_CALIBRATED_OPSLIMIT) {
+        --opslimit;
+        hashMs = timeHash(opslimit, memlimit);
+    }
+    if (hashMs < 0) {
+        std::cerr << "Password hash calibration failed; keeping the default cost" << std::endl;
+        return passwordHashCost();
+    }
+
+    currentOpslimit = opslimit;
+    currentMemlimit = memlimit;
+    currentHashMs = hashMs;
+    return passwordHashCost();
+}
+
+PasswordHashCost passwordHashCost()
+{
+    size_t memlimit = currentMemlimit.load();
+    double hashMs = currentHashMs.load();
+    return PasswordHashCost{currentOpslimit.load(), memlimit, hashMs, estimateLoginsPerSecond(memlimit, hashMs)};
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include <string>
 #include <sodium.h>
 #include <stdexcept>
@@ -6,5 +7,26 @@
 
 using namespace std;
 
+// crypto_pwhash cost used for new hashes, and what it means for throughput.
+struct PasswordHashCost {
+    unsigned long long opslimit;
+    size_t memlimit;            // bytes
+    double hashMs;              // measured time for one hash at this cost (0 if never measured)
+    double loginsPerSecond;     // estimate for this host: parallel hashes (cores and RAM) / hashMs
+};
+
 string hashPassword(const string& password);
-bool verifyPassword(const string &password, const string &hashed);
\ No newline at end of file
+bool verifyPassword(const string &password, const string &hashed);
+
+// True when `hashed` is not argon2id, is below the MODERATE preset, or is
+// clearly weaker than what hashPassword uses now. Costs within a tolerance
+// band of the current one are kept, since calibration varies between starts.
+bool passwordNeedsRehash(const string &hashed);
+
+// Benchmarks crypto_pwhash on this host and installs the strongest cost that
+// stays within PWHASH_TARGET_MS (default 250) and PWHASH_MEMORY_MB (default 256),
+// but never below the MODERATE preset (256 MiB, 3 passes), however slow the host.
+// Call once after sodium_init(); until it returns, new hashes use the MODERATE preset.
+PasswordHashCost calibratePasswordHashing();
+
+PasswordHashCost passwordHashCost();
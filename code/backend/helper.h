@@ -4,9 +4,11 @@
 #include <crow.h>
 #include <sqlite3.h>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 #include "goalTracker.h"
+#include "staticFiles.h"
 
 using namespace std;
 
@@ -25,15 +27,12 @@ inline crow::response makeSuccess(int code, const string& message) {
 }
 
 inline crow::response serveFile(const string& filepath, const string& contentType) {
-    ifstream file(filepath, ios::in | ios::binary);
-    if (!file) {
+    auto contents = staticFiles().get(filepath);
+    if (!contents) {
         return makeError(404, "File not found");
     }
 
-    ostringstream buffer;
-    buffer << file.rdbuf();
-
-    crow::response res(buffer.str());
+    crow::response res(*contents);
     res.set_header("Content-Type", contentType);
     return res;
 }
@@ -48,6 +47,15 @@ inline std::string getCookieValue(const std::string& cookieHeader, const std::st
     return cookieHeader.substr(start, end - start);
 }
 
+// A text column as a view into the statement's row; "" for NULL. Valid
+// until the next step or finalize.
+inline std::string_view columnText(sqlite3_stmt* stmt, int col)
+{
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    if (!text) return std::string_view();
+    return std::string_view(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt, col));
+}
+
 inline crow::json::wvalue serializeGoals(const std::vector<Goal>& goals, sqlite3* db) {
     crow::json::wvalue result;
     std::vector<crow::json::wvalue> arr;
@@ -78,6 +86,5 @@ inline crow::json::wvalue serializeGoals(const std::vector<Goal>& goals, sqlite3
 std::string getCurrentDate();
 std::string getCurrentDateTime();
 std::string getDateNDaysAgo(int days);
-bool validateMealData(const crow::json::rvalue& data, std::string& error);
 
 #endif // HELPERS_H
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "httpClient.h"
+#include <iostream>
+
+struct HttpClient::Transfer {
+    HttpRequest request;
+    std::promise<HttpResponse> promise;
+    HttpResponse response;
+    std::string hostKey;
+    curl_mime* mime = nullptr;
+    curl_slist* headers = nullptr;
+};
+
+namespace {
+
+size_t appendBody(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    static_cast<std::string*>(userdata)->append(ptr, size * nmemb);
+    return size * nmemb;
+}
+
+// "scheme://host:port" so http and https to the same name are limited separately.
+std::string hostKeyOf(const std::string& url)
+{
+    std::string key;
+    CURLU* u = curl_url();
+    if (curl_url_set(u, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK) {
+        char* scheme = nullptr;
+        char* host = nullptr;
+        char* port = nullptr;
+        curl_url_get(u, CURLUPART_SCHEME, &scheme, 0);
+        curl_url_get(u, CURLUPART_HOST, &host, 0);
+        curl_url_get(u, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT);
+        key = std::string(scheme ? scheme : "") + "://" + (host ? host : "") + ":" + (port ? port : "");
+        curl_free(scheme);
+        curl_free(host);
+        curl_free(port);
+    }
+    curl_url_cleanup(u);
+    return key.empty() ? url : key;
+}
+
+} // namespace
+
+HttpClient::HttpClient(Options options) : _options(options)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // The share handle is only used from the curl thread, so it needs no lock callbacks.
+    _share = curl_share_init();
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    _multi = curl_multi_init();
+    curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(_options.maxPerHost));
+    curl_multi_setopt(_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(_options.maxTotal));
+    curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, static_cast<long>(_options.maxTotal));
+    curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    _thread = std::thread(&HttpClient::run, this);
+}
+
+HttpClient::~HttpClient()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    curl_multi_wakeup(_multi);
+    if (_thread.joinable()) _thread.join();
+
+    for (CURL* easy : _idleHandles) curl_easy_cleanup(easy);
+    curl_multi_cleanup(_multi);
+    curl_share_cleanup(_share);
+}
+
+std::future<HttpResponse> HttpClient::submit(HttpRequest request)
+{
+    auto transfer = std::make_unique<Transfer>();
+    transfer->hostKey = hostKeyOf(request.url);
+    transfer->request = std::move(request);
+    std::future<HttpResponse> result = transfer->promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop) {
+            transfer->response.error = "HTTP client is shutting down";
+            transfer->promise.set_value(std::move(transfer->response));
+            return result;
+        }
+        _queued.push_back(std::move(transfer));
+    }
+    curl_multi_wakeup(_multi);
+    return result;
+}
+
+HttpResponse HttpClient::perform(HttpRequest request)
+{
+    return submit(std::move(request)).get();
+}
+
+CURL* HttpClient::takeEasyHandle()
+{
+    if (_idleHandles.empty()) return curl_easy_init();
+    CURL* easy = _idleHandles.back();
+    _idleHandles.pop_back();
+    return easy;
+}
+
+void HttpClient::startQueued()
+{
+    std::vector<std::unique_ptr<Transfer>> ready;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Oldest first; a request for a saturated host does not hold up other hosts.
+        std::size_t inFlight = _active.size();
+        for (auto it = _queued.begin(); it != _queued.end() && inFlight < static_cast<std::size_t>(_options.maxTotal);) {
+            int& perHost = _inFlightPerHost[(*it)->hostKey];
+            if (perHost >= _options.maxPerHost) {
+                ++it;
+                continue;
+            }
+            ++perHost;
+            ++inFlight;
+            ready.push_back(std::move(*it));
+            it = _queued.erase(it);
+        }
+    }
+
+    for (auto& transfer : ready) {
+        CURL* easy = takeEasyHandle();
+        if (!easy) {
+            _inFlightPerHost[transfer->hostKey]--;
+            transfer->response.error = "curl_easy_init() failed";
+            transfer->promise.set_value(std::move(transfer->response));
+            continue;
+        }
+
+        const HttpRequest& req = transfer->request;
+        curl_easy_setopt(easy, CURLOPT_SHARE, _share);
+        curl_easy_setopt(easy, CURLOPT_URL, req.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, _options.connectTimeoutMs);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, req.timeoutMs);
+
+        if (!req.username.empty()) {
+            curl_easy_setopt(easy, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+            curl_easy_setopt(easy, CURLOPT_USERNAME, req.username.c_str());
+            curl_easy_setopt(easy, CURLOPT_PASSWORD, req.password.c_str());
+        }
+
+        for (const std::string& header : req.headers) {
+            transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+        }
+        if (transfer->headers) curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+
+        if (!req.formFields.empty()) {
+            transfer->mime = curl_mime_init(easy);
+            for (const auto& field : req.formFields) {
+                curl_mimepart* part = curl_mime_addpart(transfer->mime);
+                curl_mime_name(part, field.first.c_str());
+                curl_mime_data(part, field.second.data(), field.second.size());
+            }
+            curl_easy_setopt(easy, CURLOPT_MIMEPOST, transfer->mime);
+        } else if (req.method == "POST" || !req.body.empty()) {
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, req.body.data());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(req.body.size()));
+        }
+        if (req.method != "GET" && req.method != "POST") {
+            curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, req.method.c_str());
+        }
+
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, appendBody);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response.body);
+
+        curl_multi_add_handle(_multi, easy);
+        _active.emplace(easy, std::move(transfer));
+        _activeCount = _active.size();
+    }
+}
+
+void HttpClient::finish(CURL* easy, CURLcode result)
+{
+    curl_multi_remove_handle(_multi, easy);
+    auto it = _active.find(easy);
+    if (it == _active.end()) return;
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    _active.erase(it);
+    _activeCount = _active.size();
+
+    if (result == CURLE_OK) {
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+        _completed++;
+    } else {
+        transfer->response.error = curl_easy_strerror(result);
+        _failed++;
+    }
+
+    if (transfer->mime) curl_mime_free(transfer->mime);
+    if (transfer->headers) curl_slist_free_all(transfer->headers);
+    _inFlightPerHost[transfer->hostKey]--;
+
+    // Keep the handle for the next request; live connections stay in the multi's pool.
+    curl_easy_reset(easy);
+    if (_idleHandles.size() < static_cast<std::size_t>(_options.maxTotal)) {
+        _idleHandles.push_back(easy);
+    } else {
+        curl_easy_cleanup(easy);
+    }
+
+    transfer->promise.set_value(std::move(transfer->response));
+}
+
+void HttpClient::run()
+{
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stop) break;
+        }
+
+        startQueued();
+
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(_multi, &running);
+        if (mc != CURLM_OK) {
+            std::cerr << "[HttpClient] curl_multi_perform failed: " << curl_multi_strerror(mc) << std::endl;
+        }
+
+        int remaining = 0;
+        bool finished = false;
+        while (CURLMsg* msg = curl_multi_info_read(_multi, &remaining)) {
+            if (msg->msg == CURLMSG_DONE) {
+                finish(msg->easy_handle, msg->data.result);
+                finished = true;
+            }
+        }
+        // A finished transfer may have freed a per-host slot; start the next one right away.
+        if (finished) continue;
+
+        // Sleeps until a socket is ready, a timeout is due or submit() wakes us.
+        curl_multi_poll(_multi, nullptr, 0, 1000, nullptr);
+    }
+
+    // Fail whatever is still pending so no caller waits forever.
+    for (auto& entry : _active) {
+        curl_multi_remove_handle(_multi, entry.first);
+        if (entry.second->mime) curl_mime_free(entry.second->mime);
+        if (entry.second->headers) curl_slist_free_all(entry.second->headers);
+        curl_easy_cleanup(entry.first);
+        entry.second->response.error = "HTTP client stopped";
+        entry.second->promise.set_value(std::move(entry.second->response));
+    }
+    _active.clear();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& transfer : _queued) {
+        transfer->response.error = "HTTP client stopped";
+        transfer->promise.set_value(std::move(transfer->response));
+    }
+    _queued.clear();
+}
+
+HttpClient::Stats HttpClient::stats()
+{
+    std::size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        queued = _queued.size();
+    }
+    return Stats{queued, _activeCount.load(), _completed.load(), _failed.load()};
+}
+
+HttpClient& sharedHttpClient()
+{
+    static HttpClient client;
+    return client;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <curl/curl.h>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct HttpRequest {
+    std::string method = "GET";
+    std::string url;
+    std::vector<std::string> headers;                          // "Name: value"
+    std::string body;                                          // raw body (ignored when formFields is set)
+    std::vector<std::pair<std::string, std::string>> formFields; // sent as multipart/form-data
+    std::string username;                                      // basic auth, if set
+    std::string password;
+    long timeoutMs = 15000;
+};
+
+struct HttpResponse {
+    long status = 0;      // 0 when the transfer itself failed
+    std::string body;
+    std::string error;    // curl error text when status == 0
+    bool ok() const { return status >= 200 && status < 300; }
+};
+
+// Outbound HTTP on one curl multi handle. Connections, DNS answers and TLS
+// sessions are kept between requests, many requests can be in flight at
+// once, and no more than maxPerHost run against the same host at a time
+// (the rest wait in a queue). All curl work happens on one internal thread,
+// so callers on any thread just submit and wait on the future.
+class HttpClient
+{
+public:
+    struct Options {
+        int maxPerHost = 8;
+        int maxTotal = 64;
+        long connectTimeoutMs = 5000;
+    };
+
+    HttpClient() : HttpClient(Options{}) {}
+    explicit HttpClient(Options options);
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    std::future<HttpResponse> submit(HttpRequest request);
+
+    // Blocking convenience wrapper around submit().
+    HttpResponse perform(HttpRequest request);
+
+    struct Stats {
+        std::size_t queued;     // waiting for a per-host or total slot
+        std::size_t active;
+        uint64_t completed;
+        uint64_t failed;        // transport errors; HTTP error statuses count as completed
+    };
+    Stats stats();
+
+private:
+    struct Transfer;
+
+    void run();
+    void startQueued();
+    void finish(CURL* easy, CURLcode result);
+    CURL* takeEasyHandle();
+
+    Options _options;
+    CURLM* _multi;
+    CURLSH* _share;
+
+    std::mutex _mutex;                                   // guards _queued and _stop
+    std::deque<std::unique_ptr<Transfer>> _queued;
+    bool _stop = false;
+
+    // Only touched by the curl thread.
+    std::map<std::string, int> _inFlightPerHost;
+    std::map<CURL*, std::unique_ptr<Transfer>> _active;
+    std::vector<CURL*> _idleHandles;
+
+    std::atomic<std::size_t> _activeCount{0};
+    std::atomic<uint64_t> _completed{0};
+    std::atomic<uint64_t> _failed{0};
+    std::thread _thread;
+};
+
+// Process-wide client shared by Mailgun and any other integration.
+HttpClient& sharedHttpClient();
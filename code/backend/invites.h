@@ -1,9 +1,12 @@
 #pragma once
 #include <string>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 #include <sqlite3.h>
 #include <crow.h>
+#include "admissionControl.h"
+#include "database.h"
 
 struct FriendRequest {
     int id;
@@ -52,6 +55,10 @@ std::optional<FriendRequest> getFriendRequestById(sqlite3* db, int requestId);
 // to get usernames by id
 std::optional<std::string> getUsernameById(sqlite3* db, int userId);
 
-void setupInviteRoutes(crow::SimpleApp& app, sqlite3* db);
+// Usernames for many ids at once: one directory pass, one IN (...) query for any misses.
+// Ids that do not exist are left out of the map.
+std::unordered_map<int, std::string> getUsernamesByIds(sqlite3* db, const std::vector<int>& userIds);
+
+void setupInviteRoutes(FitnessApp& app, Database& database);
 
 std::string computeFriendStatus(sqlite3* db, int userId1, int userId2);
\ No newline at end of file
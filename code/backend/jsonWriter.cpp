@@ -0,0 +1,137 @@
+#include "jsonWriter.h"
+#include <charconv>
+#include <cmath>
+
+JsonWriter::JsonWriter(std::size_t reserveBytes, std::pmr::memory_resource* arena)
+    : _out(arena)
+{
+    if (reserveBytes > 0) _out.reserve(reserveBytes);
+}
+
+void JsonWriter::separate()
+{
+    if (_needComma) _out += ',';
+    _needComma = false;
+}
+
+JsonWriter& JsonWriter::beginObject()
+{
+    separate();
+    _out += '{';
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject()
+{
+    _out += '}';
+    _needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray()
+{
+    separate();
+    _out += '[';
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray()
+{
+    _out += ']';
+    _needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name)
+{
+    separate();
+    appendString(name);
+    _out += ':';
+    return *this;
+}
+
+void JsonWriter::appendString(std::string_view s)
+{
+    static const char HEX[] = "0123456789abcdef";
+    _out += '"';
+    // Copy clean runs whole; only quotes, backslashes and control bytes are rewritten
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        _out.append(s.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': _out += "\\\""; break;
+            case '\\': _out += "\\\\"; break;
+            case '\n': _out += "\\n"; break;
+            case '\r': _out += "\\r"; break;
+            case '\t': _out += "\\t"; break;
+            case '\b': _out += "\\b"; break;
+            case '\f': _out += "\\f"; break;
+            default:
+                _out += "\\u00";
+                _out += HEX[c >> 4];
+                _out += HEX[c & 0xF];
+        }
+    }
+    _out.append(s.data() + run, s.size() - run);
+    _out += '"';
+}
+
+JsonWriter& JsonWriter::value(std::string_view s)
+{
+    separate();
+    appendString(s);
+    _needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* s)
+{
+    return s ? value(std::string_view(s)) : null();
+}
+
+template <typename N>
+JsonWriter& JsonWriter::number(N v)
+{
+    separate();
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), v);
+    _out.append(buf, result.ptr - buf);
+    _needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int v) { return number(v); }
+JsonWriter& JsonWriter::value(int64_t v) { return number(v); }
+JsonWriter& JsonWriter::value(uint64_t v) { return number(v); }
+
+JsonWriter& JsonWriter::value(double v)
+{
+    // JSON has no NaN or Infinity
+    return std::isfinite(v) ? number(v) : null();
+}
+
+JsonWriter& JsonWriter::value(bool v)
+{
+    separate();
+    _out += v ? "true" : "false";
+    _needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::null()
+{
+    separate();
+    _out += "null";
+    _needComma = true;
+    return *this;
+}
+
+crow::response JsonWriter::response(int code) const
+{
+    crow::response res(code, std::string(_out));
+    res.set_header("Content-Type", "application/json");
+    return res;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <crow.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include "requestArena.h"
+
+// Writes a JSON document front to back into one request-arena buffer, for
+// responses that would otherwise build a crow::json::wvalue per row and per
+// field and then serialize the tree:
+//
+//   JsonWriter json;
+//   json.beginObject().key("meals").beginArray();
+//   while (sqlite3_step(stmt) == SQLITE_ROW) {
+//       json.beginObject()
+//           .field("id", sqlite3_column_int(stmt, 0))
+//           .field("meal_name", columnText(stmt, 2))
+//           .endObject();
+//   }
+//   json.endArray().endObject();
+//   return json.response();
+//
+// Commas and string escaping are handled here; keeping begin/end calls
+// balanced is up to the caller. The body is copied out once, in response().
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::size_t reserveBytes = 0, std::pmr::memory_resource* arena = requestArena());
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view s);
+    JsonWriter& value(const char* s);       // nullptr (a NULL column) writes null
+    JsonWriter& value(int v);
+    JsonWriter& value(int64_t v);
+    JsonWriter& value(uint64_t v);
+    JsonWriter& value(double v);            // NaN and infinities write null
+    JsonWriter& value(bool v);
+    JsonWriter& null();
+
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& v)
+    {
+        key(name);
+        return value(v);
+    }
+
+    std::string_view view() const { return _out; }
+    // The document as an application/json body
+    crow::response response(int code = 200) const;
+
+private:
+    void separate();
+    void appendString(std::string_view s);
+    template <typename N> JsonWriter& number(N v);
+
+    std::pmr::string _out;
+    bool _needComma = false;
+};
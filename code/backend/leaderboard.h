@@ -2,6 +2,8 @@
 #define LEADERBOARD_H
 
 #include <crow.h>
+#include "admissionControl.h"
+#include "database.h"
 #include <sqlite3.h>
 #include <vector>
 #include <string>
@@ -14,7 +16,7 @@ struct UserSimple
 };
 
 // Routes
-void setupLeaderboardRoutes(crow::SimpleApp& app, sqlite3* db);
+void setupLeaderboardRoutes(FitnessApp& app, Database& database);
 std::vector<UserSimple> getTopUsers(sqlite3* db, int limit);
 std::vector<UserSimple> getTopFriends(sqlite3* db, int userId, int limit);
 
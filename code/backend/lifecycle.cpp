@@ -0,0 +1,134 @@
+#include "lifecycle.h"
+#include "logger.h"
+#include <csignal>
+#include <cstdlib>
+#include <pthread.h>
+
+namespace {
+
+constexpr long DEFAULT_TIMEOUT_MS = 15000;
+constexpr long SIGNAL_POLL_NS = 250 * 1000 * 1000;
+
+sigset_t shutdownSignals()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    return set;
+}
+
+long timeoutFromEnv()
+{
+    const char* value = std::getenv("SHUTDOWN_TIMEOUT_MS");
+    if (!value || !*value) return DEFAULT_TIMEOUT_MS;
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    return (end && *end == '\0' && parsed > 0) ? parsed : DEFAULT_TIMEOUT_MS;
+}
+
+int64_t msSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+Lifecycle::Lifecycle() : _timeout(timeoutFromEnv()) {}
+
+Lifecycle::~Lifecycle()
+{
+    finish();
+}
+
+void Lifecycle::blockShutdownSignals()
+{
+    sigset_t set = shutdownSignals();
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+void Lifecycle::onDrain(const std::string& name, Step step)
+{
+    _drain.push_back(NamedStep{name, std::move(step)});
+}
+
+void Lifecycle::onTeardown(const std::string& name, Step step)
+{
+    _teardown.push_back(NamedStep{name, std::move(step)});
+}
+
+void Lifecycle::start(std::function<void()> stopServer)
+{
+    if (_thread.joinable()) return;
+    _stopServer = std::move(stopServer);
+    _thread = std::thread(&Lifecycle::waitForSignal, this);
+}
+
+void Lifecycle::requestShutdown()
+{
+    _requested = true;
+}
+
+void Lifecycle::waitForSignal()
+{
+    sigset_t set = shutdownSignals();
+    timespec poll{0, SIGNAL_POLL_NS};
+    while (!_finished) {
+        if (_requested) {
+            beginShutdown("requested");
+            return;
+        }
+        int sig = sigtimedwait(&set, nullptr, &poll);
+        if (sig == SIGTERM || sig == SIGINT) {
+            beginShutdown(sig == SIGTERM ? "SIGTERM" : "SIGINT");
+            return;
+        }
+    }
+}
+
+void Lifecycle::beginShutdown(const char* reason)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_shuttingDown) return;
+        _started = Clock::now();
+        _deadline = _started + _timeout;
+        _shuttingDown = true;
+    }
+    logEvent(LogLevel::Info, "shutdown_started").field("reason", reason).field("timeout_ms", static_cast<int64_t>(_timeout.count()));
+
+    runSteps("drain", _drain);
+    if (_stopServer) _stopServer();
+}
+
+void Lifecycle::finish()
+{
+    if (_finished.exchange(true)) return;
+    if (_thread.joinable()) _thread.join();
+
+    // The server stopped without a signal (e.g. it failed to bind): still tear down in order.
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_shuttingDown) {
+            _started = Clock::now();
+            _deadline = _started + _timeout;
+            _shuttingDown = true;
+        }
+    }
+
+    runSteps("teardown", _teardown);
+    logEvent(LogLevel::Info, "shutdown_complete").field("elapsed_ms", msSince(_started));
+}
+
+void Lifecycle::runSteps(const char* phase, const std::vector<NamedStep>& steps)
+{
+    for (const NamedStep& s : steps) {
+        auto start = Clock::now();
+        bool ok = s.step(_deadline);
+        logEvent(ok ? LogLevel::Info : LogLevel::Warn, "shutdown_step")
+            .field("phase", phase)
+            .field("step", s.name)
+            .field("ok", ok)
+            .field("ms", msSince(start));
+    }
+}
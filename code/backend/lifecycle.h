@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Orderly shutdown on SIGTERM/SIGINT.
+//
+// The signals are blocked in every thread and picked up by one sigwait
+// thread, so shutdown code runs as normal code rather than inside a signal
+// handler. When one arrives the drain steps run on that thread (stop taking
+// requests, wait for in-flight ones), then the server is stopped; once
+// Crow's run() has returned, main calls finish() to run the teardown steps
+// (flush queues, checkpoint, close). Drain and teardown share one deadline,
+// SHUTDOWN_TIMEOUT_MS from the signal (default 15000), which should stay
+// below the container's stop grace period.
+class Lifecycle
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // A step gets the shared deadline and returns false if it could not finish in time.
+    using Step = std::function<bool(Clock::time_point deadline)>;
+
+    Lifecycle();
+    ~Lifecycle();
+
+    // Blocks SIGTERM and SIGINT for the calling thread and every thread it
+    // starts afterwards. Call first thing in main.
+    static void blockShutdownSignals();
+
+    void onDrain(const std::string& name, Step step);
+    void onTeardown(const std::string& name, Step step);
+
+    // Starts the signal thread; `stopServer` makes the server's run() return.
+    void start(std::function<void()> stopServer);
+
+    // Same as receiving SIGTERM.
+    void requestShutdown();
+    bool shuttingDown() const { return _shuttingDown.load(); }
+
+    // Runs the teardown steps and joins the signal thread. Also safe to call
+    // when the server stopped on its own, without a signal.
+    void finish();
+
+private:
+    struct NamedStep {
+        std::string name;
+        Step step;
+    };
+
+    void waitForSignal();
+    void beginShutdown(const char* reason);
+    void runSteps(const char* phase, const std::vector<NamedStep>& steps);
+
+    std::vector<NamedStep> _drain;
+    std::vector<NamedStep> _teardown;
+    std::function<void()> _stopServer;
+    std::chrono::milliseconds _timeout;
+
+    std::mutex _mutex;                  // guards _deadline and the once-only start of shutdown
+    Clock::time_point _deadline;
+    Clock::time_point _started;
+    std::atomic<bool> _requested{false};
+    std::atomic<bool> _shuttingDown{false};
+    std::atomic<bool> _finished{false};
+    std::thread _thread;
+};
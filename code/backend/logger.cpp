@@ -0,0 +1,190 @@
+#include "logger.h"
+#include "dateTime.h"
+#include <cstdio>
+
+namespace {
+
+const char* levelName(LogLevel level)
+{
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info:  return "info";
+        case LogLevel::Warn:  return "warn";
+        case LogLevel::Error: return "error";
+    }
+    return "info";
+}
+
+void appendJsonString(std::string& out, const char* s, std::size_t n)
+{
+    out += '"';
+    for (std::size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendKey(std::string& out, const char* key)
+{
+    out += ',';
+    appendJsonString(out, key, std::char_traits<char>::length(key));
+    out += ':';
+}
+
+} // namespace
+
+// ---- AsyncLogger ----
+
+AsyncLogger::AsyncLogger()
+{
+    _thread = std::thread(&AsyncLogger::run, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+}
+
+void AsyncLogger::submit(std::string line)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop || _pendingLines >= MAX_PENDING_LINES) {
+            _dropped++;
+            _droppedTotal++;
+            return;
+        }
+        _pending += line;
+        _pending += '\n';
+        _pendingLines++;
+    }
+    _wake.notify_one();
+}
+
+void AsyncLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop) return;
+        _stop = true;
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) _thread.join();
+}
+
+std::size_t AsyncLogger::pendingLines()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pendingLines;
+}
+
+void AsyncLogger::run()
+{
+    std::string batch;
+    while (true) {
+        uint64_t dropped = 0;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stop || _pendingLines > 0; });
+            batch.swap(_pending);
+            _pending.clear();
+            _pendingLines = 0;
+            dropped = _dropped;
+            _dropped = 0;
+            stopping = _stop;
+        }
+
+        if (dropped > 0) {
+            char ts[ISO8601_BUF_SIZE];
+            char note[128];
+            std::snprintf(note, sizeof(note),
+                          "{\"ts\":\"%s\",\"level\":\"warn\",\"event\":\"log_dropped\",\"lines\":%llu}\n",
+                          formatIso8601Utc(nowUtc(), ts), static_cast<unsigned long long>(dropped));
+            batch += note;
+        }
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (stopping) return;
+    }
+}
+
+AsyncLogger& appLog()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+// ---- LogLine ----
+
+LogLine::LogLine(LogLevel level, const char* event)
+{
+    char ts[ISO8601_BUF_SIZE];
+    _line.reserve(128);
+    _line += "{\"ts\":\"";
+    _line += formatIso8601Utc(nowUtc(), ts);
+    _line += "\",\"level\":\"";
+    _line += levelName(level);
+    _line += "\",\"event\":";
+    appendJsonString(_line, event, std::char_traits<char>::length(event));
+}
+
+LogLine::~LogLine()
+{
+    _line += '}';
+    appLog().submit(std::move(_line));
+}
+
+LogLine& LogLine::field(const char* key, const std::string& value)
+{
+    appendKey(_line, key);
+    appendJsonString(_line, value.data(), value.size());
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, const char* value)
+{
+    appendKey(_line, key);
+    appendJsonString(_line, value, std::char_traits<char>::length(value));
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, int64_t value)
+{
+    appendKey(_line, key);
+    _line += std::to_string(value);
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, double value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f", value);
+    appendKey(_line, key);
+    _line += buf;
+    return *this;
+}
+
+LogLine& LogLine::field(const char* key, bool value)
+{
+    appendKey(_line, key);
+    _line += value ? "true" : "false";
+    return *this;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum class LogLevel { Debug, Info, Warn, Error };
+
+// Line-oriented JSON logger. Request threads only format the line and append
+// it to a buffer; one background thread writes whole batches to stdout, so
+// no request waits on a terminal or pipe flush. When more than
+// MAX_PENDING_LINES are waiting, new lines are dropped and counted.
+class AsyncLogger
+{
+public:
+    static constexpr std::size_t MAX_PENDING_LINES = 10000;
+
+    AsyncLogger();
+    ~AsyncLogger();
+
+    void submit(std::string line);
+
+    // Writes out everything queued so far and stops the writer thread.
+    void stop();
+
+    std::size_t pendingLines();
+    uint64_t droppedTotal() const { return _droppedTotal.load(); }
+
+private:
+    void run();
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::string _pending;
+    std::size_t _pendingLines = 0;
+    uint64_t _dropped = 0;                   // since the last "log_dropped" note
+    std::atomic<uint64_t> _droppedTotal{0};
+    bool _stop = false;
+    std::thread _thread;
+};
+
+AsyncLogger& appLog();
+
+// One structured log event, queued when the expression ends:
+//   logEvent(LogLevel::Info, "login").field("user_id", id).field("result", "ok");
+class LogLine
+{
+public:
+    LogLine(LogLevel level, const char* event);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& field(const char* key, const std::string& value);
+    LogLine& field(const char* key, const char* value);
+    LogLine& field(const char* key, int64_t value);
+    LogLine& field(const char* key, int value) { return field(key, static_cast<int64_t>(value)); }
+    LogLine& field(const char* key, double value);
+    LogLine& field(const char* key, bool value);
+
+private:
+    std::string _line;
+};
+
+inline LogLine logEvent(LogLevel level, const char* event) { return LogLine(level, event); }
@@ -4,6 +4,7 @@
 #include "routes/register.h"
 #include "goalTracker.h"
 #include "db/schema.h"
+#include <atomic>
 #include <iostream>
 #include "routes/exercise.h"
 #include "routes/session.h"
@@ -12,40 +13,104 @@
 #include "reset.h"
 #include "routes/calorie_tracker.h"
 #include "routes/sleep_tracker.h"
+#include "routes/settings.h"
+#include "scoreEngine.h"
+#include "maintenance.h"
+#include "emailOutbox.h"
+#include "userDirectory.h"
+#include "logger.h"
+#include "lifecycle.h"
+#include "startup.h"
+#include "staticFiles.h"
+#include "routes/health.h"
+#include "stats.h"
+#include "storageProfile.h"
+#include "database.h"
+#include "shardRouter.h"
+#include "backup.h"
+#include "eventBus.h"
+#include "routes/backup.h"
+#include "pushHub.h"
+#include "routes/push.h"
+#include "responseCache.h"
+#include "requestArena.h"
+#include "httpClient.h"
 using namespace std;
 
-int main() {
-    crow::SimpleApp fitnessApp;
+int main(int argc, char* argv[]) {
+    // Before any thread starts, so SIGTERM/SIGINT only reach the lifecycle thread
+    Lifecycle::blockShutdownSignals();
 
-    // Initialize SQLite database connection
-    sqlite3* db;
+    Startup startup;
+    FitnessApp fitnessApp;
+
+    // Journal mode, fsync policy, cache and mmap from FITNESS_DB_PROFILE (plus foreign keys)
+    StorageProfile storage = loadStorageProfile();
+
+    // One writer connection plus a pool of read-only ones (FITNESS_DB_READERS)
     const char* dbPathEnv = std::getenv("FITNESS_DB_PATH");
     const char* dbPath = dbPathEnv ? dbPathEnv : "code/backend/fitness.db";
-    if (sqlite3_open(dbPath, &db)) {
-        std::cerr << "Can't open database at " << dbPath << ": "
-                  << sqlite3_errmsg(db) << std::endl;
+    Database database(dbPath, storage);
+    if (!database.open()) {
     return 1;
     }
+    startup.mark("open_database");
 
     // Load email configuration from environment variables
     EmailConfig emailCfg = load_email_config_from_env();
 
-    int rc = sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Failed to enable foreign keys: " << sqlite3_errmsg(db) << std::endl;
+    logEvent(database.profileApplied() ? LogLevel::Info : LogLevel::Warn, "storage_profile")
+        .field("profile", storage.name)
+        .field("journal_mode", storage.journalMode)
+        .field("synchronous", storage.synchronous)
+        .field("cache_mb", storage.cacheSizeKb / 1024)
+        .field("mmap_mb", storage.mmapBytes / (1024 * 1024))
+        .field("applied", database.profileApplied());
+    startup.mark("storage_profile");
+
+    // The DDL only runs when the stored schema version is behind this build
+    bool schemaApplied = false;
+    if (!ensureSchema(database.write(), &schemaApplied)) {
+    cerr << "Failed to create tables" << endl;
+    database.close();
+    return 1;
     }
+    startup.mark(schemaApplied ? "schema_migrate" : "schema_check");
 
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "PRAGMA foreign_keys;", -1, &stmt, nullptr);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        std::cout << "Foreign keys enabled: " << sqlite3_column_int(stmt, 0) << std::endl;
+    if (!initScoreEngine(database.write())) {
+        std::cerr << "Failed to initialize score engine" << std::endl;
+        database.close();
+        return 1;
     }
-    sqlite3_finalize(stmt);
+    startup.mark("score_engine");
 
-    if (!createTables(db)) {
-    cerr << "Failed to create tables" << endl;
-    sqlite3_close(db);
-    return 1;
+    // Per-user tables live in FITNESS_SHARD_COUNT shard files next to the directory (1 = no shards)
+    ShardRouter shards(database, dbPath, storage, shardCountFromEnv());
+    if (!shards.open()) {
+        database.close();
+        return 1;
+    }
+    setDeferredScoreTotals(shards.sharded());
+    startup.mark("open_shards");
+
+    // `fitness --replay-scores` re-scores all history after score_rules were edited, then exits
+    if (argc > 1 && std::string(argv[1]) == "--replay-scores") {
+        int scored = 0;
+        if (shards.sharded()) {
+            // Each shard rebuilds its totals; users without any events end up at 0
+            sqlite3_exec(database.write(), "UPDATE users SET score = 0;", nullptr, nullptr, nullptr);
+            for (int i = 0; i < shards.count() && scored >= 0; ++i) {
+                int replayed = replayScores(shards.shard(i).write());
+                scored = (replayed < 0 || syncScoreTotals(shards.shard(i), database) < 0) ? -1 : scored + replayed;
+            }
+        } else {
+            scored = replayScores(database.write());
+        }
+        shards.close();
+        database.close();
+        if (scored < 0) return 1;
+        std::cout << "Replayed " << scored << " score events" << std::endl;
+        return 0;
     }
 
     // Initialize libsodium
@@ -53,6 +118,33 @@ int main() {
         std::cerr << "Failed to initialize libsodium" << std::endl;
         return 1; // don’t continue if init fails
     }
+    startup.mark("sodium_init");
+
+    // Warm-ups run while the routes are registered and the server comes up. Until
+    // they finish, lookups fall back to SQLite and pages are read from disk.
+    startup.runInBackground("user_directory", [&database] { return userDirectory().load(database.read()); });
+    startup.runInBackground("static_files", [] { return staticFiles().preload("code/frontend") > 0; });
+    startup.runInBackground("leaderboard", [&database] {
+        // scans users by score, which pulls the table into the page cache (and opens a reader)
+        getTopUsers(database.read(), 10);
+        return true;
+    });
+    // Not gating readiness: until it finishes new hashes use libsodium's MODERATE cost,
+    // and those are upgraded on their next login anyway
+    startup.runInBackground("pwhash_calibration", [] {
+        PasswordHashCost cost = calibratePasswordHashing();
+        logEvent(LogLevel::Info, "pwhash_calibrated")
+            .field("opslimit", static_cast<int64_t>(cost.opslimit))
+            .field("memlimit_mb", static_cast<int64_t>(cost.memlimit / (1024 * 1024)))
+            .field("hash_ms", cost.hashMs)
+            .field("est_logins_per_sec", cost.loginsPerSecond);
+        return true;
+    }, false);
+
+    Lifecycle lifecycle;
+
+//HEALTH//
+    setupHealthRoutes(fitnessApp, startup, lifecycle);
 
 //WEBHOME//
     // Serve WebHome page
@@ -68,11 +160,8 @@ int main() {
         return serveFile("code/frontend/login.html", "text/html");
     });
 
-    // Initialize login manager with DB path
-    LogInManager loginManager;
-
     // Hook up login routes
-    setupLoginRoutes(fitnessApp, loginManager, db);
+    setupLoginRoutes(fitnessApp, database);
 
 //REGISTRATION//
     // Serve registration page
@@ -82,7 +171,7 @@ int main() {
     });
 
     // Hook up register routes
-    setupRegisterRoutes(fitnessApp, db);
+    setupRegisterRoutes(fitnessApp, database);
 
 //HOME PAGE//
     // Serve home page
@@ -105,8 +194,8 @@ int main() {
     });
 
     // Hook up session/exercise routes
-    setupSessionRoutes(fitnessApp, db);
-    registerExerciseRoutes(fitnessApp, db);
+    setupSessionRoutes(fitnessApp, shards);
+    registerExerciseRoutes(fitnessApp, shards);
 
 //GOALS//
     // Serve goals page
@@ -121,11 +210,11 @@ int main() {
     });
     
     // Hook up goal routes
-    setupGoalRoutes(fitnessApp, db);
+    setupGoalRoutes(fitnessApp, shards);
 
 //FOOD//
     
-    setupCalorieTrackerRoutes(fitnessApp, db);
+    setupCalorieTrackerRoutes(fitnessApp, shards);
 
 //SLEEP//
     CROW_ROUTE(fitnessApp, "/sleep-tracker.html")
@@ -134,14 +223,17 @@ int main() {
     });
 
      // Start sleep tracker server
-    setupSleepTrackerRoutes(fitnessApp, db);
+    setupSleepTrackerRoutes(fitnessApp, shards);
+
+//SETTINGS//
+    setupSettingsRoutes(fitnessApp, database);
 
 //LEADERBOARD//
     CROW_ROUTE(fitnessApp, "/leaderboard.html")
     ([]{
         return serveFile("code/frontend/leaderboard.html", "text/html");
     });
-    setupLeaderboardRoutes(fitnessApp, db);
+    setupLeaderboardRoutes(fitnessApp, database);
 
 //WEEKLY LOG//
     CROW_ROUTE(fitnessApp, "/weekly.html")
@@ -158,7 +250,7 @@ int main() {
         return serveFile("code/frontend/social.html", "text/html");
     });
     // Hook up invite routes
-    setupInviteRoutes(fitnessApp, db);
+    setupInviteRoutes(fitnessApp, database);
 
 //
 
@@ -172,13 +264,242 @@ int main() {
         return serveFile("code/frontend/newpassword.html", "text/html");
     });
 
-    // Hook up password reset routes
-    setupPasswordResetRoutes(fitnessApp, db, emailCfg);
+    // Reset emails are queued here and delivered by the outbox sender thread
+    EmailOutbox outbox(database, makeEmailTransport(emailCfg));
+    setupPasswordResetRoutes(fitnessApp, database, outbox);
 //
-    // Start server
-    fitnessApp.port(8080).multithreaded().run();
+    // Background maintenance runs on its own threads, off the Crow workers
+    Scheduler scheduler;
+    startup.mark("register_routes");
+    registerMaintenanceJobs(scheduler, database);
+    registerShardJobs(scheduler, shards);
+
+    // Online snapshots of every database file into FITNESS_BACKUP_DIR
+    BackupManager backups(loadBackupConfig(dbPath), shards);
+    registerBackupJob(scheduler, backups);
+    setupBackupRoutes(fitnessApp, scheduler, backups);
+
+    // Change events from the write routes; each subscriber drains them on its own thread
+    const char* logChanges = std::getenv("LOG_CHANGES");
+    if (logChanges && std::string(logChanges) == "1") {
+        eventBus().subscribe("change-log", [](const ChangeEvent& e) {
+            logEvent(LogLevel::Info, "change")
+                .field("entity", changeEntityName(e.entity))
+                .field("op", changeOpName(e.op))
+                .field("user_id", e.user_id)
+                .field("id", e.id)
+                .field("other_user_id", e.other_user_id)
+                .field("seq", static_cast<int64_t>(e.sequence));
+        });
+    }
+    // Writes drop the cached reads of the users they touch before responding
+    responseCache().subscribe(eventBus());
+    // Leaderboard and friend request deltas for open pages, over /ws
+    PushHub push(database, shards.sharded());
+    push.subscribe(eventBus());
+    setupPushRoutes(fitnessApp, push);
+
+    eventBus().start();
+    scheduler.start();
+    push.start();
+    outbox.start();
+
+    // SIGTERM: refuse new requests, let admitted ones finish, stop the server,
+    // then flush and close everything in order before the grace period runs out
+    AdmissionControl& admission = fitnessApp.get_middleware<AdmissionControl>();
+    lifecycle.onDrain("refuse-new-requests", [&admission](Lifecycle::Clock::time_point) {
+        admission.beginDrain();
+        return true;
+    });
+    lifecycle.onDrain("close-push", [&push](Lifecycle::Clock::time_point) {
+        // Websockets aren't requests; close them so pages reconnect elsewhere
+        push.stop();
+        return true;
+    });
+    lifecycle.onDrain("wait-in-flight", [&admission](Lifecycle::Clock::time_point deadline) {
+        return admission.waitIdle(deadline);
+    });
+    lifecycle.onTeardown("startup-tasks", [&startup](Lifecycle::Clock::time_point) {
+        startup.join();
+        return true;
+    });
+    lifecycle.onTeardown("scheduler", [&scheduler](Lifecycle::Clock::time_point) {
+        scheduler.stop();
+        return true;
+    });
+    lifecycle.onTeardown("event-bus", [](Lifecycle::Clock::time_point) {
+        // Requests are done; hand subscribers what is left and join them
+        eventBus().stop();
+        return true;
+    });
+    lifecycle.onTeardown("email-outbox", [&outbox](Lifecycle::Clock::time_point deadline) {
+        // Whatever is not sent by the deadline stays queued in email_outbox for the next start
+        outbox.stop();
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Lifecycle::Clock::now());
+        return outbox.flush(static_cast<int>(std::max<int64_t>(0, left.count())));
+    });
+    lifecycle.onTeardown("score-sync", [&shards](Lifecycle::Clock::time_point) {
+        // Whatever is left is picked up from score_totals on the next start
+        bool ok = true;
+        for (int i = 0; shards.sharded() && i < shards.count(); ++i) {
+            ok = syncScoreTotals(shards.shard(i), shards.directory()) >= 0 && ok;
+        }
+        return ok;
+    });
+    lifecycle.onTeardown("wal-checkpoint", [&database, &shards](Lifecycle::Clock::time_point) {
+        bool ok = true;
+        for (int i = 0; shards.sharded() && i < shards.count(); ++i) {
+            ok = finalWalCheckpoint(shards.shard(i).write()) && ok;
+        }
+        return finalWalCheckpoint(database.write()) && ok;
+    });
+    lifecycle.onTeardown("close-database", [&database, &shards](Lifecycle::Clock::time_point) {
+        // Shards first: they hold the directory attached
+        bool ok = shards.close();
+        return database.close() && ok;
+    });
+
+//STATS//
+    // Sections of /debug/stats, read by the orchestrator and when sizing thread counts
+    auto uptimeStart = std::chrono::steady_clock::now();
+    statsRegistry().add("server", [&fitnessApp, &admission, &startup, &lifecycle, uptimeStart](crow::json::wvalue& s) {
+        // handlers are synchronous, so admitted requests in flight = busy worker threads
+        s["worker_threads"] = static_cast<int64_t>(fitnessApp.concurrency());
+        s["busy_workers"] = admission.stats().inFlight;
+        s["ready"] = startup.ready();
+        s["shutting_down"] = lifecycle.shuttingDown();
+        s["uptime_s"] = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - uptimeStart).count());
+    });
+    statsRegistry().add("admission", [&admission](crow::json::wvalue& s) {
+        AdmissionStats a = admission.stats();
+        s["admitted"] = a.admitted;
+        s["rate_limited"] = a.rateLimited;
+        s["shed"] = a.shed;
+        s["in_flight"] = a.inFlight;
+        s["buckets"] = static_cast<uint64_t>(a.buckets);
+    });
+    statsRegistry().add("sqlite", [&database, storage](crow::json::wvalue& s) {
+        s["profile"] = storage.name;
+        // the writer's counters; the lease keeps a handler from using it meanwhile
+        fillSqliteStats(s, database.write());
+    });
+    statsRegistry().add("database", [&database](crow::json::wvalue& s) {
+        Database::Stats d = database.stats();
+        s["readers_open"] = static_cast<uint64_t>(d.readersOpen);
+        s["readers_idle"] = static_cast<uint64_t>(d.readersIdle);
+        s["max_readers"] = static_cast<uint64_t>(d.maxReaders);
+        s["read_checkouts"] = d.readCheckouts;
+        s["read_waits"] = d.readWaits;
+        s["write_checkouts"] = d.writeCheckouts;
+        s["write_waits"] = d.writeWaits;
+        s["write_wait_ms_total"] = d.writeWaitMsTotal;
+    });
+    statsRegistry().add("shards", [&shards](crow::json::wvalue& s) {
+        s["count"] = shards.count();
+        for (int i = 0; shards.sharded() && i < shards.count(); ++i) {
+            Database::Stats d = shards.shard(i).stats();
+            crow::json::wvalue& shard = s["shard_" + std::to_string(i)];
+            shard["readers_open"] = static_cast<uint64_t>(d.readersOpen);
+            shard["read_checkouts"] = d.readCheckouts;
+            shard["write_checkouts"] = d.writeCheckouts;
+            shard["write_waits"] = d.writeWaits;
+            shard["write_wait_ms_total"] = d.writeWaitMsTotal;
+        }
+    });
+    statsRegistry().add("events", [](crow::json::wvalue& s) {
+        s["published"] = eventBus().published();
+        for (const auto& sub : eventBus().stats()) {
+            crow::json::wvalue& entry = s["subscriber_" + sub.name];
+            entry["delivered"] = sub.delivered;
+            entry["dropped"] = sub.dropped;
+            entry["queued"] = static_cast<uint64_t>(sub.queued);
+        }
+    });
+    statsRegistry().add("response_cache", [](crow::json::wvalue& s) {
+        ResponseCache::Stats c = responseCache().stats();
+        s["hits"] = c.hits;
+        s["misses"] = c.misses;
+        s["not_modified"] = c.notModified;
+        s["evictions"] = c.evictions;
+        s["invalidations"] = c.invalidations;
+        s["entries"] = static_cast<uint64_t>(c.entries);
+        s["bytes"] = static_cast<uint64_t>(c.bytes);
+        s["max_bytes"] = static_cast<uint64_t>(c.maxBytes);
+    });
+    statsRegistry().add("request_arena", [](crow::json::wvalue& s) {
+        RequestArenaStats a = requestArenaStats();
+        s["threads"] = a.threads;
+        s["spilled"] = a.spilled;
+        s["spilled_bytes"] = a.spilledBytes;
+    });
+    statsRegistry().add("push", [&push](crow::json::wvalue& s) {
+        PushHub::Stats p = push.stats();
+        s["connections"] = p.connections;
+        s["refused"] = p.refused;
+        s["sent"] = p.sent;
+        s["resyncs"] = p.resyncs;
+        s["board_recomputes"] = p.boardRecomputes;
+    });
+    statsRegistry().add("backup", [&backups](crow::json::wvalue& s) {
+        BackupStatus b = backups.status();
+        s["running"] = b.running;
+        s["last_success_utc"] = b.lastSuccessUtc;
+        s["last_ms"] = b.lastDurationMs;
+        s["last_pages"] = b.lastPages;
+        s["last_bytes"] = b.lastBytes;
+        s["restarts"] = b.restarts;
+        s["failed"] = !b.lastError.empty();
+    });
+    statsRegistry().add("process", [](crow::json::wvalue& s) { fillProcessStats(s); });
+    statsRegistry().add("queues", [&outbox, &scheduler](crow::json::wvalue& s) {
+        HttpClient::Stats http = sharedHttpClient().stats();
+        s["email_outbox_pending"] = outbox.pendingCount();
+        s["scheduler_queued"] = static_cast<uint64_t>(scheduler.queueDepth());
+        s["http_queued"] = static_cast<uint64_t>(http.queued);
+        s["http_active"] = static_cast<uint64_t>(http.active);
+        s["http_completed"] = http.completed;
+        s["http_failed"] = http.failed;
+        s["log_pending_lines"] = static_cast<uint64_t>(appLog().pendingLines());
+        s["log_dropped"] = appLog().droppedTotal();
+    });
+    statsRegistry().add("jobs", [&scheduler](crow::json::wvalue& s) {
+        for (const auto& job : scheduler.metrics()) {
+            crow::json::wvalue j;
+            j["runs"] = job.second.runs;
+            j["failures"] = job.second.failures;
+            j["skipped_overlaps"] = job.second.skippedOverlaps;
+            j["last_ms"] = job.second.lastDurationMs;
+            j["max_ms"] = job.second.maxDurationMs;
+            j["last_success_utc"] = job.second.lastSuccessUtc;
+            s[job.first] = std::move(j);
+        }
+    });
+    statsRegistry().add("pwhash", [](crow::json::wvalue& s) {
+        PasswordHashCost cost = passwordHashCost();
+        s["opslimit"] = static_cast<uint64_t>(cost.opslimit);
+        s["memlimit_mb"] = static_cast<uint64_t>(cost.memlimit / (1024 * 1024));
+        s["hash_ms"] = cost.hashMs;
+        s["est_logins_per_sec"] = cost.loginsPerSecond;
+    });
+
+    // A signal during startup can arrive before run() has built the server,
+    // when stop() would do nothing; wait for it unless run() already gave up.
+    std::atomic<bool> serverReturned{false};
+    lifecycle.start([&fitnessApp, &serverReturned] {
+        while (!serverReturned && fitnessApp.wait_for_server_start() == std::cv_status::timeout) {
+        }
+        fitnessApp.stop();
+    });
+    startup.mark("start_background");
+    startup.reportServing();
+
+    // Start server (signals are handled by the lifecycle, not Crow)
+    fitnessApp.port(8080).signal_clear().multithreaded().run();
+    serverReturned = true;
 
-    sqlite3_close(db);
+    lifecycle.finish();
+    appLog().stop();
 
     
     return 0;
@@ -0,0 +1,210 @@
+#include "maintenance.h"
+#include "reset.h"
+#include "scoreEngine.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+constexpr int64_t VACUUM_CHUNK_PAGES = 256;
+constexpr int64_t BACKFILL_BATCH_PAGES = 64;
+
+int64_t pragmaInt(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* stmt;
+    int64_t value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+bool exec(sqlite3* db, const char* sql)
+{
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Maintenance SQL failed: " << (errMsg ? errMsg : "") << "\nSQL: " << sql << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool isWalMode(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    bool wal = false;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* mode = sqlite3_column_text(stmt, 0);
+            wal = mode && std::string(reinterpret_cast<const char*>(mode)) == "wal";
+        }
+        sqlite3_finalize(stmt);
+    }
+    return wal;
+}
+
+// Rows returned by one UPDATE ... RETURNING, or -1. Counted from the statement
+// itself: sqlite3_changes() belongs to the handle and can be another writer's.
+int64_t returnedRows(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Maintenance SQL failed: " << sqlite3_errmsg(db) << "\nSQL: " << sql << std::endl;
+        return -1;
+    }
+    int64_t rows = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) ++rows;
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Maintenance SQL failed: " << sqlite3_errmsg(db) << "\nSQL: " << sql << std::endl;
+        rows = -1;
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+// Runs a batched UPDATE (LIMIT 500) until it changes nothing, paying for each
+// batch. Handlers' writes get the writer between batches.
+bool backfillInBatches(Database& database, const char* sql, const std::atomic<bool>& stop)
+{
+    while (!stop) {
+        if (!maintenanceIoBudget().acquire(BACKFILL_BATCH_PAGES, stop)) return true;
+        int64_t rows = returnedRows(database.write(), sql);
+        if (rows < 0) return false;
+        if (rows == 0) return true;
+    }
+    return true;
+}
+
+// Upkeep every database file needs, for the directory and for each shard.
+void registerFileJobs(Scheduler& scheduler, Database& database, const std::string& suffix)
+{
+    using std::chrono::minutes;
+    using std::chrono::hours;
+    using std::chrono::seconds;
+
+    // Shards ATTACH the directory, so everything here names "main" explicitly
+    // rather than letting SQLite walk every attached file.
+
+    // Nightly: let SQLite re-analyze only the tables whose statistics drifted.
+    scheduler.addCron("optimize" + suffix, "15 3 * * *", minutes(10), [&database](const std::atomic<bool>& stop) {
+        if (!maintenanceIoBudget().acquire(1000, stop)) return true;
+        return exec(database.write(), "PRAGMA analysis_limit = 400; PRAGMA main.optimize;");
+    });
+
+    // Weekly: full ANALYZE so the planner sees current row counts for every index.
+    scheduler.addCron("analyze" + suffix, "45 3 * * 0", minutes(10), [&database](const std::atomic<bool>& stop) {
+        int64_t pages = pragmaInt(database.read(), "PRAGMA main.page_count;");
+        if (!maintenanceIoBudget().acquire(pages > 0 ? pages : 1, stop)) return true;
+        return exec(database.write(), "ANALYZE main;");
+    });
+
+    // Hand free pages back to the filesystem in small steps. Only does
+    // anything when the database was created with auto_vacuum = INCREMENTAL.
+    scheduler.addInterval("incremental-vacuum" + suffix, hours(6), minutes(15), [&database](const std::atomic<bool>& stop) {
+        if (pragmaInt(database.read(), "PRAGMA main.auto_vacuum;") != 2) return true;
+        while (!stop && pragmaInt(database.read(), "PRAGMA main.freelist_count;") > 0) {
+            if (!maintenanceIoBudget().acquire(VACUUM_CHUNK_PAGES, stop)) break;
+            if (!exec(database.write(), "PRAGMA main.incremental_vacuum(256);")) return false;
+        }
+        return true;
+    });
+
+    // Keep the WAL short without blocking writers (PASSIVE never waits on locks).
+    scheduler.addInterval("wal-checkpoint" + suffix, minutes(5), seconds(30), [&database](const std::atomic<bool>&) {
+        auto db = database.write();
+        if (!isWalMode(db)) return true;
+        int logFrames = 0, checkpointed = 0;
+        int rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointed);
+        if (checkpointed > 0) maintenanceIoBudget().charge(checkpointed);
+        return rc == SQLITE_OK || rc == SQLITE_BUSY;
+    });
+
+    // Day/timestamp columns for rows that were written without them.
+    scheduler.addInterval("day-backfill" + suffix, minutes(15), minutes(1), [&database](const std::atomic<bool>& stop) {
+        static const char* batches[] = {
+            "UPDATE sessions SET day = CAST(julianday(date) - 2440587.5 AS INTEGER) WHERE id IN "
+            "(SELECT id FROM sessions WHERE day IS NULL AND julianday(date) IS NOT NULL LIMIT 500) RETURNING 1;",
+            "UPDATE exercises SET day = CAST(julianday(date) - 2440587.5 AS INTEGER) WHERE id IN "
+            "(SELECT id FROM exercises WHERE day IS NULL AND julianday(date) IS NOT NULL LIMIT 500) RETURNING 1;",
+            "UPDATE nutrition SET day = CAST(julianday(date) - 2440587.5 AS INTEGER) WHERE id IN "
+            "(SELECT id FROM nutrition WHERE day IS NULL AND julianday(date) IS NOT NULL LIMIT 500) RETURNING 1;",
+            "UPDATE goal_progress SET day = CAST(julianday(date) - 2440587.5 AS INTEGER) WHERE id IN "
+            "(SELECT id FROM goal_progress WHERE day IS NULL AND julianday(date) IS NOT NULL LIMIT 500) RETURNING 1;",
+            // sleep_start_time is server-local wall-clock text, as in migrateTables
+            "UPDATE sleepTable SET sleep_start_ts = CAST(strftime('%s', sleep_start_time, 'utc') AS INTEGER) WHERE sleep_id IN "
+            "(SELECT sleep_id FROM sleepTable WHERE sleep_start_ts IS NULL AND strftime('%s', sleep_start_time, 'utc') IS NOT NULL LIMIT 500) RETURNING 1;",
+        };
+        for (const char* sql : batches) {
+            if (!backfillInBatches(database, sql, stop)) return false;
+        }
+        return true;
+    });
+}
+
+} // namespace
+
+IoBudget& maintenanceIoBudget()
+{
+    static IoBudget budget = [] {
+        const char* env = std::getenv("MAINTENANCE_IO_PAGES_PER_SEC");
+        int64_t rate = env ? std::atoll(env) : 2000;
+        if (rate <= 0) rate = 2000;
+        return IoBudget(rate, rate * 2);
+    }();
+    return budget;
+}
+
+void registerMaintenanceJobs(Scheduler& scheduler, Database& database)
+{
+    using std::chrono::minutes;
+    using std::chrono::hours;
+
+    // Reset tokens are single-use and short-lived; nothing else removes them.
+    scheduler.addInterval("reset-token-cleanup", hours(1), minutes(5), [&database](const std::atomic<bool>&) {
+        return delete_expired_or_used_reset_tokens(database.write());
+    });
+
+    // Delivered mail is only kept for a week; failures stay a month for inspection.
+    scheduler.addInterval("email-outbox-cleanup", hours(24), hours(1), [&database](const std::atomic<bool>&) {
+        return exec(database.write(),
+            "DELETE FROM email_outbox WHERE (status = 'sent' AND sent_at < strftime('%s', 'now') - 7 * 86400) "
+            "OR (status = 'failed' AND created_at < strftime('%s', 'now') - 30 * 86400);");
+    });
+
+    registerFileJobs(scheduler, database, "");
+}
+
+bool finalWalCheckpoint(sqlite3* db)
+{
+    if (!isWalMode(db)) return true;
+    // TRUNCATE waits for readers, copies every frame back and empties the -wal
+    // file, so the next start has nothing to recover.
+    int logFrames = 0, checkpointed = 0;
+    int rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_TRUNCATE, &logFrames, &checkpointed);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Final WAL checkpoint failed: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void registerShardJobs(Scheduler& scheduler, ShardRouter& shards)
+{
+    if (!shards.sharded()) return;
+    for (int i = 0; i < shards.count(); ++i) {
+        registerFileJobs(scheduler, shards.shard(i), "-shard-" + std::to_string(i));
+    }
+
+    // Carries score changes from the shards into users.score for the leaderboard.
+    // Quick lane: the nightly paced jobs would otherwise hold it back for minutes.
+    scheduler.addInterval("score-sync", std::chrono::seconds(2), std::chrono::seconds(0), [&shards](const std::atomic<bool>& stop) {
+        bool ok = true;
+        for (int i = 0; i < shards.count() && !stop; ++i) {
+            ok = syncScoreTotals(shards.shard(i), shards.directory()) >= 0 && ok;
+        }
+        return ok;
+    }, Scheduler::Lane::Quick);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "scheduler.h"
+#include "shardRouter.h"
+#include <sqlite3.h>
+
+// I/O budget for maintenance jobs, from MAINTENANCE_IO_PAGES_PER_SEC
+// (default 2000 pages/s, i.e. about 8 MB/s with 4 KB pages).
+IoBudget& maintenanceIoBudget();
+
+// Periodic database upkeep: expired reset tokens, old outbox mail, planner statistics,
+// incremental vacuum, WAL checkpoints and day-column backfills.
+// Every job takes its own write() lease per step, never across an I/O budget wait.
+void registerMaintenanceJobs(Scheduler& scheduler, Database& database);
+
+// With FITNESS_SHARD_COUNT > 1: the same per-file upkeep for every shard
+// (jobs named "<job>-shard-<i>") and "score-sync" every two seconds.
+void registerShardJobs(Scheduler& scheduler, ShardRouter& shards);
+
+// Checkpoints the whole WAL into the database and truncates it. Run once at
+// shutdown, after the last writer stopped; a no-op outside WAL mode.
+bool finalWalCheckpoint(sqlite3* db);
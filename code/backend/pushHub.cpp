@@ -0,0 +1,325 @@
+#include "pushHub.h"
+#include "helper.h"
+#include "logger.h"
+#include "userDirectory.h"
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+
+namespace
+{
+    const char* RESYNC_MESSAGE = R"({"type":"resync"})";
+
+    std::size_t sizeFromEnv(const char* name, std::size_t fallback)
+    {
+        const char* value = std::getenv(name);
+        if (!value || !*value) return fallback;
+        int parsed = std::atoi(value);
+        return parsed > 0 ? static_cast<std::size_t>(parsed) : fallback;
+    }
+
+    int64_t steadyMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The accept handler has the request and open() only has the connection,
+    // so the user id and topics travel in the userdata pointer itself
+    // (nothing to free if the upgrade never opens).
+    constexpr uintptr_t TOPIC_LEADERBOARD = 1;
+    constexpr uintptr_t TOPIC_FRIENDS = 2;
+
+    void* packClient(int userId, uintptr_t topics)
+    {
+        return reinterpret_cast<void*>((static_cast<uintptr_t>(userId) << 2) | topics);
+    }
+
+    bool isScoreChange(ChangeEntity entity)
+    {
+        switch (entity) {
+            case ChangeEntity::Exercise:
+            case ChangeEntity::Meal:
+            case ChangeEntity::Sleep:
+            case ChangeEntity::Goal:
+            case ChangeEntity::GoalProgress:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // The whole board when previous is null; otherwise the ranks that differ
+    // from it, or "" when none do.
+    std::string leaderboardMessage(const std::vector<UserSimple>& board, const std::vector<UserSimple>* previous)
+    {
+        crow::json::wvalue msg;
+        msg["type"] = "leaderboard";
+        msg["full"] = previous == nullptr;
+        msg["size"] = static_cast<uint64_t>(board.size());
+        std::vector<crow::json::wvalue> changes;
+        for (std::size_t i = 0; i < board.size(); ++i) {
+            if (previous && i < previous->size() && (*previous)[i].username == board[i].username
+                && (*previous)[i].score == board[i].score) {
+                continue;
+            }
+            crow::json::wvalue entry;
+            entry["rank"] = static_cast<uint64_t>(i + 1);
+            entry["username"] = board[i].username;
+            entry["score"] = board[i].score;
+            changes.push_back(std::move(entry));
+        }
+        if (previous && changes.empty() && board.size() == previous->size()) return "";
+        msg["changes"] = std::move(changes);
+        return msg.dump();
+    }
+}
+
+PushHub::PushHub(Database& directory, bool sharded)
+    : _directory(directory),
+      // score-sync folds shard totals into users.score every 2 s
+      _settleMs(sharded ? 3000 : 0),
+      _maxConnections(sizeFromEnv("PUSH_MAX_CONNECTIONS", 500)),
+      _maxQueued(sizeFromEnv("PUSH_MAX_QUEUED", 64))
+{
+}
+
+PushHub::~PushHub()
+{
+    stop();
+}
+
+bool PushHub::accept(const crow::request& req, void** userdata)
+{
+    uintptr_t topics = 0;
+    std::stringstream list(req.url_params.get("topics") ? req.url_params.get("topics") : "");
+    std::string topic;
+    while (std::getline(list, topic, ',')) {
+        if (topic == "leaderboard") topics |= TOPIC_LEADERBOARD;
+        if (topic == "friends") topics |= TOPIC_FRIENDS;
+    }
+
+    int userId = 0;
+    std::string user_id_str = getCookieValue(req.get_header_value("Cookie"), "user_id");
+    if (!user_id_str.empty()) {
+        userId = std::atoi(user_id_str.c_str());
+    }
+    // Friend updates are per user
+    if (userId <= 0) topics &= ~TOPIC_FRIENDS;
+    if (topics == 0) return false;
+
+    {
+        // Checked again in open(); this only saves the upgrade when already full
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop || _clients.size() >= _maxConnections) {
+            _refused++;
+            return false;
+        }
+    }
+    *userdata = packClient(userId, topics);
+    return true;
+}
+
+void PushHub::open(crow::websocket::connection& conn)
+{
+    auto packed = reinterpret_cast<uintptr_t>(conn.userdata());
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stop || _clients.size() >= _maxConnections) {
+        _refused++;
+        conn.close("too many connections");
+        return;
+    }
+    Client& client = _clients[&conn];
+    client.userId = static_cast<int>(packed >> 2);
+    client.leaderboard = (packed & TOPIC_LEADERBOARD) != 0;
+    client.friends = (packed & TOPIC_FRIENDS) != 0;
+    client.needsFullBoard = client.leaderboard;
+}
+
+void PushHub::close(crow::websocket::connection& conn)
+{
+    // Sends happen under _mutex, so none is in progress once this returns
+    std::lock_guard<std::mutex> lock(_mutex);
+    _clients.erase(&conn);
+}
+
+void PushHub::subscribe(EventBus& bus)
+{
+    bus.subscribe("push", [this](const ChangeEvent& event) { onChange(event); });
+}
+
+void PushHub::onChange(const ChangeEvent& event)
+{
+    if (isScoreChange(event.entity)) {
+        _scoreChangedMs = steadyMs();
+        return;
+    }
+
+    if (event.entity == ChangeEntity::Friendship) {
+        crow::json::wvalue msg;
+        msg["type"] = "friendship";
+        msg["op"] = changeOpName(event.op);
+        msg["user_id"] = event.user_id;
+        msg["friend_id"] = event.other_user_id;
+        sendToUsers(event.user_id, event.other_user_id, msg.dump());
+        return;
+    }
+
+    if (event.entity == ChangeEntity::FriendRequest) {
+        int senderId = 0, receiverId = 0;
+        std::string status;
+        {
+            auto db = _directory.read();
+            sqlite3_stmt* stmt;
+            const char* sql = "SELECT sender_id, receiver_id, status FROM friend_requests WHERE id = ?;";
+            if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return;
+            sqlite3_bind_int64(stmt, 1, event.id);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                senderId = sqlite3_column_int(stmt, 0);
+                receiverId = sqlite3_column_int(stmt, 1);
+                status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            }
+            sqlite3_finalize(stmt);
+            // Gone already (user deleted); nothing to show
+            if (senderId == 0) return;
+        }
+
+        crow::json::wvalue msg;
+        msg["type"] = "friend_request";
+        msg["id"] = event.id;
+        msg["sender_id"] = senderId;
+        msg["receiver_id"] = receiverId;
+        msg["status"] = status;
+        std::optional<UserRecord> sender = userDirectory().byId(_directory.read(), senderId);
+        msg["sender_username"] = sender ? sender->username : "";
+        sendToUsers(senderId, receiverId, msg.dump());
+    }
+}
+
+void PushHub::sendToUsers(int userA, int userB, const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stop) return;
+    for (auto& entry : _clients) {
+        Client& client = entry.second;
+        if (client.friends && (client.userId == userA || client.userId == userB)) {
+            enqueue(client, message);
+        }
+    }
+}
+
+void PushHub::enqueue(Client& client, std::string message)
+{
+    // Caller holds _mutex. The ticker sends at most SENDS_PER_TICK per TICK;
+    // a client that falls _maxQueued behind gets one resync instead of an
+    // ever-growing backlog, and the page reloads over HTTP.
+    if (!client.queue.empty() && client.queue.back() == RESYNC_MESSAGE) return;
+    if (client.queue.size() >= _maxQueued) {
+        client.queue.clear();
+        client.queue.push_back(RESYNC_MESSAGE);
+        _resyncs++;
+        return;
+    }
+    client.queue.push_back(std::move(message));
+}
+
+void PushHub::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_thread.joinable() || _stop) return;
+    _thread = std::thread([this] { run(); });
+}
+
+void PushHub::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_stop) return;
+        _stop = true;
+        // Browsers reconnect (to another instance) on their own; close() below
+        // is called by Crow for each of these
+        for (auto& entry : _clients) {
+            entry.first->close("server shutting down");
+        }
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) _thread.join();
+}
+
+void PushHub::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop) {
+        _wake.wait_for(lock, TICK);
+        if (_stop) break;
+
+        bool wantBoard = false;
+        for (const auto& entry : _clients) wantBoard = wantBoard || entry.second.leaderboard;
+        if (wantBoard) {
+            // The query runs without _mutex; sockets keep opening and closing
+            lock.unlock();
+            refreshLeaderboard();
+            lock.lock();
+        } else {
+            // Not kept current while nobody watches; reloaded for the next viewer
+            _boardLoaded = false;
+        }
+
+        for (auto& entry : _clients) {
+            Client& client = entry.second;
+            for (std::size_t sent = 0; sent < SENDS_PER_TICK && !client.queue.empty(); ++sent) {
+                entry.first->send_text(std::move(client.queue.front()));
+                client.queue.pop_front();
+                _sent++;
+            }
+        }
+    }
+}
+
+void PushHub::refreshLeaderboard()
+{
+    int64_t now = steadyMs();
+    int64_t changed = _scoreChangedMs.load();
+    // Re-read after a score change (and for a settle window after it, while
+    // shard totals catch up), at most once a second
+    bool due = !_boardLoaded
+        || (changed > _boardReadMs - _settleMs && now - _boardReadMs >= 1000);
+
+    std::string delta;
+    if (due) {
+        std::vector<UserSimple> board = getTopUsers(_directory.read(), LEADERBOARD_SIZE);
+        _boardRecomputes++;
+        _boardReadMs = now;
+        if (_boardLoaded) delta = leaderboardMessage(board, &_board);
+        _board = std::move(board);
+        _boardLoaded = true;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::string full;
+    for (auto& entry : _clients) {
+        Client& client = entry.second;
+        if (!client.leaderboard) continue;
+        if (client.needsFullBoard) {
+            if (full.empty()) full = leaderboardMessage(_board, nullptr);
+            enqueue(client, full);
+            client.needsFullBoard = false;
+        } else if (!delta.empty()) {
+            enqueue(client, delta);
+        }
+    }
+}
+
+PushHub::Stats PushHub::stats() const
+{
+    Stats s;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        s.connections = _clients.size();
+    }
+    s.refused = _refused.load();
+    s.sent = _sent.load();
+    s.resyncs = _resyncs.load();
+    s.boardRecomputes = _boardRecomputes.load();
+    return s;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <crow.h>
+#include "database.h"
+#include "eventBus.h"
+#include "leaderboard.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Pushes small JSON deltas to browsers over the /ws websocket, so the
+// leaderboard and social pages don't have to re-fetch to notice changes.
+//
+// Topics (chosen with /ws?topics=leaderboard,friends):
+//   leaderboard  {"type":"leaderboard","size":N,"changes":[{"rank","username","score"}]}
+//                the full top 100 on connect, then only the ranks that changed.
+//                Recomputed at most once a second, and only after score changes.
+//   friends      {"type":"friend_request",...} and {"type":"friendship",...}
+//                to the two users involved (needs the user_id cookie).
+//
+// Everything reaches a socket through the client's own queue, drained by
+// one ticker thread a few messages per tick. A client whose queue passes
+// PUSH_MAX_QUEUED is sent a single {"type":"resync"} instead (reload over
+// HTTP), so one slow browser costs a bounded amount of memory. At most
+// PUSH_MAX_CONNECTIONS sockets are open at once.
+class PushHub
+{
+public:
+    static constexpr int LEADERBOARD_SIZE = 100;
+    static constexpr auto TICK = std::chrono::milliseconds(250);
+    static constexpr std::size_t SENDS_PER_TICK = 8;
+
+    struct Stats {
+        uint64_t connections = 0;
+        uint64_t refused = 0;
+        uint64_t sent = 0;
+        uint64_t resyncs = 0;
+        uint64_t boardRecomputes = 0;
+    };
+
+    // With shards, users.score trails the activity by up to a score-sync
+    // period, so the leaderboard is re-read for a few seconds after a change.
+    PushHub(Database& directory, bool sharded);
+    ~PushHub();
+
+    // /ws handlers (routes/push.cpp).
+    bool accept(const crow::request& req, void** userdata);
+    void open(crow::websocket::connection& conn);
+    void close(crow::websocket::connection& conn);
+
+    // Registers the "push" subscriber; call before eventBus().start().
+    void subscribe(EventBus& bus);
+
+    void start();
+    // Closes every socket and joins the ticker.
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Client {
+        int userId = 0;
+        bool leaderboard = false;
+        bool friends = false;
+        bool needsFullBoard = false;
+        std::deque<std::string> queue;
+    };
+
+    void onChange(const ChangeEvent& event);
+    void sendToUsers(int userA, int userB, const std::string& message);
+    void enqueue(Client& client, std::string message);
+    void run();
+    void refreshLeaderboard();
+
+    Database& _directory;
+    int64_t _settleMs;
+    std::size_t _maxConnections;
+    std::size_t _maxQueued;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _stop = false;
+    std::unordered_map<crow::websocket::connection*, Client> _clients;   // guarded by _mutex
+    std::vector<UserSimple> _board;                                       // ticker thread only
+    bool _boardLoaded = false;                                            // ticker thread only
+    int64_t _boardReadMs = 0;                                             // ticker thread only
+    std::atomic<int64_t> _scoreChangedMs{0};
+    std::thread _thread;
+
+    std::atomic<uint64_t> _refused{0};
+    std::atomic<uint64_t> _sent{0};
+    std::atomic<uint64_t> _resyncs{0};
+    std::atomic<uint64_t> _boardRecomputes{0};
+};
@@ -0,0 +1,100 @@
+#include "requestArena.h"
+#include <atomic>
+#include <memory>
+
+namespace
+{
+    constexpr std::size_t FIRST_BLOCK = 64 * 1024;
+
+    std::atomic<uint64_t> g_threads{0};
+    std::atomic<uint64_t> g_spilled{0};
+    std::atomic<uint64_t> g_spilledBytes{0};
+
+    // Heap behind the first block; counts what one request takes from it
+    class SpillResource : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t bytes = 0;
+
+    private:
+        void* do_allocate(std::size_t size, std::size_t align) override
+        {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, align);
+        }
+
+        void do_deallocate(void* p, std::size_t size, std::size_t align) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, size, align);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    struct ThreadArena
+    {
+        ThreadArena()
+            : first(new std::byte[FIRST_BLOCK]),
+              arena(first.get(), FIRST_BLOCK, &spill)
+        {
+            g_threads.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Frees the spilled blocks and rewinds to the start of the first one
+        void release()
+        {
+            arena.release();
+            if (spill.bytes > 0) {
+                g_spilled.fetch_add(1, std::memory_order_relaxed);
+                g_spilledBytes.fetch_add(spill.bytes, std::memory_order_relaxed);
+                spill.bytes = 0;
+            }
+        }
+
+        std::unique_ptr<std::byte[]> first;
+        SpillResource spill;
+        std::pmr::monotonic_buffer_resource arena;
+    };
+
+    // Only worker threads construct one, on their first request
+    ThreadArena& threadArena()
+    {
+        thread_local ThreadArena arena;
+        return arena;
+    }
+
+    // Set while this thread is inside a request
+    thread_local std::pmr::memory_resource* t_current = nullptr;
+}
+
+std::pmr::memory_resource* requestArena()
+{
+    return t_current ? t_current : std::pmr::get_default_resource();
+}
+
+RequestArenaStats requestArenaStats()
+{
+    return RequestArenaStats{
+        g_threads.load(std::memory_order_relaxed),
+        g_spilled.load(std::memory_order_relaxed),
+        g_spilledBytes.load(std::memory_order_relaxed),
+    };
+}
+
+void openRequestArena()
+{
+    ThreadArena& t = threadArena();
+    // Still open if the previous request's close was skipped
+    if (t_current) t.release();
+    t_current = &t.arena;
+}
+
+void closeRequestArena()
+{
+    if (!t_current) return;
+    t_current = nullptr;
+    threadArena().release();
+}
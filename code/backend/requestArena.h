@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Scratch memory for the request a worker thread is handling.
+//
+// Every Crow worker thread owns one std::pmr::monotonic_buffer_resource
+// over a 64 KiB first block it keeps for life. A Crow middleware opens it
+// when a request arrives and releases it, all at once, after the response
+// is built; in between, row readers, the JSON writer and DTO
+// scratch buffers bump-allocate from requestArena() instead of going
+// through the global allocator (and contending for it with the other
+// workers) once per row and field. A request that outgrows the first block
+// takes more from the heap, and those blocks are freed at the release.
+//
+// Outside a request (background jobs, tools, websocket callbacks)
+// requestArena() is plain new/delete, so the same code runs there unchanged.
+// Nothing allocated from it may outlive the handler: copy what the response
+// needs into crow::response before returning.
+std::pmr::memory_resource* requestArena();
+
+struct RequestArenaStats {
+    uint64_t threads;        // workers that have served a request
+    uint64_t spilled;        // requests that outgrew the first block
+    uint64_t spilledBytes;   // heap taken by those requests
+};
+
+RequestArenaStats requestArenaStats();
+
+// Called around each request by RequestArenaMiddleware (admissionControl.h).
+// openRequestArena() also releases anything a skipped close left behind.
+void openRequestArena();
+void closeRequestArena();
@@ -4,12 +4,18 @@
 #include <optional>
 #include <sqlite3.h>
 #include <crow.h>
+#include "admissionControl.h"
+#include "database.h"
+#include "httpClient.h"
+
+class EmailOutbox;
 
 struct EmailConfig {
-    std::string mode;      // "mock" or "real"
+    std::string mode;      // "mock", "file" or "real"
     std::string api_key;   // Mailgun API key
     std::string domain;    // Mailgun domain, e.g. sandboxXXXX.mailgun.org
     std::string from;      // From address, e.g. "no-reply@fitnessapp.com"
+    std::string outbox_dir; // where "file" mode writes .eml files
 };
 
 EmailConfig load_email_config_from_env();
@@ -57,8 +63,17 @@ std::string time_plus_seconds_iso8601(int seconds);
 // Compare current time with expires_at ISO string to see if token is expired.
 bool is_token_expired(const std::string& expires_at_iso);
 
-bool send_reset_email(const EmailConfig& cfg, const std::string& to, const std::string& reset_url);
+// Build the reset message and put it on the outbox through the caller's write()
+// lease `db`; delivery happens in the background.
+bool queue_reset_email(EmailOutbox& outbox, sqlite3* db, const std::string& to, const std::string& reset_url);
+
+// Fill `out` with the Mailgun messages API call. Returns false if the config is incomplete.
+bool build_mailgun_request(const EmailConfig& cfg, const std::string& to, const std::string& subject, const std::string& body_text, const std::string& body_html, HttpRequest& out);
+
+// Logs the Mailgun reply and returns true for 200/202.
+bool mailgun_response_ok(const HttpResponse& resp);
 
+// Blocking send over the shared HTTP client (pooled, keep-alive connections).
 bool send_email_via_mailgun(const EmailConfig& cfg, const std::string& to, const std::string& subject, const std::string& body_text, const std::string& body_html = "");
 
-void setupPasswordResetRoutes(crow::SimpleApp& app, sqlite3* db, const EmailConfig& email_cfg);
\ No newline at end of file
+void setupPasswordResetRoutes(FitnessApp& app, Database& database, EmailOutbox& outbox);
\ No newline at end of file
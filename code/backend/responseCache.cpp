@@ -0,0 +1,199 @@
+#include "responseCache.h"
+#include "eventBus.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+namespace
+{
+    // Per entry on top of key and body: list node, index slot, etag
+    constexpr std::size_t ENTRY_OVERHEAD = 160;
+
+    int64_t steadyMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // FNV-1a: stable across builds and instances, so any replica can answer a 304
+    std::string etagFor(const std::string& body)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : body) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        char buf[24];
+        std::snprintf(buf, sizeof(buf), "\"%016llx\"", static_cast<unsigned long long>(hash));
+        return buf;
+    }
+
+    bool etagMatches(const std::string& ifNoneMatch, const std::string& etag)
+    {
+        return !ifNoneMatch.empty() && (ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos);
+    }
+
+    crow::response makeResponse(const std::string& body, const std::string& contentType,
+                                const std::string& etag, bool notModified)
+    {
+        crow::response res(notModified ? 304 : 200);
+        if (!notModified) {
+            res.body = body;
+            res.set_header("Content-Type", contentType);
+        }
+        res.set_header("ETag", etag);
+        // Per user, and always revalidated, which is a 304 while nothing changed
+        res.set_header("Cache-Control", "private, no-cache");
+        return res;
+    }
+}
+
+ResponseCache::ResponseCache(std::size_t maxBytes)
+    : _maxBytes(maxBytes)
+{
+}
+
+ResponseCache::Shard& ResponseCache::shardFor(int userId, const std::string& key)
+{
+    std::size_t slot = userId != 0 ? static_cast<std::size_t>(userId) : std::hash<std::string>()(key);
+    return _shards[slot % SHARDS];
+}
+
+uint64_t ResponseCache::stampOf(const Shard& shard, int userId)
+{
+    auto found = shard.stampIndex.find(userId);
+    return found != shard.stampIndex.end() ? found->second->second : shard.floor;
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Entry>::iterator it)
+{
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+}
+
+crow::response ResponseCache::serve(const crow::request& req, int userId, const std::string& key,
+                                    const std::function<crow::response()>& build,
+                                    std::chrono::milliseconds ttl)
+{
+    if (_maxBytes == 0) return build();
+
+    std::string fullKey = std::to_string(userId) + '|' + key;
+    std::string ifNoneMatch = req.get_header_value("If-None-Match");
+    Shard& shard = shardFor(userId, fullKey);
+    uint64_t started = 0;
+
+    std::shared_ptr<const std::string> body;
+    std::string contentType, etag;
+    bool notModified = false;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        started = shard.clock;
+
+        auto found = shard.index.find(fullKey);
+        if (found != shard.index.end()) {
+            auto it = found->second;
+            if (it->built >= stampOf(shard, userId) && (it->expiresMs == 0 || steadyMs() < it->expiresMs)) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                body = it->body;
+                contentType = it->contentType;
+                etag = it->etag;
+                notModified = etagMatches(ifNoneMatch, etag);
+                shard.hits++;
+                if (notModified) shard.notModified++;
+            } else {
+                erase(shard, it);
+            }
+        }
+        if (!body) shard.misses++;
+    }
+    if (body) return makeResponse(*body, contentType, etag, notModified);
+
+    // Built without the lock; two concurrent misses both build, the later insert wins
+    crow::response built = build();
+    if (built.code != 200) return built;
+
+    etag = etagFor(built.body);
+    contentType = built.get_header_value("Content-Type");
+    if (contentType.empty()) contentType = "application/json";
+    notModified = etagMatches(ifNoneMatch, etag);
+
+    std::size_t bytes = fullKey.size() + built.body.size() + ENTRY_OVERHEAD;
+    std::size_t shardBudget = _maxBytes / SHARDS;
+    auto stored = std::make_shared<const std::string>(std::move(built.body));
+    if (bytes <= shardBudget) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Invalidated while building: this body may predate the write
+        if (stampOf(shard, userId) <= started) {
+            auto found = shard.index.find(fullKey);
+            if (found != shard.index.end()) erase(shard, found->second);
+            int64_t expires = ttl.count() > 0 ? steadyMs() + ttl.count() : 0;
+            shard.lru.push_front(Entry{fullKey, userId, started, expires, stored, contentType, etag, bytes});
+            shard.index[fullKey] = shard.lru.begin();
+            shard.bytes += bytes;
+            while (shard.bytes > shardBudget) {
+                erase(shard, std::prev(shard.lru.end()));
+                shard.evictions++;
+            }
+        }
+        if (notModified) shard.notModified++;
+    }
+    return makeResponse(*stored, contentType, etag, notModified);
+}
+
+void ResponseCache::invalidateUser(int userId)
+{
+    if (_maxBytes == 0 || userId == 0) return;
+    Shard& shard = shardFor(userId, std::string());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.clock++;
+    shard.invalidations++;
+    auto found = shard.stampIndex.find(userId);
+    if (found != shard.stampIndex.end()) {
+        shard.stamps.splice(shard.stamps.end(), shard.stamps, found->second);
+        found->second->second = shard.clock;
+        return;
+    }
+    shard.stamps.emplace_back(userId, shard.clock);
+    shard.stampIndex[userId] = std::prev(shard.stamps.end());
+    if (shard.stamps.size() > STAMPS_PER_SHARD) {
+        shard.floor = shard.stamps.front().second;
+        shard.stampIndex.erase(shard.stamps.front().first);
+        shard.stamps.pop_front();
+    }
+}
+
+void ResponseCache::subscribe(EventBus& bus)
+{
+    bus.observe("response-cache", [this](const ChangeEvent& event) {
+        invalidateUser(event.user_id);
+        if (event.other_user_id != 0) invalidateUser(event.other_user_id);
+    });
+}
+
+ResponseCache::Stats ResponseCache::stats() const
+{
+    Stats s;
+    s.maxBytes = _maxBytes;
+    for (const Shard& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        s.hits += shard.hits;
+        s.misses += shard.misses;
+        s.notModified += shard.notModified;
+        s.evictions += shard.evictions;
+        s.invalidations += shard.invalidations;
+        s.entries += shard.index.size();
+        s.bytes += shard.bytes;
+    }
+    return s;
+}
+
+ResponseCache& responseCache()
+{
+    static ResponseCache cache([] {
+        const char* value = std::getenv("RESPONSE_CACHE_MB");
+        long mb = (value && *value) ? std::atol(value) : 32;
+        return static_cast<std::size_t>(mb > 0 ? mb : 0) * 1024 * 1024;
+    }());
+    return cache;
+}
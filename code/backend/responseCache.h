@@ -0,0 +1,104 @@
+#pragma once
+#include <crow.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+class EventBus;
+
+// Serialized GET responses, keyed by (user, route + parameters).
+//
+// SHARDS independent LRU lists, each under its own mutex and holding
+// 1/SHARDS of the byte budget (RESPONSE_CACHE_MB, 0 disables). A user's
+// entries all live in one shard, next to the shard's invalidation clock:
+// invalidateUser() stamps the user with the next tick, and an entry counts
+// only if its build started at or after its user's stamp; older ones are
+// dropped when next touched or evicted. serve() reads the clock before
+// building, so a response computed while a write was committing is never
+// stored as current.
+//
+// A shard remembers the last STAMPS_PER_SHARD users it stamped. Forgetting
+// the oldest raises the shard's floor, the stamp every other user reads as,
+// to that user's stamp, which only costs entries built before it.
+//
+// Entries for user 0 are shared by everyone and only expire by TTL.
+class ResponseCache
+{
+public:
+    static constexpr std::size_t SHARDS = 16;
+    static constexpr std::size_t STAMPS_PER_SHARD = 4096;
+    // For data that changes without a per-user write (leaderboards)
+    static constexpr std::chrono::milliseconds SHARED_TTL{5000};
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t notModified = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+        std::size_t maxBytes = 0;
+    };
+
+    explicit ResponseCache(std::size_t maxBytes);
+
+    // The cached response for `key`, or build()'s (cached when it is a 200).
+    // Adds an ETag, and answers 304 when If-None-Match already has it.
+    // ttl 0 = until invalidated.
+    crow::response serve(const crow::request& req, int userId, const std::string& key,
+                         const std::function<crow::response()>& build,
+                         std::chrono::milliseconds ttl = std::chrono::milliseconds(0));
+
+    void invalidateUser(int userId);
+
+    // Registers the "response-cache" observer, which invalidates both users a
+    // change names before the write returns; call before eventBus().start().
+    void subscribe(EventBus& bus);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        int userId;
+        uint64_t built;         // shard clock when its build started
+        int64_t expiresMs;      // steady clock, 0 = never
+        std::shared_ptr<const std::string> body;
+        std::string contentType;
+        std::string etag;
+        std::size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;   // most recent first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        uint64_t clock = 0;     // invalidations so far
+        uint64_t floor = 0;     // stamp of the last user forgotten
+        std::list<std::pair<int, uint64_t>> stamps;     // user, clock; oldest first
+        std::unordered_map<int, std::list<std::pair<int, uint64_t>>::iterator> stampIndex;
+        std::size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t notModified = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+    };
+
+    Shard& shardFor(int userId, const std::string& key);
+    static uint64_t stampOf(const Shard& shard, int userId);
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+
+    std::size_t _maxBytes;
+    Shard _shards[SHARDS];
+};
+
+// Process-wide cache, sized from RESPONSE_CACHE_MB (default 32).
+ResponseCache& responseCache();
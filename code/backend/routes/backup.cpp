@@ -0,0 +1,47 @@
+#include "backup.h"
+#include "health.h"
+#include "../helper.h"
+
+void setupBackupRoutes(FitnessApp& app, Scheduler& scheduler, BackupManager& backups)
+{
+    CROW_ROUTE(app, "/admin/backups").methods("GET"_method)([&backups](const crow::request& req)
+    {
+        if (!isOperatorRequest(req)) {
+            return makeError(403, "Forbidden");
+        }
+        BackupStatus status = backups.status();
+        crow::json::wvalue res;
+        res["running"] = status.running;
+        res["dir"] = backups.config().dir;
+        res["last_start_utc"] = status.lastStartUtc;
+        res["last_success_utc"] = status.lastSuccessUtc;
+        res["last_ms"] = status.lastDurationMs;
+        res["last_error"] = status.lastError;
+
+        std::vector<crow::json::wvalue> snapshots;
+        for (const auto& snapshot : backups.list()) {
+            crow::json::wvalue s;
+            s["name"] = snapshot.name;
+            s["bytes"] = snapshot.bytes;
+            s["created_utc"] = snapshot.createdUtc;
+            snapshots.push_back(std::move(s));
+        }
+        res["snapshots"] = std::move(snapshots);
+        return crow::response(200, res);
+    });
+
+    CROW_ROUTE(app, "/admin/backups").methods("POST"_method)([&scheduler, &backups](const crow::request& req)
+    {
+        if (!isOperatorRequest(req)) {
+            return makeError(403, "Forbidden");
+        }
+        if (backups.status().running) {
+            return makeError(409, "A backup is already running");
+        }
+        // Runs on a scheduler thread under the maintenance I/O budget
+        if (!scheduler.runNow("backup")) {
+            return makeError(500, "Backup job is not registered");
+        }
+        return makeSuccess(202, "Backup started");
+    });
+}
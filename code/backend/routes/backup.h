@@ -0,0 +1,14 @@
+#ifndef BACKUP_ROUTES_H
+#define BACKUP_ROUTES_H
+
+#include <crow.h>
+#include "../admissionControl.h"
+#include "../backup.h"
+#include "../scheduler.h"
+
+// Operator-only (same check as /debug/stats):
+// GET  /admin/backups: status of the last run and the snapshots on disk, newest first.
+// POST /admin/backups: queue a snapshot now on the scheduler; 409 if one is running.
+void setupBackupRoutes(FitnessApp& app, Scheduler& scheduler, BackupManager& backups);
+
+#endif
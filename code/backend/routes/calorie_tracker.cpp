@@ -1,12 +1,31 @@
 #include "calorie_tracker.h"
 #include "../helper.h"
+#include "../timeZone.h"
+#include "../scoreEngine.h"
+#include "../eventBus.h"
+#include "../responseCache.h"
+#include "../dto.h"
+#include "../jsonWriter.h"
 #include <iostream>
-#include <sstream>
-#include <iomanip>
-#include <chrono>
-#include <ctime>
 
-void setupCalorieTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
+namespace {
+    struct MealDto {
+        std::string_view meal_type;
+        std::string_view meal_name;
+        int calories = 0;
+        double protein = 0.0;
+        std::optional<std::string_view> date;   // defaults to today in the user's zone
+    };
+
+    constexpr auto MEAL_SCHEMA = dto::schema<MealDto>(
+        dto::required("meal_type", &MealDto::meal_type).length(1, 32),
+        dto::required("meal_name", &MealDto::meal_name).length(1, 200),
+        dto::required("calories", &MealDto::calories).range(0, 20000),
+        dto::optional("protein", &MealDto::protein).range(0, 2000),
+        dto::optional("date", &MealDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD"));
+}
+
+void setupCalorieTrackerRoutes(FitnessApp& app, ShardRouter& shards) {
     // Serve the calorie tracker page
     CROW_ROUTE(app, "/calorie-tracker")
     ([] {
@@ -15,100 +34,117 @@ void setupCalorieTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
 
     // Add meal
     CROW_ROUTE(app, "/api/meals").methods("POST"_method)
-    ([&app, db](const crow::request& req) {
+    ([&app, &shards](const crow::request& req) {
+        std::string user_id_str = getCookieValue(req.get_header_value("Cookie"), "user_id");
+        if (user_id_str.empty()) {
+            return crow::response{401, "Unauthorized: missing login cookie"};
+        }
+        auto db = shards.forUser(std::stoi(user_id_str)).write();
         return addMeal(app, db, req);
     });
 
     // Get meals for a specific user + date
     CROW_ROUTE(app, "/api/meals/<string>").methods("GET"_method)
-    ([&app, db](const crow::request& req, const std::string& date) {
-
+    ([&app, &shards](const crow::request& req, const std::string& date) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
 
         return getMeals(app, db, user_id, date);
     });
 
     // Update a meal
     CROW_ROUTE(app, "/api/meals/<int>").methods("PUT"_method)
-    ([&app, db](const crow::request& req, int meal_id) {
+    ([&app, &shards](const crow::request& req, int meal_id) {
+        auto db = shards.forRow(meal_id).write();
         return updateMeal(app, db, meal_id, req);
     });
 
     // Delete a meal
     CROW_ROUTE(app, "/api/meals/<int>").methods("DELETE"_method)
-    ([&app, db](const crow::request& req, int meal_id) {
+    ([&app, &shards](const crow::request& req, int meal_id) {
+        auto db = shards.forRow(meal_id).write();
         return deleteMeal(app, db, meal_id);
     });
 
     // Clear all meals for a day
     CROW_ROUTE(app, "/api/meals/clear/<string>").methods("DELETE"_method)
-    ([&app, db](const crow::request& req, const std::string& date) {
-
+    ([&app, &shards](const crow::request& req, const std::string& date) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).write();
 
         return clearDayMeals(app, db, user_id, date);
     });
 
     // Get user goals
     CROW_ROUTE(app, "/api/goals/").methods("GET"_method)
-    ([&app, db](const crow::request& req) {
-
+    ([&app, &shards](const crow::request& req) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
 
         return getUserGoals(app, db, user_id);
     });
 
     // Update user goals
     CROW_ROUTE(app, "/api/goals").methods("PUT"_method)
-    ([&app, db](const crow::request& req) {
-
+    ([&app, &shards](const crow::request& req) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).write();
 
         return updateUserGoals(app, db, user_id, req);
     });
    CROW_ROUTE(app, "/api/daily-summary/<string>").methods("GET"_method)
-    ([&app, db](const crow::request& req, const std::string& date) {
+    ([&app, &shards](const crow::request& req, const std::string& date) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
-
-        return getDailySummary(app, db, user_id, date);
+        Database& database = shards.forUser(user_id);
+
+        Day day;
+        if (!parseUserDay(database, user_id, date, day)) return getDailySummary(app, database.read(), user_id, date);
+        // "today" and its date share an entry. Leased inside build(), after the
+        // cache read its clock: a hit takes no reader, and a miss can't store a
+        // snapshot taken before that
+        return responseCache().serve(req, user_id, "daily-summary/" + toDateString(day),
+                                     [&] { return getDailySummary(app, database.read(), user_id, date); });
     });
 
     // Get weekly summary (last 7 days)
     CROW_ROUTE(app, "/api/weekly-summary").methods("GET"_method)
-    ([&app, db](const crow::request& req) {
+    ([&app, &shards](const crow::request& req) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
+        Database& database = shards.forUser(user_id);
 
-        return getWeeklySummary(app, db, user_id);
+        // Keyed by the user's today, so the window moves at local midnight
+        std::string key = "weekly-summary/" + toDateString(todayForUser(database, user_id));
+        return responseCache().serve(req, user_id, key, [&] { return getWeeklySummary(app, database.read(), user_id); });
     });
     // Get daily summary for a specific date
  
@@ -117,12 +153,9 @@ void setupCalorieTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
 
 
 
-crow::response addMeal(crow::SimpleApp& app, sqlite3* db, const crow::request& req) {
-    auto data = crow::json::load(req.body);
-    if (!data) return crow::response(400, "Invalid JSON");
-
-    std::string error;
-    if (!validateMealData(data, error)) return crow::response(400, error);
+crow::response addMeal(FitnessApp& app, sqlite3* db, const crow::request& req) {
+    auto meal = MEAL_SCHEMA.parse(req.body);
+    if (!meal) return crow::response(400, meal.error());
 
     auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
@@ -131,123 +164,168 @@ crow::response addMeal(crow::SimpleApp& app, sqlite3* db, const crow::request& r
         }
 
     int user_id = std::stoi(user_id_str);
-    std::string date = data.has("date") ? data["date"].s() : getCurrentDate();
-    std::string meal_type = data["meal_type"].s();
-    std::string meal_name = data["meal_name"].s();
-    int calories = data["calories"].i();
-    double protein = data.has("protein") ? data["protein"].d() : 0.0;
-    std::string created_at = getCurrentDateTime();
+    std::shared_ptr<const TimeZone> tz = userTimeZone(db, user_id);
+    Timestamp now = nowUtc();
+
+    Day day = tz->dayAt(now);
+    if (meal->date) parseDate(*meal->date, day);
+    char date[DATE_BUF_SIZE];
+    char created_at[DATETIME_BUF_SIZE];
+    formatDate(day, date);
+    tz->formatLocal(now, created_at);
+
+    int meal_id = 0;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db,
+            "INSERT INTO nutrition (user_id, date, meal_type, meal_name, calories, protein, created_at, day) VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+            -1, &stmt, nullptr);
 
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db,
-        "INSERT INTO nutrition (user_id, date, meal_type, meal_name, calories, protein, created_at) VALUES (?, ?, ?, ?, ?, ?, ?)",
-        -1, &stmt, nullptr);
-    
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, meal_type.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, meal_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 5, calories);
-    sqlite3_bind_double(stmt, 6, protein);
-    sqlite3_bind_text(stmt, 7, created_at.c_str(), -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        const char* err = sqlite3_errmsg(db);
-        CROW_LOG_ERROR << "DB Insert error: " << err;
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_text(stmt, 2, date, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, meal->meal_type.data(), meal->meal_type.size(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, meal->meal_name.data(), meal->meal_name.size(), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 5, meal->calories);
+        sqlite3_bind_double(stmt, 6, meal->protein);
+        sqlite3_bind_text(stmt, 7, created_at, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 8, day.value);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            CROW_LOG_ERROR << "DB Insert error: " << sqlite3_errmsg(db);
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        meal_id = sqlite3_last_insert_rowid(db);
         sqlite3_finalize(stmt);
-        return crow::response(500, "Database insert failed");
-    }
 
-    int meal_id = sqlite3_last_insert_rowid(db);
-    sqlite3_finalize(stmt);
+        return recordActivity(db, {ScoreKind::Meal, user_id, meal_id});
+    });
+    if (!ok) return crow::response(500, "Database insert failed");
+
+    publishChange(ChangeEntity::Meal, ChangeOp::Insert, user_id, meal_id);
 
-    return crow::response(201, "{\"meal_id\":" + std::to_string(meal_id) + "}");
+    return JsonWriter().beginObject().field("meal_id", meal_id).endObject().response(201);
 }
 
 
-crow::response getMeals(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date) {
+crow::response getMeals(FitnessApp& app, sqlite3* db, int user_id, const std::string& date) {
+    Day day;
+    if (!parseUserDay(db, user_id, date, day)) {
+        return crow::response(400, "Invalid date, expected YYYY-MM-DD");
+    }
+
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db,
         "SELECT id, meal_type, meal_name, calories, protein, created_at "
-        "FROM nutrition WHERE user_id=? AND date=? ORDER BY created_at DESC",
+        "FROM nutrition WHERE user_id=? AND day=? ORDER BY created_at DESC",
         -1, &stmt, nullptr);
 
     sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, day.value);
 
-    std::vector<crow::json::wvalue> meal_list;
+    JsonWriter json;
+    json.beginObject().key("meals").beginArray();
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        crow::json::wvalue meal;
-        meal["id"] = sqlite3_column_int(stmt, 0);
-        meal["meal_type"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        meal["meal_name"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        meal["calories"] = sqlite3_column_int(stmt, 3);
-        meal["protein"] = sqlite3_column_double(stmt, 4);
-        meal["created_at"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        meal_list.push_back(std::move(meal));
+        json.beginObject()
+            .field("id", sqlite3_column_int(stmt, 0))
+            .field("meal_type", columnText(stmt, 1))
+            .field("meal_name", columnText(stmt, 2))
+            .field("calories", sqlite3_column_int(stmt, 3))
+            .field("protein", sqlite3_column_double(stmt, 4))
+            .field("created_at", columnText(stmt, 5))
+            .endObject();
     }
     sqlite3_finalize(stmt);
 
-    crow::json::wvalue result;
-    result["meals"] = std::move(meal_list);
-    return crow::response(result);
+    json.endArray().endObject();
+    return json.response();
 }
 
 
 
 
-crow::response deleteMeal(crow::SimpleApp&, sqlite3* db, int meal_id) {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "DELETE FROM nutrition WHERE id=?", -1, &stmt, nullptr);
-    sqlite3_bind_int(stmt, 1, meal_id);
+crow::response deleteMeal(FitnessApp&, sqlite3* db, int meal_id) {
+    int owner_id = 0;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "DELETE FROM nutrition WHERE id=? RETURNING user_id", -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, meal_id);
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            owner_id = sqlite3_column_int(stmt, 0);
+            rc = sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
 
-    return ok ? crow::response(200, "Deleted") : crow::response(500, "Failed");
-}
+        return rc == SQLITE_DONE && retractActivity(db, ScoreKind::Meal, meal_id);
+    });
 
-crow::response updateMeal(crow::SimpleApp& app, sqlite3* db, int meal_id, const crow::request& req) {
-    auto data = crow::json::load(req.body);
-    if (!data) return crow::response(400, "Invalid JSON");
+    if (ok && owner_id) publishChange(ChangeEntity::Meal, ChangeOp::Delete, owner_id, meal_id);
 
-    std::string error;
-    if (!validateMealData(data, error)) return crow::response(400, error);
+    return ok ? crow::response(200, "Deleted") : crow::response(500, "Failed");
+}
 
-    std::string meal_type = data["meal_type"].s();
-    std::string meal_name = data["meal_name"].s();
-    int calories = data["calories"].i();
-    double protein = data.has("protein") ? data["protein"].d() : 0.0;
+crow::response updateMeal(FitnessApp& app, sqlite3* db, int meal_id, const crow::request& req) {
+    auto meal = MEAL_SCHEMA.parse(req.body);
+    if (!meal) return crow::response(400, meal.error());
 
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db,
-        "UPDATE nutrition SET meal_type=?, meal_name=?, calories=?, protein=? WHERE id=?",
+        "UPDATE nutrition SET meal_type=?, meal_name=?, calories=?, protein=? WHERE id=? RETURNING user_id",
         -1, &stmt, nullptr);
 
-    sqlite3_bind_text(stmt, 1, meal_type.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, meal_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, calories);
-    sqlite3_bind_double(stmt, 4, protein);
+    sqlite3_bind_text(stmt, 1, meal->meal_type.data(), meal->meal_type.size(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, meal->meal_name.data(), meal->meal_name.size(), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, meal->calories);
+    sqlite3_bind_double(stmt, 4, meal->protein);
     sqlite3_bind_int(stmt, 5, meal_id);
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    int rc = sqlite3_step(stmt);
+    int owner_id = 0;
+    if (rc == SQLITE_ROW) {
+        owner_id = sqlite3_column_int(stmt, 0);
+        rc = sqlite3_step(stmt);
+    }
+    bool ok = rc == SQLITE_DONE;
     sqlite3_finalize(stmt);
 
+    if (ok && owner_id) publishChange(ChangeEntity::Meal, ChangeOp::Update, owner_id, meal_id);
+
     return ok ? crow::response(200, "Updated") : crow::response(500, "Update failed");
 }
 
 
-crow::response clearDayMeals(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date) {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db,
-        "DELETE FROM nutrition WHERE user_id=? AND date=?",
-        -1, &stmt, nullptr);
+crow::response clearDayMeals(FitnessApp& app, sqlite3* db, int user_id, const std::string& date) {
+    Day day;
+    if (!parseUserDay(db, user_id, date, day)) {
+        return crow::response(400, "Invalid date, expected YYYY-MM-DD");
+    }
 
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
+    // The rows and their points go in one transaction
+    std::vector<int64_t> meal_ids;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "DELETE FROM nutrition WHERE user_id=? AND day=? RETURNING id", -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_int(stmt, 2, day.value);
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            meal_ids.push_back(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) return false;
+
+        for (int64_t meal_id : meal_ids) {
+            if (!retractActivity(db, ScoreKind::Meal, meal_id)) return false;
+        }
+        return true;
+    });
+
+    if (ok) {
+        for (int64_t meal_id : meal_ids) publishChange(ChangeEntity::Meal, ChangeOp::Delete, user_id, meal_id);
+    }
 
     return ok ? crow::response(200, "Cleared") : crow::response(500, "Failed to clear meals");
 }
@@ -277,23 +355,23 @@ crow::response clearDayMeals(crow::SimpleApp& app, sqlite3* db, int user_id, con
 //     return false;
 // }
 
-bool validateGoalsData(const crow::json::rvalue &data, std::string &error)
-{
-    return false;
-}
+crow::response getDailySummary(FitnessApp& app, sqlite3* db, int user_id, const std::string& date) {
+    Day day;
+    if (!parseUserDay(db, user_id, date, day)) {
+        return crow::response(400, "Invalid date, expected YYYY-MM-DD");
+    }
 
-crow::response getDailySummary(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date) {
     sqlite3_stmt* stmt;
     sqlite3_prepare_v2(db,
         "SELECT SUM(calories) as total_calories, SUM(protein) as total_protein "
-        "FROM nutrition WHERE user_id=? AND date=?",
+        "FROM nutrition WHERE user_id=? AND day=?",
         -1, &stmt, nullptr);
 
     sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, day.value);
 
     crow::json::wvalue result;
-    result["date"] = date;
+    result["date"] = toDateString(day);
     result["total_calories"] = 0;
     result["total_protein"] = 0.0;
 
@@ -306,33 +384,37 @@ crow::response getDailySummary(crow::SimpleApp& app, sqlite3* db, int user_id, c
     return crow::response(result);
 }
 
-crow::response getWeeklySummary(crow::SimpleApp& app, sqlite3* db, int user_id) {
-    std::vector<crow::json::wvalue> weekly_data;
+crow::response getWeeklySummary(FitnessApp& app, sqlite3* db, int user_id) {
+    // Last 7 days in the user's timezone, one range scan on (user_id, day)
+    Day today = todayForUser(db, user_id);
+    Day first = today - 6;
 
-    // Get last 7 days of data
-    for (int i = 6; i >= 0; i--) {
-        std::string date = getDateNDaysAgo(i);
-        
-        sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(db,
-            "SELECT SUM(calories) as total_calories, SUM(protein) as total_protein "
-            "FROM nutrition WHERE user_id=? AND date=?",
-            -1, &stmt, nullptr);
+    int calories[7] = {0};
+    double protein[7] = {0};
 
-        sqlite3_bind_int(stmt, 1, user_id);
-        sqlite3_bind_text(stmt, 2, date.c_str(), -1, SQLITE_STATIC);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db,
+        "SELECT day, SUM(calories) as total_calories, SUM(protein) as total_protein "
+        "FROM nutrition WHERE user_id=? AND day BETWEEN ? AND ? GROUP BY day",
+        -1, &stmt, nullptr);
 
-        crow::json::wvalue day_summary;
-        day_summary["date"] = date;
-        day_summary["total_calories"] = 0;
-        day_summary["total_protein"] = 0.0;
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, first.value);
+    sqlite3_bind_int(stmt, 3, today.value);
 
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            day_summary["total_calories"] = sqlite3_column_int(stmt, 0);
-            day_summary["total_protein"] = sqlite3_column_double(stmt, 1);
-        }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int offset = sqlite3_column_int(stmt, 0) - first.value;
+        calories[offset] = sqlite3_column_int(stmt, 1);
+        protein[offset] = sqlite3_column_double(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
 
-        sqlite3_finalize(stmt);
+    std::vector<crow::json::wvalue> weekly_data;
+    for (int i = 0; i < 7; i++) {
+        crow::json::wvalue day_summary;
+        day_summary["date"] = toDateString(first + i);
+        day_summary["total_calories"] = calories[i];
+        day_summary["total_protein"] = protein[i];
         weekly_data.push_back(std::move(day_summary));
     }
 
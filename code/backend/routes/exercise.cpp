@@ -1,12 +1,68 @@
 #include "crow.h"
 #include "exercise.h"
+#include "../timeZone.h"
+#include "../scoreEngine.h"
+#include "../eventBus.h"
+#include "../dto.h"
+#include "../jsonWriter.h"
+#include <limits>
+
+namespace {
+    struct ExerciseDto {
+        int id = 0;
+        std::string_view date;
+        std::string_view type;
+        int sets = 0;
+        int reps = 0;
+        double weight = -1.0;      // -1 = not recorded
+        int duration = -1;         // minutes, -1 = not recorded
+        std::string_view notes;
+        int session_id = 0;
+    };
+
+    constexpr int MAX_ID = std::numeric_limits<int>::max();
+    constexpr auto EXERCISE_DATE = dto::required("date", &ExerciseDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD");
+    constexpr auto EXERCISE_TYPE = dto::required("type", &ExerciseDto::type).length(1, 100);
+    constexpr auto EXERCISE_SETS = dto::optional("sets", &ExerciseDto::sets).range(0, 1000);
+    constexpr auto EXERCISE_REPS = dto::optional("reps", &ExerciseDto::reps).range(0, 10000);
+    constexpr auto EXERCISE_WEIGHT = dto::optional("weight", &ExerciseDto::weight).range(-1, 10000);
+    constexpr auto EXERCISE_DURATION = dto::optional("duration", &ExerciseDto::duration).range(-1, 24 * 60);
+    constexpr auto EXERCISE_NOTES = dto::optional("notes", &ExerciseDto::notes).length(0, 2000);
+    constexpr auto EXERCISE_SESSION = dto::optional("session_id", &ExerciseDto::session_id).range(0, MAX_ID);
+
+    constexpr auto EXERCISE_SCHEMA = dto::schema<ExerciseDto>(
+        EXERCISE_DATE, EXERCISE_TYPE, EXERCISE_SETS, EXERCISE_REPS, EXERCISE_WEIGHT,
+        EXERCISE_DURATION, EXERCISE_NOTES, EXERCISE_SESSION);
+
+    // PUT carries the row id in the body
+    constexpr auto EXERCISE_UPDATE_SCHEMA = dto::schema<ExerciseDto>(
+        dto::required("id", &ExerciseDto::id).range(1, MAX_ID),
+        EXERCISE_DATE, EXERCISE_TYPE, EXERCISE_SETS, EXERCISE_REPS, EXERCISE_WEIGHT,
+        EXERCISE_DURATION, EXERCISE_NOTES, EXERCISE_SESSION);
+
+    Exercise toExercise(const ExerciseDto& dto, int user_id)
+    {
+        Exercise e;
+        e.id = dto.id;
+        e.user_id = user_id;
+        e.date = dto.date;
+        e.type = dto.type;
+        e.sets = dto.sets;
+        e.reps = dto.reps;
+        e.weight = dto.weight;
+        e.duration = dto.duration;
+        e.notes = dto.notes;
+        e.session_id = dto.session_id;
+        return e;
+    }
+}
 
 bool addExercise(sqlite3 *db, const Exercise &e)
 {
     // Prepare SQL statement for inserting a new exercise
     const char *sql = R"(
-        INSERT INTO exercises (user_id, date, type, sets, reps, weight, duration, session_id, notes)
-        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);
+        INSERT INTO exercises (user_id, date, type, sets, reps, weight, duration, session_id, notes, day)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);
     )";
 
     sqlite3_stmt *stmt;
@@ -27,29 +83,67 @@ bool addExercise(sqlite3 *db, const Exercise &e)
     sqlite3_bind_int(stmt, 7, e.duration);
     sqlite3_bind_int(stmt, 8, e.session_id);
     sqlite3_bind_text(stmt, 9, e.notes.c_str(), -1, SQLITE_STATIC);
+    Day day;
+    if (parseDate(e.date, day))
+        sqlite3_bind_int(stmt, 10, day.value);
+    else
+        sqlite3_bind_null(stmt, 10);
+
+    // Execute the statement; the row and its points commit together
+    int64_t exercise_id = 0;
+    bool success = inTransaction(db, [&] {
+        bool inserted = (sqlite3_step(stmt) == SQLITE_DONE);
+        if (!inserted)
+        {
+            std::string err = sqlite3_errmsg(db);
+            std::cerr << "Failed to add workout: " << err << std::endl;
+            std::cerr.flush();
 
-    // Execute the statement
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    if (!success) 
-    {
-        std::string err = sqlite3_errmsg(db);
-        std::cerr << "Failed to add workout: " << err << std::endl;
-        std::cerr.flush();
-
-        // Also print to Crow log so you always see it:
-        CROW_LOG_ERROR << "SQLite error: " << err;
-    }
+            // Also print to Crow log so you always see it:
+            CROW_LOG_ERROR << "SQLite error: " << err;
+            return false;
+        }
+        exercise_id = sqlite3_last_insert_rowid(db);
+        return recordActivity(db, {ScoreKind::Exercise, e.user_id, exercise_id, static_cast<double>(e.duration)});
+    });
 
     // Finalize the statement to release resources
     sqlite3_finalize(stmt);
 
+    if (success)
+        publishChange(ChangeEntity::Exercise, ChangeOp::Insert, e.user_id, exercise_id);
     return success;
 }
 
-std::vector<Exercise> getUserExercises(sqlite3 *db, int user_id)
-{
-    std::vector<Exercise> exercises;
+namespace {
+    // Enough for a typical list; longer ones grow inside the arena
+    constexpr std::size_t EXPECTED_ROWS = 64;
+
+    // Steps `stmt` (columns as selected below) to the end; finalizes it
+    std::pmr::vector<Exercise> readExercises(sqlite3_stmt *stmt, std::pmr::memory_resource *arena)
+    {
+        std::pmr::vector<Exercise> exercises(arena);
+        exercises.reserve(EXPECTED_ROWS);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            Exercise& e = exercises.emplace_back(arena);
+            e.id = sqlite3_column_int(stmt, 0);
+            e.user_id = sqlite3_column_int(stmt, 1);
+            e.date = columnText(stmt, 2);
+            e.type = columnText(stmt, 3);
+            e.sets = sqlite3_column_int(stmt, 4);
+            e.reps = sqlite3_column_int(stmt, 5);
+            e.weight = sqlite3_column_double(stmt, 6);
+            e.duration = sqlite3_column_int(stmt, 7);
+            e.session_id = sqlite3_column_int(stmt, 8);
+            e.notes = columnText(stmt, 9);
+        }
+        sqlite3_finalize(stmt);
+        return exercises;
+    }
+}
 
+std::pmr::vector<Exercise> getUserExercises(sqlite3 *db, int user_id, std::pmr::memory_resource *arena)
+{
     // Prepare statement
     const char *sql = R"(
         SELECT id, user_id, date, type, sets, reps, weight, duration, session_id, notes
@@ -57,120 +151,52 @@ std::vector<Exercise> getUserExercises(sqlite3 *db, int user_id)
         WHERE user_id = ?
         ORDER BY date DESC;
     )";
-
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return exercises;
+        return std::pmr::vector<Exercise>(arena);
     }
 
     // Bind user_id parameter
     sqlite3_bind_int(stmt, 1, user_id);
-
-    // execute the statement for all such exercises, set values
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Exercise e;
-        e.id = sqlite3_column_int(stmt, 0);
-        e.user_id = sqlite3_column_int(stmt, 1);
-        const unsigned char* date = sqlite3_column_text(stmt, 2);
-        e.date = date ? reinterpret_cast<const char*>(date) : "";
-        const unsigned char* type = sqlite3_column_text(stmt, 3);
-        e.type = type ? reinterpret_cast<const char*>(type) : "";
-        e.sets = sqlite3_column_int(stmt, 4);
-        e.reps = sqlite3_column_int(stmt, 5);
-        e.weight = sqlite3_column_double(stmt, 6);
-        e.duration = sqlite3_column_int(stmt, 7);
-        e.session_id = sqlite3_column_int(stmt, 8);
-        const unsigned char* notes = sqlite3_column_text(stmt, 9);
-        e.notes = notes ? reinterpret_cast<const char*>(notes) : "";
-        exercises.push_back(e);
-    }
-
-    sqlite3_finalize(stmt);
-    return exercises;
+    return readExercises(stmt, arena);
 }
 
-std::vector<Exercise> getExercisesBySession(sqlite3 *db, int session_id)
+std::pmr::vector<Exercise> getExercisesBySession(sqlite3 *db, int session_id, std::pmr::memory_resource *arena)
 {
-    std::vector<Exercise> exercises;
-
     const char *sql = R"(
         SELECT id, user_id, date, type, sets, reps, weight, duration, session_id, notes
         FROM exercises
         WHERE session_id = ?
         ORDER BY date DESC;
     )";
-
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return exercises;
+        return std::pmr::vector<Exercise>(arena);
     }
 
     sqlite3_bind_int(stmt, 1, session_id);
-
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Exercise e;
-        e.id = sqlite3_column_int(stmt, 0);
-        e.user_id = sqlite3_column_int(stmt, 1);
-        const unsigned char* date = sqlite3_column_text(stmt, 2);
-        e.date = date ? reinterpret_cast<const char*>(date) : "";
-        const unsigned char* type = sqlite3_column_text(stmt, 3);
-        e.type = type ? reinterpret_cast<const char*>(type) : "";
-        e.sets = sqlite3_column_int(stmt, 4);
-        e.reps = sqlite3_column_int(stmt, 5);
-        e.weight = sqlite3_column_double(stmt, 6);
-        e.duration = sqlite3_column_int(stmt, 7);
-        e.session_id = sqlite3_column_int(stmt, 8);
-        const unsigned char* notes = sqlite3_column_text(stmt, 9);
-        e.notes = notes ? reinterpret_cast<const char*>(notes) : "";
-        exercises.push_back(e);
-    }
-
-    sqlite3_finalize(stmt);
-    return exercises;
+    return readExercises(stmt, arena);
 }
 
-std::vector<Exercise> getUserExercisesByDate(sqlite3 *db, int user_id, const std::string &startDate, const std::string &endDate)
+std::pmr::vector<Exercise> getUserExercisesByDate(sqlite3 *db, int user_id, Day startDay, Day endDay,
+                                                  std::pmr::memory_resource *arena)
 {
-    std::vector<Exercise> exercises;
-
     const char *sql = R"(
         SELECT id, user_id, date, type, sets, reps, weight, duration, session_id, notes
         FROM exercises
-        WHERE user_id = ? AND date BETWEEN ? AND ?
-        ORDER BY date DESC, id DESC;
+        WHERE user_id = ? AND day BETWEEN ? AND ?
+        ORDER BY day DESC, id DESC;
     )";
-
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return exercises;
+        return std::pmr::vector<Exercise>(arena);
     }
 
     // Bind parameters
     sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, startDate.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, endDate.c_str(), -1, SQLITE_STATIC);
-
-    // Execute the statement and populate the vector
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Exercise e;
-        e.id = sqlite3_column_int(stmt, 0);
-        e.user_id = sqlite3_column_int(stmt, 1);
-        const unsigned char* text = sqlite3_column_text(stmt, 2);
-        e.date = text ? reinterpret_cast<const char*>(text) : "";
-        const unsigned char* type = sqlite3_column_text(stmt, 3);
-        e.type = type ? reinterpret_cast<const char*>(type) : "";
-        e.sets = sqlite3_column_int(stmt, 4);
-        e.reps = sqlite3_column_int(stmt, 5);
-        e.weight = sqlite3_column_double(stmt, 6);
-        e.duration = sqlite3_column_int(stmt, 7);
-        e.session_id = sqlite3_column_int(stmt, 8);
-        const unsigned char* notes = sqlite3_column_text(stmt, 9);
-        e.notes = notes ? reinterpret_cast<const char*>(notes) : "";
-        exercises.push_back(e);
-    }
-
-    sqlite3_finalize(stmt);
-    return exercises;
+    sqlite3_bind_int(stmt, 2, startDay.value);
+    sqlite3_bind_int(stmt, 3, endDay.value);
+    return readExercises(stmt, arena);
 }
 
 bool deleteExercise(sqlite3 *db, int exercise_id, int user_id)
@@ -188,12 +214,19 @@ bool deleteExercise(sqlite3 *db, int exercise_id, int user_id)
     sqlite3_bind_int(stmt, 1, exercise_id);
     sqlite3_bind_int(stmt, 2, user_id);
 
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    if (!success) {
-        std::cerr << "Failed to delete exercise: " << sqlite3_errmsg(db) << std::endl;
-    }
+    bool deleted = false;
+    bool success = inTransaction(db, [&] {
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Failed to delete exercise: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        deleted = sqlite3_changes(db) > 0;
+        return !deleted || retractActivity(db, ScoreKind::Exercise, exercise_id);
+    });
 
     sqlite3_finalize(stmt);
+    if (success && deleted)
+        publishChange(ChangeEntity::Exercise, ChangeOp::Delete, user_id, exercise_id);
     return success;
 }
 
@@ -201,7 +234,7 @@ bool updateExercise(sqlite3 *db, const Exercise &e)
 {
     const char *sql = R"(
         UPDATE exercises
-        SET date = ?, type = ?, sets = ?, reps = ?, weight = ?, duration = ?, session_id = ?, notes = ?
+        SET date = ?, type = ?, sets = ?, reps = ?, weight = ?, duration = ?, session_id = ?, notes = ?, day = ?
         WHERE id = ? AND user_id = ?;
     )";
 
@@ -219,22 +252,35 @@ bool updateExercise(sqlite3 *db, const Exercise &e)
     sqlite3_bind_int(stmt, 6, e.duration);
     sqlite3_bind_int(stmt, 7, e.session_id);
     sqlite3_bind_text(stmt, 8, e.notes.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 9, e.id);
-    sqlite3_bind_int(stmt, 10, e.user_id);
-
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    if (!success) {
-        std::cerr << "Failed to update exercise: " << sqlite3_errmsg(db) << std::endl;
-    }
+    Day day;
+    if (parseDate(e.date, day))
+        sqlite3_bind_int(stmt, 9, day.value);
+    else
+        sqlite3_bind_null(stmt, 9);
+    sqlite3_bind_int(stmt, 10, e.id);
+    sqlite3_bind_int(stmt, 11, e.user_id);
+
+    bool updated = false;
+    bool success = inTransaction(db, [&] {
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Failed to update exercise: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        // re-score with the new duration
+        updated = sqlite3_changes(db) > 0;
+        return !updated || recordActivity(db, {ScoreKind::Exercise, e.user_id, e.id, static_cast<double>(e.duration)});
+    });
 
     sqlite3_finalize(stmt);
+    if (success && updated)
+        publishChange(ChangeEntity::Exercise, ChangeOp::Update, e.user_id, e.id);
     return success;
 }
 
-void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
+void registerExerciseRoutes(FitnessApp& app, ShardRouter& shards)
 {
     // --- Add Exercise ---
-    CROW_ROUTE(app, "/api/exercises").methods("POST"_method)([db](const crow::request& req)
+    CROW_ROUTE(app, "/api/exercises").methods("POST"_method)([&shards](const crow::request& req)
     {
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
@@ -244,24 +290,13 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
         }
         int user_id = std::stoi(user_id_str);
 
-        auto body = crow::json::load(req.body);
+        // Parsed before taking the writer, so a bad body never holds it
+        auto body = EXERCISE_SCHEMA.parse(req.body);
         if (!body)
-            return makeError(400, "Invalid JSON");
-
-        if (!body.has("date") || !body.has("type"))
-            return makeError(400, "Missing required fields");
-
-        Exercise e;
-        e.user_id = user_id;
-        e.date = body["date"].s();
-        e.type = body["type"].s();
-        e.sets = body.has("sets") ? body["sets"].i() : 0;
-        e.reps = body.has("reps") ? body["reps"].i() : 0;
-        e.weight = body.has("weight") ? body["weight"].d() : -1.0;
-        e.duration = body.has("duration") ? body["duration"].i() : -1;
-        e.notes = body.has("notes") ? body["notes"].s() : std::string("");
-        e.session_id = body.has("session_id") ? body["session_id"].i() : 0;
+            return makeError(400, body.error());
 
+        Exercise e = toExercise(*body, user_id);
+        auto db = shards.forUser(user_id).write();
         if (addExercise(db, e))
             return crow::response(201, crow::json::wvalue{{"message", "Exercise added successfully"}});
         else
@@ -269,7 +304,7 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
     });
 
     // --- Get Exercises ---
-    CROW_ROUTE(app, "/api/exercises").methods("GET"_method)([db](const crow::request& req)
+    CROW_ROUTE(app, "/api/exercises").methods("GET"_method)([&shards](const crow::request& req)
     {
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
@@ -278,9 +313,10 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
             return makeError(401, "Unauthorized: missing login cookie");
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
 
         const char* session_id_str = req.url_params.get("session_id");
-        std::vector<Exercise> exercises;
+        std::pmr::vector<Exercise> exercises(requestArena());
 
         if (session_id_str)
         {
@@ -292,37 +328,39 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
             const char* start_str = req.url_params.get("start");
             const char* end_str   = req.url_params.get("end");
             if (start_str && end_str)
-                exercises = getUserExercisesByDate(db, user_id, start_str, end_str);
+            {
+                Day startDay, endDay;
+                if (!parseUserDay(db, user_id, start_str, startDay) || !parseUserDay(db, user_id, end_str, endDay))
+                    return makeError(400, "Invalid date, expected YYYY-MM-DD");
+                exercises = getUserExercisesByDate(db, user_id, startDay, endDay);
+            }
             else
                 exercises = getUserExercises(db, user_id);
         }
 
-        crow::json::wvalue res;
-        crow::json::wvalue::list arr;
-
+        JsonWriter json(exercises.size() * 160 + 32);   // ~160 bytes a row
+        json.beginObject().key("exercises").beginArray();
         for (const auto& e : exercises)
         {
-            crow::json::wvalue item;
-            item["id"] = e.id;
-            item["user_id"] = e.user_id;
-            item["date"] = e.date;
-            item["type"] = e.type;
-            item["sets"] = e.sets;
-            item["reps"] = e.reps;
-            item["weight"] = e.weight;
-            item["duration"] = e.duration;
-            item["notes"] = e.notes;
-            item["session_id"] = e.session_id;
-
-            arr.push_back(std::move(item));
+            json.beginObject()
+                .field("id", e.id)
+                .field("user_id", e.user_id)
+                .field("date", e.date)
+                .field("type", e.type)
+                .field("sets", e.sets)
+                .field("reps", e.reps)
+                .field("weight", e.weight)
+                .field("duration", e.duration)
+                .field("notes", e.notes)
+                .field("session_id", e.session_id)
+                .endObject();
         }
-
-        res["exercises"] = std::move(arr);
-        return crow::response(200, res);
+        json.endArray().endObject();
+        return json.response();
     });
 
     // --- Update Exercise ---
-    CROW_ROUTE(app, "/api/exercises").methods("PUT"_method)([db](const crow::request& req)
+    CROW_ROUTE(app, "/api/exercises").methods("PUT"_method)([&shards](const crow::request& req)
     {
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
@@ -332,25 +370,12 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
         }
         int user_id = std::stoi(user_id_str);
 
-        auto body = crow::json::load(req.body);
+        auto body = EXERCISE_UPDATE_SCHEMA.parse(req.body);
         if (!body)
-            return makeError(400, "Invalid JSON");
-
-        if (!body.has("id") || !body.has("date") || !body.has("type"))
-            return makeError(400, "Missing required fields");
-
-        Exercise e;
-        e.id = body["id"].i();
-        e.user_id = user_id;
-        e.date = body["date"].s();
-        e.type = body["type"].s();
-        e.sets = body.has("sets") ? body["sets"].i() : 0;
-        e.reps = body.has("reps") ? body["reps"].i() : 0;
-        e.weight = body.has("weight") ? body["weight"].d() : -1.0;
-        e.duration = body.has("duration") ? body["duration"].i() : -1;
-        e.notes = body.has("notes") ? body["notes"].s() : std::string("");
-        e.session_id = body.has("session_id") ? body["session_id"].i() : 0;
+            return makeError(400, body.error());
 
+        Exercise e = toExercise(*body, user_id);
+        auto db = shards.forUser(user_id).write();
         if (updateExercise(db, e))
             return crow::response(200, crow::json::wvalue{{"message", "Exercise updated successfully"}});
         else
@@ -359,7 +384,7 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
 
     // --- Delete Exercise ---
     CROW_ROUTE(app, "/api/exercises/<int>").methods("DELETE"_method)(
-    [db](const crow::request& req, int exercise_id)
+    [&shards](const crow::request& req, int exercise_id)
     {
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
@@ -368,6 +393,7 @@ void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db)
             return makeError(401, "Unauthorized: missing login cookie");
         }
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).write();
 
         if (deleteExercise(db, exercise_id, user_id))
             return crow::response(200, crow::json::wvalue{{"message", "Exercise deleted successfully"}});
@@ -5,35 +5,46 @@
 #include <iostream>
 #include "hash.h"
 #include "../helper.h"
+#include "../dateTime.h"
 #include <vector>
+#include <memory_resource>
 #include <sqlite3.h>
+#include "../admissionControl.h"
+#include "../shardRouter.h"
 
 using namespace std;
 
 struct Exercise {
-    int id;              // Primary key
-    int user_id;         // Foreign key to users table
-    int session_id;     // Foreign key to sessions table
-    std::string date;    // ISO format "YYYY-MM-DD"
-    std::string type;    // Exercise type (e.g., "Bench Press", "Running")
-    int sets;            // Optional (can be 0 for cardio)
-    int reps;            // Optional
+    // Strings live in `arena`; the row readers pass the request arena
+    explicit Exercise(std::pmr::memory_resource* arena = std::pmr::get_default_resource())
+        : date(arena), type(arena), notes(arena) {}
+
+    int id = 0;              // Primary key
+    int user_id = 0;         // Foreign key to users table
+    int session_id = 0;      // Foreign key to sessions table
+    std::pmr::string date;   // ISO format "YYYY-MM-DD"
+    std::pmr::string type;   // Exercise type (e.g., "Bench Press", "Running")
+    int sets = 0;            // Optional (can be 0 for cardio)
+    int reps = 0;            // Optional
     double weight = -1;       // Optional (in kg or lbs)
     int duration = -1;        // Total duration (in minutes)
-    std::string notes;   // Optional comments
+    std::pmr::string notes;  // Optional comments
 };
 
 // Insert new exercise
 bool addExercise(sqlite3* db, const Exercise& w);
 
 // Get all exercises for a user
-std::vector<Exercise> getUserExercises(sqlite3* db, int user_id);
+std::pmr::vector<Exercise> getUserExercises(sqlite3* db, int user_id,
+                                            std::pmr::memory_resource* arena = requestArena());
 
 // Get exercises by session id
-std::vector<Exercise> getExercisesBySession(sqlite3* db, int session_id);
+std::pmr::vector<Exercise> getExercisesBySession(sqlite3* db, int session_id,
+                                                 std::pmr::memory_resource* arena = requestArena());
 
-// Get exercises filtered by date range (optional)
-std::vector<Exercise> getUserExercisesByDate(sqlite3* db, int user_id, const std::string& startDate, const std::string& endDate);
+// Get exercises filtered by day range, inclusive on both ends
+std::pmr::vector<Exercise> getUserExercisesByDate(sqlite3* db, int user_id, Day startDay, Day endDay,
+                                                  std::pmr::memory_resource* arena = requestArena());
 
 // Delete a specific exercise by ID
 bool deleteExercise(sqlite3* db, int exercise_id, int user_id);
@@ -41,6 +52,6 @@ bool deleteExercise(sqlite3* db, int exercise_id, int user_id);
 // Update existing exercise (optional)
 bool updateExercise(sqlite3* db, const Exercise& w);
 
-void registerExerciseRoutes(crow::SimpleApp& app, sqlite3* db);
+void registerExerciseRoutes(FitnessApp& app, ShardRouter& shards);
 
 
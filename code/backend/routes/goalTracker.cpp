@@ -2,31 +2,64 @@
 #include <sqlite3.h>
 #include "../goalTracker.h"
 #include "../helper.h"
+#include "../scoreEngine.h"
+#include "../eventBus.h"
+#include "../responseCache.h"
+#include "../dto.h"
 #include <vector>
 #include <ctime>
 #include <iostream>
 #include "helper.h"
 
-void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
+namespace {
+    bool isPositive(double value) { return value > 0; }
+    bool isDateOrEmpty(std::string_view s) { return s.empty() || dto::isDate(s); }
+
+    struct GoalDto {
+        std::string_view goal_name;
+        double target_value = 0.0;
+        std::string_view start_date;
+        std::string_view end_date;     // "" = open-ended
+    };
+
+    constexpr auto GOAL_SCHEMA = dto::schema<GoalDto>(
+        dto::required("goal_name", &GoalDto::goal_name).length(1, 100),
+        dto::required("target_value", &GoalDto::target_value).satisfies(isPositive, "must be greater than 0"),
+        dto::required("start_date", &GoalDto::start_date).satisfies(dto::isDate, "expected YYYY-MM-DD"),
+        dto::optional("end_date", &GoalDto::end_date).satisfies(isDateOrEmpty, "expected YYYY-MM-DD"));
+
+    struct GoalProgressDto {
+        int goal_id = 0;
+        double progress_value = 0.0;
+    };
+
+    constexpr auto GOAL_PROGRESS_SCHEMA = dto::schema<GoalProgressDto>(
+        dto::required("goal_id", &GoalProgressDto::goal_id).range(1, 2147483647),
+        dto::required("progress_value", &GoalProgressDto::progress_value).range(0, 1e9));
+}
+
+void setupGoalRoutes(FitnessApp& app, ShardRouter& shards) {
 
     // --- GET /goals/active ---
-    CROW_ROUTE(app, "/goals/active").methods("GET"_method)([db](const crow::request& req) {
+    CROW_ROUTE(app, "/goals/active").methods("GET"_method)([&shards](const crow::request& req) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
             return crow::response{401, "Unauthorized: missing login cookie"};
         }
         int user_id = std::stoi(user_id_str);
-        auto goals = getAllGoals(db, user_id, "active"); // now returns full Goal objects
-
-        crow::json::wvalue result;
-        std::vector<crow::json::wvalue> arr;
-
-        return crow::response(serializeGoals(goals, db));
+        Database& database = shards.forUser(user_id);
+
+        // Leased inside build(), after the cache has read its clock
+        return responseCache().serve(req, user_id, "goals/active", [&] {
+            auto db = database.read();
+            auto goals = getAllGoals(db, user_id, "active"); // now returns full Goal objects
+            return crow::response(serializeGoals(goals, db));
+        });
     });
 
     // --- Get /goals/completed ---
-    CROW_ROUTE(app, "/goals/completed").methods("GET"_method)([db](const crow::request& req) {
+    CROW_ROUTE(app, "/goals/completed").methods("GET"_method)([&shards](const crow::request& req) {
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
         if (user_id_str.empty()) {
@@ -34,16 +67,21 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
         }
 
         int user_id = std::stoi(user_id_str);
-        auto goals = getAllGoals(db, user_id, "completed"); // now returns full Goal objects
-
-        return crow::response(serializeGoals(goals, db));
+        Database& database = shards.forUser(user_id);
+
+        // Leased inside build(), after the cache has read its clock
+        return responseCache().serve(req, user_id, "goals/completed", [&] {
+            auto db = database.read();
+            auto goals = getAllGoals(db, user_id, "completed"); // now returns full Goal objects
+            return crow::response(serializeGoals(goals, db));
+        });
     });
 
     // --- POST /goals ---
-    CROW_ROUTE(app, "/goals").methods("POST"_method)([db](const crow::request& req) {
-        auto body = crow::json::load(req.body);
+    CROW_ROUTE(app, "/goals").methods("POST"_method)([&shards](const crow::request& req) {
+        auto body = GOAL_SCHEMA.parse(req.body);
         if (!body)
-            return makeError(400, "Invalid JSON");
+            return makeError(400, body.error());
 
         auto cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
@@ -52,27 +90,10 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
         }
 
         int user_id = std::stoi(user_id_str);
-        
-        std::string goal_name = "";
-        if (body.has("goal_name"))
-            goal_name = body["goal_name"].s();
-
-        double target_value = 0.0;
-        if (body.has("target_value"))
-            target_value = static_cast<double>(body["target_value"].d());
-
-        std::string start_date = "";
-        if (body.has("start_date"))
-            start_date = body["start_date"].s();
-
-        std::string end_date = "";
-        if (body.has("end_date"))
-            end_date = body["end_date"].s();
+        auto db = shards.forUser(user_id).write();
 
-        if (goal_name.empty() || start_date.empty() || target_value <= 0)
-            return makeError(400, "Missing required fields");
-
-        bool success = addGoal(db, user_id, goal_name, target_value, start_date, end_date);
+        bool success = addGoal(db, user_id, std::string(body->goal_name), body->target_value,
+                               std::string(body->start_date), std::string(body->end_date));
 
         if (success)
             return makeSuccess(201, "Goal added successfully");
@@ -82,18 +103,13 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
 
 
     // --- POST /goal-progress ---
-    CROW_ROUTE(app, "/goal-progress").methods("POST"_method)([db](const crow::request& req) {
-        auto body = crow::json::load(req.body);
+    CROW_ROUTE(app, "/goal-progress").methods("POST"_method)([&shards](const crow::request& req) {
+        auto body = GOAL_PROGRESS_SCHEMA.parse(req.body);
         if (!body)
-            return makeError(400, "Invalid JSON");
-
-        int goal_id = body.has("goal_id") ? body["goal_id"].i() : 0;
-        double progress_value = body.has("progress_value") ? body["progress_value"].d() : -1;
-
-        if (goal_id <= 0 || progress_value < 0)
-            return makeError(400, "Invalid goal or progress value");
+            return makeError(400, body.error());
 
-        bool success = addGoalProgress(db, goal_id, progress_value);
+        auto db = shards.forRow(body->goal_id).write();
+        bool success = addGoalProgress(db, body->goal_id, body->progress_value);
 
         if (success)
             return makeSuccess(201, "Progress added successfully");
@@ -102,17 +118,21 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
     });
 
     // PATCH /goals/toggle-complete/<goal_id>
-    CROW_ROUTE(app, "/goals/toggle-complete/<int>").methods("PATCH"_method)([db](int goal_id) {
+    CROW_ROUTE(app, "/goals/toggle-complete/<int>").methods("PATCH"_method)([&shards](int goal_id) {
+        auto db = shards.forRow(goal_id).write();
         // Get current status
         std::string status;
-        const char* selectSql = "SELECT status FROM goals WHERE id = ?;";
+        int owner_id = 0;
+        const char* selectSql = "SELECT status, user_id FROM goals WHERE id = ?;";
         sqlite3_stmt* selectStmt;
         if (sqlite3_prepare_v2(db, selectSql, -1, &selectStmt, nullptr) != SQLITE_OK)
             return makeError(500, "Database error");
 
         sqlite3_bind_int(selectStmt, 1, goal_id);
-        if (sqlite3_step(selectStmt) == SQLITE_ROW)
+        if (sqlite3_step(selectStmt) == SQLITE_ROW) {
             status = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 0));
+            owner_id = sqlite3_column_int(selectStmt, 1);
+        }
         sqlite3_finalize(selectStmt);
 
         // Toggle
@@ -125,26 +145,63 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
 
         sqlite3_bind_text(updateStmt, 1, newState.c_str(), -1, SQLITE_TRANSIENT);
         sqlite3_bind_int(updateStmt, 2, goal_id);
-        bool success = (sqlite3_step(updateStmt) == SQLITE_DONE);
+        bool success = inTransaction(db, [&] {
+            if (sqlite3_step(updateStmt) != SQLITE_DONE) return false;
+            if (!owner_id) return true;
+            return newState == "completed"
+                ? recordActivity(db, {ScoreKind::GoalCompleted, owner_id, goal_id})
+                : retractActivity(db, ScoreKind::GoalCompleted, goal_id);
+        });
         sqlite3_finalize(updateStmt);
 
+        if (success && owner_id)
+            publishChange(ChangeEntity::Goal, ChangeOp::Update, owner_id, goal_id);
+
         if (success)
             return makeSuccess(200, newState == "completed" ? "Goal marked complete" : "Goal marked incomplete");
         else
             return makeError(500, "Failed to toggle goal complete");
     });
 
-    CROW_ROUTE(app, "/goals/<int>").methods("DELETE"_method)([db](int goal_id) {
-        const char* sql = "DELETE FROM goals WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-
-            std::cerr << sqlite3_errmsg(db) << std::endl;
-            return makeError(500, "Database error");
-        }
-        sqlite3_bind_int(stmt, 1, goal_id);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
+    CROW_ROUTE(app, "/goals/<int>").methods("DELETE"_method)([&shards](int goal_id) {
+        auto db = shards.forRow(goal_id).write();
+        // Progress rows go with the goal (ON DELETE CASCADE), so note them first;
+        // the goal and every point it earned go in one transaction
+        int owner_id = 0;
+        bool success = inTransaction(db, [&] {
+            std::vector<int64_t> progress_ids;
+            sqlite3_stmt* progressStmt;
+            if (sqlite3_prepare_v2(db, "SELECT id FROM goal_progress WHERE goal_id = ?;", -1, &progressStmt, nullptr) != SQLITE_OK)
+                return false;
+            sqlite3_bind_int(progressStmt, 1, goal_id);
+            while (sqlite3_step(progressStmt) == SQLITE_ROW)
+                progress_ids.push_back(sqlite3_column_int64(progressStmt, 0));
+            sqlite3_finalize(progressStmt);
+
+            const char* sql = "DELETE FROM goals WHERE id = ? RETURNING user_id;";
+            sqlite3_stmt* stmt;
+            if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+                std::cerr << sqlite3_errmsg(db) << std::endl;
+                return false;
+            }
+            sqlite3_bind_int(stmt, 1, goal_id);
+            int rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW) {
+                owner_id = sqlite3_column_int(stmt, 0);
+                rc = sqlite3_step(stmt);
+            }
+            sqlite3_finalize(stmt);
+            if (rc != SQLITE_DONE) return false;
+
+            for (int64_t progress_id : progress_ids) {
+                if (!retractActivity(db, ScoreKind::GoalProgress, progress_id)) return false;
+            }
+            return retractActivity(db, ScoreKind::GoalCompleted, goal_id);
+        });
+
+        // Its progress rows went with it (ON DELETE CASCADE); one event covers them
+        if (success && owner_id)
+            publishChange(ChangeEntity::Goal, ChangeOp::Delete, owner_id, goal_id);
 
         if (success){
             return makeSuccess(200, "Goal deleted successfully");
@@ -154,17 +211,32 @@ void setupGoalRoutes(crow::SimpleApp& app, sqlite3* db) {
         }
     });
 
-    CROW_ROUTE(app, "/goals/<int>/complete").methods("POST"_method)([db](int goal_id) {
-        const char* sql = "UPDATE goals SET status = 'completed', updated_at = datetime('now') WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-        sqlite3_bind_int(stmt, 1, goal_id);
-        int rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-        if (rc == SQLITE_DONE)
+    CROW_ROUTE(app, "/goals/<int>/complete").methods("POST"_method)([&shards](int goal_id) {
+        auto db = shards.forRow(goal_id).write();
+        int owner_id = 0;
+        bool success = inTransaction(db, [&] {
+            const char* sql = "UPDATE goals SET status = 'completed', updated_at = datetime('now') WHERE id = ? RETURNING user_id;";
+            sqlite3_stmt* stmt;
+            sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+            sqlite3_bind_int(stmt, 1, goal_id);
+            int rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW) {
+                owner_id = sqlite3_column_int(stmt, 0);
+                rc = sqlite3_step(stmt);
+            }
+            sqlite3_finalize(stmt);
+
+            // Only a completion that was written earns its points
+            if (rc != SQLITE_DONE) return false;
+            return !owner_id || recordActivity(db, {ScoreKind::GoalCompleted, owner_id, goal_id});
+        });
+
+        if (success && owner_id)
+            publishChange(ChangeEntity::Goal, ChangeOp::Update, owner_id, goal_id);
+        if (success)
             return makeSuccess(200, "Goal marked as completed");
         else
-            return makeError(500, sqlite3_errmsg(db));
+            return makeError(500, "Failed to complete goal");
     });
 
 
@@ -0,0 +1,47 @@
+#include "health.h"
+#include "../helper.h"
+#include "../stats.h"
+#include <cstdlib>
+
+bool isOperatorRequest(const crow::request& req)
+{
+    const char* token = std::getenv("STATS_TOKEN");
+    if (token && *token) {
+        return req.get_header_value("Authorization") == std::string("Bearer ") + token;
+    }
+    const std::string& ip = req.remote_ip_address;
+    return ip == "127.0.0.1" || ip == "::1" || ip == "::ffff:127.0.0.1";
+}
+
+void setupHealthRoutes(FitnessApp& app, const Startup& startup, const Lifecycle& lifecycle)
+{
+    CROW_ROUTE(app, "/healthz")([]
+    {
+        crow::json::wvalue res;
+        res["status"] = "ok";
+        return crow::response(200, res);
+    });
+
+    CROW_ROUTE(app, "/readyz")([&startup, &lifecycle]
+    {
+        crow::json::wvalue res;
+        if (lifecycle.shuttingDown()) {
+            res["status"] = "draining";
+            return crow::response(503, res);
+        }
+        if (!startup.ready()) {
+            res["status"] = "starting";
+            return crow::response(503, res);
+        }
+        res["status"] = "ready";
+        return crow::response(200, res);
+    });
+
+    CROW_ROUTE(app, "/debug/stats")([](const crow::request& req)
+    {
+        if (!isOperatorRequest(req)) {
+            return makeError(403, "Forbidden");
+        }
+        return crow::response(200, statsRegistry().collect());
+    });
+}
@@ -0,0 +1,18 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <crow.h>
+#include "../admissionControl.h"
+#include "../lifecycle.h"
+#include "../startup.h"
+
+// /healthz: the process is up and answering (liveness).
+// /readyz: warm-ups finished and not shutting down (send traffic here).
+// /debug/stats: everything registered in statsRegistry(). With STATS_TOKEN set
+// it needs "Authorization: Bearer <token>"; without it, loopback clients only.
+void setupHealthRoutes(FitnessApp& app, const Startup& startup, const Lifecycle& lifecycle);
+
+// The /debug/stats check, shared by the other operator-only routes.
+bool isOperatorRequest(const crow::request& req);
+
+#endif
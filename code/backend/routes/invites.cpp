@@ -2,23 +2,15 @@
 #include <iostream>
 #include "helper.h"
 #include "invites.h"
+#include "userDirectory.h"
+#include "eventBus.h"
 
 using namespace std;
 
 bool userExists(sqlite3 *db, int userId)
 {
-    // Prepare SQL statement to check for user existence
-    const char *sql = "SELECT 1 FROM users WHERE id = ? LIMIT 1;";
-    sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
-    }
-
-    // Bind userId parameter and execute
-    sqlite3_bind_int(stmt, 1, userId);
-    bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
-    sqlite3_finalize(stmt);
-    return exists;
+    // served from the in-memory user directory, SQLite only on a miss
+    return userDirectory().byId(db, userId).has_value();
 }
 
 bool friendshipExists(sqlite3 *db, int userId1, int userId2)
@@ -244,30 +236,61 @@ bool createFriendship(sqlite3 *db, int userId1, int userId2)
 
 std::optional<std::string> getUsernameById(sqlite3 *db, int userId)
 {
-    // Prepare SQL statement to get username by user ID
-    const char *sql = "SELECT username FROM users WHERE id = ? LIMIT 1;";
-    sqlite3_stmt *stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    auto user = userDirectory().byId(db, userId);
+    if (!user) {
         return std::optional<std::string>();
     }
+    return std::optional<std::string>(user->username);
+}
 
-    // Bind userId parameter and execute
-    sqlite3_bind_int(stmt, 1, userId);
-    if (sqlite3_step(stmt) != SQLITE_ROW) {
+std::unordered_map<int, std::string> getUsernamesByIds(sqlite3 *db, const std::vector<int> &userIds)
+{
+    std::unordered_map<int, std::string> usernames;
+    std::vector<int> missing;
+
+    // Resolve everything the directory already knows against a single snapshot
+    auto snap = userDirectory().snapshot();
+    for (int id : userIds) {
+        if (usernames.count(id)) continue;
+        const UserDirectory::Entry *e = snap ? snap->findById(id) : nullptr;
+        if (e) {
+            usernames.emplace(id, std::string(e->username));
+        } else {
+            missing.push_back(id);
+        }
+    }
+
+    // Whatever is left goes to SQLite in chunks well under the bound-parameter limit
+    const std::size_t chunk = 500;
+    for (std::size_t start = 0; start < missing.size(); start += chunk) {
+        std::size_t count = std::min(chunk, missing.size() - start);
+        std::string sql = "SELECT id, username FROM users WHERE id IN (?";
+        for (std::size_t i = 1; i < count; ++i) sql += ",?";
+        sql += ");";
+
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            cerr << "Failed to prepare username lookup: " << sqlite3_errmsg(db) << endl;
+            break;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            sqlite3_bind_int(stmt, static_cast<int>(i + 1), missing[start + i]);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *uname = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            usernames.emplace(sqlite3_column_int(stmt, 0), uname ? uname : "");
+        }
         sqlite3_finalize(stmt);
-        return std::optional<std::string>();
     }
 
-    // Extract username from the result
-    std::string username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-    sqlite3_finalize(stmt);
-    return std::optional<std::string>(username);
+    return usernames;
 }
 
-void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
+void setupInviteRoutes(FitnessApp &app, Database& database)
 {
     // send friend request
-    CROW_ROUTE(app, "/api/friend-requests").methods("POST"_method)([db](const crow::request &req) {
+    CROW_ROUTE(app, "/api/friend-requests").methods("POST"_method)([&database](const crow::request &req) {
+        auto db = database.write();
         auto body = crow::json::load(req.body);
         if (!body || !body.has("receiver_id")) {
             return makeError(400, "Invalid JSON or missing receiver_id");
@@ -303,6 +326,7 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
         if (requestId == 0) {
             return makeError(500, "Failed to create friend request");
         }
+        publishChange(ChangeEntity::FriendRequest, ChangeOp::Insert, senderId, requestId, receiverId);
 
         crow::json::wvalue res;
         res["status"] = "success";
@@ -311,7 +335,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // get incoming friend requests
-    CROW_ROUTE(app, "/api/friend-requests/incoming").methods("GET"_method)([db](const crow::request &req) {
+    CROW_ROUTE(app, "/api/friend-requests/incoming").methods("GET"_method)([&database](const crow::request &req) {
+        auto db = database.read();
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
@@ -322,15 +347,23 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
 
         auto requests = getIncomingRequests(db, userId);
 
+        // Resolve every sender in one pass instead of one lookup per row
+        std::vector<int> senderIds;
+        senderIds.reserve(requests.size());
+        for (const auto &fr : requests) senderIds.push_back(fr.senderId);
+        auto usernames = getUsernamesByIds(db, senderIds);
+
         crow::json::wvalue res;
         crow::json::wvalue::list arr;
+        arr.reserve(requests.size());
 
         for (const auto &fr : requests) {
+            auto name = usernames.find(fr.senderId);
             crow::json::wvalue frJson;
             frJson["id"] = fr.id;
             frJson["sender_id"] = fr.senderId;
             frJson["receiver_id"] = fr.receiverId;
-            frJson["sender_username"] = getUsernameById(db, fr.senderId).value_or("");
+            frJson["sender_username"] = name != usernames.end() ? name->second : "";
             frJson["status"] = fr.status;
             frJson["created_at"] = fr.createdAt;
             arr.push_back(frJson);
@@ -342,7 +375,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // respond to friend request
-    CROW_ROUTE(app, "/api/friend-requests/<int>").methods("POST"_method)([db](const crow::request &req, int requestId) {
+    CROW_ROUTE(app, "/api/friend-requests/<int>").methods("POST"_method)([&database](const crow::request &req, int requestId) {
+        auto db = database.write();
 
         // extract request id from json body
         auto body = crow::json::load(req.body);
@@ -421,6 +455,10 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
         }
         sqlite3_finalize(updateStmt);
 
+        publishChange(ChangeEntity::FriendRequest, ChangeOp::Update, receiverId, requestId, senderId);
+        if (newStatus == "accepted")
+            publishChange(ChangeEntity::Friendship, ChangeOp::Insert, receiverId, 0, senderId);
+
         crow::json::wvalue res;
         res["status"] = "success";
         res["new_status"] = newStatus;
@@ -428,7 +466,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // get all friendships
-    CROW_ROUTE(app, "/api/friends").methods("GET"_method)([db](const crow::request &req) {
+    CROW_ROUTE(app, "/api/friends").methods("GET"_method)([&database](const crow::request &req) {
+        auto db = database.read();
         // Read user_id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
@@ -439,17 +478,23 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
 
         auto friendships = getFriendships(db, userId);
 
-        crow::json::wvalue res;
-        crow::json::wvalue::list arr;
-
+        // Determine every friend (the *other* user) and resolve their usernames together
+        std::vector<int> friendIds;
+        friendIds.reserve(friendships.size());
         for (const auto &f : friendships) {
+            friendIds.push_back((f.userId1 == userId) ? f.userId2 : f.userId1);
+        }
+        auto usernames = getUsernamesByIds(db, friendIds);
 
-            // Determine the friend (the *other* user)
-            int friendId = (f.userId1 == userId) ? f.userId2 : f.userId1;
+        crow::json::wvalue res;
+        crow::json::wvalue::list arr;
+        arr.reserve(friendships.size());
 
-            // Get username once
-            auto usernameOpt = getUsernameById(db, friendId);
-            std::string username = usernameOpt.has_value() ? *usernameOpt : "";
+        for (std::size_t i = 0; i < friendships.size(); ++i) {
+            const auto &f = friendships[i];
+            int friendId = friendIds[i];
+            auto name = usernames.find(friendId);
+            std::string username = name != usernames.end() ? name->second : "";
 
             crow::json::wvalue item;
             item["user_id"] = friendId;
@@ -464,7 +509,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // find friends by username across the platform
-    CROW_ROUTE(app, "/api/friends/search").methods("GET"_method)([db](const crow::request &req) {
+    CROW_ROUTE(app, "/api/friends/search").methods("GET"_method)([&database](const crow::request &req) {
+        auto db = database.read();
         // Extract 'username' query parameter
         auto urlParams = req.url_params;
         if (!urlParams.get("username")) {
@@ -521,7 +567,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // cancel outgoing pending invite
-    CROW_ROUTE(app, "/api/invites/cancel/<int>").methods("POST"_method)([db](const crow::request &req, int inviteId) {
+    CROW_ROUTE(app, "/api/invites/cancel/<int>").methods("POST"_method)([&database](const crow::request &req, int inviteId) {
+        auto db = database.write();
 
         // get user id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
@@ -566,6 +613,7 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
         if (!updateFriendRequestStatus(db, inviteId, "cancelled")) {
             return makeError(500, "Failed to cancel invite");
         }
+        publishChange(ChangeEntity::FriendRequest, ChangeOp::Update, userId, inviteId, receiverId);
         
         crow::json::wvalue res;
         res["invite_id"] = inviteId;
@@ -574,7 +622,8 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // remove friend
-    CROW_ROUTE(app, "/api/friends/remove/<int>").methods("POST"_method)([db](const crow::request &req, int friendId) {
+    CROW_ROUTE(app, "/api/friends/remove/<int>").methods("POST"_method)([&database](const crow::request &req, int friendId) {
+        auto db = database.write();
         // get user id from cookie
         std::string cookieHeader = req.get_header_value("Cookie");
         std::string user_id_str = getCookieValue(cookieHeader, "user_id");
@@ -605,6 +654,7 @@ void setupInviteRoutes(crow::SimpleApp &app, sqlite3 *db)
             return makeError(500, "Failed to remove friend");
         }
         sqlite3_finalize(stmt);
+        publishChange(ChangeEntity::Friendship, ChangeOp::Delete, userId, 0, friendId);
 
         crow::json::wvalue res;
         res["status"] = "success";
@@ -3,6 +3,10 @@
 #include "../helper.h"
 #include "../leaderboard.h"
 #include "../invites.h"   // for getFriendships()
+#include "../responseCache.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <vector>
 #include <iostream>
 
@@ -58,44 +62,53 @@ std::vector<UserSimple> getTopFriends(sqlite3* db, int userId, int limit) {
 }
 
 // Setup routes
-void setupLeaderboardRoutes(crow::SimpleApp& app, sqlite3* db) {
-    CROW_ROUTE(app, "/api/top-users").methods("GET"_method)([db](const crow::request& req, crow::response& res) {
+void setupLeaderboardRoutes(FitnessApp& app, Database& database) {
+    CROW_ROUTE(app, "/api/top-users").methods("GET"_method)([&database](const crow::request& req) {
         int limit = 3; // default
-        if (req.url_params.get("limit")) limit = std::stoi(req.url_params.get("limit"));
-        if (limit > 100) limit = 100;
+        if (const char* param = req.url_params.get("limit")) {
+            const char* end = param + std::strlen(param);
+            auto parsed = std::from_chars(param, end, limit);
+            if (parsed.ptr != end || parsed.ptr == param) {
+                return crow::response(400, R"({"error":"limit must be a number"})");
+            }
+            if (parsed.ec == std::errc::result_out_of_range) limit = *param == '-' ? 1 : 100;
+        }
+        // Clamped before the query and the cache key: -1 would mean no LIMIT in
+        // SQLite, and every distinct value would get its own cache entry
+        limit = std::clamp(limit, 1, 100);
 
         bool friendsOnly = false;
         if (req.url_params.get("friends")) friendsOnly = std::string(req.url_params.get("friends")) == "1";
 
-        std::vector<UserSimple> topUsers;
-
+        int userId = 0;
         if (friendsOnly) {
             // Get current user from cookie
             std::string cookieHeader = req.get_header_value("Cookie");
             std::string user_id_str = getCookieValue(cookieHeader, "user_id");
             if (user_id_str.empty()) {
-                res.code = 401;
-                res.write(R"({"error":"Unauthorized"})");
-                res.end();
-                return;
+                return crow::response(401, R"({"error":"Unauthorized"})");
             }
-            int userId = std::stoi(user_id_str);
-            topUsers = getTopFriends(db, userId, limit);
-        } else {
-            topUsers = getTopUsers(db, limit);
+            userId = std::stoi(user_id_str);
         }
 
-        crow::json::wvalue j;
-        j["users"] = crow::json::wvalue::list();
-        int i = 0;
-        for (const auto &u : topUsers) {
-            j["users"][i]["username"] = u.username;
-            j["users"][i]["score"] = u.score;
-            i++;
-        }
+        // Scores move with everyone's activity, so these expire instead of being invalidated
+        std::string key = std::string(friendsOnly ? "top-friends/" : "top-users/") + std::to_string(limit);
+        return responseCache().serve(req, userId, key, [&] {
+            auto db = database.read();
+            std::vector<UserSimple> topUsers = friendsOnly ? getTopFriends(db, userId, limit) : getTopUsers(db, limit);
+
+            crow::json::wvalue j;
+            j["users"] = crow::json::wvalue::list();
+            int i = 0;
+            for (const auto &u : topUsers) {
+                j["users"][i]["username"] = u.username;
+                j["users"][i]["score"] = u.score;
+                i++;
+            }
 
-        res.set_header("Content-Type", "application/json");
-        res.write(j.dump());
-        res.end();
+            crow::response res(j.dump());
+            res.set_header("Content-Type", "application/json");
+            return res;
+        }, ResponseCache::SHARED_TTL);
     });
 }
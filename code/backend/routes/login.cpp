@@ -1,79 +1,46 @@
 #include <crow.h>
 #include <sqlite3.h>
-#include <sstream>
-#include <map>
 #include "../LogIn.h"
 #include "../helper.h"
+#include "../auth.h"
+#include "../logger.h"
+#include "../formData.h"
 
-std::string urlDecode(const std::string &s) {
-    std::ostringstream out;
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '%' && i + 2 < s.size()) {
-            std::string hex = s.substr(i + 1, 2);
-            char c = static_cast<char>(std::stoi(hex, nullptr, 16));
-            out << c;
-            i += 2;
-        } else if (s[i] == '+') {
-            out << ' ';
-        } else {
-            out << s[i];
-        }
-    }
-    return out.str();
-}
-
-std::map<std::string, std::string> parseFormData(const std::string& body) {
-    std::map<std::string, std::string> form;
-    std::istringstream stream(body);
-    std::string pair;
-
-    while (std::getline(stream, pair, '&')) {
-        auto pos = pair.find('=');
-        if (pos != std::string::npos) {
-            std::string key = pair.substr(0, pos);
-            std::string value = pair.substr(pos + 1);
-
-            // decode + and %XX sequences
-            value = urlDecode(value);
-
-            form[key] = value;
-        }
-    }
-    return form;
-}
-
-void setupLoginRoutes(crow::SimpleApp& app, LogInManager& loginManager, sqlite3* db) 
+void setupLoginRoutes(FitnessApp& app, Database& database)
 {
-    CROW_ROUTE(app, "/login").methods(crow::HTTPMethod::POST)([&loginManager, db](const crow::request& req)
+    CROW_ROUTE(app, "/login").methods(crow::HTTPMethod::POST)([&database](const crow::request& req)
     {
-        auto form = parseFormData(req.body);
-        std::cout << "Raw body: " << req.body << std::endl;
-        std::cout << "Parsed username: " << form["username"] << std::endl;
-        std::cout << "Parsed password: " << form["password"] << std::endl;
+        FormData form(req.body);
+        if (!form) {
+            logEvent(LogLevel::Warn, "login")
+                .field("result", "bad_form")
+                .field("error", form.error())
+                .field("offset", static_cast<int64_t>(form.errorOffset()));
+            return crow::response(400, "Malformed login form");
+        }
 
-        auto usernameIt = form.find("username");
-        auto passwordIt = form.find("password");
-    if (usernameIt == form.end() || passwordIt == form.end()) {
+        auto usernameField = form.get("username");
+        auto passwordField = form.get("password");
+        if (!usernameField || !passwordField) {
             return crow::response(400, "Missing username or password");
         }
 
-        std::string username = usernameIt->second;
-        std::string password = passwordIt->second;
+        std::string username(*usernameField);
+        std::string password(*passwordField);
 
-        crow::response res;
-        if (loginManager.LogIn(username, password, db)) {
-
-            sqlite3_stmt* stmt;
-            const char* sql = "SELECT id FROM users WHERE username = ?;";
-            int user_id = 0;
+        // One query gives the id, the hash parameters and the account flags. It runs
+        // on a reader; the writer is only taken if the hash needs upgrading.
+        AuthResult auth = authenticateUser(database, username, password);
+        logEvent(auth.ok() ? LogLevel::Info : LogLevel::Warn, "login")
+            .field("username", username)
+            .field("result", authStatusName(auth.status))
+            .field("user_id", auth.userId)
+            .field("needs_rehash", auth.needsRehash)
+            .field("rehashed", auth.rehashed);
 
-            if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-                sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
-                if (sqlite3_step(stmt) == SQLITE_ROW) {
-                    user_id = sqlite3_column_int(stmt, 0);
-                }
-                sqlite3_finalize(stmt);
-            }
+        crow::response res;
+        if (auth.ok()) {
+            int user_id = auth.userId;
 
             //return crow::response(200, "Login successful!");
             res.code = 302;                          // HTTP redirect
@@ -0,0 +1,19 @@
+#include "push.h"
+
+void setupPushRoutes(FitnessApp& app, PushHub& hub)
+{
+    CROW_WEBSOCKET_ROUTE(app, "/ws")
+        .max_payload(1024)
+        .onaccept([&hub](const crow::request& req, void** userdata) {
+            return hub.accept(req, userdata);
+        })
+        .onopen([&hub](crow::websocket::connection& conn) {
+            hub.open(conn);
+        })
+        // Newer Crow also passes the close code
+        .onclose([&hub](crow::websocket::connection& conn, const std::string&, auto...) {
+            hub.close(conn);
+        })
+        .onmessage([](crow::websocket::connection&, const std::string&, bool) {
+        });
+}
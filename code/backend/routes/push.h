@@ -0,0 +1,13 @@
+#ifndef PUSH_ROUTES_H
+#define PUSH_ROUTES_H
+
+#include <crow.h>
+#include "../admissionControl.h"
+#include "../pushHub.h"
+
+// GET /ws?topics=leaderboard,friends: websocket upgrade for PushHub. The
+// friends topic needs the user_id cookie; refused when no topic applies or
+// PUSH_MAX_CONNECTIONS are open. Client messages are ignored.
+void setupPushRoutes(FitnessApp& app, PushHub& hub);
+
+#endif
@@ -1,12 +1,14 @@
 #include "register.h"
 #include <sqlite3.h>
 #include <crow.h>
+#include "../userDirectory.h"
 
-void setupRegisterRoutes(crow::SimpleApp& app, sqlite3* db)
+void setupRegisterRoutes(FitnessApp& app, Database& database)
 {
     // User registration route
     CROW_ROUTE(app, "/register")
-    .methods("POST"_method)([db](const crow::request& req){
+    .methods("POST"_method)([&database](const crow::request& req){
+        auto db = database.write();
 
         // Parse JSON body
         auto body = crow::json::load(req.body);
@@ -63,6 +65,7 @@ CreateUserResult createUser(sqlite3* db, const string &username, const string &p
     {
         // Get the last inserted row ID
         user.id = static_cast<int>(sqlite3_last_insert_rowid(db));
+        userDirectory().refreshUser(db, user.id);
         return CreateUserResult::Success;
     }
 
@@ -6,6 +6,8 @@
 #include <iostream>
 #include "hash.h"
 #include "../helper.h"
+#include "../admissionControl.h"
+#include "../database.h"
 
 using namespace std;
 
@@ -32,4 +34,4 @@ struct UserResult {
 
 CreateUserResult createUser(sqlite3* db, const string& username, const string& password, const string& email, const string& firstName, const string& lastName);
 int insertUserIntoDB(sqlite3* db, const User& user); // Placeholder for actual DB insertion function
-void setupRegisterRoutes(crow::SimpleApp& app, sqlite3* db);
+void setupRegisterRoutes(FitnessApp& app, Database& database);
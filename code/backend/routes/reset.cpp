@@ -1,9 +1,9 @@
 #include "reset.h"
-#include <chrono>
-#include <ctime>
-#include <iomanip>
+#include "emailOutbox.h"
+#include "userDirectory.h"
+#include "dateTime.h"
 #include <sstream>
-#include <curl/curl.h>
+#include "httpClient.h"
 #include <sodium.h>
 #include "hash.h"
 #include "helper.h"
@@ -19,28 +19,20 @@ EmailConfig load_email_config_from_env()
     const char* api_key = std::getenv("EMAIL_API_KEY");
     const char* domain = std::getenv("EMAIL_DOMAIN");
     const char* from = std::getenv("EMAIL_FROM_ADDRESS");
+    const char* outbox_dir = std::getenv("EMAIL_OUTBOX_DIR");
 
-    return EmailConfig{mode ? mode : "mock", api_key ? api_key : "", domain ? domain : "", from ? from : ""};
+    return EmailConfig{mode ? mode : "mock", api_key ? api_key : "", domain ? domain : "", from ? from : "",
+                       outbox_dir ? outbox_dir : "mail-outbox"};
 }
 
 bool get_user_id_by_email(sqlite3 *db, const std::string &email, int &out_user_id)
 {
-    sqlite3_stmt *stmt;
-    const char *sql = "SELECT id FROM users WHERE email = ? LIMIT 1;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    auto user = userDirectory().byEmail(db, email);
+    if (!user) {
         return false;
     }
-
-    sqlite3_bind_text(stmt, 1, email.c_str(), -1, SQLITE_STATIC);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        out_user_id = sqlite3_column_int(stmt, 0);
-        sqlite3_finalize(stmt);
-        return true;
-    } else {
-        sqlite3_finalize(stmt);
-    }
-
-    return false;
+    out_user_id = user->id;
+    return true;
 }
 
 bool create_password_reset_token(sqlite3 *db, int user_id, int expiry_seconds, std::string &out_token)
@@ -150,6 +142,9 @@ bool update_user_password_hash(sqlite3 *db, int user_id, const std::string &new_
     }
 
     sqlite3_finalize(stmt);
+
+    // the directory caches password hashes for login
+    userDirectory().refreshUser(db, user_id);
     return true;
 }
 
@@ -194,47 +189,30 @@ std::string generate_secure_token(std::size_t num_bytes)
 
 std::string current_time_iso8601()
 {
-    // Get current time in UTC
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-    std::tm *utc_tm = std::gmtime(&now_c);
-
-    // format as ISO 8601
-    std::ostringstream oss;
-    oss << std::put_time(utc_tm, "%Y-%m-%dT%H:%M:%SZ");
-    return oss.str();
+    // current time in UTC, formatted as ISO 8601
+    char buf[ISO8601_BUF_SIZE];
+    return formatIso8601Utc(nowUtc(), buf);
 }
 
 std::string time_plus_seconds_iso8601(int seconds)
 {
-    // Get current time + seconds in UTC 
-    auto now = std::chrono::system_clock::now();
-    auto future_time = now + std::chrono::seconds(seconds);
-    std::time_t future_c = std::chrono::system_clock::to_time_t(future_time);
-    std::tm *utc_tm = std::gmtime(&future_c);
-
-    // format as ISO 8601
-    std::ostringstream oss;
-    oss << std::put_time(utc_tm, "%Y-%m-%dT%H:%M:%SZ");
-    return oss.str();
+    // current time + seconds in UTC, formatted as ISO 8601
+    char buf[ISO8601_BUF_SIZE];
+    return formatIso8601Utc(nowUtc() + seconds, buf);
 }
 
 bool is_token_expired(const std::string &expires_at_iso)
 {
     // parse expires_at_iso
-    std::tm tm = {};
-    std::istringstream ss(expires_at_iso);
-    ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
-    if (ss.fail()) {
+    Timestamp expires;
+    if (!parseIso8601Utc(expires_at_iso, expires)) {
         return true; // consider invalid format as expired
     }
 
-    std::time_t expires_time = timegm(&tm);
-    std::time_t now = std::time(nullptr);
-    return expires_time <= now;
+    return expires <= nowUtc();
 }
 
-bool send_reset_email(const EmailConfig &cfg, const std::string &to, const std::string &reset_url)
+bool queue_reset_email(EmailOutbox &outbox, sqlite3 *db, const std::string &to, const std::string &reset_url)
 {
     // Make sure reset_url is a FULL URL, e.g.
     // "https://your-domain.com/reset-password?token=ABC123"
@@ -258,31 +236,16 @@ bool send_reset_email(const EmailConfig &cfg, const std::string &to, const std::
     "<p>If you did not request this, please ignore this email.</p>"
     "</body></html>";
 
-
-    if (cfg.mode == "mock") 
-    {
-        std::cout << "[MOCK EMAIL] To: " << to
-                  << "\nSubject: " << subject
-                  << "\n\n[TEXT VERSION]\n" << body_text
-                  << "\n\n[HTML VERSION]\n" << body_html
-                  << "\n";
-        return true;
-    } 
-    else if (cfg.mode == "real") 
-    {
-        // pass both text and html to Mailgun
-        return send_email_via_mailgun(cfg, to, subject, body_text, body_html);
-    }
-
-    return false;
+    return outbox.enqueue(db, to, subject, body_text, body_html);
 }
 
 
-bool send_email_via_mailgun(const EmailConfig& cfg,
-                            const std::string& to,
-                            const std::string& subject,
-                            const std::string& body_text,
-                            const std::string& body_html)
+bool build_mailgun_request(const EmailConfig& cfg,
+                           const std::string& to,
+                           const std::string& subject,
+                           const std::string& body_text,
+                           const std::string& body_html,
+                           HttpRequest& out)
 {
     if (cfg.api_key.empty() || cfg.domain.empty() || cfg.from.empty()) {
         std::cerr << "[Mailgun] Missing config:"
@@ -293,100 +256,65 @@ bool send_email_via_mailgun(const EmailConfig& cfg,
         return false;
     }
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        std::cerr << "[Mailgun] curl_easy_init() failed\n";
-        return false;
-    }
-
-    bool ok = false;
-
     std::ostringstream url;
     url << "https://api.mailgun.net/v3/" << cfg.domain << "/messages";
-    std::cerr << "[Mailgun] URL = " << url.str() << "\n";
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.str().c_str());
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
-    curl_easy_setopt(curl, CURLOPT_USERNAME, "api");
-    curl_easy_setopt(curl, CURLOPT_PASSWORD, cfg.api_key.c_str());
-
-    curl_mime* mime = curl_mime_init(curl);
-    curl_mimepart* part = nullptr;
-
-    // From
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "from");
-    curl_mime_data(part, cfg.from.c_str(), CURL_ZERO_TERMINATED);
-
-    // To
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "to");
-    curl_mime_data(part, to.c_str(), CURL_ZERO_TERMINATED);
-
-    // Subject
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "subject");
-    curl_mime_data(part, subject.c_str(), CURL_ZERO_TERMINATED);
-
-    // Plain text body
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "text");
-    curl_mime_data(part, body_text.c_str(), CURL_ZERO_TERMINATED);
-
-    // HTML body (this is what makes the “button” version clickable)
-    part = curl_mime_addpart(mime);
-    curl_mime_name(part, "html");
-    curl_mime_data(part, body_html.c_str(), CURL_ZERO_TERMINATED);
-
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
-
-    std::string response_body;
-    curl_easy_setopt(
-        curl,
-        CURLOPT_WRITEFUNCTION,
-        +[](char* ptr, size_t size, size_t nmemb, void* userdata) -> size_t {
-            auto* resp = static_cast<std::string*>(userdata);
-            resp->append(ptr, size * nmemb);
-            return size * nmemb;
-        }
-    );
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_body);
-
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        std::cerr << "[Mailgun] curl_easy_perform() failed: "
-                  << curl_easy_strerror(res) << "\n";
-    } else {
-        long http_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
-        std::cerr << "[Mailgun] HTTP " << http_code
-                  << " response: " << response_body << "\n";
+    out = HttpRequest{};
+    out.method = "POST";
+    out.url = url.str();
+    out.username = "api";
+    out.password = cfg.api_key;
+
+    // sent as multipart form fields; the html part is what makes the link clickable
+    out.formFields = {
+        {"from", cfg.from},
+        {"to", to},
+        {"subject", subject},
+        {"text", body_text},
+        {"html", body_html},
+    };
+    return true;
+}
 
-        if (http_code == 200 || http_code == 202) {
-            ok = true;
-        } else {
-            std::cerr << "[Mailgun] Non-success HTTP code from Mailgun\n";
-        }
+bool mailgun_response_ok(const HttpResponse& resp)
+{
+    if (resp.status == 0) {
+        std::cerr << "[Mailgun] request failed: " << resp.error << "\n";
+        return false;
     }
 
-    curl_mime_free(mime);
-    curl_easy_cleanup(curl);
+    std::cerr << "[Mailgun] HTTP " << resp.status
+              << " response: " << resp.body << "\n";
 
-    return ok;
+    if (resp.status == 200 || resp.status == 202) {
+        return true;
+    }
+    std::cerr << "[Mailgun] Non-success HTTP code from Mailgun\n";
+    return false;
+}
+
+bool send_email_via_mailgun(const EmailConfig& cfg,
+                            const std::string& to,
+                            const std::string& subject,
+                            const std::string& body_text,
+                            const std::string& body_html)
+{
+    HttpRequest request;
+    if (!build_mailgun_request(cfg, to, subject, body_text, body_html, request)) {
+        return false;
+    }
+    return mailgun_response_ok(sharedHttpClient().perform(std::move(request)));
 }
 
 
 
 
-void setupPasswordResetRoutes(crow::SimpleApp &app, sqlite3 *db, const EmailConfig &email_cfg)
+void setupPasswordResetRoutes(FitnessApp &app, Database& database, EmailOutbox &outbox)
 {
     // POST /auth/api/forgot-password
     CROW_ROUTE(app, "/auth/api/forgot-password").methods("POST"_method)(
-        [db, email_cfg](const crow::request &req) {
+        [&database, &outbox](const crow::request &req) {
+            auto db = database.write();
             auto body = crow::json::load(req.body);
             if (!body || !body.has("email")) {
                 return makeError(400, "Invalid JSON or missing email");
@@ -405,8 +333,8 @@ void setupPasswordResetRoutes(crow::SimpleApp &app, sqlite3 *db, const EmailConf
             }
 
             std::string resetUrl = "http://localhost:8080/auth/new-password?token=" + token;
-            if (!send_reset_email(email_cfg, email, resetUrl)) {
-                return makeError(500, "Failed to send reset email");
+            if (!queue_reset_email(outbox, db, email, resetUrl)) {
+                return makeError(500, "Failed to queue reset email");
             }
 
             return crow::response(200, crow::json::wvalue{{"status", "success"}});
@@ -415,7 +343,8 @@ void setupPasswordResetRoutes(crow::SimpleApp &app, sqlite3 *db, const EmailConf
 
     // GET auth/api/reset-password/validate?token=...
     CROW_ROUTE(app, "/auth/api/reset-password/validate").methods("GET"_method)(
-        [db](const crow::request &req) {
+        [&database](const crow::request &req) {
+            auto db = database.read();
 
             // get token from query param
             auto token = req.url_params.get("token");
@@ -448,7 +377,8 @@ void setupPasswordResetRoutes(crow::SimpleApp &app, sqlite3 *db, const EmailConf
 
     // POST auth/api/reset-password
     CROW_ROUTE(app, "/auth/api/reset-password").methods("POST"_method)(
-        [db](const crow::request &req) {
+        [&database](const crow::request &req) {
+            auto db = database.write();
 
             // parse body
             auto body = crow::json::load(req.body);
@@ -1,10 +1,43 @@
 #include "session.h"
 #include "exercise.h"
 #include "helper.h"
+#include "dateTime.h"
+#include "eventBus.h"
+#include "dto.h"
+#include "jsonWriter.h"
+
+namespace {
+    struct SessionDto {
+        std::string_view name;
+        std::string_view date;
+        std::string_view notes;
+        int duration = 0;          // minutes
+    };
+
+    constexpr auto SESSION_SCHEMA = dto::schema<SessionDto>(
+        dto::required("name", &SessionDto::name).length(1, 100),
+        dto::required("date", &SessionDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD"),
+        dto::optional("notes", &SessionDto::notes).length(0, 2000),
+        dto::optional("duration", &SessionDto::duration).range(0, 24 * 60));
+
+    // PUT changes only the fields it carries
+    struct SessionUpdateDto {
+        std::optional<std::string_view> name;
+        std::optional<std::string_view> date;
+        std::optional<std::string_view> notes;
+        std::optional<int> duration;
+    };
+
+    constexpr auto SESSION_UPDATE_SCHEMA = dto::schema<SessionUpdateDto>(
+        dto::optional("name", &SessionUpdateDto::name).length(1, 100),
+        dto::optional("date", &SessionUpdateDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD"),
+        dto::optional("notes", &SessionUpdateDto::notes).length(0, 2000),
+        dto::optional("duration", &SessionUpdateDto::duration).range(0, 24 * 60));
+}
 
 bool createSession(sqlite3 *db, const Session &session)
 {
-    const char *sql = "INSERT INTO sessions (user_id, name, date, notes, duration) VALUES (?, ?, ?, ?, ?)";
+    const char *sql = "INSERT INTO sessions (user_id, name, date, notes, duration, day) VALUES (?, ?, ?, ?, ?, ?)";
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
@@ -15,10 +48,16 @@ bool createSession(sqlite3 *db, const Session &session)
     sqlite3_bind_text(stmt, 3, session.date.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 4, session.notes.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 5, session.duration);
+    Day day;
+    if (parseDate(session.date, day))
+        sqlite3_bind_int(stmt, 6, day.value);
+    else
+        sqlite3_bind_null(stmt, 6);
 
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
     if (success) {
         CROW_LOG_INFO << "Session created successfully";
+        publishChange(ChangeEntity::Session, ChangeOp::Insert, session.user_id, sqlite3_last_insert_rowid(db));
     } else {
         std::cerr << "Insert failed: " << sqlite3_errmsg(db) << std::endl;
         std::cerr << "user_id=" << session.user_id
@@ -92,7 +131,7 @@ Session getSessionById(sqlite3 *db, int session_id)
 
 bool updateSession(sqlite3 *db, const Session &session)
 {
-    const char *sql = "UPDATE sessions SET name = ?, date = ?, notes = ?, duration = ? WHERE id = ?";
+    const char *sql = "UPDATE sessions SET name = ?, date = ?, notes = ?, duration = ?, day = ? WHERE id = ?";
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
@@ -102,16 +141,23 @@ bool updateSession(sqlite3 *db, const Session &session)
     sqlite3_bind_text(stmt, 2, session.date.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, session.notes.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 4, session.duration);
-    sqlite3_bind_int(stmt, 5, session.id);
+    Day day;
+    if (parseDate(session.date, day))
+        sqlite3_bind_int(stmt, 5, day.value);
+    else
+        sqlite3_bind_null(stmt, 5);
+    sqlite3_bind_int(stmt, 6, session.id);
 
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
     sqlite3_finalize(stmt);
+    if (success && sqlite3_changes(db) > 0)
+        publishChange(ChangeEntity::Session, ChangeOp::Update, session.user_id, session.id);
     return success;
 }
 
 bool deleteSession(sqlite3 *db, int session_id)
 {
-    const char *sql = "DELETE FROM sessions WHERE id = ?";
+    const char *sql = "DELETE FROM sessions WHERE id = ? RETURNING user_id";
     sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
@@ -119,15 +165,23 @@ bool deleteSession(sqlite3 *db, int session_id)
 
     sqlite3_bind_int(stmt, 1, session_id);
 
-    bool success = sqlite3_step(stmt) == SQLITE_DONE;
+    int rc = sqlite3_step(stmt);
+    int owner_id = 0;
+    if (rc == SQLITE_ROW) {
+        owner_id = sqlite3_column_int(stmt, 0);
+        rc = sqlite3_step(stmt);
+    }
+    bool success = rc == SQLITE_DONE;
     sqlite3_finalize(stmt);
+    if (success && owner_id)
+        publishChange(ChangeEntity::Session, ChangeOp::Delete, owner_id, session_id);
     return success;
 }
 
-void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
+void setupSessionRoutes(FitnessApp &app, ShardRouter& shards)
 {
     // Create a session
-    CROW_ROUTE(app, "/api/sessions/create").methods("POST"_method)([db](const crow::request &req)
+    CROW_ROUTE(app, "/api/sessions/create").methods("POST"_method)([&shards](const crow::request &req)
     {
         std::cout << "Raw body: [" << req.body << "]" << std::endl;
 
@@ -140,17 +194,19 @@ void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
 
         int user_id = std::stoi(user_id_str);
 
-        Session session;
-        auto body = crow::json::load(req.body);
+        auto body = SESSION_SCHEMA.parse(req.body);
         if (!body) {
-            return crow::response{400, "Invalid JSON"};
+            return crow::response{400, body.error()};
         }
 
+        Session session;
         session.user_id = user_id; // cookie-based user
-        session.name = body["name"].s();
-        session.date = body["date"].s();
-        session.notes = body.has("notes") ? body["notes"].s() : std::string{};
-        session.duration = body.has("duration") ? body["duration"].i() : 0;
+        session.name = std::string(body->name);
+        session.date = std::string(body->date);
+        session.notes = std::string(body->notes);
+        session.duration = body->duration;
+
+        auto db = shards.forUser(user_id).write();
 
         if (createSession(db, session)) {
             return crow::response{201, "Session created successfully"};
@@ -160,7 +216,7 @@ void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // Get sessions for the logged-in user
-    CROW_ROUTE(app, "/api/sessions/user").methods("GET"_method)([db](const crow::request &req)
+    CROW_ROUTE(app, "/api/sessions/user").methods("GET"_method)([&shards](const crow::request &req)
     {
         CROW_LOG_INFO << "Hit /api/sessions/user";
 
@@ -171,34 +227,35 @@ void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
         }
 
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
 
         std::vector<Session> sessions = getSessionsByUser(db, user_id);
         if (sessions.empty()) {
             return crow::response{404, "No sessions found for user"};
         }
 
-        crow::json::wvalue res;
-        crow::json::wvalue::list arr;
+        JsonWriter json(sessions.size() * 200 + 32);   // ~200 bytes a row
+        json.beginObject().key("sessions").beginArray();
         for (const auto& s : sessions) {
-            crow::json::wvalue item;
-            item["id"] = s.id;
-            item["user_id"] = s.user_id;
-            item["name"] = s.name;
-            item["date"] = s.date;
-            item["notes"] = s.notes;
-            item["duration"] = s.duration;
-            item["created_at"] = s.created_at;
-            item["updated_at"] = s.updated_at;
-            arr.push_back(item);
+            json.beginObject()
+                .field("id", s.id)
+                .field("user_id", s.user_id)
+                .field("name", s.name)
+                .field("date", s.date)
+                .field("notes", s.notes)
+                .field("duration", s.duration)
+                .field("created_at", s.created_at)
+                .field("updated_at", s.updated_at)
+                .endObject();
         }
-
-        res["sessions"] = std::move(arr);
-        return crow::response(200, res);
+        json.endArray().endObject();
+        return json.response();
     });
 
     // Get a single session
-    CROW_ROUTE(app, "/api/sessions/<int>").methods("GET"_method)([db](const crow::request &req, int session_id)
+    CROW_ROUTE(app, "/api/sessions/<int>").methods("GET"_method)([&shards](const crow::request &req, int session_id)
     {
+        auto db = shards.forRow(session_id).read();
         Session session = getSessionById(db, session_id);
         if (session.id == 0) {
             return crow::response{404, "Session not found"};
@@ -218,49 +275,49 @@ void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // Get exercises for a session
-    CROW_ROUTE(app, "/api/sessions/<int>/exercises").methods("GET"_method)([db](int session_id)
+    CROW_ROUTE(app, "/api/sessions/<int>/exercises").methods("GET"_method)([&shards](int session_id)
     {
+        auto db = shards.forRow(session_id).read();
         auto exercises = getExercisesBySession(db, session_id);
 
-        crow::json::wvalue res;
-        crow::json::wvalue::list arr;
-
+        JsonWriter json(exercises.size() * 160 + 32);
+        json.beginObject().key("exercises").beginArray();
         for (const auto& e : exercises) {
-            crow::json::wvalue item;
-            item["id"] = e.id;
-            item["user_id"] = e.user_id;
-            item["session_id"] = e.session_id;
-            item["date"] = e.date;
-            item["type"] = e.type;
-            item["sets"] = e.sets;
-            item["reps"] = e.reps;
-            item["weight"] = e.weight;
-            item["duration"] = e.duration;
-            item["notes"] = e.notes;
-            arr.push_back(std::move(item));
+            json.beginObject()
+                .field("id", e.id)
+                .field("user_id", e.user_id)
+                .field("session_id", e.session_id)
+                .field("date", e.date)
+                .field("type", e.type)
+                .field("sets", e.sets)
+                .field("reps", e.reps)
+                .field("weight", e.weight)
+                .field("duration", e.duration)
+                .field("notes", e.notes)
+                .endObject();
         }
-
-        res["exercises"] = std::move(arr);
-        return crow::response(200, res);
+        json.endArray().endObject();
+        return json.response();
     });
 
     // Update a session
-    CROW_ROUTE(app, "/api/sessions/<int>").methods("PUT"_method)([db](const crow::request &req, int session_id)
+    CROW_ROUTE(app, "/api/sessions/<int>").methods("PUT"_method)([&shards](const crow::request &req, int session_id)
     {
+        auto body = SESSION_UPDATE_SCHEMA.parse(req.body);
+        if (!body) {
+            return crow::response{400, body.error()};
+        }
+
+        auto db = shards.forRow(session_id).write();
         Session session = getSessionById(db, session_id);
         if (session.id == 0) {
             return crow::response{404, "Session not found"};
         }
 
-        auto body = crow::json::load(req.body);
-        if (!body) {
-            return crow::response{400, "Invalid JSON"};
-        }
-
-        if (body.has("name")) session.name = body["name"].s();
-        if (body.has("date")) session.date = body["date"].s();
-        if (body.has("notes")) session.notes = body["notes"].s();
-        if (body.has("duration")) session.duration = body["duration"].i();
+        if (body->name) session.name = std::string(*body->name);
+        if (body->date) session.date = std::string(*body->date);
+        if (body->notes) session.notes = std::string(*body->notes);
+        if (body->duration) session.duration = *body->duration;
 
         if (updateSession(db, session)) {
             return crow::response{200, "Session updated successfully"};
@@ -270,8 +327,9 @@ void setupSessionRoutes(crow::SimpleApp &app, sqlite3 *db)
     });
 
     // Delete a session
-    CROW_ROUTE(app, "/api/sessions/<int>").methods("DELETE"_method)([db](const crow::request &req, int session_id)
+    CROW_ROUTE(app, "/api/sessions/<int>").methods("DELETE"_method)([&shards](const crow::request &req, int session_id)
     {
+        auto db = shards.forRow(session_id).write();
         if (deleteSession(db, session_id)) {
             return crow::response{204, "Session deleted successfully"};
         } else {
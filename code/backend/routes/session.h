@@ -3,6 +3,8 @@
 
 #include <sqlite3.h>
 #include <crow.h>
+#include "../admissionControl.h"
+#include "../shardRouter.h"
 #include <string>
 #include <vector>
 
@@ -26,6 +28,6 @@ bool updateSession(sqlite3* db, const Session& session);
 bool deleteSession(sqlite3* db, int session_id);
 
 // routes
-void setupSessionRoutes(crow::SimpleApp& app, sqlite3* db);
+void setupSessionRoutes(FitnessApp& app, ShardRouter& shards);
 
 #endif
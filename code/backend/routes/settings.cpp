@@ -0,0 +1,51 @@
+#include "settings.h"
+#include "../helper.h"
+#include "../timeZone.h"
+#include "../responseCache.h"
+
+void setupSettingsRoutes(FitnessApp& app, Database& database)
+{
+    // --- Get the user's timezone ---
+    CROW_ROUTE(app, "/api/user/timezone").methods("GET"_method)([&database](const crow::request& req)
+    {
+        auto db = database.read();
+        std::string cookieHeader = req.get_header_value("Cookie");
+        std::string user_id_str = getCookieValue(cookieHeader, "user_id");
+        if (user_id_str.empty()) {
+            return makeError(401, "Unauthorized: missing login cookie");
+        }
+        int user_id = std::stoi(user_id_str);
+
+        std::shared_ptr<const TimeZone> tz = userTimeZone(db, user_id);
+        crow::json::wvalue res;
+        res["timezone"] = tz->name();
+        res["today"] = toDateString(tz->dayAt(nowUtc()));
+        return crow::response(200, res);
+    });
+
+    // --- Set the user's timezone (IANA name such as "America/Chicago", or "UTC", "+05:30") ---
+    CROW_ROUTE(app, "/api/user/timezone").methods("PUT"_method)([&database](const crow::request& req)
+    {
+        auto db = database.write();
+        std::string cookieHeader = req.get_header_value("Cookie");
+        std::string user_id_str = getCookieValue(cookieHeader, "user_id");
+        if (user_id_str.empty()) {
+            return makeError(401, "Unauthorized: missing login cookie");
+        }
+        int user_id = std::stoi(user_id_str);
+
+        auto body = crow::json::load(req.body);
+        if (!body || !body.has("timezone"))
+            return makeError(400, "Missing timezone");
+
+        std::string timezone = body["timezone"].s();
+        if (!findTimeZone(timezone))
+            return makeError(400, "Unknown timezone");
+        if (!setUserTimezone(db, user_id, timezone))
+            return makeError(500, "Failed to update timezone");
+        // Summaries are bucketed by the user's local day
+        responseCache().invalidateUser(user_id);
+
+        return makeSuccess(200, "Timezone updated");
+    });
+}
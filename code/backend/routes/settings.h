@@ -0,0 +1,12 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <sqlite3.h>
+#include <crow.h>
+#include "../admissionControl.h"
+#include "../database.h"
+
+// routes
+void setupSettingsRoutes(FitnessApp& app, Database& database);
+
+#endif
@@ -1,10 +1,36 @@
 #include "sleep_tracker.h"
 #include "../helper.h"
+#include "../timeZone.h"
+#include "../scoreEngine.h"
+#include "../eventBus.h"
+#include "../dto.h"
+#include "../jsonWriter.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <sstream>
-#include <iomanip>
-#include <chrono>
-#include <ctime>
+#include <map>
+#include <vector>
+
+namespace {
+    // Same formats as parseSleepDate() below
+    bool isSleepDate(std::string_view s) {
+        Day day;
+        return parseUSDate(s, day) || parseDate(s, day);
+    }
+
+    struct SleepDto {
+        std::string_view date;
+        std::string_view time;      // sleep start, wall clock in the user's zone
+        int duration = 0;           // minutes
+        std::string_view sleep_type;
+    };
+
+    constexpr auto SLEEP_SCHEMA = dto::schema<SleepDto>(
+        dto::required("date", &SleepDto::date).satisfies(isSleepDate, "expected MM-DD-YYYY or YYYY-MM-DD"),
+        dto::required("time", &SleepDto::time).satisfies(dto::isTimeOfDay, "expected HH:MM"),
+        dto::required("duration", &SleepDto::duration).range(1, 1440),
+        dto::required("sleep_type", &SleepDto::sleep_type).length(1, 32));
+}
 
 std::string getUserID(const crow::request& req) {
     // Read user_id from cookie
@@ -14,18 +40,19 @@ std::string getUserID(const crow::request& req) {
 }
 
 
-void setupSleepTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
+void setupSleepTrackerRoutes(FitnessApp& app, ShardRouter& shards) {
     CROW_ROUTE(app, "/sleep-tracker")
     ([] {
         return serveFile("code/frontend/SleepTracker.html", "text/html");
     });
 
     CROW_ROUTE(app, "/api/sleeps").methods("POST"_method)
-    ([&app, db](const crow::request& req) {
+    ([&app, &shards](const crow::request& req) {
         
         string user_id_str = getUserID(req);
         if (user_id_str.empty()) return makeError(401, "Unauthorized: missing login cookie");        
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).write();
 
         return addSleep(app, db, user_id, req);
     });
@@ -38,7 +65,7 @@ void setupSleepTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
     */
 
     CROW_ROUTE(app, "/api/sleeps").methods("GET"_method)
-    ([&app, db](const crow::request& req) {
+    ([&app, &shards](const crow::request& req) {
         /*
         auto user_id_str = req.url_params.get("user_id");
         auto date = req.url_params.get("sleepDate");
@@ -47,28 +74,54 @@ void setupSleepTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
 
         int user_id = std::stoi(user_id_str);
         */
-        auto date = req.url_params.get("sleepDate");
-        if (!date) return crow::response(400, "Missing parameter date");
-
         string user_id_str = getUserID(req);
         if (user_id_str.empty()) return makeError(401, "Unauthorized: missing login cookie");        
         int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
 
-        return getSleeps(app, db, user_id, date);
+        Day first, last;
+        std::string error;
+        if (!parseSleepRange(db, user_id, req, first, last, error)) return crow::response(400, error);
+
+        return getSleeps(app, db, user_id, first, last);
     }); 
 
+    // Nightly totals, rolling average and consistency for ?from=&to= (default: last 7 nights)
+    CROW_ROUTE(app, "/api/sleeps/stats").methods("GET"_method)
+    ([&app, &shards](const crow::request& req) {
+        string user_id_str = getUserID(req);
+        if (user_id_str.empty()) return makeError(401, "Unauthorized: missing login cookie");
+        int user_id = std::stoi(user_id_str);
+        auto db = shards.forUser(user_id).read();
+
+        Day first, last;
+        std::string error;
+        if (!parseSleepRange(db, user_id, req, first, last, error)) return crow::response(400, error);
+
+        int window = 7;
+        if (auto w = req.url_params.get("window")) {
+            window = std::atoi(w);
+            if (window < 1 || window > MAX_ROLLING_WINDOW) return crow::response(400, "Invalid window");
+        }
+
+        return getSleepStats(app, db, user_id, first, last, window);
+    });
+
     CROW_ROUTE(app, "/api/sleeps/<int>").methods("PUT"_method)
-    ([&app, db](const crow::request& req, int sleep_id) {
+    ([&app, &shards](const crow::request& req, int sleep_id) {
+        auto db = shards.forRow(sleep_id).write();
         return updateSleep(app, db, sleep_id, req);
     });
 
     CROW_ROUTE(app, "/api/sleeps/<int>").methods("DELETE"_method)
-    ([&app, db](int sleep_id) {
+    ([&app, &shards](int sleep_id) {
+       auto db = shards.forRow(sleep_id).write();
        return deleteSleep(app, db, sleep_id);
     });
 
     CROW_ROUTE(app, "/api/sleeps/clear/<int>/<string>").methods("DELETE"_method)
-    ([&app, db](int user_id, const std::string& date) {
+    ([&app, &shards](int user_id, const std::string& date) {
+       auto db = shards.forUser(user_id).write();
        return clearWeeklySleeps(app, db, user_id, date);
     });
 
@@ -83,179 +136,363 @@ void setupSleepTrackerRoutes(crow::SimpleApp& app, sqlite3* db) {
     });*/
 }
 
-// Get timestamp now - 7 days in ISO8601
-std::string seven_days_ago() {
-    using namespace std::chrono;
-    auto now = system_clock::now();
-    auto past = now - hours(24 * 7);
-    std::time_t t = system_clock::to_time_t(past);
-    char buf[32];
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
-    return buf;
+// Accepts "mm-dd-yyyy" (what the sleep page sends) as well as "yyyy-mm-dd"
+bool parseSleepDate(std::string_view date, Day& out) {
+    return parseUSDate(date, out) || parseDate(date, out);
 }
 
-std::string getCurrentDateTimeFormatted() {
-    using namespace std::chrono;
-    auto now = system_clock::now();
-    std::time_t t = system_clock::to_time_t(now);
-
-    char buf[32];
-    if (std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", std::localtime(&t)))
-        return std::string(buf);
-
-    return ""; // fallback, but should never be hit
+// Same, plus "today" in the user's timezone
+bool parseSleepDay(sqlite3* db, int user_id, const std::string& date, Day& out) {
+    if (date == "today") {
+        out = todayForUser(db, user_id);
+        return true;
+    }
+    return parseSleepDate(date, out);
 }
 
-std::string convertToISODate(const std::string& us_date) {
-    // expects "mm-dd-yyyy"
-    if (us_date.size() != 10) return us_date;  // fallback
+// Inclusive day range from ?from=&to=. "to" defaults to today (or the legacy
+// sleepDate parameter), "from" to the 6 days before it.
+bool parseSleepRange(sqlite3* db, int user_id, const crow::request& req, Day& first, Day& last, std::string& error) {
+    const char* to = req.url_params.get("to");
+    if (!to) to = req.url_params.get("sleepDate");
+    const char* from = req.url_params.get("from");
+
+    if (!to) {
+        last = todayForUser(db, user_id);
+    } else if (!parseSleepDay(db, user_id, to, last)) {
+        error = "Invalid 'to' date";
+        return false;
+    }
 
-    std::string mm = us_date.substr(0, 2);
-    std::string dd = us_date.substr(3, 2);
-    std::string yyyy = us_date.substr(6, 4);
+    if (!from) {
+        first = last - 6;
+    } else if (!parseSleepDay(db, user_id, from, first)) {
+        error = "Invalid 'from' date";
+        return false;
+    }
 
-    return yyyy + "-" + mm + "-" + dd;  // ISO format
+    if (first > last || last.value - first.value >= MAX_SLEEP_RANGE_DAYS) {
+        error = "Invalid range, at most " + std::to_string(MAX_SLEEP_RANGE_DAYS) + " days";
+        return false;
+    }
+    return true;
 }
 
-crow::response addSleep(crow::SimpleApp& app, sqlite3* db, int user_id, const crow::request& req) {
+crow::response addSleep(FitnessApp& app, sqlite3* db, int user_id, const crow::request& req) {
     //return crow::response(200, "made it to addSleep");
 
-    auto data = crow::json::load(req.body);
-    if (!data) return crow::response(400, "Invalid JSON");
-
-    std::string error;
-    if (!validateSleepData(data, error)) return crow::response(400, error);
+    auto sleep = SLEEP_SCHEMA.parse(req.body);
+    if (!sleep) return crow::response(400, sleep.error());
 
     //int user_id = data["user_id"].i();
     //int sleep_id = data.has("id") ? data["id"].s() : getCurrentDate();
-    std::string date = convertToISODate(data["date"].s());
-    std::string time = data["time"].s();
-    std::string sleepStart = date + " " + time + ":00";
-    int duration = data["duration"].i();
-    std::string sleep_type = data["sleep_type"].s();
-    std::string created_at = getCurrentDateTimeFormatted();
-
-    const char* sql = "INSERT INTO sleepTable (user_id, sleep_start_time, duration, sleep_type, created_at) "
-                      "VALUES (?, ?, ?, ?, ?)";
-
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db,sql,-1, &stmt, nullptr);
-    
-    sqlite3_bind_int(stmt, 1, user_id);
-    //sqlite3_bind_int(stmt, 2, sleep_id);
-    sqlite3_bind_text(stmt, 2, sleepStart.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, duration);
-    sqlite3_bind_text(stmt, 4, sleep_type.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 5, created_at.c_str(), -1, SQLITE_STATIC);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        std::cerr << "SQLite prepare error: " << sqlite3_errmsg(db) << "\nSQL: " << sql << std::endl;
-        std::cerr << "[DEBUG] INSERT FAILED — values were:\n";
-        std::cerr << "  user_id         = " << user_id << "\n";
-        std::cerr << "  sleep_start_time= \"" << sleepStart.c_str() << "\"\n";
-        std::cerr << "  duration        = " << duration << "\n";
-        std::cerr << "  sleep_type      = \"" << sleep_type.c_str()<< "\"\n";
-        std::cerr << "  created_at      = \"" << created_at.c_str() << "\"\n";
+    Day day;
+    int32_t timeOfDay;
+    parseSleepDate(sleep->date, day);
+    parseTimeOfDay(sleep->time, timeOfDay);
+
+    std::shared_ptr<const TimeZone> tz = userTimeZone(db, user_id);
+    Timestamp startTs = tz->fromLocal(day, timeOfDay);
+    char sleepStart[DATETIME_BUF_SIZE];
+    char created_at[DATETIME_BUF_SIZE];
+    tz->formatLocal(startTs, sleepStart);
+    tz->formatLocal(nowUtc(), created_at);
+
+    int duration = sleep->duration;
+    std::string sleep_type(sleep->sleep_type);
+
+    const char* sql = "INSERT INTO sleepTable (user_id, sleep_start_time, duration, sleep_type, created_at, sleep_start_ts) "
+                      "VALUES (?, ?, ?, ?, ?, ?)";
+
+    int sleep_id = 0;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db,sql,-1, &stmt, nullptr);
+
+        sqlite3_bind_int(stmt, 1, user_id);
+        //sqlite3_bind_int(stmt, 2, sleep_id);
+        sqlite3_bind_text(stmt, 2, sleepStart, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 3, duration);
+        sqlite3_bind_text(stmt, 4, sleep_type.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 5, created_at, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 6, startTs.value);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "SQLite prepare error: " << sqlite3_errmsg(db) << "\nSQL: " << sql << std::endl;
+            std::cerr << "[DEBUG] INSERT FAILED — values were:\n";
+            std::cerr << "  user_id         = " << user_id << "\n";
+            std::cerr << "  sleep_start_time= \"" << sleepStart << "\"\n";
+            std::cerr << "  duration        = " << duration << "\n";
+            std::cerr << "  sleep_type      = \"" << sleep_type.c_str()<< "\"\n";
+            std::cerr << "  created_at      = \"" << created_at << "\"\n";
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        sleep_id = sqlite3_last_insert_rowid(db);
         sqlite3_finalize(stmt);
-        return crow::response(500, "Database insert failed");
-    }
 
-    int sleep_id = sqlite3_last_insert_rowid(db);
-    sqlite3_finalize(stmt);
+        return recordActivity(db, {ScoreKind::Sleep, user_id, sleep_id, static_cast<double>(duration)});
+    });
+    if (!ok) return crow::response(500, "Database insert failed");
+
+    publishChange(ChangeEntity::Sleep, ChangeOp::Insert, user_id, sleep_id);
 
-    return crow::response(201, "{\"sleep_id\":" + std::to_string(sleep_id) + "}");
+    return JsonWriter().beginObject().field("sleep_id", sleep_id).endObject().response(201);
 }
 
 
-crow::response getSleeps(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date) {
+crow::response getSleeps(FitnessApp& app, sqlite3* db, int user_id, Day first, Day last) {
     sqlite3_stmt* stmt;
-    std::string sevenDaysAgo = seven_days_ago();
+    Timestamp begin, end;
+    userTimeZone(db, user_id)->dayRange(first, last, begin, end);
     sqlite3_prepare_v2(db,
         "SELECT sleep_id, sleep_start_time, duration, sleep_type, created_at "
-        "FROM sleepTable WHERE user_id=? AND sleep_start_time>=? ORDER BY sleep_start_time DESC",
+        "FROM sleepTable WHERE user_id=? AND sleep_start_ts>=? AND sleep_start_ts<? ORDER BY sleep_start_ts DESC",
         -1, &stmt, nullptr);
 
     sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, sevenDaysAgo.c_str(), -1, SQLITE_STATIC);
-
-    crow::json::wvalue result;
-    std::vector<crow::json::wvalue> sleep_list;
+    sqlite3_bind_int64(stmt, 2, begin.value);
+    sqlite3_bind_int64(stmt, 3, end.value);
 
+    JsonWriter json;
+    json.beginObject().key("sleeps").beginArray();
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        crow::json::wvalue sleep;
-        sleep["id"] = sqlite3_column_int(stmt, 0);
-        sleep["date"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        sleep["time"] = "";
-        sleep["duration"] = sqlite3_column_int(stmt, 2);
-        sleep["sleep_type"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        sleep["created_at"] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        sleep_list.push_back(std::move(sleep));
+        json.beginObject()
+            .field("id", sqlite3_column_int(stmt, 0))
+            .field("date", columnText(stmt, 1))
+            .field("time", "")
+            .field("duration", sqlite3_column_int(stmt, 2))
+            .field("sleep_type", columnText(stmt, 3))
+            .field("created_at", columnText(stmt, 4))
+            .endObject();
     }
-
     sqlite3_finalize(stmt);
-    result["sleeps"] = std::move(sleep_list);
-    return crow::response(result);
+
+    json.endArray().endObject();
+    return json.response();
 }
 
-crow::response deleteSleep(crow::SimpleApp&, sqlite3* db, int sleep_id) {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "DELETE FROM sleepTable WHERE sleep_id=?", -1, &stmt, nullptr);
-    sqlite3_bind_int(stmt, 1, sleep_id);
+crow::response deleteSleep(FitnessApp&, sqlite3* db, int sleep_id) {
+    int owner_id = 0;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db, "DELETE FROM sleepTable WHERE sleep_id=? RETURNING user_id", -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, sleep_id);
+
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            owner_id = sqlite3_column_int(stmt, 0);
+            rc = sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE && retractActivity(db, ScoreKind::Sleep, sleep_id);
+    });
+
+    if (ok && owner_id) publishChange(ChangeEntity::Sleep, ChangeOp::Delete, owner_id, sleep_id);
 
     return ok ? crow::response(200, "Deleted") : crow::response(500, "Failed");
 }
 
-crow::response updateSleep(crow::SimpleApp& app, sqlite3* db, int sleep_id, const crow::request& req) {
-    auto data = crow::json::load(req.body);
-    if (!data) return crow::response(400, "Invalid JSON");
+crow::response updateSleep(FitnessApp& app, sqlite3* db, int sleep_id, const crow::request& req) {
+    auto sleep = SLEEP_SCHEMA.parse(req.body);
+    if (!sleep) return crow::response(400, sleep.error());
+
+    Day day;
+    int32_t timeOfDay;
+    parseSleepDate(sleep->date, day);
+    parseTimeOfDay(sleep->time, timeOfDay);
+    int duration = sleep->duration;
+    std::string sleep_type(sleep->sleep_type);
+
+    // The wall-clock text is in the owner's timezone; look it up through the row itself.
+    std::shared_ptr<const TimeZone> tz = serverTimeZone();
+    int owner_id = 0;
+    sqlite3_stmt* ownerStmt;
+    if (sqlite3_prepare_v2(db, "SELECT user_id FROM sleepTable WHERE sleep_id=?", -1, &ownerStmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(ownerStmt, 1, sleep_id);
+        if (sqlite3_step(ownerStmt) == SQLITE_ROW) {
+            owner_id = sqlite3_column_int(ownerStmt, 0);
+            tz = userTimeZone(db, owner_id);
+        }
+        sqlite3_finalize(ownerStmt);
+    }
 
-    std::string error;
-    if (!validateSleepData(data, error)) return crow::response(400, error);
+    Timestamp startTs = tz->fromLocal(day, timeOfDay);
+    char sleepStart[DATETIME_BUF_SIZE];
+    tz->formatLocal(startTs, sleepStart);
 
-    std::string date = data["date"].s();
-    std::string time = data["time"].s();
-    std::string sleepStart = date + " " + time + ":00";
-    int duration = data["duration"].i();
-    std::string sleep_type = data["sleep_type"].s();
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db,
+            "UPDATE sleepTable SET sleep_start_time=?, duration=?, sleep_type=?, sleep_start_ts=? WHERE sleep_id=?",
+            -1, &stmt, nullptr);
 
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db,
-        "UPDATE sleepTable SET sleep_start_time=?, duration=?, sleep_type=? WHERE sleep_id=?",
-        -1, &stmt, nullptr);
+        sqlite3_bind_text(stmt, 1, sleepStart, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, duration);
+        sqlite3_bind_text(stmt, 3, sleep_type.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, startTs.value);
+        sqlite3_bind_int(stmt, 5, sleep_id);
 
-    sqlite3_bind_text(stmt, 1, sleepStart.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, duration);
-    sqlite3_bind_text(stmt, 3, sleep_type.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, sleep_id);
+        bool updated = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+        return updated && (!owner_id || recordActivity(db, {ScoreKind::Sleep, owner_id, sleep_id, static_cast<double>(duration)}));
+    });
+
+    if (ok && owner_id) publishChange(ChangeEntity::Sleep, ChangeOp::Update, owner_id, sleep_id);
 
     return ok ? crow::response(200, "Updated") : crow::response(500, "Update failed"); 
 }
 
 
-crow::response clearWeeklySleeps(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date) {
-    sqlite3_stmt* stmt;
-    std::string sevenDaysAgo = seven_days_ago();
-    sqlite3_prepare_v2(db,
-        "DELETE FROM sleepTable WHERE user_id=? AND sleep_start_time>=?",
-        -1, &stmt, nullptr);
+crow::response clearWeeklySleeps(FitnessApp& app, sqlite3* db, int user_id, const std::string& date) {
+    // Clears the 7 days ending on (and including) the given date
+    Day last;
+    if (!parseSleepDay(db, user_id, date, last)) return crow::response(400, "Invalid date");
+
+    Timestamp begin, end;
+    userTimeZone(db, user_id)->dayRange(last - 6, last, begin, end);
+
+    // The rows and their points go in one transaction
+    std::vector<int64_t> sleep_ids;
+    bool ok = inTransaction(db, [&] {
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(db,
+            "DELETE FROM sleepTable WHERE user_id=? AND sleep_start_ts>=? AND sleep_start_ts<? RETURNING sleep_id",
+            -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, user_id);
+        sqlite3_bind_int64(stmt, 2, begin.value);
+        sqlite3_bind_int64(stmt, 3, end.value);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            sleep_ids.push_back(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) return false;
 
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, sevenDaysAgo.c_str(), -1, SQLITE_STATIC);
+        for (int64_t sleep_id : sleep_ids) {
+            if (!retractActivity(db, ScoreKind::Sleep, sleep_id)) return false;
+        }
+        return true;
+    });
 
-    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    if (ok) {
+        for (int64_t sleep_id : sleep_ids) publishChange(ChangeEntity::Sleep, ChangeOp::Delete, user_id, sleep_id);
+    }
 
     return ok ? crow::response(200, "Cleared") : crow::response(500, "Failed to clear sleeps");
 }
     
-bool validateSleepData(const crow::json::rvalue &data, std::string &error)
-{
-    return true;
+crow::response getSleepStats(FitnessApp& app, sqlite3* db, int user_id, Day first, Day last, int window) {
+    // A night runs from noon to noon local time, so a sleep that starts at
+    // 00:30 still counts toward the evening before. Rows are fetched from
+    // window - 1 nights earlier so the first rolling averages are complete.
+    std::shared_ptr<const TimeZone> tz = userTimeZone(db, user_id);
+    Day scanFirst = first - (window - 1);
+    int nights = last.value - scanFirst.value + 1;
+    Timestamp begin = tz->fromLocal(scanFirst, NIGHT_START_SECONDS);
+    Timestamp end = tz->fromLocal(last + 1, NIGHT_START_SECONDS);
+
+    std::vector<int> totals(nights, 0);
+    std::vector<int> entries(nights, 0);
+    std::vector<int32_t> bedtimes(nights, 0);  // seconds after noon of the earliest sleep
+    std::map<std::string, int> quality;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db,
+        "SELECT sleep_start_ts, duration, sleep_type FROM sleepTable "
+        "WHERE user_id=? AND sleep_start_ts>=? AND sleep_start_ts<? ORDER BY sleep_start_ts",
+        -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare getSleepStats: " << sqlite3_errmsg(db) << std::endl;
+        return crow::response(500, "Database error");
+    }
+
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int64(stmt, 2, begin.value);
+    sqlite3_bind_int64(stmt, 3, end.value);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Timestamp start{sqlite3_column_int64(stmt, 0)};
+        int duration = sqlite3_column_int(stmt, 1);
+
+        Timestamp shifted = start + tz->offsetAt(start) - NIGHT_START_SECONDS;
+        Day night = dayAt(shifted, 0);
+        int i = night.value - scanFirst.value;
+        if (i < 0 || i >= nights) continue;
+
+        if (entries[i] == 0) {
+            bedtimes[i] = static_cast<int32_t>(shifted.value - static_cast<int64_t>(night.value) * SECONDS_PER_DAY);
+        }
+        totals[i] += duration;
+        entries[i]++;
+
+        if (night >= first) {
+            const unsigned char* type = sqlite3_column_text(stmt, 2);
+            quality[type ? reinterpret_cast<const char*>(type) : ""]++;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    // Per-night rows with a trailing average over the logged nights in the window
+    std::vector<crow::json::wvalue> nightList;
+    int windowSum = 0, windowCount = 0;
+    int totalMinutes = 0, nightsLogged = 0;
+    double durationSum = 0, durationSqSum = 0, bedtimeSum = 0, bedtimeSqSum = 0;
+
+    for (int i = 0; i < nights; i++) {
+        if (entries[i] > 0) { windowSum += totals[i]; windowCount++; }
+        if (i >= window && entries[i - window] > 0) { windowSum -= totals[i - window]; windowCount--; }
+
+        Day night = scanFirst + i;
+        if (night < first) continue;
+
+        crow::json::wvalue row;
+        row["date"] = toDateString(night);
+        row["total_minutes"] = totals[i];
+        row["entries"] = entries[i];
+        if (windowCount > 0)
+            row["rolling_avg_minutes"] = static_cast<double>(windowSum) / windowCount;
+        else
+            row["rolling_avg_minutes"] = nullptr;
+        nightList.push_back(std::move(row));
+
+        if (entries[i] > 0) {
+            nightsLogged++;
+            totalMinutes += totals[i];
+            durationSum += totals[i];
+            durationSqSum += static_cast<double>(totals[i]) * totals[i];
+            double bedtimeMinutes = bedtimes[i] / 60.0;
+            bedtimeSum += bedtimeMinutes;
+            bedtimeSqSum += bedtimeMinutes * bedtimeMinutes;
+        }
+    }
+
+    // Consistency is the standard deviation of bedtime and of nightly totals;
+    // lower means a steadier routine.
+    auto stddev = [nightsLogged](double sum, double sqSum) {
+        if (nightsLogged < 2) return 0.0;
+        double mean = sum / nightsLogged;
+        return std::sqrt(std::max(0.0, sqSum / nightsLogged - mean * mean));
+    };
+
+    crow::json::wvalue summary;
+    summary["nights_logged"] = nightsLogged;
+    summary["total_minutes"] = totalMinutes;
+    summary["avg_minutes"] = nightsLogged ? static_cast<double>(totalMinutes) / nightsLogged : 0.0;
+    summary["bedtime_stddev_minutes"] = stddev(bedtimeSum, bedtimeSqSum);
+    summary["duration_stddev_minutes"] = stddev(durationSum, durationSqSum);
+    for (const auto& q : quality) {
+        summary["quality"][q.first] = q.second;
+    }
+
+    crow::json::wvalue result;
+    result["from"] = toDateString(first);
+    result["to"] = toDateString(last);
+    result["window"] = window;
+    result["nights"] = std::move(nightList);
+    result["summary"] = std::move(summary);
+    return crow::response(result);
 }
 
@@ -1,23 +1,33 @@
 #pragma once
 #include <crow.h>
+#include "../admissionControl.h"
+#include "../shardRouter.h"
 #include <sqlite3.h>
 #include <string>
+#include "../dateTime.h"
 
-void setupSleepTrackerRoutes(crow::SimpleApp& app, sqlite3* db);
+// Longest range the sleep history and stats endpoints accept
+constexpr int MAX_SLEEP_RANGE_DAYS = 366;
+constexpr int MAX_ROLLING_WINDOW = 30;
+// Nights are bucketed noon to noon, local time
+constexpr int32_t NIGHT_START_SECONDS = 12 * 3600;
+
+void setupSleepTrackerRoutes(FitnessApp& app, ShardRouter& shards);
 
 // Sleep functions now match .cpp
-crow::response addSleep(crow::SimpleApp& app, sqlite3* db, int user_id, const crow::request& req);
-crow::response getSleeps(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date);
-crow::response updateSleep(crow::SimpleApp& app, sqlite3* db, int sleep_id, const crow::request& req);
-crow::response deleteSleep(crow::SimpleApp&, sqlite3* db, int sleep_id);
-crow::response clearWeeklySleeps(crow::SimpleApp& app, sqlite3* db, int user_id, const std::string& date);
+crow::response addSleep(FitnessApp& app, sqlite3* db, int user_id, const crow::request& req);
+crow::response getSleeps(FitnessApp& app, sqlite3* db, int user_id, Day first, Day last);
+crow::response getSleepStats(FitnessApp& app, sqlite3* db, int user_id, Day first, Day last, int window);
+crow::response updateSleep(FitnessApp& app, sqlite3* db, int sleep_id, const crow::request& req);
+crow::response deleteSleep(FitnessApp&, sqlite3* db, int sleep_id);
+crow::response clearWeeklySleeps(FitnessApp& app, sqlite3* db, int user_id, const std::string& date);
 
 // Goals
-crow::response getUserGoals(crow::SimpleApp& app, sqlite3* db, int user_id);
-crow::response updateUserGoals(crow::SimpleApp& app, sqlite3* db, int user_id, const crow::request& req);
+crow::response getUserGoals(FitnessApp& app, sqlite3* db, int user_id);
+crow::response updateUserGoals(FitnessApp& app, sqlite3* db, int user_id, const crow::request& req);
 
 // Utility
 std::string getCurrentDate(); 
 std::string getCurrentDateTime();
-bool validateSleepData(const crow::json::rvalue& data, std::string& error);
+bool parseSleepRange(sqlite3* db, int user_id, const crow::request& req, Day& first, Day& last, std::string& error);
 
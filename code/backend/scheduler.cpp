@@ -0,0 +1,377 @@
+#include "scheduler.h"
+#include "timeZone.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// ---- IoBudget ----
+
+IoBudget::IoBudget(int64_t pagesPerSecond, int64_t burstPages)
+    : _rate(std::max<int64_t>(1, pagesPerSecond)),
+      _burst(std::max<int64_t>(1, burstPages)),
+      _tokens(static_cast<double>(_burst)),
+      _last(std::chrono::steady_clock::now())
+{
+}
+
+void IoBudget::refill()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - _last).count();
+    _last = now;
+    _tokens = std::min(static_cast<double>(_burst), _tokens + elapsed * _rate);
+}
+
+bool IoBudget::acquire(int64_t pages, const std::atomic<bool>& stop)
+{
+    while (!stop.load(std::memory_order_relaxed)) {
+        double wait;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            refill();
+            // A request larger than the burst only has to wait for a full bucket.
+            double needed = static_cast<double>(std::min(pages, _burst));
+            if (_tokens >= needed) {
+                _tokens -= static_cast<double>(pages);
+                return true;
+            }
+            wait = (needed - _tokens) / _rate;
+        }
+        // Sleep in short slices so stop() is honoured promptly.
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.25)));
+    }
+    return false;
+}
+
+void IoBudget::charge(int64_t pages)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    refill();
+    _tokens -= static_cast<double>(pages);
+}
+
+// ---- cron spec ----
+
+struct Scheduler::CronField {
+    uint64_t bits = 0;
+    bool any = true;
+    bool matches(int v) const { return (bits >> v) & 1; }
+};
+
+struct Scheduler::CronSpec {
+    CronField minute, hour, dayOfMonth, month, dayOfWeek;
+};
+
+struct Scheduler::Entry {
+    std::string name;
+    int64_t intervalSeconds = 0;          // 0 for cron jobs
+    std::unique_ptr<CronSpec> cron;
+    int64_t jitterSeconds = 0;
+    Job job;
+    Lane lane = Lane::Shared;
+    bool running = false;                 // guarded by Scheduler::_mutex
+    JobMetrics metrics;                   // guarded by Scheduler::_mutex
+};
+
+namespace {
+
+bool parseCronField(const std::string& text, int lo, int hi, uint64_t& bits, bool& any)
+{
+    bits = 0;
+    any = text == "*";
+    std::stringstream parts(text);
+    std::string part;
+    while (std::getline(parts, part, ',')) {
+        int step = 1;
+        std::size_t slash = part.find('/');
+        if (slash != std::string::npos) {
+            try { step = std::stoi(part.substr(slash + 1)); } catch (...) { return false; }
+            if (step < 1) return false;
+            part = part.substr(0, slash);
+        }
+
+        int first = lo, last = hi;
+        if (part != "*") {
+            std::size_t dash = part.find('-');
+            try {
+                first = std::stoi(part.substr(0, dash));
+                last = dash == std::string::npos ? (slash == std::string::npos ? first : hi) : std::stoi(part.substr(dash + 1));
+            } catch (...) {
+                return false;
+            }
+        }
+        if (first < lo || last > hi || first > last) return false;
+        for (int v = first; v <= last; v += step) bits |= uint64_t(1) << v;
+    }
+    return bits != 0;
+}
+
+std::chrono::system_clock::time_point toTimePoint(int64_t utcSeconds)
+{
+    return std::chrono::system_clock::time_point(std::chrono::seconds(utcSeconds));
+}
+
+int64_t randomJitter(int64_t maxSeconds)
+{
+    if (maxSeconds <= 0) return 0;
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    return std::uniform_int_distribution<int64_t>(0, maxSeconds)(rng);
+}
+
+} // namespace
+
+// ---- Scheduler ----
+
+Scheduler::Scheduler(unsigned workerThreads)
+    : _workerCount(std::max(1u, workerThreads))
+{
+}
+
+Scheduler::~Scheduler()
+{
+    stop();
+}
+
+void Scheduler::addInterval(const std::string& name, std::chrono::seconds interval, std::chrono::seconds jitter, Job job,
+                            Lane lane)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->name = name;
+    entry->intervalSeconds = std::max<int64_t>(1, interval.count());
+    entry->jitterSeconds = jitter.count();
+    entry->job = std::move(job);
+    entry->lane = lane;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    entry->metrics.nextRunUtc = nextRunAfter(*entry, nowUtc().value);
+    _entries.push_back(entry);
+    _wake.notify_one();
+}
+
+bool Scheduler::addCron(const std::string& name, const std::string& spec, std::chrono::seconds jitter, Job job)
+{
+    std::istringstream in(spec);
+    std::string fields[5];
+    for (auto& f : fields) {
+        if (!(in >> f)) return false;
+    }
+    std::string extra;
+    if (in >> extra) return false;
+
+    auto cron = std::make_unique<CronSpec>();
+    if (!parseCronField(fields[0], 0, 59, cron->minute.bits, cron->minute.any) ||
+        !parseCronField(fields[1], 0, 23, cron->hour.bits, cron->hour.any) ||
+        !parseCronField(fields[2], 1, 31, cron->dayOfMonth.bits, cron->dayOfMonth.any) ||
+        !parseCronField(fields[3], 1, 12, cron->month.bits, cron->month.any) ||
+        !parseCronField(fields[4], 0, 7, cron->dayOfWeek.bits, cron->dayOfWeek.any)) {
+        std::cerr << "Invalid cron spec for job " << name << ": " << spec << std::endl;
+        return false;
+    }
+    if (cron->dayOfWeek.matches(7)) cron->dayOfWeek.bits |= 1;  // 7 is Sunday too
+
+    auto entry = std::make_shared<Entry>();
+    entry->name = name;
+    entry->cron = std::move(cron);
+    entry->jitterSeconds = jitter.count();
+    entry->job = std::move(job);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    entry->metrics.nextRunUtc = nextRunAfter(*entry, nowUtc().value);
+    if (entry->metrics.nextRunUtc == 0) {
+        std::cerr << "Cron spec for job " << name << " never matches: " << spec << std::endl;
+        return false;
+    }
+    _entries.push_back(entry);
+    _wake.notify_one();
+    return true;
+}
+
+int64_t Scheduler::nextRunAfter(const Entry& entry, int64_t now)
+{
+    if (!entry.cron) {
+        return now + entry.intervalSeconds + randomJitter(entry.jitterSeconds);
+    }
+
+    // Walk forward through local calendar days, skipping whole days and hours
+    // that cannot match. Five years covers any valid spec (e.g. Feb 29).
+    const CronSpec& c = *entry.cron;
+    std::shared_ptr<const TimeZone> tz = serverTimeZone();
+    Timestamp nowTs{now};
+    int64_t local = now + tz->offsetAt(nowTs);
+    Day day = dayAt(Timestamp{local}, 0);
+    int startMinute = static_cast<int>((local - int64_t(day.value) * SECONDS_PER_DAY) / 60) + 1;
+
+    for (int i = 0; i < 366 * 5; ++i, day = day + 1, startMinute = 0) {
+        int y; unsigned m, d;
+        civilFromDay(day, y, m, d);
+        int weekday = ((day.value % 7) + 7 + 4) % 7;
+        if (!c.month.matches(static_cast<int>(m))) continue;
+
+        bool domOk = c.dayOfMonth.matches(static_cast<int>(d));
+        bool dowOk = c.dayOfWeek.matches(weekday);
+        // Classic cron: when both day fields are restricted, either may match.
+        bool dayOk = (c.dayOfMonth.any || c.dayOfWeek.any) ? (domOk && dowOk) : (domOk || dowOk);
+        if (!dayOk) continue;
+
+        for (int minuteOfDay = startMinute; minuteOfDay < 24 * 60; ++minuteOfDay) {
+            int h = minuteOfDay / 60, mi = minuteOfDay % 60;
+            if (!c.hour.matches(h)) { minuteOfDay = h * 60 + 59; continue; }
+            if (!c.minute.matches(mi)) continue;
+            Timestamp at = tz->fromLocal(day, minuteOfDay * 60);
+            if (at.value > now) return at.value + randomJitter(entry.jitterSeconds);
+        }
+    }
+    return 0;
+}
+
+void Scheduler::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_started) return;
+    _started = true;
+    _stop = false;
+    for (unsigned i = 0; i < _workerCount; ++i) {
+        _workers.emplace_back(&Scheduler::workerLoop, this, Lane::Shared);
+    }
+    _workers.emplace_back(&Scheduler::workerLoop, this, Lane::Quick);
+    _dispatcher = std::thread(&Scheduler::dispatchLoop, this);
+}
+
+void Scheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_started) return;
+        _started = false;
+        _stop = true;
+        // Queued jobs never run now; clear their flag so a restart can queue them again
+        for (auto& entry : _queue) entry->running = false;
+        for (auto& entry : _quickQueue) entry->running = false;
+        _queue.clear();
+        _quickQueue.clear();
+    }
+    _wake.notify_all();
+    _workAvailable.notify_all();
+    if (_dispatcher.joinable()) _dispatcher.join();
+    for (auto& w : _workers) {
+        if (w.joinable()) w.join();
+    }
+    _workers.clear();
+}
+
+bool Scheduler::runNow(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& entry : _entries) {
+        if (entry->name != name) continue;
+        if (entry->running) {
+            entry->metrics.skippedOverlaps++;
+        } else {
+            enqueue(entry);
+        }
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::pair<std::string, JobMetrics>> Scheduler::metrics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::pair<std::string, JobMetrics>> out;
+    out.reserve(_entries.size());
+    for (const auto& entry : _entries) {
+        out.emplace_back(entry->name, entry->metrics);
+    }
+    return out;
+}
+
+std::size_t Scheduler::queueDepth() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.size() + _quickQueue.size();
+}
+
+void Scheduler::enqueue(const std::shared_ptr<Entry>& entry)
+{
+    entry->running = true;
+    (entry->lane == Lane::Quick ? _quickQueue : _queue).push_back(entry);
+    // Both lanes wait on the same condition; wake them all so the right one sees it
+    _workAvailable.notify_all();
+}
+
+void Scheduler::dispatchLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop) {
+        int64_t now = nowUtc().value;
+        int64_t earliest = 0;
+
+        for (auto& entry : _entries) {
+            JobMetrics& m = entry->metrics;
+            if (m.nextRunUtc == 0) continue;
+            if (m.nextRunUtc <= now) {
+                if (entry->running) {
+                    m.skippedOverlaps++;
+                } else {
+                    enqueue(entry);
+                }
+                m.nextRunUtc = nextRunAfter(*entry, now);
+                if (m.nextRunUtc == 0) continue;
+            }
+            if (earliest == 0 || m.nextRunUtc < earliest) earliest = m.nextRunUtc;
+        }
+
+        if (earliest == 0) {
+            _wake.wait(lock);
+        } else {
+            _wake.wait_until(lock, toTimePoint(earliest));
+        }
+    }
+}
+
+void Scheduler::workerLoop(Lane lane)
+{
+    auto& queue = lane == Lane::Quick ? _quickQueue : _queue;
+    while (true) {
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workAvailable.wait(lock, [this, &queue] { return _stop || !queue.empty(); });
+            if (_stop) return;
+            entry = queue.front();
+            queue.pop_front();
+        }
+        execute(entry);
+    }
+}
+
+void Scheduler::execute(const std::shared_ptr<Entry>& entry)
+{
+    int64_t startedUtc = nowUtc().value;
+    auto started = std::chrono::steady_clock::now();
+
+    bool ok = false;
+    try {
+        ok = entry->job(_stop);
+    } catch (const std::exception& e) {
+        std::cerr << "Job " << entry->name << " threw: " << e.what() << std::endl;
+    }
+
+    int64_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    if (!ok && !_stop) {
+        std::cerr << "Job " << entry->name << " failed after " << elapsedMs << " ms" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    JobMetrics& m = entry->metrics;
+    m.runs++;
+    if (!ok) m.failures++;
+    m.lastRunUtc = startedUtc;
+    if (ok) m.lastSuccessUtc = startedUtc;
+    m.lastDurationMs = elapsedMs;
+    m.maxDurationMs = std::max(m.maxDurationMs, elapsedMs);
+    m.totalDurationMs += elapsedMs;
+    entry->running = false;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Token bucket for background database work, in SQLite pages. Jobs ask for
+// pages before each chunk of work so maintenance never saturates the disk
+// that request handlers are waiting on.
+class IoBudget
+{
+public:
+    IoBudget(int64_t pagesPerSecond, int64_t burstPages);
+
+    // Blocks until `pages` are available. Returns false if `stop` was set while waiting.
+    bool acquire(int64_t pages, const std::atomic<bool>& stop);
+    // Records work that was only measured after the fact (may go into debt).
+    void charge(int64_t pages);
+
+    int64_t pagesPerSecond() const { return _rate; }
+
+private:
+    void refill();
+
+    std::mutex _mutex;
+    int64_t _rate;
+    int64_t _burst;
+    double _tokens;
+    std::chrono::steady_clock::time_point _last;
+};
+
+struct JobMetrics {
+    uint64_t runs = 0;
+    uint64_t failures = 0;
+    uint64_t skippedOverlaps = 0;   // due while the previous run was still going
+    int64_t lastDurationMs = 0;
+    int64_t maxDurationMs = 0;
+    int64_t totalDurationMs = 0;
+    int64_t lastRunUtc = 0;         // seconds since epoch, 0 = never
+    int64_t lastSuccessUtc = 0;
+    int64_t nextRunUtc = 0;
+};
+
+// In-process job scheduler. Jobs run on the scheduler's own threads, never
+// on Crow workers, and each job is single-flight: if it is still running
+// when it comes due again, that run is skipped rather than stacked.
+//
+// Most jobs share `workerThreads` workers, which paced maintenance (backup,
+// vacuum, ANALYZE) can keep busy for minutes at night. Short, frequent jobs
+// that something user-visible waits on go in the Quick lane instead, served
+// by one worker of its own; they must not wait on an IoBudget.
+class Scheduler
+{
+public:
+    // A job returns false on failure; it should check `stop` between chunks.
+    using Job = std::function<bool(const std::atomic<bool>& stop)>;
+
+    enum class Lane { Shared, Quick };
+
+    explicit Scheduler(unsigned workerThreads = 2);
+    ~Scheduler();
+
+    // Runs every `interval`, each run delayed by up to `jitter` extra.
+    void addInterval(const std::string& name, std::chrono::seconds interval, std::chrono::seconds jitter, Job job,
+                     Lane lane = Lane::Shared);
+    // Cron-style "minute hour day-of-month month day-of-week" in the server's
+    // timezone. Fields accept *, n, a-b, lists and /step. Returns false on a bad spec.
+    bool addCron(const std::string& name, const std::string& spec, std::chrono::seconds jitter, Job job);
+
+    void start();
+    // Stops dispatching, asks running jobs to stop and joins all threads.
+    void stop();
+
+    // Queues a job immediately (still single-flight). Returns false if unknown.
+    bool runNow(const std::string& name);
+
+    std::vector<std::pair<std::string, JobMetrics>> metrics() const;
+    // Jobs due and waiting for a worker thread, in either lane.
+    std::size_t queueDepth() const;
+
+private:
+    struct CronField;
+    struct CronSpec;
+    struct Entry;
+
+    int64_t nextRunAfter(const Entry& entry, int64_t nowUtc);
+    void dispatchLoop();
+    void enqueue(const std::shared_ptr<Entry>& entry);
+    void workerLoop(Lane lane);
+    void execute(const std::shared_ptr<Entry>& entry);
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _workAvailable;
+    std::vector<std::shared_ptr<Entry>> _entries;
+    std::deque<std::shared_ptr<Entry>> _queue;
+    std::deque<std::shared_ptr<Entry>> _quickQueue;
+    std::atomic<bool> _stop{false};
+    bool _started = false;
+    unsigned _workerCount;
+    std::thread _dispatcher;
+    std::vector<std::thread> _workers;
+};
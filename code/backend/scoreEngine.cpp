@@ -0,0 +1,362 @@
+#include "scoreEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace {
+
+constexpr int SCORE_KIND_COUNT = 5;
+
+std::shared_mutex rulesMutex;
+ScoreRule rules[SCORE_KIND_COUNT];
+
+std::atomic<bool> deferredTotals{false};
+
+ScoreRule ruleFor(ScoreKind kind) {
+    std::shared_lock<std::shared_mutex> lock(rulesMutex);
+    return rules[static_cast<int>(kind)];
+}
+
+bool execSql(sqlite3* db, const char* sql) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Score engine error: " << (errMsg ? errMsg : "") << "\nSQL: " << sql << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool loadRules(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT kind, points, per_unit, unit_cap FROM score_rules;", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to load score rules: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    ScoreRule loaded[SCORE_KIND_COUNT];
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* kindText = sqlite3_column_text(stmt, 0);
+        std::string kind = kindText ? reinterpret_cast<const char*>(kindText) : "";
+        for (int k = 0; k < SCORE_KIND_COUNT; ++k) {
+            if (kind == scoreKindName(static_cast<ScoreKind>(k))) {
+                loaded[k].points = sqlite3_column_int(stmt, 1);
+                loaded[k].per_unit = sqlite3_column_double(stmt, 2);
+                loaded[k].unit_cap = sqlite3_column_double(stmt, 3);
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    std::unique_lock<std::shared_mutex> lock(rulesMutex);
+    std::copy(loaded, loaded + SCORE_KIND_COUNT, rules);
+    return true;
+}
+
+// Owner and points stored for an event; false if it was never scored.
+bool storedEvent(sqlite3* db, ScoreKind kind, int64_t source_id, int& user_id, int& points) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT user_id, points FROM score_events WHERE kind = ? AND source_id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, scoreKindName(kind), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, source_id);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        user_id = sqlite3_column_int(stmt, 0);
+        points = sqlite3_column_int(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+bool adjustScore(sqlite3* db, int user_id, int delta) {
+    if (delta == 0) return true;
+    // Sharded: the total stays in the shard's own transaction and syncScoreTotals
+    // carries it to the directory, so scoring never takes the directory's write lock.
+    const char* sql = deferredTotals
+        ? "INSERT INTO score_totals (user_id, score, version) VALUES (?2, ?1, 1) "
+          "ON CONFLICT(user_id) DO UPDATE SET score = score + excluded.score, version = version + 1;"
+        : "UPDATE users SET score = score + ?1 WHERE id = ?2;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, delta);
+    sqlite3_bind_int(stmt, 2, user_id);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+bool retractOne(sqlite3* db, ScoreKind kind, int64_t source_id) {
+    int user_id = 0, points = 0;
+    if (!storedEvent(db, kind, source_id, user_id, points)) return true;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "DELETE FROM score_events WHERE kind = ? AND source_id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, scoreKindName(kind), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, source_id);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+
+    return ok && adjustScore(db, user_id, -points);
+}
+
+// Wraps a unit of work in a savepoint so it also nests inside a caller's transaction.
+template <typename F>
+bool inSavepoint(sqlite3* db, F&& work) {
+    if (!execSql(db, "SAVEPOINT score;")) return false;
+    if (work()) {
+        return execSql(db, "RELEASE score;");
+    }
+    execSql(db, "ROLLBACK TO score;");
+    execSql(db, "RELEASE score;");
+    return false;
+}
+
+} // namespace
+
+const char* scoreKindName(ScoreKind kind)
+{
+    switch (kind) {
+        case ScoreKind::Exercise: return "exercise";
+        case ScoreKind::Meal: return "meal";
+        case ScoreKind::Sleep: return "sleep";
+        case ScoreKind::GoalProgress: return "goal_progress";
+        case ScoreKind::GoalCompleted: return "goal_completed";
+    }
+    return "";
+}
+
+int computePoints(const ScoreRule& rule, double units)
+{
+    double counted = std::max(0.0, units);
+    if (rule.unit_cap > 0) counted = std::min(counted, rule.unit_cap);
+    return rule.points + static_cast<int>(rule.per_unit * counted);
+}
+
+bool initScoreEngine(sqlite3* db)
+{
+    // Default weights; edit score_rules and run a replay to change them.
+    const char* defaults = R"(
+        INSERT OR IGNORE INTO score_rules (kind, points, per_unit, unit_cap) VALUES
+            ('exercise', 10, 0.5, 120),
+            ('meal', 2, 0, 0),
+            ('sleep', 5, 0.02, 600),
+            ('goal_progress', 3, 0, 0),
+            ('goal_completed', 50, 0, 0);
+    )";
+    if (!execSql(db, defaults) || !loadRules(db)) return false;
+
+    // First start after the engine was added: score the existing history once.
+    sqlite3_stmt* stmt;
+    bool needsReplay = false;
+    if (sqlite3_prepare_v2(db,
+            "SELECT NOT EXISTS (SELECT 1 FROM score_events) AND ("
+            "EXISTS (SELECT 1 FROM exercises) OR EXISTS (SELECT 1 FROM nutrition) OR "
+            "EXISTS (SELECT 1 FROM sleepTable) OR EXISTS (SELECT 1 FROM goal_progress));",
+            -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) needsReplay = sqlite3_column_int(stmt, 0) != 0;
+        sqlite3_finalize(stmt);
+    }
+    if (needsReplay) {
+        int scored = replayScores(db);
+        if (scored < 0) return false;
+        std::cout << "Scored " << scored << " existing activity events" << std::endl;
+    }
+    return true;
+}
+
+bool recordActivity(sqlite3* db, const ActivityEvent& event)
+{
+    int points = computePoints(ruleFor(event.kind), event.units);
+
+    bool ok = inSavepoint(db, [&] {
+        int oldUser = 0, oldPoints = 0;
+        bool existed = storedEvent(db, event.kind, event.source_id, oldUser, oldPoints);
+
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db,
+                "INSERT INTO score_events (user_id, kind, source_id, units, points) VALUES (?, ?, ?, ?, ?) "
+                "ON CONFLICT(kind, source_id) DO UPDATE SET "
+                "user_id = excluded.user_id, units = excluded.units, points = excluded.points;",
+                -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+        sqlite3_bind_int(stmt, 1, event.user_id);
+        sqlite3_bind_text(stmt, 2, scoreKindName(event.kind), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 3, event.source_id);
+        sqlite3_bind_double(stmt, 4, event.units);
+        sqlite3_bind_int(stmt, 5, points);
+        bool inserted = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        if (!inserted) return false;
+
+        if (existed && oldUser != event.user_id) {
+            return adjustScore(db, oldUser, -oldPoints) && adjustScore(db, event.user_id, points);
+        }
+        return adjustScore(db, event.user_id, points - oldPoints);
+    });
+
+    if (!ok) {
+        std::cerr << "Failed to record " << scoreKindName(event.kind) << " event " << event.source_id
+                  << ": " << sqlite3_errmsg(db) << std::endl;
+    }
+    return ok;
+}
+
+bool retractActivity(sqlite3* db, ScoreKind kind, int64_t source_id)
+{
+    return inSavepoint(db, [&] { return retractOne(db, kind, source_id); });
+}
+
+int replayScores(sqlite3* db)
+{
+    if (!loadRules(db)) return -1;
+
+    // Every scored source, in the same shape recordActivity receives it.
+    struct Source { ScoreKind kind; const char* sql; };
+    const Source sources[] = {
+        {ScoreKind::Exercise, "SELECT user_id, id, MAX(COALESCE(duration, 0), 0) FROM exercises;"},
+        {ScoreKind::Meal, "SELECT user_id, id, 0 FROM nutrition;"},
+        {ScoreKind::Sleep, "SELECT user_id, sleep_id, duration FROM sleepTable;"},
+        {ScoreKind::GoalProgress,
+            "SELECT g.user_id, p.id, 0 FROM goal_progress p JOIN goals g ON g.id = p.goal_id;"},
+        {ScoreKind::GoalCompleted, "SELECT user_id, id, 0 FROM goals WHERE status = 'completed';"},
+    };
+
+    int scored = 0;
+    bool ok = inSavepoint(db, [&] {
+        if (!execSql(db, "DELETE FROM score_events;")) return false;
+
+        sqlite3_stmt* insert;
+        if (sqlite3_prepare_v2(db,
+                "INSERT INTO score_events (user_id, kind, source_id, units, points) VALUES (?, ?, ?, ?, ?);",
+                -1, &insert, nullptr) != SQLITE_OK) {
+            return false;
+        }
+
+        for (const Source& source : sources) {
+            ScoreRule rule = ruleFor(source.kind);
+            sqlite3_stmt* select;
+            if (sqlite3_prepare_v2(db, source.sql, -1, &select, nullptr) != SQLITE_OK) {
+                sqlite3_finalize(insert);
+                return false;
+            }
+            while (sqlite3_step(select) == SQLITE_ROW) {
+                double units = sqlite3_column_double(select, 2);
+                sqlite3_bind_int(insert, 1, sqlite3_column_int(select, 0));
+                sqlite3_bind_text(insert, 2, scoreKindName(source.kind), -1, SQLITE_STATIC);
+                sqlite3_bind_int64(insert, 3, sqlite3_column_int64(select, 1));
+                sqlite3_bind_double(insert, 4, units);
+                sqlite3_bind_int(insert, 5, computePoints(rule, units));
+                if (sqlite3_step(insert) != SQLITE_DONE) {
+                    sqlite3_finalize(select);
+                    sqlite3_finalize(insert);
+                    return false;
+                }
+                sqlite3_reset(insert);
+                scored++;
+            }
+            sqlite3_finalize(select);
+        }
+        sqlite3_finalize(insert);
+
+        if (deferredTotals) {
+            return execSql(db,
+                "UPDATE score_totals SET score = 0, version = version + 1;"
+                "INSERT INTO score_totals (user_id, score, version) "
+                "SELECT user_id, SUM(points), 1 FROM score_events WHERE true GROUP BY user_id "
+                "ON CONFLICT(user_id) DO UPDATE SET score = excluded.score, version = version + 1;");
+        }
+        return execSql(db,
+            "UPDATE users SET score = COALESCE((SELECT SUM(points) FROM score_events e WHERE e.user_id = users.id), 0);");
+    });
+
+    if (!ok) {
+        std::cerr << "Score replay failed: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+    return scored;
+}
+
+void setDeferredScoreTotals(bool deferred)
+{
+    deferredTotals = deferred;
+}
+
+int syncScoreTotals(Database& shard, Database& directory)
+{
+    struct Total { int user_id; int score; int64_t version; };
+    std::vector<Total> pending;
+    {
+        auto db = shard.read();
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "SELECT user_id, score, version FROM score_totals WHERE version != synced_version;",
+                               -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to read score totals: " << sqlite3_errmsg(db) << std::endl;
+            return -1;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            pending.push_back({sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int64(stmt, 2)});
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (pending.empty()) return 0;
+
+    // Absolute values, so a sync repeated after a crash is harmless.
+    {
+        auto db = directory.write();
+        sqlite3_stmt* stmt;
+        if (!execSql(db, "BEGIN;")) return -1;
+        if (sqlite3_prepare_v2(db, "UPDATE users SET score = ? WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+            execSql(db, "ROLLBACK;");
+            return -1;
+        }
+        bool ok = true;
+        for (std::size_t i = 0; ok && i < pending.size(); ++i) {
+            sqlite3_bind_int(stmt, 1, pending[i].score);
+            sqlite3_bind_int(stmt, 2, pending[i].user_id);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        if (!ok) std::cerr << "Failed to sync score totals: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        // Nothing is stamped below unless every directory update committed
+        if (!ok || !execSql(db, "COMMIT;")) {
+            execSql(db, "ROLLBACK;");
+            return -1;
+        }
+    }
+
+    // A total that moved again since it was read keeps its newer version and goes next round.
+    {
+        auto db = shard.write();
+        sqlite3_stmt* stmt;
+        if (!execSql(db, "BEGIN;")) return -1;
+        if (sqlite3_prepare_v2(db, "UPDATE score_totals SET synced_version = ? WHERE user_id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+            execSql(db, "ROLLBACK;");
+            return -1;
+        }
+        bool ok = true;
+        for (std::size_t i = 0; ok && i < pending.size(); ++i) {
+            sqlite3_bind_int64(stmt, 1, pending[i].version);
+            sqlite3_bind_int(stmt, 2, pending[i].user_id);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        // Unstamped totals are simply synced again next round
+        if (!ok || !execSql(db, "COMMIT;")) {
+            execSql(db, "ROLLBACK;");
+            return -1;
+        }
+    }
+    return static_cast<int>(pending.size());
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "database.h"
+#include <sqlite3.h>
+#include <cstdint>
+#include <string>
+
+// Activity that earns leaderboard points. The string form is what is stored
+// in score_events.kind and score_rules.kind.
+enum class ScoreKind { Exercise, Meal, Sleep, GoalProgress, GoalCompleted };
+
+const char* scoreKindName(ScoreKind kind);
+
+// One scored write. source_id is the id of the row that produced it
+// (exercise id, meal id, ...), so re-sending the same event is a no-op.
+struct ActivityEvent {
+    ScoreKind kind;
+    int user_id;
+    int64_t source_id;
+    double units = 0;  // minutes for exercise/sleep, unused otherwise
+};
+
+// A rule turns an event into points: points + per_unit * min(units, unit_cap).
+struct ScoreRule {
+    int points = 0;
+    double per_unit = 0;
+    double unit_cap = 0;  // 0 = no cap
+};
+
+int computePoints(const ScoreRule& rule, double units);
+
+// Loads score_rules into memory (inserting the default rules on first run).
+// If nothing has been scored yet but activity exists, replays it once.
+bool initScoreEngine(sqlite3* db);
+
+// Inserts or re-scores the event and moves users.score by the difference,
+// in one savepoint. Safe to call again for the same source (updates).
+// Handlers call it (and retractActivity) inside the inTransaction() that
+// writes the activity row, so the row and its points commit together.
+bool recordActivity(sqlite3* db, const ActivityEvent& event);
+
+// Removes the event (if any) and takes its points back off users.score.
+bool retractActivity(sqlite3* db, ScoreKind kind, int64_t source_id);
+
+// Rebuilds score_events and users.score from the activity tables under the
+// rules currently in score_rules. Running it twice gives the same result.
+// Returns the number of events scored, or -1 on failure.
+int replayScores(sqlite3* db);
+
+// Sharded storage keeps score_events next to the activity rows, but users.score
+// lives in the directory. With deferred totals on, recording and retracting
+// adjust score_totals in the shard instead, and syncScoreTotals later copies
+// the changed totals into users.score (the leaderboard lags by one sync).
+void setDeferredScoreTotals(bool deferred);
+
+// Copies one shard's unsynced totals into the directory's users.score.
+// Returns the number of users updated, or -1 on failure.
+int syncScoreTotals(Database& shard, Database& directory);
@@ -0,0 +1,78 @@
+#include "shardRouter.h"
+#include "db/schema.h"
+#include <cstdlib>
+#include <iostream>
+
+ShardRouter::ShardRouter(Database& directory, std::string directoryPath, StorageProfile profile, int count)
+    : _directory(directory), _directoryPath(std::move(directoryPath)), _profile(std::move(profile)), _count(count)
+{
+}
+
+bool ShardRouter::open()
+{
+    int stored = storedShardCount(_directory.write());
+    if (stored != _count) {
+        std::cerr << "FITNESS_SHARD_COUNT is " << _count << " but the data is laid out for " << stored
+                  << " shard(s); run shard_tool to reshard first" << std::endl;
+        return false;
+    }
+    if (_count == 1) return true;
+
+    for (int i = 0; i < _count; ++i) {
+        auto shard = std::make_unique<Database>(shardPath(_directoryPath, i, _count), _profile);
+        shard->attach(_directoryPath, "directory");
+        if (!shard->open() || !ensureShardSchema(shard->write(), i * ROW_ID_SPAN + 1)) {
+            close();
+            return false;
+        }
+        _shards.push_back(std::move(shard));
+    }
+    return true;
+}
+
+bool ShardRouter::close()
+{
+    bool ok = true;
+    for (auto& shard : _shards) ok = shard->close() && ok;
+    _shards.clear();
+    return ok;
+}
+
+Database& ShardRouter::shard(int index)
+{
+    return _shards.empty() ? _directory : *_shards[index];
+}
+
+int ShardRouter::shardOfUser(int userId) const
+{
+    int index = userId % _count;
+    return index < 0 ? index + _count : index;
+}
+
+int ShardRouter::shardOfRow(int64_t rowId) const
+{
+    // Ids from before sharding (or made up by a client) fall in shard 0's range
+    int64_t index = rowId / ROW_ID_SPAN;
+    return (index > 0 && index < _count) ? static_cast<int>(index) : 0;
+}
+
+int shardCountFromEnv()
+{
+    const char* value = std::getenv("FITNESS_SHARD_COUNT");
+    if (!value || !*value) return 1;
+    int count = std::atoi(value);
+    if (count < 1 || count > ShardRouter::MAX_SHARDS) {
+        std::cerr << "Ignoring FITNESS_SHARD_COUNT=" << value << " (1.." << ShardRouter::MAX_SHARDS << ")" << std::endl;
+        return 1;
+    }
+    return count;
+}
+
+std::string shardPath(const std::string& directoryPath, int index, int count)
+{
+    std::string base = directoryPath;
+    std::size_t slash = base.find_last_of('/');
+    std::size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base.erase(dot);
+    return base + ".shard-" + std::to_string(index) + "-of-" + std::to_string(count) + ".db";
+}
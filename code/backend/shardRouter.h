@@ -0,0 +1,67 @@
+#pragma once
+#include "database.h"
+#include "storageProfile.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Where a user's rows live.
+//
+// The directory database (FITNESS_DB_PATH) holds users, friendships, invites,
+// reset tokens, score rules and the outbox. With FITNESS_SHARD_COUNT = N > 1
+// the per-user tables (sessions, exercises, nutrition, sleepTable, goals,
+// goal_progress, score_events) are split over N more files next to it,
+// fitness.shard-<i>-of-<N>.db, each with its own writer and reader pool:
+//
+//   user  -> shard user_id % N
+//   row   -> shard row_id / ROW_ID_SPAN (each shard allocates ids from its own range)
+//
+// Every shard connection ATTACHes the directory as "directory", so reads of
+// global tables (a user's timezone, score rules) work from a shard lease;
+// writes to global tables go through directory().write(). With N = 1 (the
+// default) there are no shard files and every route lands on the directory.
+//
+// Changing N needs the offline reshard tool (code/tools/shard_tool.cpp); the
+// server refuses to start when FITNESS_SHARD_COUNT differs from the layout
+// recorded in the directory.
+class ShardRouter
+{
+public:
+    static constexpr int MAX_SHARDS = 16;
+    // Ids stay below 2^31 so they fit the int columns and <int> routes.
+    static constexpr int64_t ROW_ID_SPAN = (int64_t{1} << 31) / MAX_SHARDS;
+
+    ShardRouter(Database& directory, std::string directoryPath, StorageProfile profile, int count);
+
+    // Opens (creating if needed) every shard after the directory is open and
+    // its schema is current. False on a layout mismatch or an unopenable shard.
+    bool open();
+    bool close();
+
+    int count() const { return _count; }
+    bool sharded() const { return _count > 1; }
+
+    Database& directory() { return _directory; }
+    const std::string& directoryPath() const { return _directoryPath; }
+    Database& shard(int index);
+
+    int shardOfUser(int userId) const;
+    int shardOfRow(int64_t rowId) const;
+
+    Database& forUser(int userId) { return shard(shardOfUser(userId)); }
+    Database& forRow(int64_t rowId) { return shard(shardOfRow(rowId)); }
+
+private:
+    Database& _directory;
+    std::string _directoryPath;
+    StorageProfile _profile;
+    int _count;
+    std::vector<std::unique_ptr<Database>> _shards;
+};
+
+// FITNESS_SHARD_COUNT, clamped to 1..MAX_SHARDS (default 1).
+int shardCountFromEnv();
+
+// fitness.db -> fitness.shard-2-of-4.db
+std::string shardPath(const std::string& directoryPath, int index, int count);
@@ -0,0 +1,77 @@
+#include "startup.h"
+#include "logger.h"
+
+Startup::Startup() : _start(Clock::now()), _lastMark(_start) {}
+
+Startup::~Startup()
+{
+    join();
+}
+
+int64_t Startup::msSince(Clock::time_point t) const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t).count();
+}
+
+void Startup::mark(const char* name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Clock::time_point now = Clock::now();
+    _phases.push_back(Phase{name, std::chrono::duration_cast<std::chrono::milliseconds>(now - _lastMark).count(), true});
+    _lastMark = now;
+}
+
+void Startup::runInBackground(const std::string& name, std::function<bool()> task, bool gatesReadiness)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _runningTasks++;
+    }
+    if (gatesReadiness) _pendingGates++;
+
+    _threads.emplace_back([this, name, task = std::move(task), gatesReadiness] {
+        Clock::time_point begin = Clock::now();
+        bool ok = false;
+        try {
+            ok = task();
+        } catch (const std::exception& e) {
+            logEvent(LogLevel::Error, "warmup_failed").field("task", name).field("error", e.what());
+        }
+        taskDone(name, msSince(begin), ok, gatesReadiness);
+    });
+}
+
+void Startup::taskDone(const std::string& name, int64_t ms, bool ok, bool gatesReadiness)
+{
+    std::vector<Phase> finished;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(Phase{name, ms, ok});
+        if (--_runningTasks == 0) finished = _tasks;
+    }
+    if (gatesReadiness) _pendingGates--;
+    if (finished.empty()) return;
+
+    LogLine line(LogLevel::Info, "warmup_complete");
+    for (const Phase& t : finished) {
+        line.field((t.name + "_ms").c_str(), t.ms);
+        if (!t.ok) line.field((t.name + "_ok").c_str(), false);
+    }
+    line.field("since_start_ms", msSince(_start));
+}
+
+void Startup::reportServing()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    LogLine line(LogLevel::Info, "startup_phases");
+    for (const Phase& p : _phases) line.field((p.name + "_ms").c_str(), p.ms);
+    line.field("total_ms", msSince(_start));
+    line.field("warmups_pending", static_cast<int64_t>(_runningTasks));
+}
+
+void Startup::join()
+{
+    for (std::thread& t : _threads) {
+        if (t.joinable()) t.join();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Startup timing and readiness.
+//
+// main() marks the end of each synchronous phase; warm-ups that are not
+// needed to answer requests correctly run as background tasks, so the
+// server starts listening without waiting for them. ready() (and /readyz)
+// turn true once every task that gates readiness has finished. Phases are
+// logged as "startup_phases" when the server starts listening and the tasks
+// as "warmup_complete" when the last one ends.
+class Startup
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Startup();          // the clock starts here
+    ~Startup();
+
+    // Records the time since the previous mark as phase `name`.
+    void mark(const char* name);
+
+    // Runs `task` on its own thread. A task returning false is logged but
+    // still counts as finished: warm-ups only make things faster.
+    void runInBackground(const std::string& name, std::function<bool()> task, bool gatesReadiness = true);
+
+    // Logs the synchronous phases. Call right before the server starts listening.
+    void reportServing();
+
+    bool ready() const { return _pendingGates.load() == 0; }
+
+    // Waits for every background task; they use the database, so this runs before it closes.
+    void join();
+
+private:
+    struct Phase {
+        std::string name;
+        int64_t ms;
+        bool ok;
+    };
+
+    int64_t msSince(Clock::time_point t) const;
+    void taskDone(const std::string& name, int64_t ms, bool ok, bool gatesReadiness);
+
+    Clock::time_point _start;
+    Clock::time_point _lastMark;
+    std::mutex _mutex;
+    std::vector<Phase> _phases;
+    std::vector<Phase> _tasks;          // finished background tasks
+    int _runningTasks = 0;
+    std::atomic<int> _pendingGates{0};
+    std::vector<std::thread> _threads;
+};
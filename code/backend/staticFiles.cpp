@@ -0,0 +1,58 @@
+#include "staticFiles.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+StaticFileCache::StaticFileCache()
+{
+    const char* env = std::getenv("FRONTEND_CACHE");
+    _enabled = !(env && std::string(env) == "0");
+}
+
+std::shared_ptr<const std::string> StaticFileCache::readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) return nullptr;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return std::make_shared<const std::string>(buffer.str());
+}
+
+std::shared_ptr<const std::string> StaticFileCache::get(const std::string& path)
+{
+    if (!_enabled) return readFile(path);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _files.find(path);
+        if (it != _files.end()) return it->second;
+    }
+
+    // Read outside the lock; two threads racing on the same file just read it twice.
+    auto contents = readFile(path);
+    if (contents) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _files.emplace(path, contents);
+    }
+    return contents;
+}
+
+std::size_t StaticFileCache::preload(const std::string& dir)
+{
+    if (!_enabled) return 0;
+    std::error_code ec;
+    std::size_t loaded = 0;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec)) continue;
+        // Same spelling the routes use ("code/frontend/login.html").
+        if (get(it->path().generic_string())) loaded++;
+    }
+    return loaded;
+}
+
+StaticFileCache& staticFiles()
+{
+    static StaticFileCache cache;
+    return cache;
+}
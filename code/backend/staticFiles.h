@@ -0,0 +1,29 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Frontend files kept in memory after the first read; they only change on a
+// redeploy. FRONTEND_CACHE=0 reads from disk every time (for editing pages
+// while the server runs). Missing files are not remembered.
+class StaticFileCache
+{
+public:
+    StaticFileCache();
+
+    // nullptr if the file cannot be read.
+    std::shared_ptr<const std::string> get(const std::string& path);
+
+    // Reads every regular file under `dir` into the cache; returns how many.
+    std::size_t preload(const std::string& dir);
+
+private:
+    std::shared_ptr<const std::string> readFile(const std::string& path);
+
+    bool _enabled;
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<const std::string>> _files;
+};
+
+StaticFileCache& staticFiles();
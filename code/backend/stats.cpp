@@ -0,0 +1,93 @@
+#include "stats.h"
+#include <fstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+void StatsRegistry::add(const std::string& section, Provider provider)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _providers.emplace_back(section, std::move(provider));
+}
+
+crow::json::wvalue StatsRegistry::collect() const
+{
+    std::vector<std::pair<std::string, Provider>> providers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        providers = _providers;
+    }
+    crow::json::wvalue out;
+    for (const auto& p : providers) {
+        crow::json::wvalue section;
+        p.second(section);
+        out[p.first] = std::move(section);
+    }
+    return out;
+}
+
+StatsRegistry& statsRegistry()
+{
+    static StatsRegistry registry;
+    return registry;
+}
+
+namespace {
+
+int64_t dbStatus(sqlite3* db, int op)
+{
+    int current = 0, highwater = 0;
+    sqlite3_db_status(db, op, &current, &highwater, 0);
+    return current;
+}
+
+// "VmRSS:    12345 kB" -> bytes
+int64_t statusKb(const std::string& line)
+{
+    std::size_t colon = line.find(':');
+    return colon == std::string::npos ? 0 : std::stoll(line.substr(colon + 1)) * 1024;
+}
+
+} // namespace
+
+void fillSqliteStats(crow::json::wvalue& section, sqlite3* db)
+{
+    int64_t hits = dbStatus(db, SQLITE_DBSTATUS_CACHE_HIT);
+    int64_t misses = dbStatus(db, SQLITE_DBSTATUS_CACHE_MISS);
+    section["page_cache_hits"] = hits;
+    section["page_cache_misses"] = misses;
+    section["page_cache_hit_rate"] = (hits + misses) > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+    section["page_cache_writes"] = dbStatus(db, SQLITE_DBSTATUS_CACHE_WRITE);
+    section["page_cache_bytes"] = dbStatus(db, SQLITE_DBSTATUS_CACHE_USED);
+    section["statement_bytes"] = dbStatus(db, SQLITE_DBSTATUS_STMT_USED);
+    section["schema_bytes"] = dbStatus(db, SQLITE_DBSTATUS_SCHEMA_USED);
+
+    sqlite3_int64 current = 0, highwater = 0;
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 0);
+    section["memory_used_bytes"] = static_cast<int64_t>(current);
+    section["memory_highwater_bytes"] = static_cast<int64_t>(highwater);
+
+    int64_t walBytes = 0;
+    const char* file = sqlite3_db_filename(db, "main");
+    if (file && *file) {
+        struct stat st;
+        if (stat((std::string(file) + "-wal").c_str(), &st) == 0) walBytes = st.st_size;
+    }
+    section["wal_bytes"] = walBytes;
+}
+
+void fillProcessStats(crow::json::wvalue& section)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) section["rss_bytes"] = statusKb(line);
+        else if (line.compare(0, 6, "VmHWM:") == 0) section["rss_peak_bytes"] = statusKb(line);
+        else if (line.compare(0, 8, "Threads:") == 0) section["threads"] = std::stoll(line.substr(8));
+    }
+
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        section["cpu_user_ms"] = static_cast<int64_t>(usage.ru_utime.tv_sec) * 1000 + usage.ru_utime.tv_usec / 1000;
+        section["cpu_system_ms"] = static_cast<int64_t>(usage.ru_stime.tv_sec) * 1000 + usage.ru_stime.tv_usec / 1000;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <crow.h>
+#include <functional>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sections of /debug/stats. Each module that owns runtime state registers a
+// function filling its own section; they run on the request thread, so they
+// should only read counters (or run one cheap query).
+class StatsRegistry
+{
+public:
+    using Provider = std::function<void(crow::json::wvalue& section)>;
+
+    void add(const std::string& section, Provider provider);
+    crow::json::wvalue collect() const;
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<std::pair<std::string, Provider>> _providers;
+};
+
+StatsRegistry& statsRegistry();
+
+// Page-cache hits/misses, statement and schema memory (sqlite3_db_status),
+// library-wide memory (sqlite3_status64) and the size of the -wal file.
+void fillSqliteStats(crow::json::wvalue& section, sqlite3* db);
+
+// Resident and peak memory, CPU time and thread count of this process.
+void fillProcessStats(crow::json::wvalue& section);
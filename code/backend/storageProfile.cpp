@@ -0,0 +1,166 @@
+#include "storageProfile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+const char* const JOURNAL_MODES[] = {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"};
+const char* const SYNC_MODES[] = {"OFF", "NORMAL", "FULL", "EXTRA"};
+const char* const TEMP_STORES[] = {"DEFAULT", "FILE", "MEMORY"};
+
+constexpr int64_t MB = 1024 * 1024;
+
+std::string upper(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return s;
+}
+
+template <std::size_t N>
+bool oneOf(const std::string& value, const char* const (&allowed)[N])
+{
+    return std::find(std::begin(allowed), std::end(allowed), value) != std::end(allowed);
+}
+
+// Keyword setting from the environment, only if it is one of `allowed`.
+template <std::size_t N>
+void overrideKeyword(const char* env, std::string& field, const char* const (&allowed)[N])
+{
+    const char* value = std::getenv(env);
+    if (!value || !*value) return;
+    std::string v = upper(value);
+    if (oneOf(v, allowed)) {
+        field = v;
+    } else {
+        std::cerr << "Ignoring " << env << "=" << value << std::endl;
+    }
+}
+
+template <typename T>
+void overrideNumber(const char* env, T& field, int64_t scale = 1)
+{
+    const char* value = std::getenv(env);
+    if (!value || !*value) return;
+    char* end = nullptr;
+    long long parsed = std::strtoll(value, &end, 10);
+    if (end && *end == '\0' && parsed >= 0) {
+        field = static_cast<T>(parsed * scale);
+    } else {
+        std::cerr << "Ignoring " << env << "=" << value << std::endl;
+    }
+}
+
+std::string pragmaText(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* stmt;
+    std::string out;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* text = sqlite3_column_text(stmt, 0);
+            if (text) out = reinterpret_cast<const char*>(text);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return out;
+}
+
+} // namespace
+
+std::vector<std::string> storageProfileNames()
+{
+    return {"durable", "balanced", "throughput", "legacy"};
+}
+
+bool storageProfilePreset(const std::string& name, StorageProfile& p)
+{
+    p = StorageProfile{};
+    p.name = name;
+    if (name == "durable") {
+        p.journalMode = "WAL";
+        p.synchronous = "FULL";
+        p.cacheSizeKb = 16 * 1024;
+        p.mmapBytes = 0;
+        p.tempStore = "DEFAULT";
+        p.walAutocheckpoint = 1000;
+    } else if (name == "balanced") {
+        p.journalMode = "WAL";
+        p.synchronous = "NORMAL";
+        p.cacheSizeKb = 64 * 1024;
+        p.mmapBytes = 256 * MB;
+        p.tempStore = "MEMORY";
+        p.walAutocheckpoint = 1000;
+    } else if (name == "throughput") {
+        p.journalMode = "WAL";
+        p.synchronous = "OFF";
+        p.cacheSizeKb = 256 * 1024;
+        p.mmapBytes = 1024 * MB;
+        p.tempStore = "MEMORY";
+        p.walAutocheckpoint = 10000;
+    } else if (name == "legacy") {
+        p.journalMode = "DELETE";
+        p.synchronous = "FULL";
+        p.cacheSizeKb = 2000;
+        p.mmapBytes = 0;
+        p.tempStore = "DEFAULT";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+StorageProfile loadStorageProfile()
+{
+    const char* env = std::getenv("FITNESS_DB_PROFILE");
+    std::string name = (env && *env) ? env : "balanced";
+
+    StorageProfile profile;
+    if (!storageProfilePreset(name, profile)) {
+        std::cerr << "Unknown FITNESS_DB_PROFILE '" << name << "', using balanced" << std::endl;
+        storageProfilePreset("balanced", profile);
+    }
+
+    overrideKeyword("FITNESS_DB_JOURNAL_MODE", profile.journalMode, JOURNAL_MODES);
+    overrideKeyword("FITNESS_DB_SYNCHRONOUS", profile.synchronous, SYNC_MODES);
+    overrideKeyword("FITNESS_DB_TEMP_STORE", profile.tempStore, TEMP_STORES);
+    overrideNumber("FITNESS_DB_CACHE_MB", profile.cacheSizeKb, 1024);
+    overrideNumber("FITNESS_DB_MMAP_MB", profile.mmapBytes, MB);
+    overrideNumber("FITNESS_DB_BUSY_TIMEOUT_MS", profile.busyTimeoutMs);
+    overrideNumber("FITNESS_DB_WAL_AUTOCHECKPOINT", profile.walAutocheckpoint);
+    return profile;
+}
+
+bool applyStorageProfile(sqlite3* db, const StorageProfile& p)
+{
+    // Keywords were validated when the profile was built, numbers are numbers.
+    sqlite3_busy_timeout(db, p.busyTimeoutMs);
+
+    // The journal mode belongs to the database file (WAL persists), and changing
+    // it needs a lock, so only connections that find it different set it.
+    std::string sql = "PRAGMA foreign_keys = ON;";
+    if (upper(pragmaText(db, "PRAGMA journal_mode;")) != p.journalMode) {
+        sql += "PRAGMA journal_mode = " + p.journalMode + ";";
+    }
+    sql +=
+        "PRAGMA synchronous = " + p.synchronous + ";"
+        "PRAGMA cache_size = -" + std::to_string(p.cacheSizeKb) + ";"
+        "PRAGMA mmap_size = " + std::to_string(p.mmapBytes) + ";"
+        "PRAGMA temp_store = " + p.tempStore + ";"
+        "PRAGMA wal_autocheckpoint = " + std::to_string(p.walAutocheckpoint) + ";";
+
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Failed to apply storage profile " << p.name << ": " << (errMsg ? errMsg : "") << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    // journal_mode reports the mode it ended up in rather than failing.
+    std::string mode = upper(pragmaText(db, "PRAGMA journal_mode;"));
+    if (mode != p.journalMode) {
+        std::cerr << "Requested journal_mode " << p.journalMode << " but the database is in " << mode << std::endl;
+        return false;
+    }
+    return true;
+}
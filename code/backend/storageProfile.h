@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+// Per-connection SQLite settings, picked by FITNESS_DB_PROFILE:
+//
+//   durable     WAL, synchronous=FULL: every commit is on disk before it returns.
+//   balanced    WAL, synchronous=NORMAL, 64 MB cache, 256 MB mmap (default).
+//               Survives crashes; a power cut can drop the last few commits.
+//   throughput  WAL, synchronous=OFF, 256 MB cache, 1 GB mmap, rare checkpoints.
+//               Survives the process crashing, not the OS or power; for
+//               benchmarks and throwaway environments.
+//   legacy      rollback journal, FULL, SQLite's default cache, no mmap
+//               (how the server ran before profiles existed). Reads share
+//               the writer, since a reader's SHARED lock would fail its COMMIT.
+//
+// Any field can then be overridden on its own: FITNESS_DB_JOURNAL_MODE,
+// FITNESS_DB_SYNCHRONOUS, FITNESS_DB_CACHE_MB, FITNESS_DB_MMAP_MB,
+// FITNESS_DB_TEMP_STORE, FITNESS_DB_BUSY_TIMEOUT_MS, FITNESS_DB_WAL_AUTOCHECKPOINT.
+struct StorageProfile {
+    std::string name;
+    std::string journalMode;      // DELETE, TRUNCATE, PERSIST, MEMORY, WAL, OFF
+    std::string synchronous;      // OFF, NORMAL, FULL, EXTRA
+    int64_t cacheSizeKb = 2000;   // page cache per connection
+    int64_t mmapBytes = 0;
+    std::string tempStore;        // DEFAULT, FILE, MEMORY
+    int busyTimeoutMs = 5000;
+    int walAutocheckpoint = 1000; // pages
+};
+
+// Names accepted by FITNESS_DB_PROFILE, in the order above.
+std::vector<std::string> storageProfileNames();
+
+// False if `name` is not a preset.
+bool storageProfilePreset(const std::string& name, StorageProfile& profile);
+
+// Preset from FITNESS_DB_PROFILE (default "balanced") plus per-field overrides.
+// Bad values are reported on stderr and ignored.
+StorageProfile loadStorageProfile();
+
+// Applies the profile (and foreign_keys = ON) to one connection. Every
+// connection the server opens goes through here. Returns false if a pragma
+// failed or the journal mode did not take (e.g. WAL on a read-only mount).
+bool applyStorageProfile(sqlite3* db, const StorageProfile& profile);
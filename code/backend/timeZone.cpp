@@ -0,0 +1,435 @@
+#include "timeZone.h"
+#include "database.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+// Transition tables are extended from the footer rule up to this year.
+constexpr int LAST_PRECOMPUTED_YEAR = 2100;
+
+uint32_t readBE32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+int64_t readBE64(const unsigned char* p) {
+    return static_cast<int64_t>((uint64_t(readBE32(p)) << 32) | readBE32(p + 4));
+}
+
+// ---- POSIX TZ footer ("EST5EDT,M3.2.0,M11.1.0") ----
+
+struct PosixRule {
+    char kind = 'M';      // 'M' (month.week.weekday), 'J' (1-365, no leap day), 'D' (0-365)
+    int month = 0, week = 0, weekday = 0, dayOfYear = 0;
+    int32_t time = 7200;  // local time of the switch, seconds (default 02:00)
+};
+
+struct PosixTz {
+    int32_t stdOffset = 0;  // seconds east of UTC
+    bool hasDst = false;
+    int32_t dstOffset = 0;
+    PosixRule start, end;
+};
+
+bool parsePosixName(const std::string& s, std::size_t& i) {
+    if (i < s.size() && s[i] == '<') {
+        std::size_t close = s.find('>', i);
+        if (close == std::string::npos) return false;
+        i = close + 1;
+        return true;
+    }
+    std::size_t begin = i;
+    while (i < s.size() && std::isalpha(static_cast<unsigned char>(s[i]))) ++i;
+    return i - begin >= 3;
+}
+
+bool parsePosixTime(const std::string& s, std::size_t& i, int32_t& out) {
+    int sign = 1;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) sign = s[i++] == '-' ? -1 : 1;
+    int32_t parts[3] = {0, 0, 0};
+    for (int p = 0; p < 3; ++p) {
+        if (i >= s.size() || !std::isdigit(static_cast<unsigned char>(s[i]))) {
+            if (p == 0) return false;
+            break;
+        }
+        int32_t v = 0;
+        while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) v = v * 10 + (s[i++] - '0');
+        parts[p] = v;
+        if (p < 2 && i < s.size() && s[i] == ':') ++i; else break;
+    }
+    out = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+    return true;
+}
+
+bool parseInt(const std::string& s, std::size_t& i, int& out) {
+    if (i >= s.size() || !std::isdigit(static_cast<unsigned char>(s[i]))) return false;
+    out = 0;
+    while (i < s.size() && std::isdigit(static_cast<unsigned char>(s[i]))) out = out * 10 + (s[i++] - '0');
+    return true;
+}
+
+bool parsePosixRule(const std::string& s, std::size_t& i, PosixRule& r) {
+    if (i < s.size() && s[i] == 'M') {
+        ++i;
+        r.kind = 'M';
+        if (!parseInt(s, i, r.month) || i >= s.size() || s[i++] != '.') return false;
+        if (!parseInt(s, i, r.week) || i >= s.size() || s[i++] != '.') return false;
+        if (!parseInt(s, i, r.weekday)) return false;
+        if (r.month < 1 || r.month > 12 || r.week < 1 || r.week > 5 || r.weekday > 6) return false;
+    } else if (i < s.size() && s[i] == 'J') {
+        ++i;
+        r.kind = 'J';
+        if (!parseInt(s, i, r.dayOfYear) || r.dayOfYear < 1 || r.dayOfYear > 365) return false;
+    } else {
+        r.kind = 'D';
+        if (!parseInt(s, i, r.dayOfYear) || r.dayOfYear > 365) return false;
+    }
+    if (i < s.size() && s[i] == '/') {
+        ++i;
+        if (!parsePosixTime(s, i, r.time)) return false;
+    }
+    return true;
+}
+
+bool parsePosixTz(const std::string& s, PosixTz& tz) {
+    std::size_t i = 0;
+    int32_t westOffset;
+    if (!parsePosixName(s, i) || !parsePosixTime(s, i, westOffset)) return false;
+    tz.stdOffset = -westOffset;
+    if (i == s.size()) return true;
+
+    if (!parsePosixName(s, i)) return false;
+    tz.hasDst = true;
+    tz.dstOffset = tz.stdOffset + 3600;
+    if (i < s.size() && s[i] != ',') {
+        if (!parsePosixTime(s, i, westOffset)) return false;
+        tz.dstOffset = -westOffset;
+    }
+    if (i >= s.size() || s[i++] != ',' || !parsePosixRule(s, i, tz.start)) return false;
+    if (i >= s.size() || s[i++] != ',' || !parsePosixRule(s, i, tz.end)) return false;
+    return i == s.size();
+}
+
+bool isLeap(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Local day on which a rule fires in the given year.
+Day ruleDay(const PosixRule& r, int year) {
+    if (r.kind == 'J') {
+        int doy = r.dayOfYear;  // 1..365, Feb 29 never counted
+        Day d = dayFromCivil(year, 1, 1) + (doy - 1);
+        if (isLeap(year) && doy >= 60) d = d + 1;
+        return d;
+    }
+    if (r.kind == 'D') {
+        return dayFromCivil(year, 1, 1) + r.dayOfYear;
+    }
+
+    // Weekday of the first of the month; 1970-01-01 was a Thursday (4).
+    Day first = dayFromCivil(year, static_cast<unsigned>(r.month), 1);
+    int firstWeekday = ((first.value % 7) + 7 + 4) % 7;
+    int dom = 1 + (r.weekday - firstWeekday + 7) % 7 + (r.week - 1) * 7;
+    static const int monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int daysInMonth = monthDays[r.month - 1] + ((r.month == 2 && isLeap(year)) ? 1 : 0);
+    while (dom > daysInMonth) dom -= 7;
+    return first + (dom - 1);
+}
+
+// ---- registry ----
+
+std::shared_mutex registryMutex;
+std::unordered_map<std::string, std::shared_ptr<const TimeZone>> registry;
+
+std::shared_mutex userZoneMutex;
+std::unordered_map<int, std::shared_ptr<const TimeZone>> userZoneCache;  // nullptr = follows server
+
+// False when the user's zone hasn't been looked up yet
+bool cachedUserTimeZone(int user_id, std::shared_ptr<const TimeZone>& out) {
+    std::shared_lock<std::shared_mutex> lock(userZoneMutex);
+    auto it = userZoneCache.find(user_id);
+    if (it == userZoneCache.end()) return false;
+    out = it->second ? it->second : serverTimeZone();
+    return true;
+}
+
+bool isSafeZoneName(const std::string& name) {
+    if (name.empty() || name.size() > 64 || name[0] == '/' || name.find("..") != std::string::npos) return false;
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '/' && c != '_' && c != '-' && c != '+') return false;
+    }
+    return true;
+}
+
+std::string zoneInfoDir() {
+    const char* dir = std::getenv("TZDIR");
+    return dir ? dir : "/usr/share/zoneinfo";
+}
+
+} // namespace
+
+std::shared_ptr<const TimeZone> TimeZone::fixed(const std::string& name, int32_t offsetSeconds)
+{
+    std::shared_ptr<TimeZone> tz(new TimeZone());
+    tz->_name = name;
+    tz->_initialOffset = offsetSeconds;
+    return tz;
+}
+
+std::shared_ptr<const TimeZone> TimeZone::fromTzif(const std::string& name, const std::string& path)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) return nullptr;
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    const std::size_t HEADER = 44;
+    if (data.size() < HEADER || data[0] != 'T' || data[1] != 'Z' || data[2] != 'i' || data[3] != 'f') return nullptr;
+
+    struct Counts { uint32_t isut, isstd, leap, time, type, chars; };
+    auto readCounts = [&](std::size_t at) {
+        const unsigned char* p = data.data() + at + 20;
+        return Counts{readBE32(p), readBE32(p + 4), readBE32(p + 8), readBE32(p + 12), readBE32(p + 16), readBE32(p + 20)};
+    };
+
+    // v1 block (32-bit times). For v2+ files skip it and read the 64-bit block instead.
+    Counts c = readCounts(0);
+    std::size_t pos = HEADER;
+    int timeSize = 4;
+    char version = static_cast<char>(data[4]);
+    if (version >= '2') {
+        pos += c.time * 5 + c.type * 6 + c.chars + c.leap * 8 + c.isstd + c.isut;
+        if (data.size() < pos + HEADER) return nullptr;
+        c = readCounts(pos);
+        pos += HEADER;
+        timeSize = 8;
+    }
+
+    std::size_t blockSize = c.time * (timeSize + 1) + c.type * 6 + c.chars + c.leap * (timeSize + 4) + c.isstd + c.isut;
+    if (c.type == 0 || data.size() < pos + blockSize) return nullptr;
+
+    const unsigned char* times = data.data() + pos;
+    const unsigned char* indices = times + c.time * timeSize;
+    const unsigned char* types = indices + c.time;
+
+    std::vector<int32_t> typeOffsets(c.type);
+    for (uint32_t t = 0; t < c.type; ++t) {
+        typeOffsets[t] = static_cast<int32_t>(readBE32(types + t * 6));
+    }
+
+    std::shared_ptr<TimeZone> tz(new TimeZone());
+    tz->_name = name;
+    tz->_initialOffset = typeOffsets[0];
+    tz->_transitions.reserve(c.time);
+    tz->_offsets.reserve(c.time);
+    for (uint32_t t = 0; t < c.time; ++t) {
+        int64_t at = timeSize == 8 ? readBE64(times + t * 8) : static_cast<int32_t>(readBE32(times + t * 4));
+        uint8_t idx = indices[t];
+        if (idx >= c.type) return nullptr;
+        tz->_transitions.push_back(at);
+        tz->_offsets.push_back(typeOffsets[idx]);
+    }
+
+    // Footer: "\n<POSIX TZ>\n", describes everything after the last transition.
+    std::size_t footer = pos + blockSize;
+    if (timeSize == 8 && footer < data.size() && data[footer] == '\n') {
+        std::size_t endOfFooter = footer + 1;
+        while (endOfFooter < data.size() && data[endOfFooter] != '\n') ++endOfFooter;
+        std::string rule(data.begin() + footer + 1, data.begin() + endOfFooter);
+
+        PosixTz posix;
+        if (!rule.empty() && parsePosixTz(rule, posix)) {
+            // Without DST the last transition already holds the final offset.
+            if (posix.hasDst) {
+                int64_t lastAt = tz->_transitions.empty() ? INT64_MIN : tz->_transitions.back();
+                int firstYear = 1970;
+                if (!tz->_transitions.empty()) {
+                    int y; unsigned m, d;
+                    civilFromDay(::dayAt(Timestamp{lastAt}, 0), y, m, d);
+                    firstYear = std::max(1970, y);
+                }
+                for (int year = firstYear; year <= LAST_PRECOMPUTED_YEAR; ++year) {
+                    int64_t dstStart = ::startOfDay(ruleDay(posix.start, year), posix.stdOffset).value + posix.start.time;
+                    int64_t dstEnd = ::startOfDay(ruleDay(posix.end, year), posix.dstOffset).value + posix.end.time;
+                    std::pair<int64_t, int32_t> pairs[2] = {{dstStart, posix.dstOffset}, {dstEnd, posix.stdOffset}};
+                    if (pairs[1].first < pairs[0].first) std::swap(pairs[0], pairs[1]);  // southern hemisphere
+                    for (auto& p : pairs) {
+                        if (p.first > lastAt) {
+                            tz->_transitions.push_back(p.first);
+                            tz->_offsets.push_back(p.second);
+                            lastAt = p.first;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return tz;
+}
+
+int32_t TimeZone::offsetAt(Timestamp utc) const
+{
+    auto it = std::upper_bound(_transitions.begin(), _transitions.end(), utc.value);
+    if (it == _transitions.begin()) return _initialOffset;
+    return _offsets[static_cast<std::size_t>(it - _transitions.begin()) - 1];
+}
+
+Day TimeZone::dayAt(Timestamp utc) const
+{
+    return ::dayAt(utc, offsetAt(utc));
+}
+
+Timestamp TimeZone::fromLocal(Day d, int32_t secondsOfDay) const
+{
+    int64_t local = static_cast<int64_t>(d.value) * SECONDS_PER_DAY + secondsOfDay;
+
+    // Guess with the offset in effect just before, then correct once.
+    int32_t before = offsetAt(Timestamp{local - offsetAt(Timestamp{local}) - SECONDS_PER_DAY});
+    Timestamp utc{local - before};
+    int32_t actual = offsetAt(utc);
+    if (actual != before && offsetAt(Timestamp{local - actual}) == actual) {
+        utc = Timestamp{local - actual};
+    }
+    return utc;
+}
+
+void TimeZone::dayRange(Day first, Day last, Timestamp& outBegin, Timestamp& outEnd) const
+{
+    outBegin = startOfDay(first);
+    outEnd = startOfDay(last + 1);
+}
+
+char* TimeZone::formatLocal(Timestamp utc, char (&out)[DATETIME_BUF_SIZE]) const
+{
+    return formatDateTime(utc, offsetAt(utc), out);
+}
+
+std::string TimeZone::formatLocal(Timestamp utc) const
+{
+    return toDateTimeString(utc, offsetAt(utc));
+}
+
+std::shared_ptr<const TimeZone> findTimeZone(const std::string& name)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(registryMutex);
+        auto it = registry.find(name);
+        if (it != registry.end()) return it->second;
+    }
+
+    std::shared_ptr<const TimeZone> tz;
+    int32_t fixedOffset;
+    if (parseUtcOffset(name, fixedOffset)) {
+        tz = TimeZone::fixed(name, fixedOffset);
+    } else if (isSafeZoneName(name)) {
+        tz = TimeZone::fromTzif(name, zoneInfoDir() + "/" + name);
+    }
+    if (!tz) return nullptr;
+
+    std::unique_lock<std::shared_mutex> lock(registryMutex);
+    return registry.emplace(name, tz).first->second;
+}
+
+std::shared_ptr<const TimeZone> serverTimeZone()
+{
+    static const std::shared_ptr<const TimeZone> zone = [] {
+        std::shared_ptr<const TimeZone> tz;
+        const char* env = std::getenv("TZ");
+        if (env && *env) {
+            tz = findTimeZone(env[0] == ':' ? env + 1 : env);
+        }
+        if (!tz) tz = TimeZone::fromTzif("localtime", "/etc/localtime");
+        if (!tz) tz = TimeZone::fixed("UTC", 0);
+        return tz;
+    }();
+    return zone;
+}
+
+std::shared_ptr<const TimeZone> userTimeZone(sqlite3* db, int user_id)
+{
+    std::shared_ptr<const TimeZone> cached;
+    if (cachedUserTimeZone(user_id, cached)) return cached;
+
+    // NULL (or unknown) timezone means "follow the server", which is what
+    // every date was based on before users could pick their own zone.
+    std::shared_ptr<const TimeZone> tz;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT timezone FROM users WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return serverTimeZone();
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* name = sqlite3_column_text(stmt, 0);
+        if (name) tz = findTimeZone(reinterpret_cast<const char*>(name));
+    }
+    sqlite3_finalize(stmt);
+
+    {
+        std::unique_lock<std::shared_mutex> lock(userZoneMutex);
+        userZoneCache[user_id] = tz;
+    }
+    return tz ? tz : serverTimeZone();
+}
+
+bool setUserTimezone(sqlite3* db, int user_id, const std::string& timezone)
+{
+    std::shared_ptr<const TimeZone> tz = findTimeZone(timezone);
+    if (!tz) return false;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "UPDATE users SET timezone = ? WHERE id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, timezone.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, user_id);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) > 0;
+    sqlite3_finalize(stmt);
+
+    if (ok) {
+        std::unique_lock<std::shared_mutex> lock(userZoneMutex);
+        userZoneCache[user_id] = tz;
+    }
+    return ok;
+}
+
+Day todayForUser(sqlite3* db, int user_id)
+{
+    return userTimeZone(db, user_id)->dayAt(nowUtc());
+}
+
+bool parseUserDay(sqlite3* db, int user_id, const std::string& s, Day& out)
+{
+    if (s == "today") {
+        out = todayForUser(db, user_id);
+        return true;
+    }
+    return parseDate(s, out);
+}
+
+std::shared_ptr<const TimeZone> userTimeZone(Database& database, int user_id)
+{
+    std::shared_ptr<const TimeZone> cached;
+    if (cachedUserTimeZone(user_id, cached)) return cached;
+    return userTimeZone(database.read(), user_id);
+}
+
+Day todayForUser(Database& database, int user_id)
+{
+    return userTimeZone(database, user_id)->dayAt(nowUtc());
+}
+
+bool parseUserDay(Database& database, int user_id, const std::string& s, Day& out)
+{
+    if (s == "today") {
+        out = todayForUser(database, user_id);
+        return true;
+    }
+    return parseDate(s, out);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "dateTime.h"
+#include <memory>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+class Database;
+
+// UTC-offset transition table for one zone. IANA zones are read once from the
+// system tz database (TZif files) and extended through 2100 from the POSIX rule
+// in the file footer, so every lookup after that is a binary search.
+class TimeZone
+{
+public:
+    // Zone with a single offset, e.g. "UTC" or "+05:30".
+    static std::shared_ptr<const TimeZone> fixed(const std::string& name, int32_t offsetSeconds);
+    // Zone loaded from a TZif file. Returns nullptr if the file is missing or malformed.
+    static std::shared_ptr<const TimeZone> fromTzif(const std::string& name, const std::string& path);
+
+    const std::string& name() const { return _name; }
+
+    int32_t offsetAt(Timestamp utc) const;
+    Day dayAt(Timestamp utc) const;
+    // Local wall-clock time -> UTC. Times inside a DST gap resolve with the offset
+    // in effect before the gap; repeated times resolve to the first occurrence.
+    Timestamp fromLocal(Day d, int32_t secondsOfDay) const;
+    // First instant of a local calendar day.
+    Timestamp startOfDay(Day d) const { return fromLocal(d, 0); }
+    // [startOfDay(first), startOfDay(last + 1)) as UTC seconds.
+    void dayRange(Day first, Day last, Timestamp& outBegin, Timestamp& outEnd) const;
+
+    char* formatLocal(Timestamp utc, char (&out)[DATETIME_BUF_SIZE]) const;
+    std::string formatLocal(Timestamp utc) const;
+
+private:
+    TimeZone() {}
+
+    std::string _name;
+    int32_t _initialOffset = 0;
+    std::vector<int64_t> _transitions;  // UTC instants where the offset changes, ascending
+    std::vector<int32_t> _offsets;      // _offsets[i] is in effect from _transitions[i]
+};
+
+// Zone registry. Each zone is built once and then shared by every caller.
+// Accepts IANA names ("Europe/Berlin") and fixed offsets ("UTC", "+05:30").
+std::shared_ptr<const TimeZone> findTimeZone(const std::string& name);
+
+// Zone used when no user is known: $TZ if set, else /etc/localtime, else UTC.
+std::shared_ptr<const TimeZone> serverTimeZone();
+
+// Per-user timezone from users.timezone (NULL follows the server), cached in memory.
+std::shared_ptr<const TimeZone> userTimeZone(sqlite3* db, int user_id);
+bool setUserTimezone(sqlite3* db, int user_id, const std::string& timezone);
+
+// Today in a given user's timezone.
+Day todayForUser(sqlite3* db, int user_id);
+
+// Day named by a request parameter: "today" (in the user's zone) or "YYYY-MM-DD".
+bool parseUserDay(sqlite3* db, int user_id, const std::string& s, Day& out);
+
+// The same, leasing a reader from `database` only when the user's zone isn't
+// cached yet, so a cache key can be computed without a connection.
+std::shared_ptr<const TimeZone> userTimeZone(Database& database, int user_id);
+Day todayForUser(Database& database, int user_id);
+bool parseUserDay(Database& database, int user_id, const std::string& s, Day& out);
@@ -0,0 +1,333 @@
+#include "userDirectory.h"
+#include <iostream>
+
+namespace {
+
+uint64_t hashId(int id)
+{
+    uint64_t x = static_cast<uint32_t>(id);
+    x ^= x >> 16;
+    x *= 0x7feb352dULL;
+    x ^= x >> 15;
+    x *= 0x846ca68bULL;
+    x ^= x >> 16;
+    return x;
+}
+
+uint64_t hashText(std::string_view s)
+{
+    uint64_t h = 1469598103934665603ULL;  // FNV-1a
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::size_t tableSizeFor(std::size_t entries)
+{
+    std::size_t size = 16;
+    while (size < entries * 2) size <<= 1;  // keep the load factor at or below 1/2
+    return size;
+}
+
+template <typename Matches>
+const UserDirectory::Entry* probe(const std::vector<uint32_t>& table, const std::vector<UserDirectory::Entry>& entries,
+                                  uint64_t hash, Matches matches)
+{
+    if (table.empty()) return nullptr;
+    std::size_t mask = table.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t slot = table[i];
+        if (slot == 0) return nullptr;
+        const UserDirectory::Entry& e = entries[slot - 1];
+        if (matches(e)) return &e;
+    }
+}
+
+void place(std::vector<uint32_t>& table, uint64_t hash, uint32_t slot)
+{
+    std::size_t mask = table.size() - 1;
+    std::size_t i = hash & mask;
+    while (table[i] != 0) i = (i + 1) & mask;
+    table[i] = slot;
+}
+
+const char* columnText(sqlite3_stmt* stmt, int col)
+{
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    return text ? reinterpret_cast<const char*>(text) : "";
+}
+
+// Copies the strings of `records` into one chunk and appends entries viewing it.
+void appendRecords(std::vector<std::shared_ptr<const std::string>>& chunks, std::vector<UserDirectory::Entry>& entries,
+                   const std::vector<UserRecord>& records, std::size_t& liveBytes)
+{
+    std::size_t bytes = 0;
+    for (const UserRecord& r : records) bytes += r.username.size() + r.email.size() + r.passwordHash.size();
+
+    auto chunk = std::make_shared<std::string>();
+    chunk->reserve(bytes);
+    for (const UserRecord& r : records) {
+        chunk->append(r.username).append(r.email).append(r.passwordHash);
+    }
+
+    const char* base = chunk->data();
+    std::size_t offset = 0;
+    for (const UserRecord& r : records) {
+        UserDirectory::Entry e;
+        e.id = r.id;
+        e.username = std::string_view(base + offset, r.username.size());
+        offset += r.username.size();
+        e.email = std::string_view(base + offset, r.email.size());
+        offset += r.email.size();
+        e.passwordHash = std::string_view(base + offset, r.passwordHash.size());
+        offset += r.passwordHash.size();
+        entries.push_back(e);
+    }
+    liveBytes += bytes;
+    chunks.push_back(std::move(chunk));
+}
+
+UserRecord toRecord(const UserDirectory::Entry& e)
+{
+    return UserRecord{e.id, std::string(e.username), std::string(e.email), std::string(e.passwordHash)};
+}
+
+std::size_t entryBytes(const UserDirectory::Entry& e)
+{
+    return e.username.size() + e.email.size() + e.passwordHash.size();
+}
+
+} // namespace
+
+// ---- Snapshot ----
+
+const UserDirectory::Entry* UserDirectory::Snapshot::findById(int id) const
+{
+    return probe(_byId, _entries, hashId(id), [id](const Entry& e) { return e.id == id; });
+}
+
+const UserDirectory::Entry* UserDirectory::Snapshot::findByUsername(std::string_view username) const
+{
+    return probe(_byUsername, _entries, hashText(username), [username](const Entry& e) { return e.username == username; });
+}
+
+const UserDirectory::Entry* UserDirectory::Snapshot::findByEmail(std::string_view email) const
+{
+    return probe(_byEmail, _entries, hashText(email), [email](const Entry& e) { return e.email == email; });
+}
+
+void UserDirectory::Snapshot::rebuildIndexes()
+{
+    std::size_t size = tableSizeFor(_entries.size());
+    _byId.assign(size, 0);
+    _byUsername.assign(size, 0);
+    _byEmail.assign(size, 0);
+    for (uint32_t i = 0; i < _entries.size(); ++i) {
+        const Entry& e = _entries[i];
+        place(_byId, hashId(e.id), i + 1);
+        place(_byUsername, hashText(e.username), i + 1);
+        place(_byEmail, hashText(e.email), i + 1);
+    }
+}
+
+// ---- UserDirectory ----
+
+bool UserDirectory::load(sqlite3* db)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    return loadLocked(db);
+}
+
+bool UserDirectory::loadLocked(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, username, email, password_hash FROM users;", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to load user directory: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    std::vector<UserRecord> records;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        records.push_back(UserRecord{sqlite3_column_int(stmt, 0), columnText(stmt, 1), columnText(stmt, 2), columnText(stmt, 3)});
+    }
+    sqlite3_finalize(stmt);
+
+    auto next = std::make_shared<Snapshot>();
+    next->_entries.reserve(records.size());
+    appendRecords(next->_chunks, next->_entries, records, next->_liveBytes);
+    next->rebuildIndexes();
+    publish(std::move(next));
+    _loaded = true;
+    return true;
+}
+
+void UserDirectory::ensureLoaded(sqlite3* db)
+{
+    if (_loaded.load(std::memory_order_acquire)) return;
+    // The startup warm-up may be loading right now; wait for it instead of loading twice.
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    if (!_loaded.load(std::memory_order_acquire)) loadLocked(db);
+}
+
+std::shared_ptr<const UserDirectory::Snapshot> UserDirectory::snapshot() const
+{
+    // Each thread holds on to the snapshot it last saw and only re-reads the
+    // shared pointer after a writer bumped the version.
+    struct Cached {
+        const UserDirectory* owner = nullptr;
+        uint64_t version = 0;
+        std::shared_ptr<const Snapshot> snap;
+    };
+    thread_local Cached cached;
+
+    uint64_t version = _version.load(std::memory_order_acquire);
+    if (cached.owner != this || cached.version != version || !cached.snap) {
+        cached.snap = std::atomic_load(&_current);
+        cached.owner = this;
+        cached.version = version;
+    }
+    return cached.snap;
+}
+
+void UserDirectory::publish(std::shared_ptr<const Snapshot> next)
+{
+    std::atomic_store(&_current, std::move(next));
+    _version.fetch_add(1, std::memory_order_release);
+}
+
+void UserDirectory::upsert(const UserRecord& record)
+{
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&_current);
+    auto next = current ? std::make_shared<Snapshot>(*current) : std::make_shared<Snapshot>();
+
+    std::vector<Entry> added;
+    appendRecords(next->_chunks, added, {record}, next->_liveBytes);
+    const Entry& fresh = added.front();
+
+    bool reindex = true;
+    const Entry* old = current ? current->findById(record.id) : nullptr;
+    if (old) {
+        std::size_t index = static_cast<std::size_t>(old - current->_entries.data());
+        reindex = old->username != fresh.username || old->email != fresh.email;
+        next->_liveBytes -= entryBytes(*old);
+        next->_deadBytes += entryBytes(*old);
+        next->_entries[index] = fresh;
+    } else {
+        next->_entries.push_back(fresh);
+        if (tableSizeFor(next->_entries.size()) == next->_byId.size()) {
+            // Still under the load limit: add to the copied tables instead of rebuilding.
+            uint32_t slot = static_cast<uint32_t>(next->_entries.size());
+            place(next->_byId, hashId(fresh.id), slot);
+            place(next->_byUsername, hashText(fresh.username), slot);
+            place(next->_byEmail, hashText(fresh.email), slot);
+            reindex = false;
+        }
+    }
+
+    // Replaced strings stay in their chunk; repack once they outweigh the live ones.
+    if (next->_deadBytes > next->_liveBytes) {
+        std::vector<UserRecord> records;
+        records.reserve(next->_entries.size());
+        for (const Entry& e : next->_entries) records.push_back(toRecord(e));
+        next->_chunks.clear();
+        next->_entries.clear();
+        next->_liveBytes = next->_deadBytes = 0;
+        appendRecords(next->_chunks, next->_entries, records, next->_liveBytes);
+    }
+
+    if (reindex) next->rebuildIndexes();
+    publish(std::move(next));
+}
+
+void UserDirectory::remove(int userId)
+{
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&_current);
+    if (!current || !current->findById(userId)) return;
+
+    auto next = std::make_shared<Snapshot>(*current);
+    for (std::size_t i = 0; i < next->_entries.size(); ++i) {
+        if (next->_entries[i].id != userId) continue;
+        next->_liveBytes -= entryBytes(next->_entries[i]);
+        next->_deadBytes += entryBytes(next->_entries[i]);
+        next->_entries.erase(next->_entries.begin() + static_cast<std::ptrdiff_t>(i));
+        break;
+    }
+    next->rebuildIndexes();
+    publish(std::move(next));
+}
+
+std::optional<UserRecord> UserDirectory::fetch(sqlite3* db, const char* where, int id, const std::string* text)
+{
+    std::string sql = std::string("SELECT id, username, email, password_hash FROM users WHERE ") + where + " LIMIT 1;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return std::nullopt;
+    }
+    if (text) {
+        sqlite3_bind_text(stmt, 1, text->c_str(), -1, SQLITE_TRANSIENT);
+    } else {
+        sqlite3_bind_int(stmt, 1, id);
+    }
+
+    std::optional<UserRecord> found;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        found = UserRecord{sqlite3_column_int(stmt, 0), columnText(stmt, 1), columnText(stmt, 2), columnText(stmt, 3)};
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+void UserDirectory::refreshUser(sqlite3* db, int userId)
+{
+    ensureLoaded(db);
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    if (auto record = fetch(db, "id = ?", userId, nullptr)) {
+        upsert(*record);
+    } else {
+        remove(userId);
+    }
+}
+
+std::optional<UserRecord> UserDirectory::byId(sqlite3* db, int userId)
+{
+    ensureLoaded(db);
+    auto snap = snapshot();
+    if (const Entry* e = snap ? snap->findById(userId) : nullptr) return toRecord(*e);
+
+    // Not cached: the row may have been written by something that did not refresh us.
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    auto record = fetch(db, "id = ?", userId, nullptr);
+    if (record) upsert(*record);
+    return record;
+}
+
+std::optional<UserRecord> UserDirectory::byUsername(sqlite3* db, const std::string& username)
+{
+    ensureLoaded(db);
+    auto snap = snapshot();
+    if (const Entry* e = snap ? snap->findByUsername(username) : nullptr) return toRecord(*e);
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    auto record = fetch(db, "username = ?", 0, &username);
+    if (record) upsert(*record);
+    return record;
+}
+
+std::optional<UserRecord> UserDirectory::byEmail(sqlite3* db, const std::string& email)
+{
+    ensureLoaded(db);
+    auto snap = snapshot();
+    if (const Entry* e = snap ? snap->findByEmail(email) : nullptr) return toRecord(*e);
+
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    auto record = fetch(db, "email = ?", 0, &email);
+    if (record) upsert(*record);
+    return record;
+}
+
+UserDirectory& userDirectory()
+{
+    static UserDirectory directory;
+    return directory;
+}
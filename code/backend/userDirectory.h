@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Owning copy of one users row, handed out by the convenience lookups.
+struct UserRecord {
+    int id = 0;
+    std::string username;
+    std::string email;
+    std::string passwordHash;
+};
+
+// In-memory id/username/email index over the users table.
+//
+// Readers work on an immutable Snapshot: strings live in shared append-only
+// chunks and three open-addressing tables map id, username and email to an
+// entry. A change publishes a new snapshot (copy-on-write) and bumps a
+// version counter; each reader thread keeps its own reference and only
+// touches the shared pointer when the version moved, so lookups never wait
+// on a writer.
+class UserDirectory
+{
+public:
+    struct Entry {
+        int id;
+        std::string_view username;      // views into the snapshot's string chunks
+        std::string_view email;
+        std::string_view passwordHash;
+    };
+
+    class Snapshot
+    {
+    public:
+        const Entry* findById(int id) const;
+        const Entry* findByUsername(std::string_view username) const;
+        const Entry* findByEmail(std::string_view email) const;
+        std::size_t size() const { return _entries.size(); }
+
+    private:
+        friend class UserDirectory;
+        void rebuildIndexes();
+
+        std::vector<std::shared_ptr<const std::string>> _chunks;
+        std::vector<Entry> _entries;
+        std::vector<uint32_t> _byId;        // slot = entry index + 1, 0 = empty
+        std::vector<uint32_t> _byUsername;
+        std::vector<uint32_t> _byEmail;
+        std::size_t _liveBytes = 0;
+        std::size_t _deadBytes = 0;         // strings of replaced rows, dropped on compaction
+    };
+
+    // Reads every user. Called by a startup warm-up; lookups load lazily otherwise.
+    bool load(sqlite3* db);
+
+    // Re-reads one row after it was inserted, updated or deleted.
+    void refreshUser(sqlite3* db, int userId);
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Lookups that fall back to SQLite on a miss (and remember what they find).
+    std::optional<UserRecord> byId(sqlite3* db, int userId);
+    std::optional<UserRecord> byUsername(sqlite3* db, const std::string& username);
+    std::optional<UserRecord> byEmail(sqlite3* db, const std::string& email);
+
+private:
+    bool loadLocked(sqlite3* db);
+    std::optional<UserRecord> fetch(sqlite3* db, const char* where, int id, const std::string* text);
+    void publish(std::shared_ptr<const Snapshot> next);
+    void upsert(const UserRecord& record);
+    void remove(int userId);
+    void ensureLoaded(sqlite3* db);
+
+    std::mutex _writeMutex;                     // one writer at a time
+    std::shared_ptr<const Snapshot> _current;   // accessed with std::atomic_load/store
+    std::atomic<uint64_t> _version{0};
+    std::atomic<bool> _loaded{false};
+};
+
+// Process-wide directory used by the login, register, reset and invite code.
+UserDirectory& userDirectory();
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdio>
+
+// What the tests in code/tests share: CHECK() reports a failed condition and
+// keeps going, and main() ends with `return checkResult("name");`, which
+// is nonzero when anything failed. Works with NDEBUG, unlike assert().
+inline int& checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++checkFailures();                                                                \
+        }                                                                                     \
+    } while (0)
+
+inline int checkResult(const char* name)
+{
+    if (checkFailures() == 0) {
+        std::printf("%s: ok\n", name);
+        return 0;
+    }
+    std::printf("%s: %d check(s) failed\n", name, checkFailures());
+    return 1;
+}
@@ -0,0 +1,150 @@
+// dto::Reader and dto::Schema: escapes decoded into the scratch buffer,
+// duplicate and missing fields, and integers narrowed to the member type.
+#include "check.h"
+#include "dto.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace {
+
+struct MealDto {
+    std::string_view meal_name;
+    int calories = 0;
+    std::optional<std::string_view> date;
+    std::optional<int16_t> portions;
+    int64_t logged_at = 0;
+};
+
+constexpr auto MEAL_SCHEMA = dto::schema<MealDto>(
+    dto::required("meal_name", &MealDto::meal_name).length(1, 100),
+    dto::required("calories", &MealDto::calories).range(0, 20000),
+    dto::optional("date", &MealDto::date).satisfies(dto::isDate, "expected YYYY-MM-DD"),
+    dto::optional("portions", &MealDto::portions),
+    dto::optional("logged_at", &MealDto::logged_at));
+
+bool inside(std::string_view view, const char* begin, std::size_t size)
+{
+    return view.data() >= begin && view.data() + view.size() <= begin + size;
+}
+
+std::string errorFor(std::string_view body)
+{
+    auto meal = MEAL_SCHEMA.parse(body);
+    return meal ? std::string() : meal.error();
+}
+
+void readerEscapes()
+{
+    const std::string body =
+        R"({"plain":"toast","quoted":"a\"b\\c\/d\n","accent":"Caf\u00e9 \ud83d\ude00"})";
+    std::pmr::string scratch;
+    dto::Reader reader(body, scratch);
+    CHECK(reader.beginObject());
+
+    std::string_view key, plain, quoted, accent;
+    CHECK(reader.nextKey(key) && key == "plain");
+    CHECK(reader.readString(plain));
+    CHECK(reader.nextKey(key) && key == "quoted");
+    CHECK(reader.readString(quoted));
+    CHECK(reader.nextKey(key) && key == "accent");
+    CHECK(reader.readString(accent));
+    CHECK(!reader.nextKey(key));
+    CHECK(reader.finish());
+    CHECK(!reader.failed());
+
+    // Unescaped values are slices of the body; escaped ones live in scratch
+    CHECK(plain == "toast");
+    CHECK(inside(plain, body.data(), body.size()));
+    CHECK(quoted == "a\"b\\c/d\n");
+    CHECK(accent == "Caf\xc3\xa9 \xf0\x9f\x98\x80");
+    CHECK(inside(quoted, scratch.data(), scratch.size()));
+    CHECK(inside(accent, scratch.data(), scratch.size()));
+    // Decoding the second value must not have moved the first
+    CHECK(quoted == "a\"b\\c/d\n");
+}
+
+void readerRejects()
+{
+    const char* bad[] = {
+        R"({"a":"\x"})",            // unknown escape
+        R"({"a":"\u12"})",          // short \u
+        R"({"a":"\u12zz"})",        // not hex
+        R"({"a":"\udc00"})",        // lone low surrogate
+        R"({"a":"\ud83d"})",        // high surrogate without its pair
+        R"({"a":"\ud83d\u0041"})",  // high surrogate, then not a low one
+        "{\"a\":\"tab\there\"}",    // raw control character
+        R"({"a":"unterminated)",
+    };
+    for (const char* text : bad) {
+        std::pmr::string scratch;
+        dto::Reader reader(text, scratch);
+        std::string_view key, value;
+        bool ok = reader.beginObject() && reader.nextKey(key) && reader.readString(value);
+        CHECK(!ok);
+        CHECK(reader.failed());
+    }
+}
+
+void schemaParses()
+{
+    const std::string body =
+        R"({"meal_name":"Oat bowl","extra":{"nested":[1,{"x":null}]},"calories":450,)"
+        R"("date":"2024-02-29","portions":null,"logged_at":9007199254740993})";
+    auto meal = MEAL_SCHEMA.parse(body);
+    CHECK(static_cast<bool>(meal));
+    CHECK(meal->meal_name == "Oat bowl");
+    CHECK(meal->calories == 450);
+    CHECK(meal->date && *meal->date == "2024-02-29");
+    CHECK(!meal->portions);
+    CHECK(meal->logged_at == 9007199254740993LL);
+
+    // Whole numbers written as 5.0 or 5e2 are integers too
+    auto floats = MEAL_SCHEMA.parse(R"({"meal_name":"x","calories":5e2,"portions":3.0})");
+    CHECK(static_cast<bool>(floats));
+    CHECK(floats->calories == 500);
+    CHECK(floats->portions && *floats->portions == 3);
+}
+
+void schemaErrors()
+{
+    CHECK(errorFor(R"({"calories":1})") == "missing field: meal_name");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"meal_name":"b"})") == "duplicate field: meal_name");
+    CHECK(errorFor(R"({"meal_name":null,"calories":1})") == "meal_name: expected a string");
+    CHECK(errorFor(R"({"meal_name":"","calories":1})") == "meal_name: must be 1-100 characters");
+    CHECK(errorFor(R"({"meal_name":"a","calories":"450"})") == "calories: expected an integer");
+    CHECK(errorFor(R"({"meal_name":"a","calories":20001})") == "calories: must be between 0 and 20000");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"date":"2024-2-3"})") == "date: expected YYYY-MM-DD");
+    CHECK(errorFor(R"([1,2])") == "expected a JSON object");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1} x)") == "invalid JSON at offset 31");
+}
+
+void integerNarrowing()
+{
+    // Each member type takes exactly its own range
+    CHECK(errorFor(R"({"meal_name":"a","calories":2147483648})") == "calories: expected an integer");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1.5})") == "calories: expected an integer");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"portions":32767})").empty());
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"portions":32768})") == "portions: expected an integer");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"portions":-32769})") == "portions: expected an integer");
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"logged_at":9223372036854775807})").empty());
+    CHECK(errorFor(R"({"meal_name":"a","calories":1,"logged_at":9223372036854775808})") == "logged_at: expected an integer");
+
+    int64_t value = 0;
+    CHECK(dto::toInt64("-9223372036854775808", value) && value == INT64_MIN);
+    CHECK(!dto::toInt64("1e19", value));
+    CHECK(!dto::toInt64("2.5", value));
+}
+
+} // namespace
+
+int main()
+{
+    readerEscapes();
+    readerRejects();
+    schemaParses();
+    schemaErrors();
+    integerNarrowing();
+    return checkResult("dto_test");
+}
@@ -0,0 +1,154 @@
+// FormData and formDecode: the strictness rules, and a randomized check
+// against the istringstream parser FormData replaced (the same reference
+// code/tools/form_bench.cpp times it against).
+#include "check.h"
+#include "formData.h"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::vector<std::string> SAMPLES = {
+    "username=alice&password=correcthorse",
+    "username=J%C3%BCrgen+M&password=p%40ss%26w0rd%3D%21%7E",
+    "username=bob&password=hunter2&remember=1&next=%2Fhome&tz=Europe%2FBerlin&lang=en&theme=dark",
+};
+
+// The pre-FormData parser, verbatim apart from names
+std::string legacyDecode(const std::string& s)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            std::string hex = s.substr(i + 1, 2);
+            char c = static_cast<char>(std::stoi(hex, nullptr, 16));
+            out << c;
+            i += 2;
+        } else if (s[i] == '+') {
+            out << ' ';
+        } else {
+            out << s[i];
+        }
+    }
+    return out.str();
+}
+
+std::map<std::string, std::string> legacyParse(const std::string& body)
+{
+    std::map<std::string, std::string> form;
+    std::istringstream stream(body);
+    std::string pair;
+    while (std::getline(stream, pair, '&')) {
+        auto pos = pair.find('=');
+        if (pos != std::string::npos) {
+            form[pair.substr(0, pos)] = legacyDecode(pair.substr(pos + 1));
+        }
+    }
+    return form;
+}
+
+std::string mutate(std::string body, std::mt19937& rng)
+{
+    static const char ALPHABET[] = "%&=+aZ09-._~ \x01\x7f\xc3";
+    std::uniform_int_distribution<int> edits(1, 4);
+    for (int n = edits(rng); n > 0; --n) {
+        std::size_t at = body.empty() ? 0 : rng() % (body.size() + 1);
+        char c = rng() % 4 == 0 ? static_cast<char>(rng()) : ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+        switch (rng() % 3) {
+            case 0: body.insert(at, 1, c); break;
+            case 1: if (at < body.size()) body.erase(at, 1); break;
+            default: if (at < body.size()) body[at] = c; break;
+        }
+    }
+    return body;
+}
+
+void decodes()
+{
+    FormData form("username=J%C3%BCrgen+M&password=p%40ss%26w0rd%3D&empty=&&remember=1&");
+    CHECK(static_cast<bool>(form));
+    CHECK(form.size() == 4);
+    CHECK(form.get("username") == std::optional<std::string_view>("J\xc3\xbcrgen M"));
+    CHECK(form.get("password") == std::optional<std::string_view>("p@ss&w0rd="));
+    CHECK(form.get("empty") == std::optional<std::string_view>(""));
+    CHECK(form.get("remember") == std::optional<std::string_view>("1"));
+    CHECK(!form.get("missing"));
+
+    std::string raw = "a+b%41";
+    std::size_t length = 0;
+    CHECK(formDecode(raw, raw.data(), length));
+    CHECK(raw.substr(0, length) == "a bA");
+}
+
+void rejects()
+{
+    const char* bad[] = {
+        "username",                     // no '='
+        "=alice",                       // empty name
+        "username=a&username=b",        // repeated name
+        "username=a=b",                 // second '='
+        "username=al ice",              // raw space
+        "username=caf\xc3\xa9",         // raw non-ASCII byte
+        "username=%4",                  // short escape
+        "username=%zz",                 // not hex
+        "username=%0A",                 // decodes to a control character
+    };
+    for (const char* body : bad) {
+        FormData form(body);
+        CHECK(!form);
+        CHECK(form.error() != nullptr);
+    }
+
+    std::string many;
+    for (std::size_t i = 0; i <= FormData::MAX_FIELDS; ++i) many += "f" + std::to_string(i) + "=1&";
+    CHECK(!FormData(many));
+    CHECK(!FormData(std::string(FormData::MAX_BYTES + 1, 'a')));
+}
+
+// Whatever FormData accepts must read the same as the old parser did
+void matchesLegacy()
+{
+    std::mt19937 rng(20261019);
+    long accepted = 0;
+    int mismatches = 0;
+    for (long i = 0; i < 50000; ++i) {
+        // Exact-size copy, so a sanitizer build flags any read past the end
+        std::string body = mutate(SAMPLES[i % SAMPLES.size()], rng);
+        std::vector<char> exact(body.begin(), body.end());
+        FormData form(std::string_view(exact.data(), exact.size()));
+        if (!form) continue;
+        accepted++;
+
+        // The old parser never decoded names
+        std::map<std::string, std::string> legacy;
+        for (auto& entry : legacyParse(body)) {
+            std::string name = entry.first;
+            std::size_t length = 0;
+            formDecode(name, name.data(), length);
+            legacy[name.substr(0, length)] = entry.second;
+        }
+        bool same = legacy.size() == form.size();
+        for (std::size_t f = 0; same && f < form.size(); ++f) {
+            auto it = legacy.find(std::string(form.name(f)));
+            same = it != legacy.end() && it->second == form.value(f);
+        }
+        if (!same && mismatches++ < 5) std::fprintf(stderr, "mismatch: %s\n", body.c_str());
+    }
+    CHECK(mismatches == 0);
+    // The mutations must leave enough bodies valid to compare anything
+    CHECK(accepted > 1000);
+}
+
+} // namespace
+
+int main()
+{
+    decodes();
+    rejects();
+    matchesLegacy();
+    return checkResult("form_data_test");
+}
@@ -0,0 +1,181 @@
+// ResponseCache invalidation: hits until the user is invalidated, nothing
+// stored from a build that raced a write, forgotten stamps, and the EventBus
+// observer that keeps read-your-writes.
+#include "check.h"
+#include "eventBus.h"
+#include "responseCache.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Users 1, 17, 33, ... share a shard
+constexpr int SHARD_STRIDE = static_cast<int>(ResponseCache::SHARDS);
+
+struct Counter {
+    int builds = 0;
+    crow::response operator()() { return crow::response(200, "body " + std::to_string(++builds)); }
+};
+
+void hitsUntilInvalidated()
+{
+    ResponseCache cache(1024 * 1024);
+    crow::request req;
+    Counter build;
+
+    CHECK(cache.serve(req, 1, "goals/active", std::ref(build)).body == "body 1");
+    CHECK(cache.serve(req, 1, "goals/active", std::ref(build)).body == "body 1");
+    CHECK(build.builds == 1);
+
+    // Other users and other keys are separate entries
+    cache.serve(req, 2, "goals/active", std::ref(build));
+    cache.serve(req, 1, "goals/completed", std::ref(build));
+    CHECK(build.builds == 3);
+
+    cache.invalidateUser(2);
+    CHECK(cache.serve(req, 1, "goals/active", std::ref(build)).body == "body 1");
+    cache.invalidateUser(1);
+    CHECK(cache.serve(req, 1, "goals/active", std::ref(build)).body == "body 4");
+    CHECK(cache.serve(req, 1, "goals/completed", std::ref(build)).body == "body 5");
+    CHECK(cache.serve(req, 1, "goals/active", std::ref(build)).body == "body 4");
+
+    // Errors are passed through, never stored
+    int failures = 0;
+    auto failing = [&] { ++failures; return crow::response(500, "down"); };
+    cache.serve(req, 1, "weekly-summary", failing);
+    CHECK(cache.serve(req, 1, "weekly-summary", failing).code == 500);
+    CHECK(failures == 2);
+
+    ResponseCache::Stats stats = cache.stats();
+    CHECK(stats.hits == 3);
+    CHECK(stats.invalidations == 2);
+}
+
+void notModified()
+{
+    ResponseCache cache(1024 * 1024);
+    Counter build;
+    crow::request first;
+    crow::response full = cache.serve(first, 1, "k", std::ref(build));
+    std::string etag = full.get_header_value("ETag");
+    CHECK(!etag.empty());
+
+    crow::request again;
+    again.add_header("If-None-Match", etag);
+    crow::response revalidated = cache.serve(again, 1, "k", std::ref(build));
+    CHECK(revalidated.code == 304);
+    CHECK(revalidated.body.empty());
+
+    cache.invalidateUser(1);
+    CHECK(cache.serve(again, 1, "k", std::ref(build)).code == 200);
+}
+
+// A body built while a write committed may predate it: serve it, don't keep it
+void raceWithWrite()
+{
+    ResponseCache cache(1024 * 1024);
+    crow::request req;
+    Counter build;
+    auto racing = [&] {
+        cache.invalidateUser(1);
+        return build();
+    };
+    CHECK(cache.serve(req, 1, "k", racing).body == "body 1");
+    CHECK(cache.stats().entries == 0);
+    CHECK(cache.serve(req, 1, "k", std::ref(build)).body == "body 2");
+    CHECK(cache.serve(req, 1, "k", std::ref(build)).body == "body 2");
+
+    // Another user's write in the same shard doesn't matter
+    auto neighbour = [&] {
+        cache.invalidateUser(1 + SHARD_STRIDE);
+        return build();
+    };
+    cache.serve(req, 1, "other", neighbour);
+    CHECK(cache.serve(req, 1, "other", std::ref(build)).body == "body 3");
+}
+
+// Forgetting the oldest stamps only costs entries built before them
+void forgottenStamps()
+{
+    ResponseCache cache(16 * 1024 * 1024);
+    crow::request req;
+    Counter build;
+
+    cache.serve(req, 1, "old", std::ref(build));
+    cache.invalidateUser(1);
+    cache.serve(req, 1, "k", std::ref(build));            // body 2, after user 1's stamp
+    for (std::size_t i = 0; i < ResponseCache::STAMPS_PER_SHARD + 8; ++i) {
+        cache.invalidateUser(1 + SHARD_STRIDE * static_cast<int>(i + 1));
+    }
+    // User 1's stamp is gone, yet its invalidation still holds for "old"...
+    CHECK(cache.serve(req, 1, "old", std::ref(build)).body == "body 3");
+    // ...and what was built after it is stale only because the floor passed it
+    CHECK(cache.serve(req, 1, "k", std::ref(build)).body == "body 4");
+    CHECK(cache.serve(req, 1, "k", std::ref(build)).body == "body 4");
+
+    // A recently stamped user is still remembered
+    int recent = 1 + SHARD_STRIDE * static_cast<int>(ResponseCache::STAMPS_PER_SHARD + 8);
+    cache.serve(req, recent, "k", std::ref(build));
+    CHECK(cache.serve(req, recent, "k", std::ref(build)).body == "body 5");
+    cache.invalidateUser(recent);
+    CHECK(cache.serve(req, recent, "k", std::ref(build)).body == "body 6");
+}
+
+void sharedEntriesExpire()
+{
+    ResponseCache cache(1024 * 1024);
+    crow::request req;
+    Counter build;
+    auto ttl = std::chrono::milliseconds(20);
+    cache.serve(req, 0, "top-users/10", std::ref(build), ttl);
+    cache.invalidateUser(0);
+    CHECK(cache.serve(req, 0, "top-users/10", std::ref(build), ttl).body == "body 1");
+    std::this_thread::sleep_for(ttl * 2);
+    CHECK(cache.serve(req, 0, "top-users/10", std::ref(build), ttl).body == "body 2");
+}
+
+void disabled()
+{
+    ResponseCache cache(0);
+    crow::request req;
+    Counter build;
+    cache.serve(req, 1, "k", std::ref(build));
+    cache.serve(req, 1, "k", std::ref(build));
+    CHECK(build.builds == 2);
+}
+
+// The observer runs inside publish(), so the write's own next read misses
+void observesTheBus()
+{
+    ResponseCache cache(1024 * 1024);
+    EventBus bus;
+    cache.subscribe(bus);
+    crow::request req;
+    Counter build;
+
+    cache.serve(req, 1, "friends", std::ref(build));
+    cache.serve(req, 2, "friends", std::ref(build));
+    bus.publish(ChangeEvent{ChangeEntity::Friendship, ChangeOp::Insert, 1, 0, 2});
+    CHECK(cache.serve(req, 1, "friends", std::ref(build)).body == "body 3");
+    CHECK(cache.serve(req, 2, "friends", std::ref(build)).body == "body 4");
+
+    bus.publish(ChangeEvent{ChangeEntity::Meal, ChangeOp::Insert, 2, 42});
+    CHECK(cache.serve(req, 1, "friends", std::ref(build)).body == "body 3");
+    CHECK(cache.serve(req, 2, "friends", std::ref(build)).body == "body 5");
+}
+
+} // namespace
+
+int main()
+{
+    hitsUntilInvalidated();
+    notModified();
+    raceWithWrite();
+    forgottenStamps();
+    sharedEntriesExpire();
+    disabled();
+    observesTheBus();
+    return checkResult("response_cache_test");
+}
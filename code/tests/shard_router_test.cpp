@@ -0,0 +1,164 @@
+// ShardRouter id math: which shard a user and a row id land on, shard file
+// names, and that each shard hands out ids from its own range. Also that
+// shards (and the directory) take writes while another shard is mid-transaction.
+#include "check.h"
+#include "db/schema.h"
+#include "shardRouter.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int64_t SPAN = ShardRouter::ROW_ID_SPAN;
+
+void idMath(Database& directory)
+{
+    // Ids must stay within int columns and <int> route parameters
+    CHECK(SPAN * ShardRouter::MAX_SHARDS == (int64_t{1} << 31));
+
+    ShardRouter single(directory, "unused.db", loadStorageProfile(), 1);
+    CHECK(!single.sharded());
+    CHECK(single.shardOfUser(7) == 0);
+    CHECK(single.shardOfRow(3 * SPAN + 5) == 0);
+    CHECK(&single.forUser(7) == &directory);
+
+    ShardRouter four(directory, "unused.db", loadStorageProfile(), 4);
+    CHECK(four.shardOfUser(0) == 0);
+    CHECK(four.shardOfUser(5) == 1);
+    CHECK(four.shardOfUser(4 * 1000 + 3) == 3);
+    CHECK(four.shardOfUser(-1) == 3);
+
+    CHECK(four.shardOfRow(1) == 0);
+    CHECK(four.shardOfRow(SPAN - 1) == 0);
+    CHECK(four.shardOfRow(SPAN) == 1);
+    CHECK(four.shardOfRow(2 * SPAN + 1) == 2);
+    CHECK(four.shardOfRow(4 * SPAN - 1) == 3);
+    // Outside the layout (old ids, made-up ids) falls back to shard 0
+    CHECK(four.shardOfRow(4 * SPAN) == 0);
+    CHECK(four.shardOfRow(15 * SPAN) == 0);
+    CHECK(four.shardOfRow(-5) == 0);
+    CHECK(four.shardOfRow(0) == 0);
+
+    CHECK(shardPath("fitness.db", 2, 4) == "fitness.shard-2-of-4.db");
+    CHECK(shardPath("/var/lib/app/fitness.db", 0, 2) == "/var/lib/app/fitness.shard-0-of-2.db");
+    CHECK(shardPath("/var/lib/app.d/fitness", 1, 3) == "/var/lib/app.d/fitness.shard-1-of-3.db");
+}
+
+int64_t insertExercise(sqlite3* db, int userId)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO exercises (user_id, date, type) VALUES (?, '2024-01-01', 'run');",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, userId);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? sqlite3_last_insert_rowid(db) : -1;
+}
+
+// Rows written to a user's shard get ids that route back to that shard
+void shardRanges(const std::string& directoryPath, Database& directory)
+{
+    CHECK(setStoredShardCount(directory.write(), 4));
+    ShardRouter shards(directory, directoryPath, loadStorageProfile(), 4);
+    CHECK(shards.open());
+    for (int userId = 1; userId <= 8; ++userId) {
+        int64_t id = insertExercise(shards.forUser(userId).write(), userId);
+        int index = shards.shardOfUser(userId);
+        CHECK(id > index * SPAN && id < (index + 1) * SPAN);
+        CHECK(shards.shardOfRow(id) == index);
+        CHECK(&shards.forRow(id) == &shards.forUser(userId));
+    }
+    CHECK(shards.close());
+}
+
+// One shard holds a transaction open while another shard and the directory
+// commit. Shard writers ATTACH the directory, so this fails if a shard
+// transaction locks more than the file it writes.
+void concurrentShards(const std::string& directoryPath, Database& directory)
+{
+    ShardRouter shards(directory, directoryPath, loadStorageProfile(), 4);
+    CHECK(shards.open());
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool holding = false, othersDone = false, doneWhileHeld = false;
+
+    std::thread holder([&] {
+        auto db = shards.shard(0).write();
+        CHECK(inTransaction(db, [&] {
+            if (insertExercise(db, 4) < 0) return false;
+            std::unique_lock<std::mutex> lock(mutex);
+            holding = true;
+            changed.notify_all();
+            changed.wait_for(lock, std::chrono::seconds(3), [&] { return othersDone; });
+            doneWhileHeld = othersDone;
+            return true;
+        }));
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return holding; });
+    }
+    auto started = std::chrono::steady_clock::now();
+    {
+        auto db = shards.shard(1).write();
+        CHECK(inTransaction(db, [&] { return insertExercise(db, 5) > 0; }));
+    }
+    {
+        auto db = shards.shard(2).write();
+        CHECK(sqlite3_exec(db, "UPDATE score_totals SET score = score WHERE 0;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    }
+    {
+        auto db = directory.write();
+        CHECK(inTransaction(db, [&] {
+            return sqlite3_exec(db, "INSERT INTO users (first_name, last_name, username, password_hash, email) "
+                                    "VALUES ('a', 'b', 'concurrent', 'x', 'c@example.com');",
+                                nullptr, nullptr, nullptr) == SQLITE_OK;
+        }));
+    }
+    // No busy-timeout waits either
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(1));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        othersDone = true;
+    }
+    changed.notify_all();
+    holder.join();
+    CHECK(doneWhileHeld);
+    CHECK(shards.close());
+}
+
+} // namespace
+
+int main()
+{
+    char pattern[] = "/tmp/shard_router_test-XXXXXX";
+    const char* dir = mkdtemp(pattern);
+    CHECK(dir != nullptr);
+    if (!dir) return checkResult("shard_router_test");
+
+    std::string directoryPath = std::string(dir) + "/fitness.db";
+    {
+        Database directory(directoryPath, loadStorageProfile());
+        CHECK(directory.open());
+        CHECK(ensureSchema(directory.write()));
+        idMath(directory);
+        shardRanges(directoryPath, directory);
+        concurrentShards(directoryPath, directory);
+        CHECK(directory.close());
+    }
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    return checkResult("shard_router_test");
+}
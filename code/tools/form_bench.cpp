@@ -0,0 +1,153 @@
+// Checks and times FormData (the /login body parser) against the
+// istringstream parser it replaced.
+//
+//   form_bench [iterations] [mutations]
+//
+// check   `mutations` random edits of the sample bodies (default 200k). The
+//         parser must never read outside the body, and whatever it accepts
+//         must agree with the old parser, which stays here as the reference.
+// bench   ns per parse for each sample body, old parser vs FormData (inside
+//         a request arena, as the server runs it).
+#include "formData.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample {
+    const char* name;
+    std::string body;
+};
+
+const std::vector<Sample> SAMPLES = {
+    {"login", "username=alice&password=correcthorse"},
+    {"login-escaped", "username=J%C3%BCrgen+M&password=p%40ss%26w0rd%3D%21%7E"},
+    {"8-fields", "username=bob&password=hunter2&remember=1&next=%2Fhome&tz=Europe%2FBerlin"
+                 "&lang=en&theme=dark&csrf=6f1c2a9b7d3e4f5a"},
+};
+
+// The pre-FormData parser, verbatim apart from names
+std::string legacyDecode(const std::string& s)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            std::string hex = s.substr(i + 1, 2);
+            char c = static_cast<char>(std::stoi(hex, nullptr, 16));
+            out << c;
+            i += 2;
+        } else if (s[i] == '+') {
+            out << ' ';
+        } else {
+            out << s[i];
+        }
+    }
+    return out.str();
+}
+
+std::map<std::string, std::string> legacyParse(const std::string& body)
+{
+    std::map<std::string, std::string> form;
+    std::istringstream stream(body);
+    std::string pair;
+    while (std::getline(stream, pair, '&')) {
+        auto pos = pair.find('=');
+        if (pos != std::string::npos) {
+            form[pair.substr(0, pos)] = legacyDecode(pair.substr(pos + 1));
+        }
+    }
+    return form;
+}
+
+std::string mutate(std::string body, std::mt19937& rng)
+{
+    static const char ALPHABET[] = "%&=+aZ09-._~ \x01\x7f\xc3";
+    std::uniform_int_distribution<int> edits(1, 4);
+    for (int n = edits(rng); n > 0; --n) {
+        std::size_t at = body.empty() ? 0 : rng() % (body.size() + 1);
+        char c = rng() % 4 == 0 ? static_cast<char>(rng()) : ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+        switch (rng() % 3) {
+            case 0: body.insert(at, 1, c); break;
+            case 1: if (at < body.size()) body.erase(at, 1); break;
+            default: if (at < body.size()) body[at] = c; break;
+        }
+    }
+    return body;
+}
+
+// Returns the number of disagreements
+long check(long mutations)
+{
+    std::mt19937 rng(20261019);
+    long accepted = 0, mismatches = 0;
+    for (long i = 0; i < mutations; ++i) {
+        // Exact-size copy, so ASan flags any read past the end
+        std::string body = mutate(SAMPLES[i % SAMPLES.size()].body, rng);
+        std::vector<char> exact(body.begin(), body.end());
+        FormData form(std::string_view(exact.data(), exact.size()));
+        if (!form) continue;
+        accepted++;
+
+        // The old parser never decoded names
+        std::map<std::string, std::string> legacy;
+        for (auto& entry : legacyParse(body)) {
+            std::string name = entry.first;
+            std::size_t length = 0;
+            formDecode(name, name.data(), length);
+            legacy[name.substr(0, length)] = entry.second;
+        }
+        bool same = legacy.size() == form.size();
+        for (std::size_t f = 0; same && f < form.size(); ++f) {
+            auto it = legacy.find(std::string(form.name(f)));
+            same = it != legacy.end() && it->second == form.value(f);
+        }
+        if (!same) {
+            if (mismatches++ < 5) std::printf("mismatch: %s\n", body.c_str());
+        }
+    }
+    std::printf("check: %ld mutations, %ld accepted, %ld mismatches\n", mutations, accepted, mismatches);
+    return mismatches;
+}
+
+template <typename F>
+double nsPerCall(long iterations, F&& f)
+{
+    auto start = Clock::now();
+    for (long i = 0; i < iterations; ++i) f();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    long iterations = argc > 1 ? std::max(1L, std::atol(argv[1])) : 1000000;
+    long mutations = argc > 2 ? std::max(0L, std::atol(argv[2])) : 200000;
+
+    long mismatches = check(mutations);
+
+    std::printf("%-14s %10s %10s %8s\n", "body", "legacy ns", "form ns", "speedup");
+    volatile std::size_t sink = 0;
+    for (const Sample& sample : SAMPLES) {
+        double legacy = nsPerCall(iterations, [&] { sink = sink + legacyParse(sample.body).size(); });
+        double fast = nsPerCall(iterations, [&] {
+            openRequestArena();
+            {
+                FormData form(sample.body);
+                sink = sink + form.get("password").value_or("").size();
+            }
+            closeRequestArena();
+        });
+        std::printf("%-14s %10.0f %10.0f %7.1fx\n", sample.name, legacy, fast, legacy / fast);
+    }
+    return mismatches == 0 ? 0 : 1;
+}
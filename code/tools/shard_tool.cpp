@@ -0,0 +1,381 @@
+// Offline resharding for FITNESS_SHARD_COUNT.
+//
+//   shard_tool <fitness.db> status
+//   shard_tool <fitness.db> reshard <count>
+//
+// Stop the server first: this is an offline tool. Each file is read and
+// written in its own transaction, and SQLite has no transaction that spans
+// files, so a server writing meanwhile could commit rows to an old shard after
+// they were copied (and lose them when it is deleted). reshard takes the write
+// lock of the directory and of every old shard before it reads anything, so
+// such writes fail or wait rather than slip in, but that is a backstop, not a
+// way to run it live.
+//
+// reshard copies every per-user row into the files of
+// the new layout (user_id % count), then switches shard_layout in the
+// directory in one transaction and only then deletes the old shard files, so
+// an interrupted run leaves the old layout intact. Moved rows get ids from
+// their new shard's range; references between them (exercises.session_id,
+// goal_progress.goal_id, score_events.source_id) are rewritten to match.
+// Start the server again with FITNESS_SHARD_COUNT=<count>.
+#include "db/schema.h"
+#include "shardRouter.h"
+#include "storageProfile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Copy order: parents before the rows that point at them.
+struct TableSpec {
+    const char* name;
+    const char* idColumn;
+    const char* select;   // every column, plus the owner as the last one
+};
+
+const TableSpec TABLES[] = {
+    {"sessions", "id", "SELECT *, user_id FROM sessions;"},
+    {"goals", "id", "SELECT *, user_id FROM goals;"},
+    {"exercises", "id", "SELECT *, user_id FROM exercises;"},
+    {"goal_progress", "id", "SELECT p.*, g.user_id FROM goal_progress p JOIN goals g ON g.id = p.goal_id;"},
+    {"nutrition", "id", "SELECT *, user_id FROM nutrition;"},
+    {"sleepTable", "sleep_id", "SELECT *, user_id FROM sleepTable;"},
+    {"score_events", "id", "SELECT *, user_id FROM score_events;"},
+};
+
+// score_events.kind -> table its source_id points into
+const std::map<std::string, std::string> SCORE_SOURCES = {
+    {"exercise", "exercises"}, {"meal", "nutrition"}, {"sleep", "sleepTable"},
+    {"goal_progress", "goal_progress"}, {"goal_completed", "goals"},
+};
+
+// old id -> new id, per table
+using IdMap = std::unordered_map<std::string, std::unordered_map<int64_t, int64_t>>;
+
+bool exec(sqlite3* db, const std::string& sql)
+{
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::fprintf(stderr, "%s\nSQL: %s\n", errMsg ? errMsg : "", sql.c_str());
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+sqlite3* openFile(const std::string& path, const StorageProfile& profile)
+{
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::fprintf(stderr, "open %s: %s\n", path.c_str(), sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return nullptr;
+    }
+    applyStorageProfile(db, profile);
+    // Rows arrive parents first, but a goal_progress row whose goal is gone would not
+    exec(db, "PRAGMA foreign_keys = OFF;");
+    return db;
+}
+
+void removeFile(const std::string& path)
+{
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) std::remove((path + suffix).c_str());
+}
+
+std::vector<std::string> columnsOf(sqlite3* db, const char* table)
+{
+    std::vector<std::string> columns;
+    sqlite3_stmt* stmt;
+    std::string sql = std::string("PRAGMA main.table_info(") + table + ");";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            columns.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return columns;
+}
+
+int64_t countRows(sqlite3* db, const char* table)
+{
+    sqlite3_stmt* stmt;
+    int64_t n = -1;
+    std::string sql = std::string("SELECT COUNT(*) FROM main.") + table + ";";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) n = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return n;
+}
+
+// Copies one table from `source` into the target of each row's owner,
+// renumbering ids and rewriting references to tables copied before it.
+bool copyTable(sqlite3* source, const TableSpec& table, std::vector<sqlite3*>& targets, IdMap& ids, int64_t& copied)
+{
+    std::vector<std::string> columns = columnsOf(source, table.name);
+    if (columns.empty()) {
+        std::fprintf(stderr, "no table %s\n", table.name);
+        return false;
+    }
+
+    // INSERT without the id column; the target's AUTOINCREMENT picks the new id.
+    std::string names, params;
+    for (const std::string& c : columns) {
+        if (c == table.idColumn) continue;
+        names += (names.empty() ? "" : ", ") + c;
+        params += params.empty() ? "?" : ", ?";
+    }
+    std::string insertSql = std::string("INSERT INTO main.") + table.name + " (" + names + ") VALUES (" + params + ");";
+    std::vector<sqlite3_stmt*> inserts(targets.size(), nullptr);
+    for (std::size_t t = 0; t < targets.size(); ++t) {
+        if (sqlite3_prepare_v2(targets[t], insertSql.c_str(), -1, &inserts[t], nullptr) != SQLITE_OK) {
+            std::fprintf(stderr, "%s: %s\n", insertSql.c_str(), sqlite3_errmsg(targets[t]));
+            for (sqlite3_stmt* s : inserts) sqlite3_finalize(s);
+            return false;
+        }
+    }
+
+    sqlite3_stmt* select;
+    if (sqlite3_prepare_v2(source, table.select, -1, &select, nullptr) != SQLITE_OK) {
+        std::fprintf(stderr, "%s: %s\n", table.select, sqlite3_errmsg(source));
+        for (sqlite3_stmt* s : inserts) sqlite3_finalize(s);
+        return false;
+    }
+
+    bool ok = true;
+    int ownerColumn = static_cast<int>(columns.size());
+    while (ok && sqlite3_step(select) == SQLITE_ROW) {
+        int owner = sqlite3_column_int(select, ownerColumn);
+        int t = owner % static_cast<int>(targets.size());
+        sqlite3_stmt* insert = inserts[t];
+
+        std::string kind;
+        int param = 1;
+        int64_t oldId = 0;
+        bool orphan = false;
+        for (int c = 0; c < ownerColumn && !orphan; ++c) {
+            const std::string& name = columns[c];
+            if (name == table.idColumn) {
+                oldId = sqlite3_column_int64(select, c);
+                continue;
+            }
+            if (name == "kind") {
+                const unsigned char* text = sqlite3_column_text(select, c);
+                kind = text ? reinterpret_cast<const char*>(text) : "";
+            }
+
+            // References to rows that were renumbered
+            const char* refTable = nullptr;
+            if (name == "session_id") refTable = "sessions";
+            else if (name == "goal_id") refTable = "goals";
+            else if (name == "source_id") {
+                auto it = SCORE_SOURCES.find(kind);
+                refTable = it != SCORE_SOURCES.end() ? it->second.c_str() : nullptr;
+            }
+
+            if (refTable && sqlite3_column_type(select, c) != SQLITE_NULL) {
+                auto& map = ids[refTable];
+                auto found = map.find(sqlite3_column_int64(select, c));
+                if (found != map.end()) sqlite3_bind_int64(insert, param, found->second);
+                else if (name == "session_id") sqlite3_bind_null(insert, param);   // dangling before, dangling after
+                else orphan = true;   // a score for a row that no longer exists
+            } else {
+                sqlite3_bind_value(insert, param, sqlite3_column_value(select, c));
+            }
+            param++;
+        }
+
+        if (orphan) {
+            sqlite3_reset(insert);
+            sqlite3_clear_bindings(insert);
+            continue;
+        }
+        if (sqlite3_step(insert) != SQLITE_DONE) {
+            std::fprintf(stderr, "insert into %s: %s\n", table.name, sqlite3_errmsg(targets[t]));
+            ok = false;
+        }
+        ids[table.name][oldId] = sqlite3_last_insert_rowid(targets[t]);
+        sqlite3_reset(insert);
+        sqlite3_clear_bindings(insert);
+        copied++;
+    }
+    sqlite3_finalize(select);
+    for (sqlite3_stmt* s : inserts) sqlite3_finalize(s);
+    return ok;
+}
+
+int status(sqlite3* directory, const std::string& path, const StorageProfile& profile)
+{
+    int count = storedShardCount(directory);
+    std::printf("layout: %d shard(s)%s\n", count, count == 1 ? " (per-user tables in the directory)" : "");
+
+    std::printf("%-40s", "file");
+    for (const TableSpec& table : TABLES) std::printf(" %13s", table.name);
+    std::printf("\n");
+    for (int i = 0; i < count; ++i) {
+        std::string file = count == 1 ? path : shardPath(path, i, count);
+        sqlite3* db = count == 1 ? directory : openFile(file, profile);
+        if (!db) return 1;
+        std::printf("%-40s", file.c_str());
+        for (const TableSpec& table : TABLES) std::printf(" %13lld", static_cast<long long>(countRows(db, table.name)));
+        std::printf("\n");
+        if (db != directory) sqlite3_close(db);
+    }
+    return 0;
+}
+
+int reshard(sqlite3* directory, const std::string& path, const StorageProfile& profile, int newCount)
+{
+    int oldCount = storedShardCount(directory);
+    if (oldCount < 1) {
+        std::fprintf(stderr, "cannot read shard_layout from %s\n", path.c_str());
+        return 1;
+    }
+    if (oldCount == newCount) {
+        std::printf("already laid out for %d shard(s)\n", newCount);
+        return 0;
+    }
+
+    // Old files are read as they are; new ones start empty (leftovers of an aborted run go).
+    std::vector<sqlite3*> sources, targets;
+    auto closeAll = [&] {
+        for (sqlite3* db : sources) if (db != directory) sqlite3_close(db);
+        for (sqlite3* db : targets) if (db != directory) sqlite3_close(db);
+    };
+    for (int i = 0; i < oldCount; ++i) {
+        sqlite3* db = oldCount == 1 ? directory : openFile(shardPath(path, i, oldCount), profile);
+        if (!db) { closeAll(); return 1; }
+        sources.push_back(db);
+    }
+    for (int j = 0; j < newCount; ++j) {
+        sqlite3* db = directory;
+        if (newCount > 1) {
+            std::string file = shardPath(path, j, newCount);
+            removeFile(file);
+            db = openFile(file, profile);
+            if (!db || !ensureShardSchema(db, j * ShardRouter::ROW_ID_SPAN + 1)) {
+                if (db) sqlite3_close(db);
+                closeAll();
+                return 1;
+            }
+        }
+        targets.push_back(db);
+    }
+
+    // The directory's transaction is the switch-over: it commits the new
+    // layout (and, going back to 1, the rows themselves) last. Every old shard
+    // is pinned too, before the first row is read.
+    bool ok = exec(directory, "BEGIN IMMEDIATE;");
+    for (sqlite3* db : sources) if (ok && db != directory) ok = exec(db, "BEGIN IMMEDIATE;");
+    for (sqlite3* db : targets) if (ok && db != directory) ok = exec(db, "BEGIN;");
+
+    IdMap ids;
+    for (sqlite3* source : sources) {
+        for (const TableSpec& table : TABLES) {
+            if (!ok) break;
+            int64_t copied = 0;
+            ok = copyTable(source, table, targets, ids, copied);
+            std::printf("%-14s %10lld rows\n", table.name, static_cast<long long>(copied));
+        }
+    }
+
+    // Totals and users.score straight from the copied events, so nothing is left to sync.
+    if (ok && newCount > 1) {
+        for (sqlite3* db : targets) {
+            ok = ok && exec(db,
+                "INSERT INTO score_totals (user_id, score, version, synced_version) "
+                "SELECT user_id, SUM(points), 1, 1 FROM score_events GROUP BY user_id;");
+        }
+    }
+    if (ok) {
+        ok = exec(directory, "UPDATE users SET score = 0;");
+        for (sqlite3* db : targets) {
+            sqlite3_stmt* sums;
+            sqlite3_stmt* update;
+            if (!ok || sqlite3_prepare_v2(db, "SELECT user_id, SUM(points) FROM main.score_events GROUP BY user_id;", -1, &sums, nullptr) != SQLITE_OK) {
+                ok = false;
+                break;
+            }
+            if (sqlite3_prepare_v2(directory, "UPDATE users SET score = ? WHERE id = ?;", -1, &update, nullptr) != SQLITE_OK) {
+                sqlite3_finalize(sums);
+                ok = false;
+                break;
+            }
+            while (sqlite3_step(sums) == SQLITE_ROW) {
+                sqlite3_bind_int(update, 1, sqlite3_column_int(sums, 1));
+                sqlite3_bind_int(update, 2, sqlite3_column_int(sums, 0));
+                ok = sqlite3_step(update) == SQLITE_DONE && ok;
+                sqlite3_reset(update);
+            }
+            sqlite3_finalize(sums);
+            sqlite3_finalize(update);
+        }
+    }
+
+    // Leaving the unsharded layout: the directory keeps its (now empty) per-user tables.
+    if (ok && oldCount == 1) {
+        for (int t = static_cast<int>(std::size(TABLES)) - 1; ok && t >= 0; --t) {
+            ok = exec(directory, std::string("DELETE FROM main.") + TABLES[t].name + ";");
+        }
+    }
+
+    for (sqlite3* db : targets) if (ok && db != directory) ok = exec(db, "COMMIT;");
+    ok = ok && setStoredShardCount(directory, newCount) && exec(directory, "COMMIT;");
+    for (sqlite3* db : sources) {
+        if (db != directory && !sqlite3_get_autocommit(db)) exec(db, "ROLLBACK;");   // read only, nothing to keep
+    }
+    if (!ok) {
+        exec(directory, "ROLLBACK;");
+        closeAll();
+        for (int j = 0; newCount > 1 && j < newCount; ++j) removeFile(shardPath(path, j, newCount));
+        std::fprintf(stderr, "reshard failed; still laid out for %d shard(s)\n", oldCount);
+        return 1;
+    }
+
+    closeAll();
+    for (int i = 0; oldCount > 1 && i < oldCount; ++i) removeFile(shardPath(path, i, oldCount));
+    std::printf("now laid out for %d shard(s); start the server with FITNESS_SHARD_COUNT=%d\n", newCount, newCount);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || (std::string(argv[2]) == "reshard" && argc < 4)) {
+        std::fprintf(stderr, "usage: shard_tool <fitness.db> status\n       shard_tool <fitness.db> reshard <count>\n");
+        return 2;
+    }
+    std::string path = argv[1];
+    std::string command = argv[2];
+    StorageProfile profile = loadStorageProfile();
+
+    sqlite3* directory = openFile(path, profile);
+    if (!directory) return 1;
+    if (!ensureSchema(directory)) {
+        sqlite3_close(directory);
+        return 1;
+    }
+
+    int rc = 2;
+    if (command == "status") {
+        rc = status(directory, path, profile);
+    } else if (command == "reshard") {
+        int count = std::atoi(argv[3]);
+        if (count < 1 || count > ShardRouter::MAX_SHARDS) {
+            std::fprintf(stderr, "count must be 1..%d\n", ShardRouter::MAX_SHARDS);
+        } else {
+            rc = reshard(directory, path, profile, count);
+        }
+    } else {
+        std::fprintf(stderr, "unknown command %s\n", command.c_str());
+    }
+    sqlite3_close(directory);
+    return rc;
+}
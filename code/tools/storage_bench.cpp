@@ -0,0 +1,176 @@
+// Compares the storage profiles (FITNESS_DB_PROFILE) on this machine's disk.
+//
+//   storage_bench [dir] [seconds-per-phase]
+//
+// For each profile, on a fresh database in `dir` (default /tmp) seeded with
+// 50k session rows:
+//   commits/s         single-row INSERT transactions from one writer, alone
+//   loaded commits/s  the same writer while 4 readers run
+//   reads/s, p99      day-window reads (the dashboard query) from the readers
+//   busy              reads that failed on a lock (legacy has no busy timeout)
+#include "storageProfile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int SEED_ROWS = 50000;
+constexpr int USERS = 500;
+constexpr int READERS = 4;
+
+struct Result {
+    double commitsPerSec = 0;
+    double loadedCommitsPerSec = 0;
+    double readsPerSec = 0;
+    double p99ReadUs = 0;
+    long busy = 0;
+};
+
+sqlite3* openWith(const std::string& path, const StorageProfile& profile)
+{
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::fprintf(stderr, "open %s: %s\n", path.c_str(), sqlite3_errmsg(db));
+        std::exit(1);
+    }
+    applyStorageProfile(db, profile);
+    return db;
+}
+
+void seed(sqlite3* db)
+{
+    sqlite3_exec(db,
+                 "CREATE TABLE sessions (id INTEGER PRIMARY KEY, user_id INTEGER, day INTEGER, minutes INTEGER);"
+                 "CREATE INDEX idx_sessions_user_day ON sessions(user_id, day);"
+                 "BEGIN;",
+                 nullptr, nullptr, nullptr);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO sessions (user_id, day, minutes) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+    for (int i = 0; i < SEED_ROWS; ++i) {
+        sqlite3_bind_int(stmt, 1, i % USERS);
+        sqlite3_bind_int(stmt, 2, 19000 + i / USERS);
+        sqlite3_bind_int(stmt, 3, 20 + i % 40);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+}
+
+// One INSERT per transaction until `stop`; returns commits.
+long writeUntil(sqlite3* db, const std::atomic<bool>& stop)
+{
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "INSERT INTO sessions (user_id, day, minutes) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+    long commits = 0;
+    while (!stop) {
+        sqlite3_bind_int(stmt, 1, static_cast<int>(commits % USERS));
+        sqlite3_bind_int(stmt, 2, 19100);
+        sqlite3_bind_int(stmt, 3, 30);
+        if (sqlite3_step(stmt) == SQLITE_DONE) commits++;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return commits;
+}
+
+void readUntil(sqlite3* db, const std::atomic<bool>& stop, std::vector<double>& latenciesUs, long& busy, unsigned seed)
+{
+    const char* sql = "SELECT SUM(minutes) FROM sessions WHERE user_id = ? AND day BETWEEN ? AND ?;";
+    sqlite3_stmt* stmt = nullptr;
+    std::mt19937 rng(seed);
+    while (!stop) {
+        // Preparing reads the schema, which can itself hit the writer's lock.
+        if (!stmt && sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            busy++;
+            continue;
+        }
+        int user = static_cast<int>(rng() % USERS);
+        int first = 19000 + static_cast<int>(rng() % 90);
+        sqlite3_bind_int(stmt, 1, user);
+        sqlite3_bind_int(stmt, 2, first);
+        sqlite3_bind_int(stmt, 3, first + 7);
+        auto start = Clock::now();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {}
+        if (rc != SQLITE_DONE) busy++;
+        else latenciesUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+}
+
+Result run(const std::string& dir, const StorageProfile& profile, int seconds)
+{
+    std::string path = dir + "/storage_bench_" + profile.name + ".db";
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) std::remove((path + suffix).c_str());
+
+    Result r;
+    sqlite3* writer = openWith(path, profile);
+    seed(writer);
+
+    std::atomic<bool> stop{false};
+    std::thread timer([&] { std::this_thread::sleep_for(std::chrono::seconds(seconds)); stop = true; });
+    r.commitsPerSec = static_cast<double>(writeUntil(writer, stop)) / seconds;
+    timer.join();
+
+    stop = false;
+    std::vector<std::vector<double>> latencies(READERS);
+    std::vector<long> busy(READERS, 0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < READERS; ++i) {
+        readers.emplace_back([&, i] {
+            sqlite3* db = openWith(path, profile);
+            readUntil(db, stop, latencies[i], busy[i], 1234u + i);
+            sqlite3_close(db);
+        });
+    }
+    timer = std::thread([&] { std::this_thread::sleep_for(std::chrono::seconds(seconds)); stop = true; });
+    r.loadedCommitsPerSec = static_cast<double>(writeUntil(writer, stop)) / seconds;
+    timer.join();
+    for (std::thread& t : readers) t.join();
+    sqlite3_close(writer);
+
+    std::vector<double> all;
+    for (int i = 0; i < READERS; ++i) {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+        r.busy += busy[i];
+    }
+    r.readsPerSec = static_cast<double>(all.size()) / seconds;
+    if (!all.empty()) {
+        std::size_t k = all.size() * 99 / 100;
+        std::nth_element(all.begin(), all.begin() + k, all.end());
+        r.p99ReadUs = all[k];
+    }
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) std::remove((path + suffix).c_str());
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+    int seconds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+    std::printf("%-11s %-8s %-7s %11s %17s %10s %12s %8s\n", "profile", "journal", "sync", "commits/s",
+                "loaded commits/s", "reads/s", "p99 read us", "busy");
+    for (const std::string& name : storageProfileNames()) {
+        StorageProfile profile;
+        storageProfilePreset(name, profile);
+        Result r = run(dir, profile, seconds);
+        std::printf("%-11s %-8s %-7s %11.0f %17.0f %10.0f %12.0f %8ld\n", name.c_str(), profile.journalMode.c_str(),
+                    profile.synchronous.c_str(), r.commitsPerSec, r.loadedCommitsPerSec, r.readsPerSec, r.p99ReadUs,
+                    r.busy);
+    }
+    return 0;
+}